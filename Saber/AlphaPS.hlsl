@@ -1,5 +1,7 @@
+#include "GBufferEncoding.hlsli"
 #include "Math.hlsli"
 #include "MaterialCB.h"
+#include "ObjectData.hlsli"
 
 struct SceneBuffer
 {
@@ -11,15 +13,6 @@ struct SceneBuffer
 
 ConstantBuffer<SceneBuffer> SceneCB : register(b0);
 
-struct ModelBuffer
-{
-    matrix modelMatrix;
-    matrix normalMatrix;
-    uint4 materialId;
-};
-
-ConstantBuffer<ModelBuffer> ModelCB : register(b1);
-
 ConstantBuffer<MaterialCB> Materials : register(b2);
 Texture2D<float4> MaterialsTextures[] : register(t0);
 
@@ -31,17 +24,20 @@ struct PSInput
     float3 norm : NORMAL;
     float4 tang : TANGENT;
     float2 uv : TEXCOORD;
+    nointerpolation uint objectId : OBJECT_ID;
 };
 
 struct PSOutput
 {
-    float4 uvMaterialId : SV_Target0;
-    float4 tbn : SV_Target1;
+    uint4 uvMaterialId : SV_Target0;
+    uint4 tbn : SV_Target1;
 };
 
 PSOutput main(PSInput input)
 {
-    if (MaterialsTextures[Materials.materials[ModelCB.materialId.x].x].Sample(s1, input.uv).w == 0.f)
+    uint materialId = GetObjectData(input.objectId).materialId.x;
+    
+    if (MaterialsTextures[Materials.materials[materialId].x].Sample(s1, input.uv).w == 0.f)
     {
         discard;
     }
@@ -59,8 +55,8 @@ PSOutput main(PSInput input)
     float4 tbnQuat = matrix_to_quaternion(tbnMatrix);
     
     PSOutput output;
-    output.uvMaterialId = float4(input.uv, ModelCB.materialId.x, 0.f);
-    output.tbn = tbnQuat;
+    output.uvMaterialId = EncodeUvMaterialId(input.uv, materialId);
+    output.tbn = EncodeQuaternion(tbnQuat);
     
     return output;
 }
@@ -1,3 +1,5 @@
+#include "ObjectData.hlsli"
+
 struct SceneBuffer
 {
     matrix vpMatrix;
@@ -8,21 +10,13 @@ struct SceneBuffer
 
 ConstantBuffer<SceneBuffer> SceneCB : register(b0);
 
-struct ModelBuffer
-{
-    matrix modelMatrix;
-    matrix normalMatrix;
-    uint4 materialId;
-};
-
-ConstantBuffer<ModelBuffer> ModelCB : register(b1);
-
 struct VSOutput
 {
     float3 worldPos : POSITION;
     float3 norm : NORMAL;
     float4 tang : TANGENT;
     float2 uv : TEXCOORD;
+    nointerpolation uint objectId : OBJECT_ID;
     float4 position : SV_Position;
 };
 
@@ -30,16 +24,19 @@ VSOutput main(
     float3 position : POSITION,
     float3 norm : NORMAL,
     float4 tang : TANGENT,
-    float2 uv : TEXCOORD
+    float2 uv : TEXCOORD,
+    uint instanceId : SV_InstanceID
 )
 {
     VSOutput vtxOut;
+    vtxOut.objectId = GetObjectId(instanceId);
+    ModelBuffer objectData = GetObjectData(vtxOut.objectId);
     
     float4 pos = float4(position.xyz, 1.f);
-    vtxOut.worldPos = mul(ModelCB.modelMatrix, pos);
+    vtxOut.worldPos = mul(objectData.modelMatrix, pos);
     
-    vtxOut.norm = mul(ModelCB.normalMatrix, float4(norm.xyz, 0.f)).xyz;
-    vtxOut.tang.xyz = mul(ModelCB.normalMatrix, float4(tang.xyz, 0.f)).xyz;
+    vtxOut.norm = mul(objectData.normalMatrix, float4(norm.xyz, 0.f)).xyz;
+    vtxOut.tang.xyz = mul(objectData.normalMatrix, float4(tang.xyz, 0.f)).xyz;
     vtxOut.tang.w = tang.w;
     
     vtxOut.uv = uv;
@@ -0,0 +1,108 @@
+#include "ClusterGrid.h"
+
+#include <cstring>
+
+namespace ClusteredLighting {
+	namespace {
+		constexpr UINT threadBlockSize{ 64 };
+	}
+
+	ClusterGrid::ClusterGrid(Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator)
+		: m_pLightCounts(CreateBuffer(
+			pAllocator,
+			CLUSTERS_COUNT * sizeof(uint32_t),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		))
+		, m_pLightIndices(CreateBuffer(
+			pAllocator,
+			CLUSTERS_COUNT * CLUSTER_LIGHTS_MAX_COUNT * sizeof(uint32_t),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		))
+		, m_pStats(CreateBuffer(pAllocator, sizeof(ClusterStats), D3D12_RESOURCE_STATE_UNORDERED_ACCESS))
+		, m_pStatsReadback(CreateBuffer(
+			pAllocator,
+			statsSlotsCount * sizeof(ClusterStats),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_HEAP_TYPE_READBACK
+		))
+	{}
+
+	void ClusterGrid::RecordBuild(
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+		std::shared_ptr<ComputeObject> pBuilder,
+		const ClusterConstants& constants,
+		D3D12_GPU_VIRTUAL_ADDRESS lightsAddress
+	) {
+		static_assert(CLUSTERS_Z <= threadBlockSize, "a group fills all the clusters of a tile");
+
+		D3D12_GPU_VIRTUAL_ADDRESS statsAddress{ m_pStats->GetResource()->GetGPUVirtualAddress() };
+		ResourceTransition(pCommandList, m_pStats->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER parameters[]{
+			{ .Dest{ statsAddress + offsetof(ClusterStats, overflowedClustersCount) }, .Value{ 0 } },
+			{ .Dest{ statsAddress + offsetof(ClusterStats, maxClusterLightsCount) }, .Value{ 0 } }
+		};
+		pCommandList->WriteBufferImmediate(_countof(parameters), parameters, nullptr);
+		ResourceTransition(pCommandList, m_pStats->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+		pBuilder->Dispatch(
+			pCommandList,
+			CLUSTERS_X * CLUSTERS_Y, 1, 1,
+			[&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, UINT& rootParamId) {
+				pCommandList->SetComputeRoot32BitConstants(rootParamId++, sizeof(ClusterConstants) / sizeof(UINT), &constants, 0);
+				pCommandList->SetComputeRootShaderResourceView(rootParamId++, lightsAddress);
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, GetLightCountsAddress());
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, GetLightIndicesAddress());
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, statsAddress);
+			}
+		);
+
+		ResourceTransition(pCommandList, m_pStats->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		uint64_t slotId{ m_buildsCount.load() % statsSlotsCount };
+		pCommandList->CopyBufferRegion(
+			m_pStatsReadback->GetResource().Get(),
+			slotId * sizeof(ClusterStats),
+			m_pStats->GetResource().Get(),
+			0,
+			sizeof(ClusterStats)
+		);
+		ResourceTransition(pCommandList, m_pStats->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_buildsCount.fetch_add(1);
+	}
+
+	ClusterStats ClusterGrid::GetStats() const {
+		uint64_t buildsCount{ m_buildsCount.load() };
+		if (buildsCount < statsSlotsCount) {
+			return ClusterStats{};
+		}
+		// the oldest slot, the next build overwrites it
+		uint64_t slotId{ buildsCount % statsSlotsCount };
+		CD3DX12_RANGE readRange(slotId * sizeof(ClusterStats), (slotId + 1) * sizeof(ClusterStats));
+		void* pData{};
+		ThrowIfFailed(m_pStatsReadback->GetResource()->Map(0, &readRange, &pData));
+		ClusterStats stats{};
+		std::memcpy(&stats, static_cast<uint8_t*>(pData) + readRange.Begin, sizeof(ClusterStats));
+		CD3DX12_RANGE writtenRange(0, 0);
+		m_pStatsReadback->GetResource()->Unmap(0, &writtenRange);
+		return stats;
+	}
+
+	std::shared_ptr<GPUResource> ClusterGrid::CreateBuffer(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		UINT64 size,
+		D3D12_RESOURCE_STATES state,
+		D3D12_HEAP_TYPE heapType
+	) {
+		bool isReadback{ heapType == D3D12_HEAP_TYPE_READBACK };
+		return std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ .heapType{ heapType } },
+			GPUResource::ResourceData{
+				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(
+					size,
+					isReadback ? D3D12_RESOURCE_FLAG_NONE : D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS
+				) },
+				.resInitState{ state }
+			}
+		);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <atomic>
+
+#include "ClusteredLighting.h"
+#include "ComputeObject.h"
+#include "GPUResource.h"
+
+namespace ClusteredLighting {
+	// Light counts and index lists of all clusters, rebuilt every frame on the compute queue before the shading.
+	// Both are render graph resources: the graph makes them unordered access for the build and
+	// returns them to non pixel shader resource, the state they are created in, after the shading.
+	class ClusterGrid {
+		std::shared_ptr<GPUResource> m_pLightCounts{};
+		std::shared_ptr<GPUResource> m_pLightIndices{};
+
+		// Builds copy their stats to the next slot, a slot is read statsSlotsCount - 1 builds after it was written,
+		// more than the frames the renderer keeps in flight.
+		static constexpr uint32_t statsSlotsCount{ 4 };
+		std::shared_ptr<GPUResource> m_pStats{};
+		std::shared_ptr<GPUResource> m_pStatsReadback{};
+		std::atomic<uint64_t> m_buildsCount{};
+
+	public:
+		ClusterGrid(Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator);
+
+		// The lights have to be readable by non pixel shaders, the lists have to be unordered access.
+		void RecordBuild(
+			Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+			std::shared_ptr<ComputeObject> pBuilder,
+			const ClusterConstants& constants,
+			D3D12_GPU_VIRTUAL_ADDRESS lightsAddress
+		);
+
+		// Stats of a build a few frames old, zeroed until there is one.
+		ClusterStats GetStats() const;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> GetLightCounts() const {
+			return m_pLightCounts->GetResource();
+		}
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> GetLightIndices() const {
+			return m_pLightIndices->GetResource();
+		}
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetLightCountsAddress() const {
+			return m_pLightCounts->GetResource()->GetGPUVirtualAddress();
+		}
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetLightIndicesAddress() const {
+			return m_pLightIndices->GetResource()->GetGPUVirtualAddress();
+		}
+
+	private:
+		static std::shared_ptr<GPUResource> CreateBuffer(
+			Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+			UINT64 size,
+			D3D12_RESOURCE_STATES state,
+			D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT
+		);
+	};
+}
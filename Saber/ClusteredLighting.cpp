@@ -0,0 +1,203 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ClusteredLighting {
+	namespace {
+		// Side planes go through the camera with normals pointing inside,
+		// the depth range is along the camera forward direction.
+		struct ClusterBounds {
+			DirectX::XMFLOAT3 planeNormals[4]{};
+			float minDepth{};
+			float maxDepth{};
+		};
+
+		// clip = v * M, like mul(M, v) in the shader with the matrix stored as it is
+		DirectX::XMFLOAT4 TransformPoint(const DirectX::XMFLOAT4X4& m, float x, float y, float z) {
+			return DirectX::XMFLOAT4{
+				x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0],
+				x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1],
+				x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + m.m[3][2],
+				x * m.m[0][3] + y * m.m[1][3] + z * m.m[2][3] + m.m[3][3]
+			};
+		}
+
+		float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+			return DirectX::XMFLOAT3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		// direction from the camera to the point on the near plane, reversed depth puts the plane at 1
+		DirectX::XMFLOAT3 UnprojectDirection(const ClusterConstants& constants, float ndcX, float ndcY) {
+			DirectX::XMFLOAT4 point{ TransformPoint(constants.invViewProjection, ndcX, ndcY, 1.f) };
+			return DirectX::XMFLOAT3{
+				point.x / point.w - constants.cameraPosition.x,
+				point.y / point.w - constants.cameraPosition.y,
+				point.z / point.w - constants.cameraPosition.z
+			};
+		}
+
+		float GetSliceDepth(const ClusterConstants& constants, uint32_t sliceId) {
+			return constants.nearZ * std::pow(constants.farZ / constants.nearZ, static_cast<float>(sliceId) / CLUSTERS_Z);
+		}
+
+		ClusterBounds GetClusterBounds(const ClusterConstants& constants, uint32_t clusterId) {
+			uint32_t x{ clusterId % CLUSTERS_X };
+			uint32_t y{ clusterId / CLUSTERS_X % CLUSTERS_Y };
+			uint32_t z{ clusterId / (CLUSTERS_X * CLUSTERS_Y) };
+
+			// tile rows go down the screen, NDC y goes up
+			float ndcMinX{ -1.f + 2.f * x / CLUSTERS_X }, ndcMaxX{ -1.f + 2.f * (x + 1) / CLUSTERS_X };
+			float ndcTopY{ 1.f - 2.f * y / CLUSTERS_Y }, ndcBottomY{ 1.f - 2.f * (y + 1) / CLUSTERS_Y };
+			DirectX::XMFLOAT3 topLeft{ UnprojectDirection(constants, ndcMinX, ndcTopY) };
+			DirectX::XMFLOAT3 topRight{ UnprojectDirection(constants, ndcMaxX, ndcTopY) };
+			DirectX::XMFLOAT3 bottomLeft{ UnprojectDirection(constants, ndcMinX, ndcBottomY) };
+			DirectX::XMFLOAT3 bottomRight{ UnprojectDirection(constants, ndcMaxX, ndcBottomY) };
+			DirectX::XMFLOAT3 center{
+				topLeft.x + topRight.x + bottomLeft.x + bottomRight.x,
+				topLeft.y + topRight.y + bottomLeft.y + bottomRight.y,
+				topLeft.z + topRight.z + bottomLeft.z + bottomRight.z
+			};
+
+			ClusterBounds bounds{
+				.planeNormals{
+					Cross(topLeft, bottomLeft),
+					Cross(bottomRight, topRight),
+					Cross(topRight, topLeft),
+					Cross(bottomLeft, bottomRight)
+				},
+				.minDepth{ GetSliceDepth(constants, z) },
+				.maxDepth{ GetSliceDepth(constants, z + 1) }
+			};
+			// the winding depends on the handedness, the tile center decides
+			for (DirectX::XMFLOAT3& normal : bounds.planeNormals) {
+				float length{ std::sqrt(Dot(normal, normal)) };
+				float sign{ Dot(normal, center) < 0.f ? -1.f : 1.f };
+				normal = DirectX::XMFLOAT3{ sign * normal.x / length, sign * normal.y / length, sign * normal.z / length };
+			}
+			return bounds;
+		}
+
+		// the clusters of a screen tile share the side planes, the depth is tested separately for each of them
+		bool IsSphereInTile(const ClusterConstants& constants, const ClusterBounds& bounds, const DirectX::XMFLOAT4& sphere) {
+			if (sphere.w <= 0.f) {
+				return false;
+			}
+			DirectX::XMFLOAT3 offset{
+				sphere.x - constants.cameraPosition.x,
+				sphere.y - constants.cameraPosition.y,
+				sphere.z - constants.cameraPosition.z
+			};
+			for (const DirectX::XMFLOAT3& normal : bounds.planeNormals) {
+				if (Dot(normal, offset) < -sphere.w) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// nearest and farthest depth of the sphere along the camera forward direction
+		DirectX::XMFLOAT2 GetSphereDepthRange(const ClusterConstants& constants, const DirectX::XMFLOAT4& sphere) {
+			DirectX::XMFLOAT3 offset{
+				sphere.x - constants.cameraPosition.x,
+				sphere.y - constants.cameraPosition.y,
+				sphere.z - constants.cameraPosition.z
+			};
+			float depth{ Dot(offset, DirectX::XMFLOAT3{ constants.cameraForward.x, constants.cameraForward.y, constants.cameraForward.z }) };
+			return DirectX::XMFLOAT2{ depth - sphere.w, depth + sphere.w };
+		}
+
+		bool IsDepthRangeInSlice(const ClusterBounds& bounds, const DirectX::XMFLOAT2& depthRange) {
+			return depthRange.y >= bounds.minDepth && depthRange.x <= bounds.maxDepth;
+		}
+	}
+
+	float GetLightRange(const Light& light) {
+		if (light.diffuseColorAndPower.w <= 0.f) {
+			return 0.f;
+		}
+		auto getIntensity{ [](const DirectX::XMFLOAT4& colorAndPower) {
+			return std::max({ colorAndPower.x, colorAndPower.y, colorAndPower.z }) * std::max(colorAndPower.w, 0.f);
+		} };
+		float intensity{ std::max(getIntensity(light.diffuseColorAndPower), getIntensity(light.specularColorAndPower)) };
+		// attenuation is 1 / d^2
+		return std::sqrt(intensity / LIGHT_ATTENUATION_CUTOFF);
+	}
+
+	ClusterConstants MakeClusterConstants(
+		const DirectX::XMMATRIX& viewProjection,
+		const DirectX::XMFLOAT3& cameraPosition,
+		float nearZ,
+		float farZ,
+		uint32_t lightsCount
+	) {
+		ClusterConstants constants{
+			.cameraPosition{ cameraPosition.x, cameraPosition.y, cameraPosition.z, 1.f },
+			.nearZ{ nearZ },
+			.farZ{ farZ },
+			.lightsCount{ lightsCount }
+		};
+		DirectX::XMStoreFloat4x4(&constants.invViewProjection, DirectX::XMMatrixInverse(nullptr, viewProjection));
+
+		// the projection is symmetric, the screen center looks forward
+		DirectX::XMFLOAT3 forward{ UnprojectDirection(constants, 0.f, 0.f) };
+		float length{ std::sqrt(Dot(forward, forward)) };
+		constants.cameraForward = DirectX::XMFLOAT4{ forward.x / length, forward.y / length, forward.z / length, 0.f };
+		return constants;
+	}
+
+	uint32_t GetClusterId(const ClusterConstants& constants, float u, float v, float viewDepth) {
+		uint32_t x{ std::min(static_cast<uint32_t>(std::max(u, 0.f) * CLUSTERS_X), uint32_t{ CLUSTERS_X - 1 }) };
+		uint32_t y{ std::min(static_cast<uint32_t>(std::max(v, 0.f) * CLUSTERS_Y), uint32_t{ CLUSTERS_Y - 1 }) };
+		float slice{ std::log(std::max(viewDepth, constants.nearZ) / constants.nearZ)
+			/ std::log(constants.farZ / constants.nearZ) * CLUSTERS_Z };
+		uint32_t z{ std::min(static_cast<uint32_t>(slice), uint32_t{ CLUSTERS_Z - 1 }) };
+		return (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+	}
+
+	void AssignLightsReference(
+		const ClusterConstants& constants,
+		const Light* pLights,
+		uint32_t* pClusterLightCounts,
+		uint32_t* pClusterLightIndices,
+		ClusterStats* pStats
+	) {
+		ClusterStats stats{};
+		std::vector<uint32_t> tileLightIds{};
+		for (uint32_t tileId{}; tileId < CLUSTERS_X * CLUSTERS_Y; ++tileId) {
+			// the tile planes are tested once, the clusters of the tile only test the depth
+			ClusterBounds tileBounds{ GetClusterBounds(constants, tileId) };
+			tileLightIds.clear();
+			for (uint32_t lightId{}; lightId < constants.lightsCount; ++lightId) {
+				if (IsSphereInTile(constants, tileBounds, pLights[lightId].position)) {
+					tileLightIds.push_back(lightId);
+				}
+			}
+
+			for (uint32_t sliceId{}; sliceId < CLUSTERS_Z; ++sliceId) {
+				uint32_t clusterId{ sliceId * CLUSTERS_X * CLUSTERS_Y + tileId };
+				ClusterBounds bounds{ GetClusterBounds(constants, clusterId) };
+				uint32_t count{};
+				for (uint32_t lightId : tileLightIds) {
+					if (IsDepthRangeInSlice(bounds, GetSphereDepthRange(constants, pLights[lightId].position))) {
+						if (count < CLUSTER_LIGHTS_MAX_COUNT) {
+							pClusterLightIndices[clusterId * CLUSTER_LIGHTS_MAX_COUNT + count] = lightId;
+						}
+						++count;
+					}
+				}
+				pClusterLightCounts[clusterId] = std::min(count, uint32_t{ CLUSTER_LIGHTS_MAX_COUNT });
+				stats.maxClusterLightsCount = std::max(stats.maxClusterLightsCount, count);
+				stats.overflowedClustersCount += count > CLUSTER_LIGHTS_MAX_COUNT;
+			}
+		}
+		if (pStats) {
+			*pStats = stats;
+		}
+	}
+}
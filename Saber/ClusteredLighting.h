@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Headers.h"
+
+#include "LightingData.h"
+
+// CPU side of LightClusterBuilder.hlsl: the constants and a reference of the shader to test it without a GPU.
+// ClusterGrid.h has the buffers and the dispatch.
+namespace ClusteredLighting {
+	// Distance at which the attenuation times the brightest color channel drops under LIGHT_ATTENUATION_CUTOFF,
+	// 0 for lights the shading skips.
+	float GetLightRange(const Light& light);
+
+	// The matrix is the view projection SceneBuffer stores, near and far are the camera planes.
+	ClusterConstants MakeClusterConstants(
+		const DirectX::XMMATRIX& viewProjection,
+		const DirectX::XMFLOAT3& cameraPosition,
+		float nearZ,
+		float farZ,
+		uint32_t lightsCount
+	);
+
+	// The cluster the shading reads for a pixel, uv has y pointing down and the depth is along the camera forward direction.
+	uint32_t GetClusterId(const ClusterConstants& constants, float u, float v, float viewDepth);
+
+	// Same assignment as LightClusterBuilder.hlsl, to check it without a GPU.
+	// The list of a cluster starts at clusterId * CLUSTER_LIGHTS_MAX_COUNT and keeps the light order,
+	// lights after the first CLUSTER_LIGHTS_MAX_COUNT are dropped and counted in the stats.
+	void AssignLightsReference(
+		const ClusterConstants& constants,
+		const Light* pLights,
+		uint32_t* pClusterLightCounts,
+		uint32_t* pClusterLightIndices,
+		ClusterStats* pStats = nullptr
+	);
+}
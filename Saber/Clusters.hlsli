@@ -0,0 +1,97 @@
+#include "LightingData.h"
+
+// Mirrors the cluster math of ClusteredLighting.cpp, keep them in sync
+
+// side planes go through the camera with normals pointing inside,
+// the depth range is along the camera forward direction
+struct ClusterBounds
+{
+    float3 planeNormals[4];
+    float minDepth;
+    float maxDepth;
+};
+
+// direction from the camera to the point on the near plane, reversed depth puts the plane at 1
+float3 UnprojectDirection(ClusterConstants constants, float2 ndc)
+{
+    float4 position = mul(constants.invViewProjection, float4(ndc, 1.f, 1.f));
+    return position.xyz / position.w - constants.cameraPosition.xyz;
+}
+
+float GetSliceDepth(ClusterConstants constants, uint sliceId)
+{
+    return constants.nearZ * pow(constants.farZ / constants.nearZ, float(sliceId) / CLUSTERS_Z);
+}
+
+ClusterBounds GetClusterBounds(ClusterConstants constants, uint clusterId)
+{
+    uint x = clusterId % CLUSTERS_X;
+    uint y = clusterId / CLUSTERS_X % CLUSTERS_Y;
+    uint z = clusterId / (CLUSTERS_X * CLUSTERS_Y);
+
+    // tile rows go down the screen, NDC y goes up
+    float2 ndcMin = float2(-1.f + 2.f * x / CLUSTERS_X, 1.f - 2.f * (y + 1) / CLUSTERS_Y);
+    float2 ndcMax = float2(-1.f + 2.f * (x + 1) / CLUSTERS_X, 1.f - 2.f * y / CLUSTERS_Y);
+    float3 topLeft = UnprojectDirection(constants, float2(ndcMin.x, ndcMax.y));
+    float3 topRight = UnprojectDirection(constants, ndcMax);
+    float3 bottomLeft = UnprojectDirection(constants, ndcMin);
+    float3 bottomRight = UnprojectDirection(constants, float2(ndcMax.x, ndcMin.y));
+    float3 center = topLeft + topRight + bottomLeft + bottomRight;
+
+    ClusterBounds bounds;
+    bounds.planeNormals[0] = cross(topLeft, bottomLeft);
+    bounds.planeNormals[1] = cross(bottomRight, topRight);
+    bounds.planeNormals[2] = cross(topRight, topLeft);
+    bounds.planeNormals[3] = cross(bottomLeft, bottomRight);
+    bounds.minDepth = GetSliceDepth(constants, z);
+    bounds.maxDepth = GetSliceDepth(constants, z + 1);
+
+    // the winding depends on the handedness, the tile center decides
+    [unroll]
+    for (uint i = 0; i < 4; ++i)
+    {
+        float3 normal = normalize(bounds.planeNormals[i]);
+        bounds.planeNormals[i] = dot(normal, center) < 0.f ? -normal : normal;
+    }
+    return bounds;
+}
+
+// the clusters of a screen tile share the side planes, the depth is tested separately for each of them
+bool IsSphereInTile(ClusterConstants constants, ClusterBounds bounds, float4 sphere)
+{
+    if (sphere.w <= 0.f)
+    {
+        return false;
+    }
+    float3 offset = sphere.xyz - constants.cameraPosition.xyz;
+    [unroll]
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (dot(bounds.planeNormals[i], offset) < -sphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// nearest and farthest depth of the sphere along the camera forward direction
+float2 GetSphereDepthRange(ClusterConstants constants, float4 sphere)
+{
+    float depth = dot(sphere.xyz - constants.cameraPosition.xyz, constants.cameraForward.xyz);
+    return float2(depth - sphere.w, depth + sphere.w);
+}
+
+bool IsDepthRangeInSlice(ClusterBounds bounds, float2 depthRange)
+{
+    return depthRange.y >= bounds.minDepth && depthRange.x <= bounds.maxDepth;
+}
+
+// uv has y pointing down, the depth is along the camera forward direction
+uint GetClusterId(ClusterConstants constants, float2 uv, float viewDepth)
+{
+    uint2 tile = min(uint2(max(uv, 0.f) * float2(CLUSTERS_X, CLUSTERS_Y)), uint2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    float slice = log(max(viewDepth, constants.nearZ) / constants.nearZ) / log(constants.farZ / constants.nearZ) * CLUSTERS_Z;
+    uint z = min(uint(slice), CLUSTERS_Z - 1);
+    return (z * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x;
+}
@@ -4,9 +4,11 @@ CommandList::CommandList(
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
 	uint8_t priority,
 	std::function<void(void)> beforeExec,
-	std::function<void(void)> afterExec
+	std::function<void(void)> afterExec,
+	uint32_t order
 ) : m_pCommandList(pCommandList)
 	, m_priority(priority)
+	, m_order(order)
 	, m_beforeExec(beforeExec)
 	, m_afterExec(afterExec)
 {}
@@ -15,6 +17,10 @@ inline uint16_t CommandList::GetPriority() const {
 	return m_priority;
 }
 
+uint32_t CommandList::GetOrder() const {
+	return m_order;
+}
+
 bool CommandList::IsReadyForExection() const {
 	return m_isReadyForExecution.load();
 }
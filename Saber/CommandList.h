@@ -6,6 +6,8 @@
 
 class CommandList {
 	uint8_t m_priority{};
+	// lists of one priority are submitted by ascending order
+	uint32_t m_order{};
 	std::function<void(void)> m_beforeExec{};
 	std::function<void(void)> m_afterExec{};
 	std::atomic<bool> m_isReadyForExecution{};
@@ -17,7 +19,8 @@ public:
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
 		uint8_t priority = 0,
 		std::function<void(void)> beforeExec = [=]() { return; },
-		std::function<void(void)> afterExec = [=]() { return; }
+		std::function<void(void)> afterExec = [=]() { return; },
+		uint32_t order = 0
 	);
 
 	template <typename T>
@@ -31,6 +34,8 @@ public:
 
 	uint16_t GetPriority() const;
 
+	uint32_t GetOrder() const;
+
 	bool IsReadyForExection() const;
 
 	void SetReadyForExection();
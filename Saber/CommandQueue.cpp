@@ -40,7 +40,8 @@ std::shared_ptr<CommandList> CommandQueue::GetCommandList(
 	bool isDeffered,
 	uint8_t priority,
 	std::function<void(void)> beforeExecuteTask,
-	std::function<void(void)> afterExecuteTask
+	std::function<void(void)> afterExecuteTask,
+	uint32_t order
 ) {
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> pCommandAllocator{};
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pD3D12CommandList{};
@@ -82,7 +83,8 @@ std::shared_ptr<CommandList> CommandQueue::GetCommandList(
 		pD3D12CommandList,
 		priority,
 		beforeExecuteTask,
-		afterExecuteTask
+		afterExecuteTask,
+		order
 	) };
 
 	if (isDeffered) {
@@ -150,13 +152,21 @@ uint64_t CommandQueue::ExecutionTask(uint64_t waitFenceValue) {
 			continue;
 		}
 		std::unordered_multiset<std::shared_ptr<CommandList>>& pCommandLists{ priorityVector->pCommandLists };
+		auto getNextOrder = [&pCommandLists]() {
+			uint32_t nextOrder{ std::numeric_limits<uint32_t>::max() };
+			for (const std::shared_ptr<CommandList>& pCommandList : pCommandLists) {
+				nextOrder = std::min(nextOrder, pCommandList->GetOrder());
+			}
+			return nextOrder;
+		};
 
+		uint32_t nextOrder{ getNextOrder() };
 		auto iter = pCommandLists.begin();
 		while (!pCommandLists.empty()) {
 			if (iter == pCommandLists.end()) {
 				iter = pCommandLists.begin();
 			}
-			if ((*iter)->IsReadyForExection()) {
+			if ((*iter)->GetOrder() == nextOrder && (*iter)->IsReadyForExection()) {
 				if(waitFence)
 				{
 					WaitForFenceValue(waitFenceValue);
@@ -164,6 +174,7 @@ uint64_t CommandQueue::ExecutionTask(uint64_t waitFenceValue) {
 				}
 				lastFrameValue = ExecuteCommandList(*iter);
 				pCommandLists.erase(iter);
+				nextOrder = getNextOrder();
 				iter = pCommandLists.begin();
 			}
 			else {
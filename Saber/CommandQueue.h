@@ -11,6 +11,8 @@
 #undef max
 #endif
 
+#include <algorithm>
+#include <limits>
 #include <queue>
 #include <vector>
 #include <unordered_set>
@@ -52,12 +54,14 @@ public:
 	D3D12_COMMAND_LIST_TYPE GetCommandListType() const;
 
 	// Get an available command list from the command queue.
+	// Deferred lists of one priority are executed by ascending order, the ones with equal order as they get ready.
 	std::shared_ptr<CommandList> GetCommandList(
 		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 		bool isDeffered = false,
 		uint8_t priority = 0,
 		std::function<void(void)> beforeExecuteTask = [=]() { return; },
-		std::function<void(void)> afterExecuteTask = [=]() { return; }
+		std::function<void(void)> afterExecuteTask = [=]() { return; },
+		uint32_t order = 0
 	);
 
 	// Execute a command list.
@@ -3,6 +3,8 @@
 #include "Headers.h"
 
 #include "Atlas.h"
+#include "GeometryPool.h"
+#include "LightingData.h"
 #include "PSOLibrary.h"
 #include "RenderObject.h"
 #include "Resources.h"
@@ -129,9 +131,12 @@ private:
         Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
     ) {
         size_t rpId{};
-        CD3DX12_ROOT_PARAMETER1 rootParameters[7]{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[10]{};
         rootParameters[rpId++].InitAsConstantBufferView(0);
         rootParameters[rpId++].InitAsConstantBufferView(1); 
+        rootParameters[rpId++].InitAsShaderResourceView(0, 1);  // lights
+        rootParameters[rpId++].InitAsShaderResourceView(1, 1);  // cluster light counts
+        rootParameters[rpId++].InitAsShaderResourceView(2, 1);  // cluster light indices
 
         CD3DX12_DESCRIPTOR_RANGE1 rangeSrvsGbuffer[1]{};
         rangeSrvsGbuffer[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0);
@@ -197,3 +202,179 @@ private:
         return rootSignatureBlob;
     }
 };
+
+// Shading of GBuffer::Layout::Visibility, attributes come from the geometry pool and the object data of every render subsystem
+class VisibilityShading : ComputeObject {
+public:
+    static std::shared_ptr<ComputeObject> CreateVisibilityShadingComputeObject(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
+        std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
+        std::shared_ptr<PSOLibrary> pPSOLibrary
+    ) {
+        std::shared_ptr<ComputeObject> pComputeObj{ std::make_shared<ComputeObject>() };
+        pComputeObj->InitMaterial(
+            pDevice,
+            RootSignatureData(
+                pRootSignatureAtlas,
+                CreateRootSignatureBlob(pDevice),
+                L"VisibilityShadingRootSignature"
+            ),
+            ComputeShaderData(
+                pShaderAtlas,
+                L"VisibilityShadingComputeShader.cso"
+            ),
+            pPSOLibrary
+        );
+
+        return pComputeObj;
+    }
+
+private:
+    static Microsoft::WRL::ComPtr<ID3DBlob> CreateRootSignatureBlob(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
+    ) {
+        size_t rpId{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[18]{};
+        rootParameters[rpId++].InitAsConstantBufferView(0);
+        rootParameters[rpId++].InitAsConstantBufferView(1);
+        rootParameters[rpId++].InitAsShaderResourceView(0, 1);  // lights
+        rootParameters[rpId++].InitAsShaderResourceView(1, 1);  // cluster light counts
+        rootParameters[rpId++].InitAsShaderResourceView(2, 1);  // cluster light indices
+
+        CD3DX12_DESCRIPTOR_RANGE1 rangeSrvsGbuffer[1]{};
+        rangeSrvsGbuffer[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+        rootParameters[rpId++].InitAsDescriptorTable(_countof(rangeSrvsGbuffer), rangeSrvsGbuffer);
+
+        CD3DX12_DESCRIPTOR_RANGE1 rangeUavsGbuffer[1]{};
+        rangeUavsGbuffer[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+        rootParameters[rpId++].InitAsDescriptorTable(_countof(rangeUavsGbuffer), rangeUavsGbuffer);
+
+        CD3DX12_DESCRIPTOR_RANGE1 rangeCbvsMaterials[1]{};
+        rangeCbvsMaterials[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 2);
+        rootParameters[rpId++].InitAsDescriptorTable(_countof(rangeCbvsMaterials), rangeCbvsMaterials);
+
+        CD3DX12_DESCRIPTOR_RANGE1 rangeSrvsMaterial[1]{};
+        rangeSrvsMaterial[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, -1, 3);
+        rootParameters[rpId++].InitAsDescriptorTable(_countof(rangeSrvsMaterial), rangeSrvsMaterial);
+
+        rootParameters[rpId++].InitAsShaderResourceView(0, 2);  // indices
+        for (UINT streamId{}; streamId < GeometryPool::Stream::Count; ++streamId) {
+            rootParameters[rpId++].InitAsShaderResourceView(1 + streamId, 2);  // vertex streams
+        }
+        for (UINT subsystemId{}; subsystemId < 4; ++subsystemId) {
+            rootParameters[rpId++].InitAsShaderResourceView(subsystemId, 3);  // objects data of the render subsystems
+        }
+
+        D3D12_STATIC_SAMPLER_DESC sampler{
+            .Filter{ D3D12_FILTER_ANISOTROPIC },
+            .AddressU{ D3D12_TEXTURE_ADDRESS_MODE_WRAP },
+            .AddressV{ D3D12_TEXTURE_ADDRESS_MODE_WRAP },
+            .AddressW{ D3D12_TEXTURE_ADDRESS_MODE_WRAP },
+            .MipLODBias{},
+            .MaxAnisotropy{ 16 },
+            .ComparisonFunc{ D3D12_COMPARISON_FUNC_ALWAYS },
+            .BorderColor{ D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK },
+            .MinLOD{},
+            .MaxLOD{ D3D12_FLOAT32_MAX },
+            .ShaderRegister{},
+            .RegisterSpace{},
+            .ShaderVisibility{ D3D12_SHADER_VISIBILITY_ALL }
+        };
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 1, &sampler);
+
+        D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{ D3D_ROOT_SIGNATURE_VERSION_1_1 };
+        if (FAILED(pDevice->CheckFeatureSupport(
+            D3D12_FEATURE_ROOT_SIGNATURE,
+            &featureData,
+            sizeof(featureData)
+        ))) {
+            featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+        }
+
+        // Serialize the root signature.
+        Microsoft::WRL::ComPtr<ID3DBlob> rootSignatureBlob, errorBlob;
+        HRESULT hr{ D3DX12SerializeVersionedRootSignature(
+            &rootSignatureDescription,
+            featureData.HighestVersion,
+            &rootSignatureBlob,
+            &errorBlob
+        ) };
+        if (FAILED(hr) && errorBlob) {
+            OutputDebugStringA(static_cast<char*>(errorBlob->GetBufferPointer()));
+        }
+        ThrowIfFailed(hr);
+
+        return rootSignatureBlob;
+    }
+};
+
+// Fills the light lists of the clusters of ClusteredLighting::ClusterGrid, one group per screen tile
+class LightClusterBuilder : ComputeObject {
+public:
+    static std::shared_ptr<ComputeObject> CreateLightClusterBuilderComputeObject(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
+        std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
+        std::shared_ptr<PSOLibrary> pPSOLibrary
+    ) {
+        std::shared_ptr<ComputeObject> pComputeObj{ std::make_shared<ComputeObject>() };
+        pComputeObj->InitMaterial(
+            pDevice,
+            RootSignatureData(
+                pRootSignatureAtlas,
+                CreateRootSignatureBlob(pDevice),
+                L"LightClusterBuilderRootSignature"
+            ),
+            ComputeShaderData(
+                pShaderAtlas,
+                L"LightClusterBuilder.cso"
+            ),
+            pPSOLibrary
+        );
+
+        return pComputeObj;
+    }
+
+private:
+    static Microsoft::WRL::ComPtr<ID3DBlob> CreateRootSignatureBlob(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
+    ) {
+        size_t rpId{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[5]{};
+        rootParameters[rpId++].InitAsConstants(sizeof(ClusterConstants) / sizeof(UINT), 0);
+        rootParameters[rpId++].InitAsShaderResourceView(0);  // lights
+        rootParameters[rpId++].InitAsUnorderedAccessView(0);  // cluster light counts
+        rootParameters[rpId++].InitAsUnorderedAccessView(1);  // cluster light indices
+        rootParameters[rpId++].InitAsUnorderedAccessView(2);  // cluster stats
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters);
+
+        D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{ D3D_ROOT_SIGNATURE_VERSION_1_1 };
+        if (FAILED(pDevice->CheckFeatureSupport(
+            D3D12_FEATURE_ROOT_SIGNATURE,
+            &featureData,
+            sizeof(featureData)
+        ))) {
+            featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+        }
+
+        // Serialize the root signature.
+        Microsoft::WRL::ComPtr<ID3DBlob> rootSignatureBlob, errorBlob;
+        HRESULT hr{ D3DX12SerializeVersionedRootSignature(
+            &rootSignatureDescription,
+            featureData.HighestVersion,
+            &rootSignatureBlob,
+            &errorBlob
+        ) };
+        if (FAILED(hr) && errorBlob) {
+            OutputDebugStringA(static_cast<char*>(errorBlob->GetBufferPointer()));
+        }
+        ThrowIfFailed(hr);
+
+        return rootSignatureBlob;
+    }
+};
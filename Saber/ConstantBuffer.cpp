@@ -21,6 +21,12 @@ ConstantBuffer::ConstantBuffer(
 	}
 }
 
+ConstantBuffer::~ConstantBuffer() {
+	if (m_pMappedData) {
+		GetResource()->Unmap(0, nullptr);
+	}
+}
+
 void ConstantBuffer::CreateConstantBufferView(
 	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 	const D3D12_CPU_DESCRIPTOR_HANDLE& cpuDescHandle
@@ -33,12 +39,14 @@ void ConstantBuffer::CreateConstantBufferView(
 }
 
 void ConstantBuffer::Update(void* newData, size_t offset, size_t size) {
-	void* pData{};
-	ThrowIfFailed(GetResource()->Map(0, &CD3DX12_RANGE(), &pData));
+	if (!m_pMappedData) {
+		void* pData{};
+		ThrowIfFailed(GetResource()->Map(0, &CD3DX12_RANGE(), &pData));
+		m_pMappedData = static_cast<std::byte*>(pData);
+	}
 	memcpy(
-		static_cast<std::byte*>(pData) + offset,
+		m_pMappedData + offset,
 		newData,
 		size ? size : GetResource()->GetDesc().Width
 	);
-	//GetResource()->Unmap(0, nullptr);
 }
@@ -5,6 +5,9 @@
 #include "GPUResource.h"
 
 class ConstantBuffer : public GPUResource {
+	// upload heap buffers are mapped on the first update and stay mapped until destruction
+	std::byte* m_pMappedData{};
+
 public:
 	ConstantBuffer(
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
@@ -13,11 +16,14 @@ public:
 		const HeapData& heapData = HeapData{ D3D12_HEAP_TYPE_UPLOAD },
 		const D3D12MA::ALLOCATION_FLAGS& allocationFlags = D3D12MA::ALLOCATION_FLAG_NONE
 	);
+	~ConstantBuffer() override;
 
 	void CreateConstantBufferView(
 		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 		const D3D12_CPU_DESCRIPTOR_HANDLE& cpuDescHandle
 	);
 
+	// Writes in place, the caller makes sure the GPU isn't reading the buffer,
+	// data changing every frame belongs in a DynamicUploadHeap allocation instead.
 	void Update(void* newData, size_t offset = 0, size_t size = 0);
 };
@@ -0,0 +1,170 @@
+#include "CulledCommandBuffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace GpuCulling {
+	namespace {
+		constexpr UINT threadBlockSize{ 64 };
+	}
+
+	void VisibilityBuffer::Reserve(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect,
+		uint32_t objectsCount
+	) {
+		while (!m_retiredBuffers.empty() && pCommandQueueDirect->IsFenceComplete(m_retiredBuffers.front().fenceValue)) {
+			m_retiredBuffers.pop_front();
+		}
+		if (m_pBuffer && objectsCount <= m_capacity) {
+			return;
+		}
+
+		if (m_pBuffer) {
+			m_retiredBuffers.push_back({ m_pBuffer, pCommandQueueDirect->Signal() });
+		}
+		m_capacity = std::bit_ceil(std::max(objectsCount, 1u));
+		// committed resources are zeroed, so nothing is visible at first
+		m_pBuffer = std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ .heapType{ D3D12_HEAP_TYPE_DEFAULT } },
+			GPUResource::ResourceData{
+				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(
+					static_cast<UINT64>(m_capacity) * sizeof(uint32_t),
+					D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS
+				) },
+				.resInitState{ D3D12_RESOURCE_STATE_UNORDERED_ACCESS }
+			},
+			D3D12MA::ALLOCATION_FLAG_COMMITTED
+		);
+	}
+
+	void VisibilityBuffer::RecordBarrier(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const {
+		CD3DX12_RESOURCE_BARRIER barrier{ CD3DX12_RESOURCE_BARRIER::UAV(m_pBuffer->GetResource().Get()) };
+		pCommandList->ResourceBarrier(1, &barrier);
+	}
+
+	void CulledCommandBuffer::Reserve(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect,
+		uint32_t commandsCount,
+		uint32_t instancesCount
+	) {
+		while (!m_retiredBuffers.empty() && pCommandQueueDirect->IsFenceComplete(m_retiredBuffers.front().fenceValue)) {
+			m_retiredBuffers.pop_front();
+		}
+
+		bool isCommandBufferGrowing{ !m_pCommandBuffer || commandsCount > m_commandsCapacity };
+		bool isInstanceBufferGrowing{ !m_pInstanceBuffer || instancesCount > m_instancesCapacity };
+		if (!isCommandBufferGrowing && !isInstanceBufferGrowing) {
+			return;
+		}
+
+		uint64_t fenceValue{ pCommandQueueDirect->Signal() };
+		if (isCommandBufferGrowing) {
+			if (m_pCommandBuffer) {
+				m_retiredBuffers.push_back({ m_pCommandBuffer, fenceValue });
+			}
+			m_commandsCapacity = std::bit_ceil(std::max(commandsCount, 1u));
+			m_pCommandBuffer = CreateBuffer(pAllocator, GetCounterOffset() + CULLING_MAX_CHUNKS_COUNT * sizeof(UINT));
+			m_commandBufferState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		}
+		if (isInstanceBufferGrowing) {
+			if (m_pInstanceBuffer) {
+				m_retiredBuffers.push_back({ m_pInstanceBuffer, fenceValue });
+			}
+			m_instancesCapacity = std::bit_ceil(std::max(instancesCount, 1u));
+			m_pInstanceBuffer = CreateBuffer(pAllocator, static_cast<UINT64>(m_instancesCapacity) * sizeof(uint32_t));
+			m_instanceBufferState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		}
+	}
+
+	void CulledCommandBuffer::RecordCulling(
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+		std::shared_ptr<ComputeObject> pCuller,
+		const CullingConstants& constants,
+		D3D12_GPU_VIRTUAL_ADDRESS inputCommandsAddress,
+		D3D12_GPU_VIRTUAL_ADDRESS instancesAddress,
+		D3D12_GPU_VIRTUAL_ADDRESS objectBoundsAddress,
+		const VisibilityBuffer& visibilityBuffer,
+		const HzbView& hzbView
+	) {
+		assert(IsCreated() && visibilityBuffer.IsCreated());
+		// the HZB table is bound in every phase, without an HZB any texture SRV will do
+		assert(hzbView.pDescHeap);
+		D3D12_GPU_VIRTUAL_ADDRESS counterAddress{
+			m_pCommandBuffer->GetResource()->GetGPUVirtualAddress() + GetCounterOffset()
+		};
+
+		ResourceTransition(pCommandList, m_pCommandBuffer->GetResource(), m_commandBufferState, D3D12_RESOURCE_STATE_COPY_DEST);
+		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER parameters[CULLING_MAX_CHUNKS_COUNT]{};
+		for (UINT chunkId{}; chunkId < CULLING_MAX_CHUNKS_COUNT; ++chunkId) {
+			parameters[chunkId] = { .Dest{ counterAddress + chunkId * sizeof(UINT) }, .Value{ 0 } };
+		}
+		pCommandList->WriteBufferImmediate(CULLING_MAX_CHUNKS_COUNT, parameters, nullptr);
+		ResourceTransition(pCommandList, m_pCommandBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		if (m_instanceBufferState != D3D12_RESOURCE_STATE_UNORDERED_ACCESS) {
+			ResourceTransition(pCommandList, m_pInstanceBuffer->GetResource(), m_instanceBufferState, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+		visibilityBuffer.RecordBarrier(pCommandList);
+		pCommandList->SetDescriptorHeaps(1, &hzbView.pDescHeap);
+
+		pCuller->Dispatch(
+			pCommandList,
+			static_cast<UINT>(std::ceil(constants.commandsCount / float(threadBlockSize))), 1, 1,
+			[&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, UINT& rootParamId) {
+				pCommandList->SetComputeRoot32BitConstants(rootParamId++, sizeof(CullingConstants) / sizeof(UINT), &constants, 0);
+				pCommandList->SetComputeRootShaderResourceView(rootParamId++, inputCommandsAddress);
+				pCommandList->SetComputeRootShaderResourceView(rootParamId++, instancesAddress);
+				pCommandList->SetComputeRootShaderResourceView(rootParamId++, objectBoundsAddress);
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, m_pCommandBuffer->GetResource()->GetGPUVirtualAddress());
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, counterAddress);
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, GetVisibleInstancesAddress());
+				pCommandList->SetComputeRootUnorderedAccessView(rootParamId++, visibilityBuffer.GetGpuAddress());
+				pCommandList->SetComputeRootDescriptorTable(rootParamId++, hzbView.srvHandle);
+			}
+		);
+
+		m_commandBufferState = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+		ResourceTransition(pCommandList, m_pCommandBuffer->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, m_commandBufferState);
+		m_instanceBufferState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+		ResourceTransition(pCommandList, m_pInstanceBuffer->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, m_instanceBufferState);
+	}
+
+	void CulledCommandBuffer::Execute(
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+		Microsoft::WRL::ComPtr<ID3D12CommandSignature> pCommandSignature,
+		uint32_t maxCommandsCount,
+		uint32_t chunkId,
+		uint32_t chunksCount
+	) const {
+		uint32_t commandsPerChunk{ GetCommandsPerChunk(maxCommandsCount, chunksCount) };
+		uint32_t firstCommand{ chunkId * commandsPerChunk };
+		if (firstCommand >= std::min(maxCommandsCount, m_commandsCapacity)) {
+			return;
+		}
+		pCommandList->ExecuteIndirect(
+			pCommandSignature.Get(),
+			std::min({ commandsPerChunk, maxCommandsCount - firstCommand, m_commandsCapacity - firstCommand }),
+			m_pCommandBuffer->GetResource().Get(),
+			static_cast<UINT64>(firstCommand) * sizeof(IdIndirectCommand),
+			m_pCommandBuffer->GetResource().Get(),
+			GetCounterOffset() + chunkId * sizeof(UINT)
+		);
+	}
+
+	std::shared_ptr<GPUResource> CulledCommandBuffer::CreateBuffer(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		UINT64 size
+	) {
+		return std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ .heapType{ D3D12_HEAP_TYPE_DEFAULT } },
+			GPUResource::ResourceData{
+				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) },
+				.resInitState{ D3D12_RESOURCE_STATE_UNORDERED_ACCESS }
+			}
+		);
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <deque>
+
+#include "CommandQueue.h"
+#include "ComputeObject.h"
+#include "GpuCulling.h"
+#include "GPUResource.h"
+
+namespace GpuCulling {
+	struct RetiredBuffer {
+		std::shared_ptr<GPUResource> pBuffer{};
+		uint64_t fenceValue{};
+	};
+
+	// Visibility of every object slot after the last late phase, starts zeroed.
+	// It is shared by the early and late culling of a subsystem.
+	class VisibilityBuffer {
+		std::shared_ptr<GPUResource> m_pBuffer{};
+		uint32_t m_capacity{};
+		std::deque<RetiredBuffer> m_retiredBuffers{};
+
+	public:
+		// A grown buffer starts over, objects visible so far are drawn by the late phase once.
+		void Reserve(
+			Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+			std::shared_ptr<CommandQueue> pCommandQueueDirect,
+			uint32_t objectsCount
+		);
+
+		bool IsCreated() const {
+			return m_pBuffer != nullptr;
+		}
+
+		// the early phase reads what the late phase of the previous frame wrote
+		void RecordBarrier(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const;
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress() const {
+			return m_pBuffer->GetResource()->GetGPUVirtualAddress();
+		}
+	};
+
+	// Output of the culling pass: compacted commands with their count and the visible instances.
+	// Culling and drawing are recorded into the same direct list.
+	class CulledCommandBuffer {
+		std::shared_ptr<GPUResource> m_pCommandBuffer{};
+		D3D12_RESOURCE_STATES m_commandBufferState{};
+		uint32_t m_commandsCapacity{};
+
+		std::shared_ptr<GPUResource> m_pInstanceBuffer{};
+		D3D12_RESOURCE_STATES m_instanceBufferState{};
+		uint32_t m_instancesCapacity{};
+
+		std::deque<RetiredBuffer> m_retiredBuffers{};
+
+	public:
+		// Grows the buffers, must not be called while a list using them is recorded.
+		// Old buffers are kept until the direct queue has passed the work submitted so far.
+		void Reserve(
+			Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+			std::shared_ptr<CommandQueue> pCommandQueueDirect,
+			uint32_t commandsCount,
+			uint32_t instancesCount
+		);
+
+		bool IsCreated() const {
+			return m_pCommandBuffer && m_pInstanceBuffer;
+		}
+
+		// Input commands, instances and bounds have to be readable by non pixel shaders, the HZB too in the late phase.
+		// Leaves the outputs ready for Execute and the vertex shader.
+		void RecordCulling(
+			Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+			std::shared_ptr<ComputeObject> pCuller,
+			const CullingConstants& constants,
+			D3D12_GPU_VIRTUAL_ADDRESS inputCommandsAddress,
+			D3D12_GPU_VIRTUAL_ADDRESS instancesAddress,
+			D3D12_GPU_VIRTUAL_ADDRESS objectBoundsAddress,
+			const VisibilityBuffer& visibilityBuffer,
+			const HzbView& hzbView
+		);
+
+		// Draws the window of one chunk, chunking has to match the culling constants
+		void Execute(
+			Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+			Microsoft::WRL::ComPtr<ID3D12CommandSignature> pCommandSignature,
+			uint32_t maxCommandsCount,
+			uint32_t chunkId = 0,
+			uint32_t chunksCount = 1
+		) const;
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetVisibleInstancesAddress() const {
+			return m_pInstanceBuffer->GetResource()->GetGPUVirtualAddress();
+		}
+
+	private:
+		// commands are a multiple of 4 bytes, so the counters need no extra alignment
+		UINT64 GetCounterOffset() const {
+			return static_cast<UINT64>(m_commandsCapacity) * sizeof(IdIndirectCommand);
+		}
+
+		static std::shared_ptr<GPUResource> CreateBuffer(
+			Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+			UINT64 size
+		);
+	};
+}
@@ -0,0 +1,37 @@
+#ifndef CULLING_DATA
+#define CULLING_DATA
+
+#include "HlslCppTypesRedefine.h"
+
+// Layouts shared by IdIndirectCuller.hlsl and its CPU reference in GpuCulling
+
+// frustum test only
+#define CULLING_PHASE_FRUSTUM 0
+// draws instances visible last frame, before the HZB is built
+#define CULLING_PHASE_EARLY 1
+// tests against the HZB, draws instances the early phase skipped and stores visibility for the next frame
+#define CULLING_PHASE_LATE 2
+
+// The output is split into windows of commandsPerChunk commands, one per chunk of the input, each with its own count,
+// so the chunks can be drawn from different command lists in input order
+#define CULLING_MAX_CHUNKS_COUNT 8
+
+// world space bounding sphere, xyz is the center and w the radius, indexed like the object data
+struct ObjectBounds {
+    float4 sphere;
+};
+
+// Set as root constants, planes point inside the frustum.
+// The matrix is stored the way SceneBuffer stores it, shaders multiply it from the left.
+struct CullingConstants {
+    float4 frustumPlanes[6];
+    float4x4 viewProjection;
+    uint commandsCount;
+    uint phase;
+    uint2 hzbSize;
+    uint hzbMipsCount;
+    // after hzbSize, which can't cross a 16 byte boundary in the shader
+    uint commandsPerChunk;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef DEFERRED_LIGHTING_HLSLI
+#define DEFERRED_LIGHTING_HLSLI
+
+#include "BlinnPhongLighting.hlsli"
+#include "Clusters.hlsli"
+
+// Lighting shared by DeferredShadingComputeShader.hlsl and VisibilityShadingComputeShader.hlsl,
+// both get the same first root parameters from Scene::RunDeferredShading
+
+struct SceneBuffer
+{
+    matrix vpMatrix;
+    matrix invViewProjMatrix;
+    float4 cameraPosition;
+    float4 nearFar;
+};
+
+ConstantBuffer<SceneBuffer> SceneCB : register(b0);
+
+ConstantBuffer<LightingConstants> LightingCB : register(b1);
+
+StructuredBuffer<Light> lights : register(t0, space1);
+// built by LightClusterBuilder.hlsl this frame
+StructuredBuffer<uint> clusterLightCounts : register(t1, space1);
+StructuredBuffer<uint> clusterLightIndices : register(t2, space1);
+
+float3 WorldPositionFromDepth(float2 uv, float depth)
+{
+    uv = float2(2.f, -2.f) * uv - float2(1.f, -1.f);
+    float4 worldPos = mul(SceneCB.invViewProjMatrix, float4(uv, depth, 1.f));
+    return worldPos.xyz / worldPos.w;
+}
+
+// ambient plus the lights reaching the cluster of the pixel, uv has y pointing down
+float3 GetLightColor(float2 uvGlobal, float3 worldPos, float3 norm)
+{
+    float3 lightColor = LightingCB.ambientColorAndPower.xyz * LightingCB.ambientColorAndPower.w;
+    
+    float viewDepth = dot(worldPos - LightingCB.clusters.cameraPosition.xyz, LightingCB.clusters.cameraForward.xyz);
+    uint clusterId = GetClusterId(LightingCB.clusters, uvGlobal, viewDepth);
+    uint clusterLightsCount = clusterLightCounts[clusterId];
+    for (uint i = 0; i < clusterLightsCount; ++i)
+    {
+        Lighting lighting = GetPointLight(
+            lights[clusterLightIndices[clusterId * CLUSTER_LIGHTS_MAX_COUNT + i]],
+            worldPos,
+            worldPos - SceneCB.cameraPosition.xyz,
+            norm,
+            1.f
+        );
+        
+        lightColor += lighting.diffuse;
+        lightColor += lighting.specular;
+    }
+    
+    return lightColor;
+}
+
+#endif
@@ -1,30 +1,10 @@
-#include "BlinnPhongLighting.hlsli"
+#include "DeferredLighting.hlsli"
+#include "GBufferEncoding.hlsli"
 #include "Math.hlsli"
 #include "MaterialCB.h"
 
-#define LIGHTS_MAX_COUNT 10
-
-struct SceneBuffer
-{
-    matrix vpMatrix;
-    matrix invViewProjMatrix;
-    float4 cameraPosition;
-    float4 nearFar;
-};
-
-ConstantBuffer<SceneBuffer> SceneCB : register(b0);
-
-struct LightBuffer
-{
-    float4 ambientColorAndPower;
-    uint4 lightCount;
-    Light lights[LIGHTS_MAX_COUNT];
-};
-
-ConstantBuffer<LightBuffer> LightCB : register(b1);
-
-Texture2D<float4> uvMaterialId : register(t0);
-Texture2D<float4> tbn : register(t1);
+Texture2D<uint4> uvMaterialId : register(t0);
+Texture2D<uint4> tbn : register(t1);
 
 Texture2D<float> depthBuffer : register(t2);
 
@@ -35,17 +15,10 @@ Texture2D<float4> MaterialsTextures[] : register(t3);
 
 SamplerState s1 : register(s0);
 
-float3 WorldPositionFromDepth(float2 uv, float depth)
-{
-    uv = float2(2.f, -2.f) * uv - float2(1.f, -1.f);
-    float4 worldPos = mul(SceneCB.invViewProjMatrix, float4(uv, depth, 1.f));
-    return worldPos.xyz / worldPos.w;
-}
-
 #define DDX_DDY_PIXEL_CHECK_CNT 4   // 2 / 4
 float2 BestUVDerivative(
     int3 pixel,
-    float4 pixelUVMI,
+    uint4 pixelUVMI,
     float pixelDepth,
     int3 pixelDeltas[DDX_DDY_PIXEL_CHECK_CNT]
 )
@@ -59,9 +32,10 @@ float2 BestUVDerivative(
         if (abs(deltaDepth) > allowedDeltaDepth)
             continue;
         
-        float4 uvmiDelta = NonUniformResourceIndex(uvMaterialId.Load(pixel + pixelDeltas[i])) - pixelUVMI;
-        if (uvmiDelta.z == 0.f && uvmiDelta.w == 0.f && length(uvmiDelta.xy) < length(uvBest))
-            uvBest = uvmiDelta.xy;
+        uint4 uvmiNeighbour = NonUniformResourceIndex(uvMaterialId.Load(pixel + pixelDeltas[i]));
+        float2 uvDelta = WrapUvDelta(DecodeUv(uvmiNeighbour) - DecodeUv(pixelUVMI));
+        if (DecodeMaterialId(uvmiNeighbour) == DecodeMaterialId(pixelUVMI) && length(uvDelta) < length(uvBest))
+            uvBest = uvDelta;
     }
 
     if (uvBest.x == 1.f && uvBest.y == 1.f)
@@ -99,9 +73,9 @@ void main(ComputeShaderInput IN)
         return;
     }
     
-    float4 uvmi = NonUniformResourceIndex(uvMaterialId.Load(pixel));
-    float2 uv = uvmi.xy;
-    uint materialId = uvmi.z;
+    uint4 uvmi = NonUniformResourceIndex(uvMaterialId.Load(pixel));
+    float2 uv = DecodeUv(uvmi);
+    uint materialId = DecodeMaterialId(uvmi);
     
     if (materialId == 0) {
         output[pixel.xy] = float4(.4f, .6f, .9f, 1.f);
@@ -125,7 +99,7 @@ void main(ComputeShaderInput IN)
     // normal
     float3 nmValue = MaterialsTextures[NonUniformResourceIndex(material.y)].SampleGrad(s1, uv, uvDdx, uvDdy).xyz;
     float3 localNorm = normalize(2.f * nmValue - 1.f); // normalize to avoid unnormalized texture
-    float4 tbnQuat = tbn.Load(pixel);
+    float4 tbnQuat = DecodeQuaternion(tbn.Load(pixel));
     matrix tbnMatrix = quaternion_to_matrix(tbnQuat);
     float3 norm = mul(tbnMatrix, float4(localNorm, 0.f)).xyz;
     
@@ -133,20 +107,7 @@ void main(ComputeShaderInput IN)
     float2 uvGlobal = float2(pixel.xy) / float2(w, h);
     float3 worldPos = WorldPositionFromDepth(uvGlobal, depth);
     
-    float3 lightColor = LightCB.ambientColorAndPower.xyz * LightCB.ambientColorAndPower.w;
-    for (uint i = 0; i < LightCB.lightCount.x; ++i)
-    {
-        Lighting lighting = GetPointLight(
-            LightCB.lights[i],
-            worldPos,
-            worldPos - SceneCB.cameraPosition.xyz,
-            norm,
-            1.f
-        );
-        
-        lightColor += lighting.diffuse;
-        lightColor += lighting.specular;
-    }
+    float3 lightColor = GetLightColor(uvGlobal, worldPos, norm);
     
     float3 albedo = MaterialsTextures[NonUniformResourceIndex(material.x)].SampleGrad(s1, uv, uvDdx, uvDdy);
     
@@ -1,5 +1,8 @@
 #include "DepthBuffer.h"
 
+#include <algorithm>
+#include <bit>
+
 DepthBuffer::DepthBuffer(
 	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 	Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
@@ -85,10 +88,15 @@ bool DepthBuffer::ResizeHZB(
 		return false;
 	}
 
-	UINT mipLevels{ 1u + static_cast<UINT>(std::log2f(resMax)) };
+	// Padded to a power of two: the last texel of an odd mip side covers the pixels a 2x2 reduction
+	// of the depth's size would drop, they'd be under no texel and the test wouldn't be conservative.
+	// The padding after the depth is never read, mip 0 only gets the depth copied to it.
+	UINT hzbWidth{ std::bit_ceil(static_cast<UINT>(width)) };
+	UINT hzbHeight{ std::bit_ceil(height) };
+	UINT mipLevels{ static_cast<UINT>(std::bit_width(std::max(hzbWidth, hzbHeight))) };
 	D3D12_RESOURCE_DESC resDesc{ m_depthBufferDesc };
-	resDesc.Width = width;
-	resDesc.Height = height;
+	resDesc.Width = hzbWidth;
+	resDesc.Height = hzbHeight;
 	resDesc.MipLevels = mipLevels;
 	resDesc.Format = DXGI_FORMAT_R32_FLOAT;
 	resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
@@ -147,6 +155,21 @@ void DepthBuffer::CreateHierarchicalDepthBuffer(
 		return;
 	}
 
+	ResourceTransition(pCommandList, m_pDepthBuffer->GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	ResourceTransition(pCommandList, m_pHZBuffer->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+	CopyDepthToHZB(pCommandList);
+	ResourceTransition(pCommandList, m_pDepthBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	ResourceTransition(pCommandList, m_pHZBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	DownsampleHZB(pCommandList, pDescHeap);
+	ResourceTransition(pCommandList, m_pDepthBuffer->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+}
+
+void DepthBuffer::CopyDepthToHZB(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) {
+	if (!m_pSinglePassDownsampler) {
+		return;
+	}
+
 	// copy original depth-buffer as mip 0
 	pCommandList->CopyTextureRegion(
 		&CD3DX12_TEXTURE_COPY_LOCATION(m_pHZBuffer->GetResource().Get(), 0),
@@ -154,6 +177,15 @@ void DepthBuffer::CreateHierarchicalDepthBuffer(
 		&CD3DX12_TEXTURE_COPY_LOCATION(m_pDepthBuffer->GetResource().Get(), 0),
 		&CD3DX12_BOX(0, 0, 0, m_width, m_height, 1)
 	);
+}
+
+void DepthBuffer::DownsampleHZB(
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> pDescHeap
+) {
+	if (!m_pSinglePassDownsampler) {
+		return;
+	}
 
 	// run single pass downsampler
 	m_pSinglePassDownsampler->Dispatch(
@@ -169,6 +201,10 @@ std::shared_ptr<Texture> DepthBuffer::GetTexture() const {
 	return m_pDepthBuffer;
 }
 
+std::shared_ptr<Texture> DepthBuffer::GetHZBTexture() const {
+	return m_pHZBuffer;
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE DepthBuffer::GetDsvCpuDescHandle() const {
 	return m_pDsvsRange->GetCpuHandle();
 }
@@ -73,8 +73,17 @@ public:
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
 		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> pDescHeap
 	);
+	// both steps of CreateHierarchicalDepthBuffer, the caller is responsible for transitions:
+	// depth buffer in COPY_SOURCE and HZB in COPY_DEST for the copy,
+	// depth buffer in NON_PIXEL_SHADER_RESOURCE and HZB in UNORDERED_ACCESS for downsampling
+	void CopyDepthToHZB(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList);
+	void DownsampleHZB(
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> pDescHeap
+	);
 
 	std::shared_ptr<Texture> GetTexture() const;
+	std::shared_ptr<Texture> GetHZBTexture() const;
 
 	D3D12_CPU_DESCRIPTOR_HANDLE GetDsvCpuDescHandle() const;
 
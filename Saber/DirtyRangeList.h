@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Half-open ranges of elements changed since the last upload
+class DirtyRangeList {
+public:
+	struct Range {
+		size_t begin{};
+		size_t end{};
+	};
+
+private:
+	std::vector<Range> m_ranges{};
+
+public:
+	void Add(size_t begin, size_t end) {
+		if (begin >= end) {
+			return;
+		}
+		// sequential updates (filling a buffer) grow the last range
+		if (!m_ranges.empty()) {
+			Range& last{ m_ranges.back() };
+			if (begin >= last.begin && begin <= last.end) {
+				last.end = std::max(last.end, end);
+				return;
+			}
+		}
+		m_ranges.push_back({ begin, end });
+	}
+
+	// sorts and merges overlapping or adjacent ranges, drops everything past size
+	const std::vector<Range>& Merge(size_t size) {
+		std::sort(m_ranges.begin(), m_ranges.end(), [](const Range& lhs, const Range& rhs) {
+			return lhs.begin < rhs.begin;
+		});
+
+		size_t mergedCount{};
+		for (const Range& range : m_ranges) {
+			if (range.begin >= size) {
+				break;
+			}
+			if (mergedCount && range.begin <= m_ranges[mergedCount - 1].end) {
+				m_ranges[mergedCount - 1].end = std::max(m_ranges[mergedCount - 1].end, range.end);
+			}
+			else {
+				m_ranges[mergedCount++] = range;
+			}
+		}
+		m_ranges.resize(mergedCount);
+		if (!m_ranges.empty()) {
+			m_ranges.back().end = std::min(m_ranges.back().end, size);
+		}
+
+		return m_ranges;
+	}
+
+	size_t GetElementsCount() const {
+		size_t count{};
+		for (const Range& range : m_ranges) {
+			count += range.end - range.begin;
+		}
+		return count;
+	}
+
+	bool IsEmpty() const {
+		return m_ranges.empty();
+	}
+
+	void Clear() {
+		m_ranges.clear();
+	}
+};
@@ -0,0 +1,95 @@
+#include "DrawSorting.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace DrawSorting {
+	namespace {
+		constexpr uint32_t digitBits{ 8 };
+		constexpr uint32_t bucketsCount{ 1 << digitBits };
+		constexpr size_t chunkSize{ 64 * 1024 };
+
+		constexpr uint64_t FieldMask(uint32_t bits) {
+			return (uint64_t{ 1 } << bits) - 1;
+		}
+
+		uint32_t GetDigit(DrawKey key, uint32_t shift) {
+			return static_cast<uint32_t>(key >> shift) & (bucketsCount - 1);
+		}
+	}
+
+	DrawKey MakeDrawKey(uint32_t pass, uint32_t pipelineId, uint32_t materialId, float viewDepth) {
+		uint32_t depthBitsValue{ std::bit_cast<uint32_t>(std::max(viewDepth, 0.f)) >> (32 - depthBits) };
+		return (pass & FieldMask(passBits)) << (pipelineBits + materialBits + depthBits)
+			| (pipelineId & FieldMask(pipelineBits)) << (materialBits + depthBits)
+			| (materialId & FieldMask(materialBits)) << depthBits
+			| depthBitsValue;
+	}
+
+	void RadixSort(std::vector<DrawKey>& keys, std::vector<uint32_t>& values, JobSystem<>* pJobSystem) {
+		assert(keys.size() == values.size());
+		size_t count{ keys.size() };
+		if (count < 2) {
+			return;
+		}
+
+		size_t chunksCount{ pJobSystem ? (count + chunkSize - 1) / chunkSize : 1 };
+		size_t currChunkSize{ (count + chunksCount - 1) / chunksCount };
+		auto forEachChunk{ [pJobSystem, chunksCount](const auto& task) {
+			if (chunksCount == 1) {
+				task(0);
+			}
+			else {
+				pJobSystem->RunAndWait(chunksCount, task);
+			}
+		} };
+
+		std::vector<DrawKey> sortedKeys(count);
+		std::vector<uint32_t> sortedValues(count);
+		// per chunk, counts and then the offsets the chunk scatters to
+		std::vector<size_t> histograms(chunksCount * bucketsCount);
+
+		for (uint32_t shift{}; shift < 64; shift += digitBits) {
+			std::fill(histograms.begin(), histograms.end(), size_t{});
+			forEachChunk([&](size_t chunkId) {
+				size_t* pHistogram{ histograms.data() + chunkId * bucketsCount };
+				size_t end{ std::min((chunkId + 1) * currChunkSize, count) };
+				for (size_t i{ chunkId * currChunkSize }; i < end; ++i) {
+					++pHistogram[GetDigit(keys[i], shift)];
+				}
+			});
+
+			// bucket by bucket, chunks in order, so equal digits keep their order
+			size_t offset{};
+			bool isSingleBucket{};
+			for (uint32_t bucket{}; bucket < bucketsCount; ++bucket) {
+				size_t bucketBegin{ offset };
+				for (size_t chunkId{}; chunkId < chunksCount; ++chunkId) {
+					size_t& chunkCount{ histograms[chunkId * bucketsCount + bucket] };
+					size_t chunkOffset{ offset };
+					offset += chunkCount;
+					chunkCount = chunkOffset;
+				}
+				if (offset - bucketBegin == count) {
+					isSingleBucket = true;
+					break;
+				}
+			}
+			if (isSingleBucket) {
+				continue;
+			}
+
+			forEachChunk([&](size_t chunkId) {
+				size_t* pOffsets{ histograms.data() + chunkId * bucketsCount };
+				size_t end{ std::min((chunkId + 1) * currChunkSize, count) };
+				for (size_t i{ chunkId * currChunkSize }; i < end; ++i) {
+					size_t destination{ pOffsets[GetDigit(keys[i], shift)]++ };
+					sortedKeys[destination] = keys[i];
+					sortedValues[destination] = values[i];
+				}
+			});
+			keys.swap(sortedKeys);
+			values.swap(sortedValues);
+		}
+	}
+}
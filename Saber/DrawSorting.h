@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace DrawSorting {
+	// From the most significant bits: pass, pipeline state, material, view depth.
+	// Sorting by the key groups draws by state and orders each group front to back for early depth rejection.
+	using DrawKey = uint64_t;
+
+	constexpr uint32_t passBits{ 4 };
+	constexpr uint32_t pipelineBits{ 16 };
+	constexpr uint32_t materialBits{ 20 };
+	constexpr uint32_t depthBits{ 24 };
+	static_assert(passBits + pipelineBits + materialBits + depthBits == 64);
+
+	// Ids are truncated to their fields. Positive floats compare like their bits,
+	// so the depth keeps the exponent and the top of the mantissa, negative depth (behind the camera) is 0.
+	DrawKey MakeDrawKey(uint32_t pass, uint32_t pipelineId, uint32_t materialId, float viewDepth);
+
+	// Stable LSD radix sort of keys with their values, 8 bits per pass. Passes where all keys share the digit
+	// are skipped. With a job system large arrays are split into chunks that are counted and scattered by its workers,
+	// the calling thread takes part and waits for the rest, so it must not be a job system worker.
+	void RadixSort(std::vector<DrawKey>& keys, std::vector<uint32_t>& values, JobSystem<>* pJobSystem = nullptr);
+}
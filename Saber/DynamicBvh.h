@@ -0,0 +1,530 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <DirectXCollision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+// AABB tree with one object per leaf. Leaf ids (proxies) stay valid until the object is removed.
+// Dynamic trees insert, remove and move objects incrementally: leaves are fattened so small moves
+// don't touch the tree, and ancestors of changed leaves are rotated to keep the surface area low.
+// Static trees have exact leaves and are rebuilt with binned SAH before the first query after a change.
+// All methods lock, a query holds the lock while the job system workers traverse subtrees.
+template <typename UserData>
+class DynamicBvh {
+public:
+	static constexpr uint32_t nullId{ std::numeric_limits<uint32_t>::max() };
+
+private:
+	struct Aabb {
+		DirectX::XMFLOAT3 min{};
+		DirectX::XMFLOAT3 max{};
+	};
+
+	struct Node {
+		Aabb box{};
+		// the next free node for nodes in the free list
+		uint32_t parentId{ nullId };
+		uint32_t childIds[2]{ nullId, nullId };
+		UserData userData{};
+
+		bool IsLeaf() const {
+			return childIds[0] == nullId;
+		}
+	};
+
+	static constexpr size_t sahBinsCount{ 16 };
+	// subtrees handed to the workers by a parallel query
+	static constexpr size_t parallelSubtreesCount{ 32 };
+	// relative to the object size
+	static constexpr float fatMargin{ 0.1f };
+
+	const bool m_isStatic{};
+	std::vector<Node> m_nodes{};
+	uint32_t m_rootId{ nullId };
+	uint32_t m_freeId{ nullId };
+	size_t m_leavesCount{};
+	bool m_isRebuildPending{};
+	std::mutex m_mutex{};
+
+public:
+	explicit DynamicBvh(bool isStatic) : m_isStatic(isStatic) {}
+
+	uint32_t Insert(const DirectX::BoundingBox& box, const UserData& userData) {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		uint32_t leafId{ AllocateNode() };
+		m_nodes[leafId].box = m_isStatic ? ToAabb(box) : Fatten(box);
+		m_nodes[leafId].userData = userData;
+		InsertLeaf(leafId);
+		++m_leavesCount;
+		m_isRebuildPending = m_isStatic;
+		return leafId;
+	}
+
+	void Remove(uint32_t leafId) {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		assert(leafId < m_nodes.size() && m_nodes[leafId].IsLeaf());
+		RemoveLeaf(leafId);
+		FreeNode(leafId);
+		--m_leavesCount;
+		m_isRebuildPending = m_isStatic;
+	}
+
+	// Returns false when a dynamic leaf still contains the box and the tree is unchanged.
+	bool Move(uint32_t leafId, const DirectX::BoundingBox& box) {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		assert(leafId < m_nodes.size() && m_nodes[leafId].IsLeaf());
+		Aabb aabb{ ToAabb(box) };
+		if (!m_isStatic && Contains(m_nodes[leafId].box, aabb)) {
+			return false;
+		}
+
+		RemoveLeaf(leafId);
+		m_nodes[leafId].box = m_isStatic ? aabb : Fatten(box);
+		InsertLeaf(leafId);
+		m_isRebuildPending = m_isStatic;
+		return true;
+	}
+
+	void SetUserData(uint32_t leafId, const UserData& userData) {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_nodes[leafId].userData = userData;
+	}
+
+	// rebuilds the inner nodes with binned SAH, leaf ids are kept
+	void Rebuild() {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		RebuildImpl();
+	}
+
+	size_t GetSize() {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		return m_leavesCount;
+	}
+
+	// Queries append the user data of intersecting leaves to results, without a job system on the calling thread.
+	// With one the calling thread must not be a worker.
+	void Query(
+		const FrustumCulling::Frustum& frustum,
+		std::vector<UserData>& results,
+		JobSystem<>* pJobSystem = nullptr
+	) {
+		QueryImpl([&frustum](const Aabb& box) {
+			// the corner farthest along the plane normal decides
+			for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+				float x{ plane.x >= 0.f ? box.max.x : box.min.x };
+				float y{ plane.y >= 0.f ? box.max.y : box.min.y };
+				float z{ plane.z >= 0.f ? box.max.z : box.min.z };
+				if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.f) {
+					return false;
+				}
+			}
+			return true;
+		}, results, pJobSystem);
+	}
+
+	void Query(
+		const DirectX::BoundingSphere& sphere,
+		std::vector<UserData>& results,
+		JobSystem<>* pJobSystem = nullptr
+	) {
+		QueryImpl([&sphere](const Aabb& box) {
+			float dx{ std::max({ box.min.x - sphere.Center.x, 0.f, sphere.Center.x - box.max.x }) };
+			float dy{ std::max({ box.min.y - sphere.Center.y, 0.f, sphere.Center.y - box.max.y }) };
+			float dz{ std::max({ box.min.z - sphere.Center.z, 0.f, sphere.Center.z - box.max.z }) };
+			return dx * dx + dy * dy + dz * dz <= sphere.Radius * sphere.Radius;
+		}, results, pJobSystem);
+	}
+
+	// leaves hit by the segment from origin along the normalized direction
+	void Query(
+		const DirectX::XMFLOAT3& origin,
+		const DirectX::XMFLOAT3& direction,
+		float maxDistance,
+		std::vector<UserData>& results,
+		JobSystem<>* pJobSystem = nullptr
+	) {
+		DirectX::XMFLOAT3 invDirection{ 1.f / direction.x, 1.f / direction.y, 1.f / direction.z };
+		QueryImpl([&](const Aabb& box) {
+			// slab test, infinite inverses of zero components work out for origins off the slab planes
+			float tMin{ 0.f }, tMax{ maxDistance };
+			const float* pOrigin{ &origin.x };
+			const float* pInvDirection{ &invDirection.x };
+			const float* pMin{ &box.min.x };
+			const float* pMax{ &box.max.x };
+			for (size_t i{}; i < 3; ++i) {
+				float t0{ (pMin[i] - pOrigin[i]) * pInvDirection[i] };
+				float t1{ (pMax[i] - pOrigin[i]) * pInvDirection[i] };
+				tMin = std::max(tMin, std::min(t0, t1));
+				tMax = std::min(tMax, std::max(t0, t1));
+			}
+			return tMin <= tMax;
+		}, results, pJobSystem);
+	}
+
+private:
+	static Aabb ToAabb(const DirectX::BoundingBox& box) {
+		return Aabb{
+			.min{ box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z },
+			.max{ box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z }
+		};
+	}
+
+	static Aabb Fatten(const DirectX::BoundingBox& box) {
+		DirectX::BoundingBox fatBox{ box };
+		fatBox.Extents.x *= 1.f + fatMargin;
+		fatBox.Extents.y *= 1.f + fatMargin;
+		fatBox.Extents.z *= 1.f + fatMargin;
+		return ToAabb(fatBox);
+	}
+
+	static Aabb Union(const Aabb& lhs, const Aabb& rhs) {
+		return Aabb{
+			.min{ std::min(lhs.min.x, rhs.min.x), std::min(lhs.min.y, rhs.min.y), std::min(lhs.min.z, rhs.min.z) },
+			.max{ std::max(lhs.max.x, rhs.max.x), std::max(lhs.max.y, rhs.max.y), std::max(lhs.max.z, rhs.max.z) }
+		};
+	}
+
+	static bool Contains(const Aabb& outer, const Aabb& inner) {
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+			&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	// half of the surface area, the factor doesn't matter for comparisons
+	static float GetArea(const Aabb& box) {
+		float dx{ box.max.x - box.min.x }, dy{ box.max.y - box.min.y }, dz{ box.max.z - box.min.z };
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	static DirectX::XMFLOAT3 GetCentroid(const Aabb& box) {
+		return DirectX::XMFLOAT3{
+			(box.min.x + box.max.x) * 0.5f,
+			(box.min.y + box.max.y) * 0.5f,
+			(box.min.z + box.max.z) * 0.5f
+		};
+	}
+
+	uint32_t AllocateNode() {
+		uint32_t nodeId{};
+		if (m_freeId != nullId) {
+			nodeId = m_freeId;
+			m_freeId = m_nodes[nodeId].parentId;
+		}
+		else {
+			nodeId = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.emplace_back();
+		}
+		m_nodes[nodeId] = Node{};
+		return nodeId;
+	}
+
+	void FreeNode(uint32_t nodeId) {
+		m_nodes[nodeId].parentId = m_freeId;
+		m_nodes[nodeId].childIds[0] = m_nodes[nodeId].childIds[1] = nullId;
+		m_freeId = nodeId;
+	}
+
+	// Descends to the sibling with the lowest cost: the area of the new parent
+	// plus the growth of every ancestor (Catto, Dynamic Bounding Volume Hierarchies)
+	void InsertLeaf(uint32_t leafId) {
+		if (m_rootId == nullId) {
+			m_rootId = leafId;
+			m_nodes[leafId].parentId = nullId;
+			return;
+		}
+
+		const Aabb leafBox{ m_nodes[leafId].box };
+		uint32_t siblingId{ m_rootId };
+		while (!m_nodes[siblingId].IsLeaf()) {
+			const Node& node{ m_nodes[siblingId] };
+			float area{ GetArea(node.box) };
+			float combinedArea{ GetArea(Union(node.box, leafBox)) };
+			float cost{ combinedArea };
+			float inheritedCost{ combinedArea - area };
+
+			float childCosts[2]{};
+			for (size_t i{}; i < 2; ++i) {
+				const Node& child{ m_nodes[node.childIds[i]] };
+				float childCombinedArea{ GetArea(Union(child.box, leafBox)) };
+				childCosts[i] = inheritedCost + (child.IsLeaf() ? childCombinedArea : childCombinedArea - GetArea(child.box));
+			}
+			if (cost < childCosts[0] && cost < childCosts[1]) {
+				break;
+			}
+			siblingId = node.childIds[childCosts[0] < childCosts[1] ? 0 : 1];
+		}
+
+		uint32_t oldParentId{ m_nodes[siblingId].parentId };
+		uint32_t parentId{ AllocateNode() };
+		Node& parent{ m_nodes[parentId] };
+		parent.parentId = oldParentId;
+		parent.box = Union(leafBox, m_nodes[siblingId].box);
+		parent.childIds[0] = siblingId;
+		parent.childIds[1] = leafId;
+		m_nodes[siblingId].parentId = parentId;
+		m_nodes[leafId].parentId = parentId;
+		if (oldParentId == nullId) {
+			m_rootId = parentId;
+		}
+		else {
+			Node& oldParent{ m_nodes[oldParentId] };
+			oldParent.childIds[oldParent.childIds[0] == siblingId ? 0 : 1] = parentId;
+		}
+
+		Refit(oldParentId);
+	}
+
+	// the sibling takes the place of the parent
+	void RemoveLeaf(uint32_t leafId) {
+		if (leafId == m_rootId) {
+			m_rootId = nullId;
+			return;
+		}
+
+		uint32_t parentId{ m_nodes[leafId].parentId };
+		uint32_t grandParentId{ m_nodes[parentId].parentId };
+		const Node& parent{ m_nodes[parentId] };
+		uint32_t siblingId{ parent.childIds[parent.childIds[0] == leafId ? 1 : 0] };
+
+		m_nodes[siblingId].parentId = grandParentId;
+		if (grandParentId == nullId) {
+			m_rootId = siblingId;
+		}
+		else {
+			Node& grandParent{ m_nodes[grandParentId] };
+			grandParent.childIds[grandParent.childIds[0] == parentId ? 0 : 1] = siblingId;
+		}
+		FreeNode(parentId);
+		m_nodes[leafId].parentId = nullId;
+
+		Refit(grandParentId);
+	}
+
+	// recomputes boxes up to the root and rotates every ancestor when it lowers the area
+	void Refit(uint32_t nodeId) {
+		while (nodeId != nullId) {
+			Rotate(nodeId);
+			Node& node{ m_nodes[nodeId] };
+			node.box = Union(m_nodes[node.childIds[0]].box, m_nodes[node.childIds[1]].box);
+			nodeId = node.parentId;
+		}
+	}
+
+	// Swaps a child with a grandchild on the other side if that shrinks the box of the other child
+	void Rotate(uint32_t nodeId) {
+		const Node& node{ m_nodes[nodeId] };
+		float bestDelta{};
+		uint32_t bestChildId{ nullId };
+		uint32_t bestGrandChildId{ nullId };
+		for (size_t side{}; side < 2; ++side) {
+			uint32_t childId{ node.childIds[side] };
+			const Node& other{ m_nodes[node.childIds[1 - side]] };
+			if (other.IsLeaf()) {
+				continue;
+			}
+			// childId moves down, one grandchild moves up, the other one shares a box with childId
+			for (size_t i{}; i < 2; ++i) {
+				const Aabb& remainingBox{ m_nodes[other.childIds[1 - i]].box };
+				float delta{ GetArea(Union(m_nodes[childId].box, remainingBox)) - GetArea(other.box) };
+				if (delta < bestDelta) {
+					bestDelta = delta;
+					bestChildId = childId;
+					bestGrandChildId = other.childIds[i];
+				}
+			}
+		}
+		if (bestChildId == nullId) {
+			return;
+		}
+
+		Node& current{ m_nodes[nodeId] };
+		size_t childSide{ current.childIds[0] == bestChildId ? 0u : 1u };
+		uint32_t otherId{ current.childIds[1 - childSide] };
+		Node& other{ m_nodes[otherId] };
+		size_t grandChildSide{ other.childIds[0] == bestGrandChildId ? 0u : 1u };
+
+		current.childIds[childSide] = bestGrandChildId;
+		m_nodes[bestGrandChildId].parentId = nodeId;
+		other.childIds[grandChildSide] = bestChildId;
+		m_nodes[bestChildId].parentId = otherId;
+		other.box = Union(m_nodes[other.childIds[0]].box, m_nodes[other.childIds[1]].box);
+	}
+
+	void RebuildImpl() {
+		m_isRebuildPending = false;
+		if (m_rootId == nullId) {
+			return;
+		}
+
+		std::vector<uint32_t> leafIds{};
+		leafIds.reserve(m_leavesCount);
+		std::vector<uint32_t> stack{ m_rootId };
+		while (!stack.empty()) {
+			uint32_t nodeId{ stack.back() };
+			stack.pop_back();
+			if (m_nodes[nodeId].IsLeaf()) {
+				leafIds.push_back(nodeId);
+				continue;
+			}
+			stack.push_back(m_nodes[nodeId].childIds[0]);
+			stack.push_back(m_nodes[nodeId].childIds[1]);
+			FreeNode(nodeId);
+		}
+
+		m_rootId = BuildSah(leafIds.data(), leafIds.data() + leafIds.size());
+		m_nodes[m_rootId].parentId = nullId;
+	}
+
+	// Splits at the bin boundary with the lowest SAH cost over all axes.
+	// Leaves with the same centroid are split in halves.
+	uint32_t BuildSah(uint32_t* pBegin, uint32_t* pEnd) {
+		size_t count{ static_cast<size_t>(pEnd - pBegin) };
+		if (count == 1) {
+			return *pBegin;
+		}
+
+		Aabb centroidBounds{ .min{ GetCentroid(m_nodes[*pBegin].box) }, .max{ GetCentroid(m_nodes[*pBegin].box) } };
+		for (uint32_t* pId{ pBegin + 1 }; pId < pEnd; ++pId) {
+			DirectX::XMFLOAT3 centroid{ GetCentroid(m_nodes[*pId].box) };
+			centroidBounds = Union(centroidBounds, Aabb{ .min{ centroid }, .max{ centroid } });
+		}
+
+		struct Bin {
+			Aabb box{};
+			size_t count{};
+		};
+		float bestCost{ std::numeric_limits<float>::max() };
+		size_t bestAxis{};
+		size_t bestSplit{};
+		const float* pBoundsMin{ &centroidBounds.min.x };
+		const float* pBoundsMax{ &centroidBounds.max.x };
+		auto getBinId{ [&](uint32_t nodeId, size_t axis) {
+			DirectX::XMFLOAT3 centroid{ GetCentroid(m_nodes[nodeId].box) };
+			float extent{ pBoundsMax[axis] - pBoundsMin[axis] };
+			size_t binId{ static_cast<size_t>(((&centroid.x)[axis] - pBoundsMin[axis]) / extent * sahBinsCount) };
+			return std::min(binId, sahBinsCount - 1);
+		} };
+
+		for (size_t axis{}; axis < 3; ++axis) {
+			if (pBoundsMax[axis] - pBoundsMin[axis] <= 0.f) {
+				continue;
+			}
+			Bin bins[sahBinsCount]{};
+			for (uint32_t* pId{ pBegin }; pId < pEnd; ++pId) {
+				Bin& bin{ bins[getBinId(*pId, axis)] };
+				bin.box = bin.count ? Union(bin.box, m_nodes[*pId].box) : m_nodes[*pId].box;
+				++bin.count;
+			}
+
+			// right side costs swept from the end, left side accumulated on the way back
+			float rightCosts[sahBinsCount]{};
+			Aabb rightBox{};
+			size_t rightCount{};
+			for (size_t i{ sahBinsCount - 1 }; i > 0; --i) {
+				if (bins[i].count) {
+					rightBox = rightCount ? Union(rightBox, bins[i].box) : bins[i].box;
+					rightCount += bins[i].count;
+				}
+				rightCosts[i] = rightCount ? GetArea(rightBox) * rightCount : 0.f;
+			}
+			Aabb leftBox{};
+			size_t leftCount{};
+			for (size_t split{ 1 }; split < sahBinsCount; ++split) {
+				const Bin& bin{ bins[split - 1] };
+				if (bin.count) {
+					leftBox = leftCount ? Union(leftBox, bin.box) : bin.box;
+					leftCount += bin.count;
+				}
+				if (!leftCount || leftCount == count) {
+					continue;
+				}
+				float cost{ GetArea(leftBox) * leftCount + rightCosts[split] };
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		uint32_t* pMiddle{};
+		if (bestSplit) {
+			pMiddle = std::partition(pBegin, pEnd, [&](uint32_t nodeId) { return getBinId(nodeId, bestAxis) < bestSplit; });
+		}
+		else {
+			pMiddle = pBegin + count / 2;
+		}
+
+		uint32_t childIds[2]{ BuildSah(pBegin, pMiddle), BuildSah(pMiddle, pEnd) };
+		uint32_t nodeId{ AllocateNode() };
+		Node& node{ m_nodes[nodeId] };
+		node.childIds[0] = childIds[0];
+		node.childIds[1] = childIds[1];
+		node.box = Union(m_nodes[childIds[0]].box, m_nodes[childIds[1]].box);
+		m_nodes[childIds[0]].parentId = nodeId;
+		m_nodes[childIds[1]].parentId = nodeId;
+		return nodeId;
+	}
+
+	template <typename Overlaps>
+	void Traverse(uint32_t nodeId, const Overlaps& overlaps, std::vector<UserData>& results) const {
+		std::vector<uint32_t> stack{ nodeId };
+		while (!stack.empty()) {
+			const Node& node{ m_nodes[stack.back()] };
+			stack.pop_back();
+			if (!overlaps(node.box)) {
+				continue;
+			}
+			if (node.IsLeaf()) {
+				results.push_back(node.userData);
+				continue;
+			}
+			stack.push_back(node.childIds[0]);
+			stack.push_back(node.childIds[1]);
+		}
+	}
+
+	// The top of the tree is opened on the calling thread until there are enough subtrees for the workers,
+	// each subtree appends to its own results and they are joined in order.
+	template <typename Overlaps>
+	void QueryImpl(const Overlaps& overlaps, std::vector<UserData>& results, JobSystem<>* pJobSystem) {
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		if (m_isRebuildPending) {
+			RebuildImpl();
+		}
+		if (m_rootId == nullId) {
+			return;
+		}
+		if (!pJobSystem) {
+			Traverse(m_rootId, overlaps, results);
+			return;
+		}
+
+		std::vector<uint32_t> subtreeIds{ m_rootId };
+		for (size_t i{}; i < subtreeIds.size() && subtreeIds.size() < parallelSubtreesCount;) {
+			const Node& node{ m_nodes[subtreeIds[i]] };
+			if (node.IsLeaf() || !overlaps(node.box)) {
+				++i;
+				continue;
+			}
+			subtreeIds[i] = node.childIds[0];
+			subtreeIds.push_back(node.childIds[1]);
+		}
+
+		std::vector<std::vector<UserData>> subtreeResults(subtreeIds.size());
+		pJobSystem->RunAndWait(subtreeIds.size(), [&](size_t subtreeId) {
+			Traverse(subtreeIds[subtreeId], overlaps, subtreeResults[subtreeId]);
+		});
+		for (const std::vector<UserData>& subtreeResult : subtreeResults) {
+			results.insert(results.end(), subtreeResult.begin(), subtreeResult.end());
+		}
+	}
+};
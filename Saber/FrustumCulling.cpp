@@ -0,0 +1,242 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include <immintrin.h>
+#include <intrin.h>
+
+namespace FrustumCulling {
+	namespace {
+		// enough work per job to hide the queue overhead
+		constexpr size_t chunkSize{ 16 * 1024 };
+		static_assert(chunkSize % BoundingSpheres::laneCount == 0);
+
+		size_t WriteVisibleIds(uint32_t mask, size_t baseId, uint32_t* pVisibleIds) {
+			size_t count{};
+			while (mask) {
+				pVisibleIds[count++] = static_cast<uint32_t>(baseId + std::countr_zero(mask));
+				mask &= mask - 1;
+			}
+			return count;
+		}
+
+		size_t CullAvx2(
+			const Frustum& frustum,
+			const BoundingSpheres& spheres,
+			size_t begin,
+			size_t end,
+			uint32_t* pVisibleIds
+		) {
+			__m256 planes[6][4]{};
+			for (size_t i{}; i < 6; ++i) {
+				planes[i][0] = _mm256_set1_ps(frustum.planes[i].x);
+				planes[i][1] = _mm256_set1_ps(frustum.planes[i].y);
+				planes[i][2] = _mm256_set1_ps(frustum.planes[i].z);
+				planes[i][3] = _mm256_set1_ps(frustum.planes[i].w);
+			}
+
+			size_t count{};
+			for (size_t i{ begin }; i < end; i += 8) {
+				__m256 x{ _mm256_loadu_ps(spheres.GetCentersX() + i) };
+				__m256 y{ _mm256_loadu_ps(spheres.GetCentersY() + i) };
+				__m256 z{ _mm256_loadu_ps(spheres.GetCentersZ() + i) };
+				__m256 negRadius{ _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.GetRadii() + i)) };
+
+				__m256 isInside{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+				for (size_t j{}; j < 6; ++j) {
+					__m256 distance{ _mm256_fmadd_ps(x, planes[j][0], planes[j][3]) };
+					distance = _mm256_fmadd_ps(y, planes[j][1], distance);
+					distance = _mm256_fmadd_ps(z, planes[j][2], distance);
+					isInside = _mm256_and_ps(isInside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+				}
+
+				uint32_t mask{ static_cast<uint32_t>(_mm256_movemask_ps(isInside)) };
+				if (i + 8 > end) {
+					mask &= (1u << (end - i)) - 1;
+				}
+				count += WriteVisibleIds(mask, i, pVisibleIds + count);
+			}
+			return count;
+		}
+
+		size_t CullSse(
+			const Frustum& frustum,
+			const BoundingSpheres& spheres,
+			size_t begin,
+			size_t end,
+			uint32_t* pVisibleIds
+		) {
+			__m128 planes[6][4]{};
+			for (size_t i{}; i < 6; ++i) {
+				planes[i][0] = _mm_set1_ps(frustum.planes[i].x);
+				planes[i][1] = _mm_set1_ps(frustum.planes[i].y);
+				planes[i][2] = _mm_set1_ps(frustum.planes[i].z);
+				planes[i][3] = _mm_set1_ps(frustum.planes[i].w);
+			}
+
+			size_t count{};
+			for (size_t i{ begin }; i < end; i += 4) {
+				__m128 x{ _mm_loadu_ps(spheres.GetCentersX() + i) };
+				__m128 y{ _mm_loadu_ps(spheres.GetCentersY() + i) };
+				__m128 z{ _mm_loadu_ps(spheres.GetCentersZ() + i) };
+				__m128 negRadius{ _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.GetRadii() + i)) };
+
+				__m128 isInside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+				for (size_t j{}; j < 6; ++j) {
+					__m128 distance{ _mm_add_ps(_mm_mul_ps(x, planes[j][0]), planes[j][3]) };
+					distance = _mm_add_ps(_mm_mul_ps(y, planes[j][1]), distance);
+					distance = _mm_add_ps(_mm_mul_ps(z, planes[j][2]), distance);
+					isInside = _mm_and_ps(isInside, _mm_cmpge_ps(distance, negRadius));
+				}
+
+				uint32_t mask{ static_cast<uint32_t>(_mm_movemask_ps(isInside)) };
+				if (i + 4 > end) {
+					mask &= (1u << (end - i)) - 1;
+				}
+				count += WriteVisibleIds(mask, i, pVisibleIds + count);
+			}
+			return count;
+		}
+	}
+
+	bool IsAvx2Supported() {
+		static const bool isSupported{ [] {
+			int cpuInfo[4]{};
+			__cpuid(cpuInfo, 0);
+			if (cpuInfo[0] < 7) {
+				return false;
+			}
+			__cpuid(cpuInfo, 1);
+			bool isOsxsave{ (cpuInfo[2] & (1 << 27)) != 0 };
+			bool isAvx{ (cpuInfo[2] & (1 << 28)) != 0 };
+			bool isFma{ (cpuInfo[2] & (1 << 12)) != 0 };
+			if (!isOsxsave || !isAvx || !isFma) {
+				return false;
+			}
+			// the OS has to save ymm registers
+			if ((_xgetbv(0) & 0x6) != 0x6) {
+				return false;
+			}
+			__cpuidex(cpuInfo, 7, 0);
+			return (cpuInfo[1] & (1 << 5)) != 0;
+		}() };
+		return isSupported;
+	}
+
+	Frustum Frustum::FromViewProjection(DirectX::FXMMATRIX viewProjection) {
+		DirectX::XMFLOAT4X4 m{};
+		DirectX::XMStoreFloat4x4(&m, viewProjection);
+
+		// clip = v * M, so the planes are built from the columns
+		DirectX::XMVECTOR column[4]{};
+		for (size_t i{}; i < 4; ++i) {
+			column[i] = DirectX::XMVectorSet(m.m[0][i], m.m[1][i], m.m[2][i], m.m[3][i]);
+		}
+
+		DirectX::XMVECTOR planes[6]{
+			DirectX::XMVectorAdd(column[3], column[0]),			// left
+			DirectX::XMVectorSubtract(column[3], column[0]),	// right
+			DirectX::XMVectorAdd(column[3], column[1]),			// bottom
+			DirectX::XMVectorSubtract(column[3], column[1]),	// top
+			column[2],											// near, D3D depth is in [0, 1]
+			DirectX::XMVectorSubtract(column[3], column[2])		// far
+		};
+
+		Frustum frustum{};
+		for (size_t i{}; i < 6; ++i) {
+			DirectX::XMStoreFloat4(&frustum.planes[i], DirectX::XMPlaneNormalize(planes[i]));
+		}
+		return frustum;
+	}
+
+	void BoundingSpheres::PushBack(const DirectX::BoundingSphere& sphere) {
+		Resize(m_size + 1);
+		SetAt(m_size - 1, sphere);
+	}
+
+	void BoundingSpheres::SetAt(size_t id, const DirectX::BoundingSphere& sphere) {
+		assert(id < m_size);
+		m_centersX[id] = sphere.Center.x;
+		m_centersY[id] = sphere.Center.y;
+		m_centersZ[id] = sphere.Center.z;
+		m_radii[id] = sphere.Radius;
+	}
+
+	void BoundingSpheres::SwapRemove(size_t id) {
+		assert(id < m_size);
+		size_t lastId{ m_size - 1 };
+		m_centersX[id] = m_centersX[lastId];
+		m_centersY[id] = m_centersY[lastId];
+		m_centersZ[id] = m_centersZ[lastId];
+		m_radii[id] = m_radii[lastId];
+		Resize(lastId);
+	}
+
+	void BoundingSpheres::Clear() {
+		Resize(0);
+	}
+
+	void BoundingSpheres::Resize(size_t size) {
+		size_t paddedSize{ (size + laneCount - 1) / laneCount * laneCount };
+		m_centersX.resize(paddedSize);
+		m_centersY.resize(paddedSize);
+		m_centersZ.resize(paddedSize);
+		m_radii.resize(paddedSize);
+		// padding fails any plane test
+		for (size_t i{ size }; i < paddedSize; ++i) {
+			m_centersX[i] = m_centersY[i] = m_centersZ[i] = 0.f;
+			m_radii[i] = -std::numeric_limits<float>::infinity();
+		}
+		m_size = size;
+	}
+
+	size_t Cull(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		size_t begin,
+		size_t end,
+		uint32_t* pVisibleIds
+	) {
+		assert(begin % BoundingSpheres::laneCount == 0);
+		end = std::min(end, spheres.GetSize());
+		if (begin >= end) {
+			return 0;
+		}
+		if (IsAvx2Supported()) {
+			return CullAvx2(frustum, spheres, begin, end, pVisibleIds);
+		}
+		return CullSse(frustum, spheres, begin, end, pVisibleIds);
+	}
+
+	void CullParallel(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		JobSystem<>& jobSystem,
+		std::vector<uint32_t>& visibleIds
+	) {
+		size_t size{ spheres.GetSize() };
+		visibleIds.resize(size);
+		size_t chunksCount{ (size + chunkSize - 1) / chunkSize };
+		if (chunksCount <= 1) {
+			visibleIds.resize(Cull(frustum, spheres, 0, size, visibleIds.data()));
+			return;
+		}
+
+		// every chunk writes into its own part of visibleIds, the parts are compacted afterwards
+		std::vector<size_t> counts(chunksCount);
+		jobSystem.RunAndWait(chunksCount, [&](size_t chunkId) {
+			size_t begin{ chunkId * chunkSize };
+			counts[chunkId] = Cull(frustum, spheres, begin, begin + chunkSize, visibleIds.data() + begin);
+		});
+
+		size_t visibleCount{ counts[0] };
+		for (size_t chunkId{ 1 }; chunkId < chunksCount; ++chunkId) {
+			uint32_t* pChunkIds{ visibleIds.data() + chunkId * chunkSize };
+			std::copy(pChunkIds, pChunkIds + counts[chunkId], visibleIds.data() + visibleCount);
+			visibleCount += counts[chunkId];
+		}
+		visibleIds.resize(visibleCount);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <DirectXCollision.h>
+
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace FrustumCulling {
+	// Planes point inside, a point is inside when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum {
+		DirectX::XMFLOAT4 planes[6]{};
+
+		// Gribb-Hartmann extraction, works with row-vector matrices as DirectXMath builds them
+		static Frustum FromViewProjection(DirectX::FXMMATRIX viewProjection);
+	};
+
+	// World space bounding spheres stored SoA, so the test loads 8 of them with 4 loads.
+	// Storage is padded to the lane count with spheres that are never visible.
+	class BoundingSpheres {
+	public:
+		static constexpr size_t laneCount{ 8 };
+
+	private:
+		std::vector<float> m_centersX{};
+		std::vector<float> m_centersY{};
+		std::vector<float> m_centersZ{};
+		std::vector<float> m_radii{};
+		size_t m_size{};
+
+	public:
+		void PushBack(const DirectX::BoundingSphere& sphere);
+		void SetAt(size_t id, const DirectX::BoundingSphere& sphere);
+		// moves the last sphere into id, like the removal in RenderSubsystem
+		void SwapRemove(size_t id);
+		void Clear();
+
+		size_t GetSize() const {
+			return m_size;
+		}
+
+		const float* GetCentersX() const {
+			return m_centersX.data();
+		}
+		const float* GetCentersY() const {
+			return m_centersY.data();
+		}
+		const float* GetCentersZ() const {
+			return m_centersZ.data();
+		}
+		const float* GetRadii() const {
+			return m_radii.data();
+		}
+
+	private:
+		void Resize(size_t size);
+	};
+
+	// AVX2 and FMA on the CPU, and ymm registers saved by the OS. Checked once.
+	bool IsAvx2Supported();
+
+	// Writes ids of spheres in [begin, end) that intersect the frustum into pVisibleIds, returns their count.
+	// begin has to be a multiple of the lane count. Uses AVX2 when the CPU has it, SSE otherwise.
+	size_t Cull(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		size_t begin,
+		size_t end,
+		uint32_t* pVisibleIds
+	);
+
+	// Splits the spheres into chunks culled by the job system workers and compacts their results,
+	// visibleIds is resized to the visible count. The calling thread culls one chunk and waits for the rest,
+	// so it must not be a job system worker.
+	void CullParallel(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		JobSystem<>& jobSystem,
+		std::vector<uint32_t>& visibleIds
+	);
+}
@@ -6,8 +6,10 @@ GBuffer::GBuffer(
 	std::shared_ptr<DescriptorHeapManager> pDescHeapManagerRtv,
 	std::shared_ptr<DescriptorHeapManager> pDescHeapManagerCbvSrvUav,
 	UINT64 width,
-	UINT height
-) {
+	UINT height,
+	bool isTransient,
+	Layout layout
+) : m_layout(layout), m_isTransient(isTransient) {
 	m_pRtvsRange = pDescHeapManagerRtv->AllocateRange(L"GBuffer/Ranges/RTV", GetSize() - 1);
 	m_pSrvsRange = pDescHeapManagerCbvSrvUav->AllocateRange(L"GBuffer/Ranges/SRV", GetSize(), D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
 	m_pUavsRange = pDescHeapManagerCbvSrvUav->AllocateRange(L"GBuffer/Ranges/UAV", 1, D3D12_DESCRIPTOR_RANGE_TYPE_UAV);
@@ -21,54 +23,74 @@ void GBuffer::Resize(
 	UINT64 width,
 	UINT height
 ) {
+	// views have fixed slots, so textures can be set in any order
 	m_pRtvsRange->Clear();
 	m_pSrvsRange->Clear();
 	m_pUavsRange->Clear();
+	for (size_t i{}; i < GetSize(); ++i) {
+		if (GetBaseResourceDesc(m_layout, i).Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET) {
+			m_pRtvsRange->GetNextId();
+		}
+		if (GetBaseResourceDesc(m_layout, i).Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) {
+			m_pUavsRange->GetNextId();
+		}
+		m_pSrvsRange->GetNextId();
+	}
 
 	m_pTextures.clear();
 	m_pTextures.resize(GetSize());
 
-	for (size_t i{}; i < GetSize(); ++i) {
-		m_resDescs[i].Width = width;
-		m_resDescs[i].Height = height;
+	if (m_isTransient) {
+		return;
+	}
 
-		std::shared_ptr<Texture> pTex{ std::make_shared<Texture>(
+	for (size_t i{}; i < GetSize(); ++i) {
+		SetTexture(pDevice, i, std::make_shared<Texture>(
 			pAllocator,
 			GPUResource::HeapData{ D3D12_HEAP_TYPE_DEFAULT },
 			GPUResource::ResourceData{
-				m_resDescs[i],
-				m_resDescs[i].Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET ?
-				D3D12_RESOURCE_STATE_RENDER_TARGET : D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+				GetResourceDesc(m_layout, i, width, height),
+				GetResourceState(m_layout, i)
 			}
-		) };
+		));
+	}
+}
 
-		if (pTex->IsRtv()) {
-			pTex->CreateRenderTargetView(pDevice, m_pRtvsRange->GetNextCpuHandle());
-		}
-		if (pTex->IsSrv()) {
-			pTex->CreateShaderResourceView(pDevice, m_pSrvsRange->GetNextCpuHandle() );
-		}
-		if (pTex->IsUav()) {
-			pTex->CreateUnorderedAccessView(pDevice, m_pUavsRange->GetNextCpuHandle());
-		}
+D3D12_RESOURCE_DESC GBuffer::GetResourceDesc(Layout layout, size_t id, UINT64 width, UINT height) {
+	D3D12_RESOURCE_DESC resDesc{ GetBaseResourceDesc(layout, id) };
+	resDesc.Width = width;
+	resDesc.Height = height;
+	return resDesc;
+}
+
+D3D12_RESOURCE_STATES GBuffer::GetResourceState(Layout layout, size_t id) {
+	return GetBaseResourceDesc(layout, id).Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET ?
+		D3D12_RESOURCE_STATE_RENDER_TARGET : D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+}
 
-		m_pTextures[i] = pTex;
+void GBuffer::SetTexture(
+	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+	size_t id,
+	std::shared_ptr<Texture> pTexture
+) {
+	// render targets go first, the last texture is the only uav
+	if (pTexture->IsRtv()) {
+		pTexture->CreateRenderTargetView(pDevice, m_pRtvsRange->GetCpuHandle(id));
 	}
+	if (pTexture->IsSrv()) {
+		pTexture->CreateShaderResourceView(pDevice, m_pSrvsRange->GetCpuHandle(id));
+	}
+	if (pTexture->IsUav()) {
+		pTexture->CreateUnorderedAccessView(pDevice, m_pUavsRange->GetCpuHandle(id - m_pRtvsRange->GetSize()));
+	}
+
+	m_pTextures[id] = pTexture;
 }
 
 void GBuffer::Clear(
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
 	const float* pClearValue
 ) {
-	for (size_t i{}; i < m_pRtvsRange->GetSize(); ++i) {
-		ResourceTransition(
-			pCommandList,
-			m_pTextures[i]->GetResource().Get(),
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_RENDER_TARGET
-		);
-	}
-
 	ClearRenderTarget(
 		pCommandList,
 		m_pTextures[0]->GetResource(),
@@ -92,7 +114,7 @@ std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> GBuffer::GetRtvs() const {
 D3D12_RT_FORMAT_ARRAY GBuffer::GetRtFormatArray() const {
 	D3D12_RT_FORMAT_ARRAY rtFormats{ .NumRenderTargets{ static_cast<UINT>(GetSize() - 1) } };
 	for (size_t i{}; i < GetSize() - 1; ++i) {
-		rtFormats.RTFormats[i] = m_resDescs[i].Format;
+		rtFormats.RTFormats[i] = GetBaseResourceDesc(m_layout, i).Format;
 	}
 	return rtFormats;
 }
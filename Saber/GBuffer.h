@@ -9,23 +9,44 @@
 #include "Texture.h"
 
 class GBuffer {
-	static inline D3D12_RESOURCE_DESC m_resDescs[]{
-		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),	// uvMaterial
-		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),    // tbn
-		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),    // ddxddy
+public:
+	enum class Layout {
+		// uv, material and tangent frame of every pixel, shaded by DeferredShadingComputeShader.hlsl
+		Attributes,
+		// only the triangle of every pixel, VisibilityShadingComputeShader.hlsl fetches and interpolates its vertices
+		Visibility
+	};
+
+private:
+	static inline D3D12_RESOURCE_DESC m_attributesResDescs[]{
+		// packed as GBufferEncoding.hlsli describes, 12 bytes per pixel with the uv derivatives rebuilt from neighbours
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_UINT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),	// uvMaterial
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R10G10B10A2_UINT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),    // tbn
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)	// resulting ua
+	};
+	static inline D3D12_RESOURCE_DESC m_visibilityResDescs[]{
+		// packed as VisibilityBuffer.hlsli describes, 4 bytes per pixel next to the depth
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),	// visibility id
 		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 0, 0, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)	// resulting ua
 	};
 
+	Layout m_layout{};
+
 	std::vector<std::shared_ptr<Texture>> m_pTextures{};
 
 	std::shared_ptr<DescHeapRange> m_pSrvsRange{};
 	std::shared_ptr<DescHeapRange> m_pUavsRange{};
 	std::shared_ptr<DescHeapRange> m_pRtvsRange{};
 
+	// textures are created outside (by the render graph) and set with SetTexture
+	bool m_isTransient{};
+
 public:
-	static size_t GetSize() {
-		return _countof(m_resDescs);
+	static size_t GetSize(Layout layout) {
+		return layout == Layout::Visibility ? _countof(m_visibilityResDescs) : _countof(m_attributesResDescs);
 	}
+	static D3D12_RESOURCE_DESC GetResourceDesc(Layout layout, size_t id, UINT64 width, UINT height);
+	static D3D12_RESOURCE_STATES GetResourceState(Layout layout, size_t id);
 
 	GBuffer(
 		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
@@ -33,9 +54,18 @@ public:
 		std::shared_ptr<DescriptorHeapManager> pDescHeapManagerRtv,
 		std::shared_ptr<DescriptorHeapManager> pDescHeapManagerCbvSrvUav,
 		UINT64 width,
-		UINT height
+		UINT height,
+		bool isTransient = false,
+		Layout layout = Layout::Attributes
 	);
 
+	Layout GetLayout() const {
+		return m_layout;
+	}
+	size_t GetSize() const {
+		return GetSize(m_layout);
+	}
+
 	void Resize(
 		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
@@ -48,6 +78,11 @@ public:
 		const float* pClearValue = nullptr
 	);
 
+	void SetTexture(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		size_t id,
+		std::shared_ptr<Texture> pTexture
+	);
 	std::shared_ptr<Texture> GetTexture(size_t id) const;
 
 	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> GetRtvs() const;
@@ -68,4 +103,9 @@ public:
 		D3D12_DESCRIPTOR_RANGE_FLAGS flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
 		UINT offsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND
 	) const;
+
+private:
+	static const D3D12_RESOURCE_DESC& GetBaseResourceDesc(Layout layout, size_t id) {
+		return layout == Layout::Visibility ? m_visibilityResDescs[id] : m_attributesResDescs[id];
+	}
 };
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef GBUFFER_DATA
+#define GBUFFER_DATA
+
+// Quantization shared by GBufferEncoding.hlsli and the CPU mirror in GBufferEncoding
+
+// uvMaterialId, R16G16B16A16_UINT: wrapped uv in 16 bits each, the material id, w unused
+#define GBUFFER_UV_MAX 65535
+#define GBUFFER_MATERIAL_ID_MAX 65535
+// tbn, R10G10B10A2_UINT: the three smallest quaternion components in 10 bits each,
+// the index of the dropped largest one in the 2 bits left
+#define GBUFFER_QUATERNION_MAX 1023
+// the smallest three are within [-1 / sqrt(2), 1 / sqrt(2)]
+#define GBUFFER_QUATERNION_RANGE 0.70710678f
+
+#endif
@@ -0,0 +1,74 @@
+#include "GBufferEncoding.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace GBufferEncoding {
+	namespace {
+		// frac in HLSL
+		float Fraction(float value) {
+			return value - std::floor(value);
+		}
+
+		uint32_t Quantize(float normalized, uint32_t maxValue) {
+			return static_cast<uint32_t>(std::round(std::clamp(normalized, 0.f, 1.f) * maxValue));
+		}
+	}
+
+	DirectX::XMUINT4 EncodeUvMaterialId(const DirectX::XMFLOAT2& uv, uint32_t materialId) {
+		return DirectX::XMUINT4{
+			Quantize(Fraction(uv.x), GBUFFER_UV_MAX),
+			Quantize(Fraction(uv.y), GBUFFER_UV_MAX),
+			std::min(materialId, uint32_t{ GBUFFER_MATERIAL_ID_MAX }),
+			0
+		};
+	}
+
+	DirectX::XMFLOAT2 DecodeUv(const DirectX::XMUINT4& encoded) {
+		return DirectX::XMFLOAT2{
+			static_cast<float>(encoded.x) / GBUFFER_UV_MAX,
+			static_cast<float>(encoded.y) / GBUFFER_UV_MAX
+		};
+	}
+
+	uint32_t DecodeMaterialId(const DirectX::XMUINT4& encoded) {
+		return encoded.z;
+	}
+
+	DirectX::XMUINT4 EncodeQuaternion(const DirectX::XMFLOAT4& quaternion) {
+		float q[4]{ quaternion.x, quaternion.y, quaternion.z, quaternion.w };
+		uint32_t largest{};
+		for (uint32_t i{ 1 }; i < 4; ++i) {
+			if (std::abs(q[i]) > std::abs(q[largest])) {
+				largest = i;
+			}
+		}
+		// q and -q are the same rotation, the sign makes the dropped component positive
+		float sign{ q[largest] < 0.f ? -1.f : 1.f };
+
+		uint32_t quantized[3]{};
+		for (uint32_t i{}, restId{}; i < 4; ++i) {
+			if (i != largest) {
+				quantized[restId++] = Quantize(sign * q[i] / (2.f * GBUFFER_QUATERNION_RANGE) + 0.5f, GBUFFER_QUATERNION_MAX);
+			}
+		}
+		return DirectX::XMUINT4{ quantized[0], quantized[1], quantized[2], largest };
+	}
+
+	DirectX::XMFLOAT4 DecodeQuaternion(const DirectX::XMUINT4& encoded) {
+		float rest[3]{};
+		const uint32_t quantized[3]{ encoded.x, encoded.y, encoded.z };
+		float restLengthSquared{};
+		for (uint32_t i{}; i < 3; ++i) {
+			rest[i] = (static_cast<float>(quantized[i]) / GBUFFER_QUATERNION_MAX - 0.5f) * (2.f * GBUFFER_QUATERNION_RANGE);
+			restLengthSquared += rest[i] * rest[i];
+		}
+		float dropped{ std::sqrt(std::clamp(1.f - restLengthSquared, 0.f, 1.f)) };
+
+		float q[4]{};
+		for (uint32_t i{}, restId{}; i < 4; ++i) {
+			q[i] = i == encoded.w ? dropped : rest[restId++];
+		}
+		return DirectX::XMFLOAT4{ q[0], q[1], q[2], q[3] };
+	}
+}
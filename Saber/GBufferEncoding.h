@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+#include "GBufferData.h"
+
+// Same packing as GBufferEncoding.hlsli, to check its precision without a GPU.
+// Only needs DirectXMath, so it builds on any platform.
+namespace GBufferEncoding {
+	DirectX::XMUINT4 EncodeUvMaterialId(const DirectX::XMFLOAT2& uv, uint32_t materialId);
+	// in [0, 1], the fraction of the encoded uv
+	DirectX::XMFLOAT2 DecodeUv(const DirectX::XMUINT4& encoded);
+	uint32_t DecodeMaterialId(const DirectX::XMUINT4& encoded);
+
+	// the quaternion has to be normalized, the decoded one may have the opposite sign
+	DirectX::XMUINT4 EncodeQuaternion(const DirectX::XMFLOAT4& quaternion);
+	DirectX::XMFLOAT4 DecodeQuaternion(const DirectX::XMUINT4& encoded);
+}
@@ -0,0 +1,66 @@
+#include "GBufferData.h"
+
+// Written by the geometry pixel shaders, read by the deferred shading.
+// Mirrored by GBufferEncoding.cpp, keep them in sync
+
+// a wrapping sampler reads the same texels at the fraction of the uv
+uint4 EncodeUvMaterialId(float2 uv, uint materialId)
+{
+    uint2 quantizedUv = uint2(round(frac(uv) * GBUFFER_UV_MAX));
+    return uint4(quantizedUv, min(materialId, GBUFFER_MATERIAL_ID_MAX), 0);
+}
+
+float2 DecodeUv(uint4 encoded)
+{
+    return float2(encoded.xy) / GBUFFER_UV_MAX;
+}
+
+uint DecodeMaterialId(uint4 encoded)
+{
+    return encoded.z;
+}
+
+// uvs are wrapped, the difference between neighbours is taken the short way around
+float2 WrapUvDelta(float2 delta)
+{
+    return delta - round(delta);
+}
+
+// q and -q are the same rotation, the sign makes the dropped component positive
+uint4 EncodeQuaternion(float4 q)
+{
+    float4 a = abs(q);
+    uint largest = 0;
+    float largestValue = a.x;
+    [unroll]
+    for (uint i = 1; i < 4; ++i)
+    {
+        if (a[i] > largestValue)
+        {
+            largest = i;
+            largestValue = a[i];
+        }
+    }
+    q = q[largest] < 0.f ? -q : q;
+
+    float3 rest = largest == 0 ? q.yzw : largest == 1 ? q.xzw : largest == 2 ? q.xyw : q.xyz;
+    float3 normalized = saturate(rest / (2.f * GBUFFER_QUATERNION_RANGE) + 0.5f);
+    return uint4(round(normalized * GBUFFER_QUATERNION_MAX), largest);
+}
+
+float4 DecodeQuaternion(uint4 encoded)
+{
+    float3 rest = (float3(encoded.xyz) / GBUFFER_QUATERNION_MAX - 0.5f) * (2.f * GBUFFER_QUATERNION_RANGE);
+    float dropped = sqrt(saturate(1.f - dot(rest, rest)));
+    switch (encoded.w)
+    {
+    case 0:
+        return float4(dropped, rest);
+    case 1:
+        return float4(rest.x, dropped, rest.yz);
+    case 2:
+        return float4(rest.xy, dropped, rest.z);
+    default:
+        return float4(rest, dropped);
+    }
+}
@@ -9,8 +9,12 @@ GPUResource::GPUResource(
 	CreateResource(pAllocator, heapData, resData, allocationFlags);
 }
 
+GPUResource::GPUResource(Microsoft::WRL::ComPtr<ID3D12Resource> pResource)
+	: m_pResource(pResource)
+{}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> GPUResource::GetResource() const {
-	return m_pAllocation->GetResource();
+	return m_pAllocation ? m_pAllocation->GetResource() : m_pResource;
 }
 
 std::shared_ptr<GPUResource> GPUResource::CreateIntermediate(
@@ -8,6 +8,8 @@
 
 class GPUResource {
 	Microsoft::WRL::ComPtr<D3D12MA::Allocation> m_pAllocation{};
+	// resource placed in memory owned by someone else (render graph heap)
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pResource{};
 
 public:
 	GPUResource() = default;
@@ -28,6 +30,7 @@ public:
 		const ResourceData& resData,
 		const D3D12MA::ALLOCATION_FLAGS& allocationFlags = D3D12MA::ALLOCATION_FLAG_NONE
 	);
+	GPUResource(Microsoft::WRL::ComPtr<ID3D12Resource> pResource);
 
 	void CreateResource(
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
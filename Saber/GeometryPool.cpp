@@ -0,0 +1,313 @@
+#include "GeometryPool.h"
+
+GeometryPool::GeometryPool(
+	Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+	std::shared_ptr<CommandQueue> pCommandQueueDirect,
+	uint32_t vertexCapacity,
+	uint32_t indexCapacity
+) : m_ranges(vertexCapacity, indexCapacity),
+	m_pCommandQueueDirect(pCommandQueueDirect)
+{
+	// Buffers stay in COMMON: copy queue writes promote them to COPY_DEST,
+	// draws on the direct queue promote them to the read states implicitly
+	for (size_t i{}; i < Stream::Count; ++i) {
+		UINT64 size{ static_cast<UINT64>(m_strides[i]) * vertexCapacity };
+		m_pVertexBuffers[i] = std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ D3D12_HEAP_TYPE_DEFAULT },
+			GPUResource::ResourceData{ CD3DX12_RESOURCE_DESC::Buffer(size), D3D12_RESOURCE_STATE_COMMON }
+		);
+		m_vertexBufferViews[i] = D3D12_VERTEX_BUFFER_VIEW{
+			.BufferLocation{ m_pVertexBuffers[i]->GetResource()->GetGPUVirtualAddress() },
+			.SizeInBytes{ static_cast<UINT>(size) },
+			.StrideInBytes{ m_strides[i] }
+		};
+	}
+
+	UINT64 indexBufferSize{ static_cast<UINT64>(sizeof(uint32_t)) * indexCapacity };
+	m_pIndexBuffer = std::make_shared<GPUResource>(
+		pAllocator,
+		GPUResource::HeapData{ D3D12_HEAP_TYPE_DEFAULT },
+		GPUResource::ResourceData{ CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize), D3D12_RESOURCE_STATE_COMMON }
+	);
+	m_indexBufferView = D3D12_INDEX_BUFFER_VIEW{
+		.BufferLocation{ m_pIndexBuffer->GetResource()->GetGPUVirtualAddress() },
+		.SizeInBytes{ static_cast<UINT>(indexBufferSize) },
+		.Format{ DXGI_FORMAT_R32_UINT }
+	};
+}
+
+GeometryPool::Allocation GeometryPool::Add(
+	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+	Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+	std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
+	const std::wstring& name,
+	const Mesh::MeshData& meshData
+) {
+	std::scoped_lock<std::mutex> lock(m_mutex);
+	if (auto it{ m_entries.find(name) }; it != m_entries.end()) {
+		++it->second.refCount;
+		return it->second.allocation;
+	}
+	FreeCompleted();
+
+	GeometryData geometryData{ std::visit([&](const auto& data) {
+		using T = std::decay_t<decltype(data)>;
+		if constexpr (std::is_same_v<T, Mesh::MeshDataVerticesIndices>) {
+			return LoadVerticesIndices(data);
+		}
+		else {
+			return LoadGLTF(data);
+		}
+	}, meshData.data) };
+
+	uint32_t indexCount{ static_cast<uint32_t>(geometryData.indices.size()) };
+	if (!indexCount || !geometryData.vertexCount) {
+		throw std::runtime_error("GeometryPool: empty mesh");
+	}
+	if (indexCount / 3 > m_maxTriangleCount) {
+		std::stringstream ss{};
+		ss << "GeometryPool: mesh has more than " << m_maxTriangleCount << " triangles";
+		throw std::runtime_error(ss.str());
+	}
+
+	Entry entry{
+		.range{ m_ranges.Allocate(geometryData.vertexCount, indexCount) },
+		.refCount{ 1 }
+	};
+	entry.allocation = Allocation{
+		.startIndex{ entry.range.firstIndex },
+		.indexCount{ indexCount },
+		.baseVertex{ static_cast<int32_t>(entry.range.firstVertex) },
+		.vertexCount{ geometryData.vertexCount }
+	};
+	DirectX::BoundingSphere::CreateFromPoints(
+		entry.allocation.boundingSphere,
+		geometryData.vertexCount,
+		reinterpret_cast<const DirectX::XMFLOAT3*>(geometryData.streams[Stream::Position].data()),
+		m_strides[Stream::Position]
+	);
+	Upload(pDevice, pAllocator, pCommandQueueCopy, geometryData, entry.allocation);
+
+	m_entries.emplace(name, entry);
+
+	return entry.allocation;
+}
+
+void GeometryPool::SetMaxTriangleCount(uint32_t maxTriangleCount) {
+	std::scoped_lock<std::mutex> lock(m_mutex);
+	m_maxTriangleCount = maxTriangleCount;
+}
+
+void GeometryPool::AddReference(const std::wstring& name) {
+	std::scoped_lock<std::mutex> lock(m_mutex);
+	auto it{ m_entries.find(name) };
+	assert(it != m_entries.end());
+	if (it != m_entries.end()) {
+		++it->second.refCount;
+	}
+}
+
+void GeometryPool::Release(const std::wstring& name) {
+	std::scoped_lock<std::mutex> lock(m_mutex);
+	auto it{ m_entries.find(name) };
+	assert(it != m_entries.end());
+	if (it == m_entries.end() || --it->second.refCount) {
+		return;
+	}
+
+	m_ranges.Free(it->second.range, m_pCommandQueueDirect->Signal());
+	m_entries.erase(it);
+}
+
+void GeometryPool::Bind(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const {
+	pCommandList->IASetVertexBuffers(0, Stream::Count, m_vertexBufferViews);
+	pCommandList->IASetIndexBuffer(&m_indexBufferView);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GeometryPool::GetIndexAddress() const {
+	return m_indexBufferView.BufferLocation;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GeometryPool::GetStreamAddress(Stream stream) const {
+	return m_vertexBufferViews[stream].BufferLocation;
+}
+
+void GeometryPool::FreeCompleted() {
+	m_ranges.FreeCompleted([this](uint64_t fenceValue) {
+		return m_pCommandQueueDirect->IsFenceComplete(fenceValue);
+	});
+}
+
+uint32_t GeometryPool::GetVertexCount() const {
+	return m_ranges.GetVertexCount();
+}
+
+uint32_t GeometryPool::GetIndexCount() const {
+	return m_ranges.GetIndexCount();
+}
+
+GeometryPool::GeometryData GeometryPool::LoadVerticesIndices(const Mesh::MeshDataVerticesIndices& meshData) {
+	GeometryData geometryData{};
+	geometryData.vertexCount = static_cast<uint32_t>(meshData.verticesCnt);
+
+	geometryData.indices.resize(meshData.indicesCnt);
+	if (meshData.indexSize == sizeof(uint16_t)) {
+		const uint16_t* pIndices{ static_cast<const uint16_t*>(meshData.indices) };
+		std::copy(pIndices, pIndices + meshData.indicesCnt, geometryData.indices.begin());
+	}
+	else {
+		assert(meshData.indexSize == sizeof(uint32_t));
+		memcpy(geometryData.indices.data(), meshData.indices, meshData.indicesCnt * sizeof(uint32_t));
+	}
+
+	size_t streamId{};
+	for (const Mesh::VertexData& vertexData : meshData.verticesData) {
+		if (streamId == Stream::Count) {
+			break;
+		}
+		geometryData.streams[streamId] = ConvertStream(
+			static_cast<const float*>(vertexData.data),
+			vertexData.size / sizeof(float),
+			meshData.verticesCnt,
+			m_strides[streamId] / sizeof(float)
+		);
+		++streamId;
+	}
+	for (; streamId < Stream::Count; ++streamId) {
+		geometryData.streams[streamId] = ConvertStream(nullptr, 0, meshData.verticesCnt, m_strides[streamId] / sizeof(float));
+	}
+
+	return geometryData;
+}
+
+GeometryPool::GeometryData GeometryPool::LoadGLTF(const Mesh::MeshDataGLTF& meshData) {
+	GeometryData geometryData{};
+	GLTFLoader gltfLoader{ meshData.filepath };
+
+	switch (gltfLoader.GetIndicesFormat()) {
+	case DXGI_FORMAT_R32_UINT:
+		gltfLoader.GetIndices(geometryData.indices);
+		break;
+	case DXGI_FORMAT_R16_UINT:
+	{
+		std::vector<uint16_t> indices{};
+		gltfLoader.GetIndices(indices);
+		geometryData.indices.assign(indices.begin(), indices.end());
+	}
+	break;
+	default:
+	{
+		std::stringstream ss;
+		ss << "Unsupported index format in file " << meshData.filepath;
+		throw std::runtime_error(ss.str());
+	}
+	}
+
+	size_t streamId{};
+	for (const Mesh::Attribute& attribute : meshData.attributes) {
+		if (streamId == Stream::Count) {
+			break;
+		}
+		std::vector<float> vertexData{};
+		if (!gltfLoader.GetVerticesData(vertexData, attribute.name)) {
+			std::stringstream ss;
+			ss << "Bad attribute " << attribute.name << " in file " << meshData.filepath;
+			throw std::runtime_error(ss.str());
+		}
+
+		size_t components{ attribute.size / sizeof(float) };
+		if (streamId == Stream::Position) {
+			geometryData.vertexCount = static_cast<uint32_t>(vertexData.size() / components);
+		}
+		geometryData.streams[streamId] = ConvertStream(
+			vertexData.data(),
+			components,
+			geometryData.vertexCount,
+			m_strides[streamId] / sizeof(float)
+		);
+		++streamId;
+	}
+	for (; streamId < Stream::Count; ++streamId) {
+		geometryData.streams[streamId] = ConvertStream(nullptr, 0, geometryData.vertexCount, m_strides[streamId] / sizeof(float));
+	}
+
+	return geometryData;
+}
+
+std::vector<float> GeometryPool::ConvertStream(const float* pSrc, size_t srcComponents, size_t count, size_t dstComponents) {
+	std::vector<float> stream(count * dstComponents);
+	for (size_t i{}; i < count; ++i) {
+		for (size_t c{}; c < dstComponents; ++c) {
+			stream[i * dstComponents + c] = c < srcComponents ? pSrc[i * srcComponents + c] : (c == 3 ? 1.f : 0.f);
+		}
+	}
+	return stream;
+}
+
+void GeometryPool::Upload(
+	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+	Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+	std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
+	const GeometryData& geometryData,
+	const Allocation& allocation
+) {
+	UINT64 uploadSize{ geometryData.indices.size() * sizeof(uint32_t) };
+	for (const std::vector<float>& stream : geometryData.streams) {
+		uploadSize += stream.size() * sizeof(float);
+	}
+	if (!uploadSize) {
+		return;
+	}
+
+	// all streams and indices go through one intermediate buffer and one command list
+	GPUResource intermediateBuffer{
+		pAllocator,
+		GPUResource::HeapData{ D3D12_HEAP_TYPE_UPLOAD },
+		GPUResource::ResourceData{
+			CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ
+		}
+	};
+	uint8_t* pUploadData{};
+	ThrowIfFailed(intermediateBuffer.GetResource()->Map(0, &CD3DX12_RANGE(), reinterpret_cast<void**>(&pUploadData)));
+
+	std::shared_ptr<CommandList> pCommandList{
+		pCommandQueueCopy->GetCommandList(pDevice)
+	};
+
+	UINT64 uploadOffset{};
+	auto copy = [&](std::shared_ptr<GPUResource> pDst, UINT64 dstOffset, const void* pData, UINT64 size) {
+		if (!size) {
+			return;
+		}
+		memcpy(pUploadData + uploadOffset, pData, size);
+		pCommandList->m_pCommandList->CopyBufferRegion(
+			pDst->GetResource().Get(),
+			dstOffset,
+			intermediateBuffer.GetResource().Get(),
+			uploadOffset,
+			size
+		);
+		uploadOffset += size;
+	};
+
+	for (size_t i{}; i < Stream::Count; ++i) {
+		copy(
+			m_pVertexBuffers[i],
+			static_cast<UINT64>(allocation.baseVertex) * m_strides[i],
+			geometryData.streams[i].data(),
+			geometryData.streams[i].size() * sizeof(float)
+		);
+	}
+	copy(
+		m_pIndexBuffer,
+		static_cast<UINT64>(allocation.startIndex) * sizeof(uint32_t),
+		geometryData.indices.data(),
+		geometryData.indices.size() * sizeof(uint32_t)
+	);
+
+	intermediateBuffer.GetResource()->Unmap(0, nullptr);
+
+	pCommandQueueCopy->ExecuteCommandListImmediately(pCommandList);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <DirectXCollision.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "D3D12MemAlloc.h"
+
+#include "CommandQueue.h"
+#include "GeometryRanges.h"
+#include "GPUResource.h"
+#include "Mesh.h"
+
+// Vertex and index data of many meshes in a few shared buffers. Draws only differ
+// in draw arguments, so indirect commands don't have to carry buffer views.
+// Vertex streams are stored separately, indices are always 32 bit.
+// Ranges come from GeometryRanges, so freed meshes leave holes that later meshes can reuse.
+class GeometryPool {
+public:
+	enum Stream {
+		Position = 0,
+		Normal = 1,
+		Tangent = 2,
+		Uv = 3,
+		Count = 4
+	};
+
+	struct Allocation {
+		uint32_t startIndex{};
+		uint32_t indexCount{};
+		int32_t baseVertex{};
+		uint32_t vertexCount{};
+		// mesh space bounds, for culling
+		DirectX::BoundingSphere boundingSphere{};
+	};
+
+	static inline D3D12_INPUT_ELEMENT_DESC inputLayout[Stream::Count]{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, Position, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, Normal, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, Tangent, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, Uv, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+
+private:
+	static constexpr UINT m_strides[Stream::Count]{
+		sizeof(DirectX::XMFLOAT3),
+		sizeof(DirectX::XMFLOAT3),
+		sizeof(DirectX::XMFLOAT4),
+		sizeof(DirectX::XMFLOAT2)
+	};
+
+	struct GeometryData {
+		std::vector<uint32_t> indices{};
+		std::vector<float> streams[Stream::Count]{};
+		uint32_t vertexCount{};
+	};
+
+	struct Entry {
+		Allocation allocation{};
+		GeometryRanges::Range range{};
+		uint32_t refCount{};
+	};
+
+	std::shared_ptr<GPUResource> m_pVertexBuffers[Stream::Count]{};
+	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferViews[Stream::Count]{};
+	std::shared_ptr<GPUResource> m_pIndexBuffer{};
+	D3D12_INDEX_BUFFER_VIEW m_indexBufferView{};
+
+	GeometryRanges m_ranges;
+	// per mesh, triangle ids are stored per pixel in the visibility mode
+	uint32_t m_maxTriangleCount{ std::numeric_limits<uint32_t>::max() };
+
+	// meshes are shared by name, like in Atlas<Mesh>
+	std::unordered_map<std::wstring, Entry> m_entries{};
+	std::shared_ptr<CommandQueue> m_pCommandQueueDirect{};
+	std::mutex m_mutex{};
+
+public:
+	GeometryPool(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect,
+		uint32_t vertexCapacity = 1 << 20,
+		uint32_t indexCapacity = 1 << 22
+	);
+
+	// Uploads the mesh on the copy queue and waits for it, or adds a reference to a mesh with the same name.
+	// Throws if there is no free range big enough.
+	Allocation Add(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
+		const std::wstring& name,
+		const Mesh::MeshData& meshData
+	);
+
+	// Add throws for meshes with more triangles, meshes already in aren't checked again
+	void SetMaxTriangleCount(uint32_t maxTriangleCount);
+
+	// another reference to a mesh that is already in, e.g. for a copy of an object
+	void AddReference(const std::wstring& name);
+
+	// drops a reference taken by Add, the last one frees the ranges once submitted draws are done with them
+	void Release(const std::wstring& name);
+
+	void Bind(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const;
+
+	// For shaders fetching vertices themselves, the buffers stay in COMMON and are promoted on read
+	D3D12_GPU_VIRTUAL_ADDRESS GetIndexAddress() const;
+	D3D12_GPU_VIRTUAL_ADDRESS GetStreamAddress(Stream stream) const;
+
+	// used vertices and indices, including freed ranges the GPU may still read
+	uint32_t GetVertexCount() const;
+	uint32_t GetIndexCount() const;
+
+private:
+	static GeometryData LoadVerticesIndices(const Mesh::MeshDataVerticesIndices& meshData);
+	static GeometryData LoadGLTF(const Mesh::MeshDataGLTF& meshData);
+	void FreeCompleted();
+
+	// copies count vertices with srcComponents floats each, missing components are 0 and w is 1
+	static std::vector<float> ConvertStream(const float* pSrc, size_t srcComponents, size_t count, size_t dstComponents);
+
+	void Upload(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
+		const GeometryData& geometryData,
+		const Allocation& allocation
+	);
+};
@@ -0,0 +1,82 @@
+#include "GeometryRanges.h"
+
+#include <stdexcept>
+
+GeometryRanges::GeometryRanges(uint32_t vertexCapacity, uint32_t indexCapacity)
+	: m_pVertexBlock(CreateVirtualBlock(vertexCapacity)),
+	m_pIndexBlock(CreateVirtualBlock(indexCapacity)),
+	m_vertexCapacity(vertexCapacity),
+	m_indexCapacity(indexCapacity)
+{}
+
+GeometryRanges::~GeometryRanges() {
+	// ranges still referenced by objects being destroyed together with the pool
+	m_pVertexBlock->Clear();
+	m_pIndexBlock->Clear();
+}
+
+GeometryRanges::Range GeometryRanges::Allocate(uint32_t vertexCount, uint32_t indexCount) {
+	Range range{
+		.vertexCount{ vertexCount },
+		.indexCount{ indexCount }
+	};
+
+	UINT64 vertexOffset{};
+	D3D12MA::VIRTUAL_ALLOCATION_DESC vertexAllocationDesc{ .Size{ vertexCount } };
+	if (FAILED(m_pVertexBlock->Allocate(&vertexAllocationDesc, &range.vertexAllocation, &vertexOffset))) {
+		throw std::runtime_error("GeometryPool is out of vertex space");
+	}
+	UINT64 indexOffset{};
+	D3D12MA::VIRTUAL_ALLOCATION_DESC indexAllocationDesc{ .Size{ indexCount } };
+	if (FAILED(m_pIndexBlock->Allocate(&indexAllocationDesc, &range.indexAllocation, &indexOffset))) {
+		m_pVertexBlock->FreeAllocation(range.vertexAllocation);
+		throw std::runtime_error("GeometryPool is out of index space");
+	}
+
+	range.firstVertex = static_cast<uint32_t>(vertexOffset);
+	range.firstIndex = static_cast<uint32_t>(indexOffset);
+	m_vertexCount += vertexCount;
+	m_indexCount += indexCount;
+	return range;
+}
+
+void GeometryRanges::Free(const Range& range, uint64_t fenceValue) {
+	m_pendingFrees.push_back(PendingFree{
+		.range{ range },
+		.fenceValue{ fenceValue }
+	});
+}
+
+void GeometryRanges::FreeCompleted(const IsFenceCompleteFunc& isFenceComplete) {
+	while (!m_pendingFrees.empty() && isFenceComplete(m_pendingFrees.front().fenceValue)) {
+		const Range& range{ m_pendingFrees.front().range };
+		m_pVertexBlock->FreeAllocation(range.vertexAllocation);
+		m_pIndexBlock->FreeAllocation(range.indexAllocation);
+		m_vertexCount -= range.vertexCount;
+		m_indexCount -= range.indexCount;
+		m_pendingFrees.pop_front();
+	}
+}
+
+uint32_t GeometryRanges::GetVertexCapacity() const {
+	return m_vertexCapacity;
+}
+
+uint32_t GeometryRanges::GetIndexCapacity() const {
+	return m_indexCapacity;
+}
+
+uint32_t GeometryRanges::GetVertexCount() const {
+	return m_vertexCount;
+}
+
+uint32_t GeometryRanges::GetIndexCount() const {
+	return m_indexCount;
+}
+
+Microsoft::WRL::ComPtr<D3D12MA::VirtualBlock> GeometryRanges::CreateVirtualBlock(uint32_t size) {
+	D3D12MA::VIRTUAL_BLOCK_DESC blockDesc{ .Size{ size } };
+	Microsoft::WRL::ComPtr<D3D12MA::VirtualBlock> pBlock{};
+	ThrowIfFailed(D3D12MA::CreateVirtualBlock(&blockDesc, &pBlock));
+	return pBlock;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <deque>
+#include <functional>
+
+#include "D3D12MemAlloc.h"
+
+// Vertex and index ranges of GeometryPool, sub-allocated from two D3D12MA virtual blocks
+// counted in vertices and indices. A freed range is reused only after the fence value it was
+// freed with has completed. Nothing here needs a device.
+class GeometryRanges {
+public:
+	struct Range {
+		D3D12MA::VirtualAllocation vertexAllocation{};
+		D3D12MA::VirtualAllocation indexAllocation{};
+		uint32_t firstVertex{};
+		uint32_t vertexCount{};
+		uint32_t firstIndex{};
+		uint32_t indexCount{};
+	};
+
+	using IsFenceCompleteFunc = std::function<bool(uint64_t fenceValue)>;
+
+private:
+	struct PendingFree {
+		Range range{};
+		uint64_t fenceValue{};
+	};
+
+	Microsoft::WRL::ComPtr<D3D12MA::VirtualBlock> m_pVertexBlock{};
+	Microsoft::WRL::ComPtr<D3D12MA::VirtualBlock> m_pIndexBlock{};
+	uint32_t m_vertexCapacity{};
+	uint32_t m_indexCapacity{};
+	uint32_t m_vertexCount{};
+	uint32_t m_indexCount{};
+	std::deque<PendingFree> m_pendingFrees{};
+
+public:
+	GeometryRanges(uint32_t vertexCapacity, uint32_t indexCapacity);
+	~GeometryRanges();
+
+	// Throws if there is no free range big enough, nothing stays allocated then
+	Range Allocate(uint32_t vertexCount, uint32_t indexCount);
+
+	// fence values are expected to grow from one call to the next
+	void Free(const Range& range, uint64_t fenceValue);
+
+	// returns the ranges freed with completed fence values to the blocks
+	void FreeCompleted(const IsFenceCompleteFunc& isFenceComplete);
+
+	uint32_t GetVertexCapacity() const;
+	uint32_t GetIndexCapacity() const;
+
+	// used vertices and indices, including freed ranges waiting for their fence
+	uint32_t GetVertexCount() const;
+	uint32_t GetIndexCount() const;
+
+private:
+	static Microsoft::WRL::ComPtr<D3D12MA::VirtualBlock> CreateVirtualBlock(uint32_t size);
+};
@@ -0,0 +1,194 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace GpuCulling {
+	namespace {
+		bool IsSphereVisible(const CullingConstants& constants, const DirectX::XMFLOAT4& sphere) {
+			for (const DirectX::XMFLOAT4& plane : constants.frustumPlanes) {
+				if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -sphere.w) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Texels of a mip that cover depth pixels. The last one of an odd side covers fewer pixels than the others,
+		// the padded HZB has room for it where a mip chain of the depth's size would have dropped it.
+		uint32_t GetMipSize(uint32_t size, uint32_t mipId) {
+			return ((size - 1) >> mipId) + 1;
+		}
+
+		// clip = v * M, like mul(M, v) in the shader with the matrix stored as it is
+		DirectX::XMFLOAT4 TransformPoint(const DirectX::XMFLOAT4X4& m, float x, float y, float z) {
+			return DirectX::XMFLOAT4{
+				x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0],
+				x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1],
+				x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + m.m[3][2],
+				x * m.m[0][3] + y * m.m[1][3] + z * m.m[2][3] + m.m[3][3]
+			};
+		}
+	}
+
+	HzbReference::HzbReference(const float* pDepth, uint32_t width, uint32_t height)
+		: m_width(width), m_height(height) {
+		// same mip count as DepthBuffer::ResizeHZB, down to 1x1 of the power of two the HZB is padded to
+		uint32_t mipsCount{ static_cast<uint32_t>(std::bit_width(std::bit_ceil(std::max(width, height)))) };
+		m_mips.resize(mipsCount);
+		m_mips[0].assign(pDepth, pDepth + static_cast<size_t>(width) * height);
+
+		for (uint32_t mipId{ 1 }; mipId < mipsCount; ++mipId) {
+			uint32_t srcWidth{ GetMipSize(width, mipId - 1) };
+			uint32_t srcHeight{ GetMipSize(height, mipId - 1) };
+			uint32_t dstWidth{ GetMipSize(width, mipId) };
+			uint32_t dstHeight{ GetMipSize(height, mipId) };
+			const std::vector<float>& src{ m_mips[mipId - 1] };
+			std::vector<float>& dst{ m_mips[mipId] };
+			dst.resize(static_cast<size_t>(dstWidth) * dstHeight);
+
+			for (uint32_t y{}; y < dstHeight; ++y) {
+				for (uint32_t x{}; x < dstWidth; ++x) {
+					// the last texel of an odd side is reduced with itself, like the shader's loads clamped to the edge
+					uint32_t x0{ 2 * x }, x1{ std::min(2 * x + 1, srcWidth - 1) };
+					uint32_t y0{ 2 * y }, y1{ std::min(2 * y + 1, srcHeight - 1) };
+					dst[static_cast<size_t>(y) * dstWidth + x] = std::min(
+						std::min(src[static_cast<size_t>(y0) * srcWidth + x0], src[static_cast<size_t>(y0) * srcWidth + x1]),
+						std::min(src[static_cast<size_t>(y1) * srcWidth + x0], src[static_cast<size_t>(y1) * srcWidth + x1])
+					);
+				}
+			}
+		}
+	}
+
+	float HzbReference::Load(uint32_t x, uint32_t y, uint32_t mipId) const {
+		assert(mipId < m_mips.size());
+		assert(x < GetMipSize(m_width, mipId) && y < GetMipSize(m_height, mipId));
+		return m_mips[mipId][static_cast<size_t>(y) * GetMipSize(m_width, mipId) + x];
+	}
+
+	uint32_t GetCommandsPerChunk(uint32_t commandsCount, uint32_t chunksCount) {
+		assert(chunksCount > 0);
+		return std::max((commandsCount + chunksCount - 1) / chunksCount, 1u);
+	}
+
+	CullingConstants MakeCullingConstants(
+		const FrustumCulling::Frustum& frustum,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		uint32_t commandsCount,
+		Phase phase,
+		const HzbView& hzbView,
+		uint32_t chunksCount
+	) {
+		assert(chunksCount <= CULLING_MAX_CHUNKS_COUNT);
+		CullingConstants constants{
+			.frustumPlanes{},
+			.viewProjection{ viewProjection },
+			.commandsCount{ commandsCount },
+			.phase{ static_cast<uint32_t>(phase) },
+			.hzbSize{ hzbView.width, hzbView.height },
+			.hzbMipsCount{ hzbView.mipsCount },
+			.commandsPerChunk{ GetCommandsPerChunk(commandsCount, chunksCount) }
+		};
+		std::copy(std::begin(frustum.planes), std::end(frustum.planes), constants.frustumPlanes);
+		return constants;
+	}
+
+	bool IsOccludedReference(const CullingConstants& constants, const DirectX::XMFLOAT4& sphere, const HzbReference& hzb) {
+		float ndcMinX{ 1.f }, ndcMinY{ 1.f }, ndcMaxX{ -1.f }, ndcMaxY{ -1.f };
+		float nearestDepth{};
+		for (uint32_t i{}; i < 8; ++i) {
+			DirectX::XMFLOAT4 clip{ TransformPoint(
+				constants.viewProjection,
+				sphere.x + (i & 1 ? sphere.w : -sphere.w),
+				sphere.y + (i & 2 ? sphere.w : -sphere.w),
+				sphere.z + (i & 4 ? sphere.w : -sphere.w)
+			) };
+			if (clip.w <= 0.f) {
+				return false;
+			}
+			float ndcX{ clip.x / clip.w }, ndcY{ clip.y / clip.w };
+			ndcMinX = std::min(ndcMinX, ndcX);
+			ndcMinY = std::min(ndcMinY, ndcY);
+			ndcMaxX = std::max(ndcMaxX, ndcX);
+			ndcMaxY = std::max(ndcMaxY, ndcY);
+			// reversed depth, the nearest point has the largest value
+			nearestDepth = std::max(nearestDepth, clip.z / clip.w);
+		}
+
+		// texture space has y pointing down
+		auto toUv{ [](float ndc) { return std::clamp(ndc * 0.5f + 0.5f, 0.f, 1.f); } };
+		float uvMinX{ toUv(ndcMinX) }, uvMaxX{ toUv(ndcMaxX) };
+		float uvMinY{ toUv(-ndcMaxY) }, uvMaxY{ toUv(-ndcMinY) };
+
+		float sizePx{ std::max((uvMaxX - uvMinX) * hzb.GetWidth(), (uvMaxY - uvMinY) * hzb.GetHeight()) };
+		uint32_t mipId{ std::min(
+			static_cast<uint32_t>(std::ceil(std::log2(std::max(sizePx, 1.f)))),
+			hzb.GetMipsCount() - 1
+		) };
+		// pixel coordinates are in the depth's size, the HZB only pads after them
+		auto toTexel{ [mipId](float uv, uint32_t size) {
+			return std::min(static_cast<uint32_t>(uv * size), size - 1) >> mipId;
+		} };
+		uint32_t x0{ toTexel(uvMinX, hzb.GetWidth()) }, x1{ toTexel(uvMaxX, hzb.GetWidth()) };
+		uint32_t y0{ toTexel(uvMinY, hzb.GetHeight()) }, y1{ toTexel(uvMaxY, hzb.GetHeight()) };
+
+		float farthestDepth{ std::min(
+			std::min(hzb.Load(x0, y0, mipId), hzb.Load(x1, y0, mipId)),
+			std::min(hzb.Load(x0, y1, mipId), hzb.Load(x1, y1, mipId))
+		) };
+		return nearestDepth < farthestDepth;
+	}
+
+	size_t CullCommandsReference(
+		const CullingConstants& constants,
+		const IdIndirectCommand* pInputCommands,
+		const uint32_t* pInstances,
+		const ObjectBounds* pObjectBounds,
+		IdIndirectCommand* pOutputCommands,
+		uint32_t* pVisibleInstances,
+		uint32_t* pObjectVisibility,
+		const HzbReference* pHzb,
+		uint32_t* pChunkCounts
+	) {
+		assert(constants.phase == CULLING_PHASE_FRUSTUM || pObjectVisibility);
+		assert(constants.phase != CULLING_PHASE_LATE || pHzb);
+		uint32_t chunkCounts[CULLING_MAX_CHUNKS_COUNT]{};
+		size_t outputCount{};
+		for (uint32_t commandId{}; commandId < constants.commandsCount; ++commandId) {
+			IdIndirectCommand command{ pInputCommands[commandId] };
+			uint32_t visibleCount{};
+			for (uint32_t i{}; i < command.drawArguments.InstanceCount; ++i) {
+				uint32_t objectId{ pInstances[command.instanceOffset + i] };
+				const DirectX::XMFLOAT4& sphere{ pObjectBounds[objectId].sphere };
+				bool isDrawn{ IsSphereVisible(constants, sphere) };
+				if (constants.phase == CULLING_PHASE_EARLY) {
+					isDrawn = isDrawn && pObjectVisibility[objectId];
+				}
+				else if (constants.phase == CULLING_PHASE_LATE) {
+					bool isVisible{ isDrawn && !IsOccludedReference(constants, sphere, *pHzb) };
+					isDrawn = isVisible && !pObjectVisibility[objectId];
+					pObjectVisibility[objectId] = isVisible;
+				}
+				if (isDrawn) {
+					pVisibleInstances[command.instanceOffset + visibleCount] = objectId;
+					++visibleCount;
+				}
+			}
+			if (!visibleCount) {
+				continue;
+			}
+
+			uint32_t chunkId{ commandId / constants.commandsPerChunk };
+			assert(chunkId < CULLING_MAX_CHUNKS_COUNT);
+			command.drawArguments.InstanceCount = visibleCount;
+			pOutputCommands[chunkId * constants.commandsPerChunk + chunkCounts[chunkId]++] = command;
+			++outputCount;
+		}
+		if (pChunkCounts) {
+			std::copy(std::begin(chunkCounts), std::end(chunkCounts), pChunkCounts);
+		}
+		return outputCount;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <vector>
+
+#include "CullingData.h"
+#include "FrustumCulling.h"
+#include "IndirectCommand.h"
+
+// CPU side of IdIndirectCuller.hlsl: the constants and a reference of the shader to test it without a GPU.
+// CulledCommandBuffer.h has the buffers and the dispatch.
+namespace GpuCulling {
+	// Frustum draws everything in the frustum in one pass. With an HZB the early phase draws what was visible
+	// last frame, the HZB is built from that depth, and the late phase draws what the early phase missed.
+	enum class Phase : uint32_t {
+		Frustum = CULLING_PHASE_FRUSTUM,
+		Early = CULLING_PHASE_EARLY,
+		Late = CULLING_PHASE_LATE
+	};
+
+	// SRV of all HZB mips in the shader visible heap, only the late phase reads it.
+	// The size is the depth's, the HZB texture is padded to a power of two after it.
+	struct HzbView {
+		ID3D12DescriptorHeap* pDescHeap{};
+		D3D12_GPU_DESCRIPTOR_HANDLE srvHandle{};
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t mipsCount{};
+	};
+
+	// Min reduced depth mips built from mip 0 like SinglePassDownsamplerCS.hlsl does.
+	// With reversed depth every texel holds the farthest depth of the pixels it covers,
+	// texel t of mip m covers the pixels [t << m, (t + 1) << m) that are inside the depth.
+	class HzbReference {
+		std::vector<std::vector<float>> m_mips{};
+		uint32_t m_width{};
+		uint32_t m_height{};
+
+	public:
+		HzbReference(const float* pDepth, uint32_t width, uint32_t height);
+
+		float Load(uint32_t x, uint32_t y, uint32_t mipId) const;
+
+		uint32_t GetWidth() const {
+			return m_width;
+		}
+
+		uint32_t GetHeight() const {
+			return m_height;
+		}
+
+		uint32_t GetMipsCount() const {
+			return static_cast<uint32_t>(m_mips.size());
+		}
+	};
+
+	// Commands in every chunk but the last one, which may be shorter. At least 1.
+	uint32_t GetCommandsPerChunk(uint32_t commandsCount, uint32_t chunksCount);
+
+	// chunksCount is at most CULLING_MAX_CHUNKS_COUNT
+	CullingConstants MakeCullingConstants(
+		const FrustumCulling::Frustum& frustum,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		uint32_t commandsCount,
+		Phase phase = Phase::Frustum,
+		const HzbView& hzbView = {},
+		uint32_t chunksCount = 1
+	);
+
+	// The HZB test of the late phase, the sphere's screen rectangle is compared with at most 2x2 texels.
+	// Spheres crossing the camera plane are never occluded.
+	bool IsOccludedReference(const CullingConstants& constants, const DirectX::XMFLOAT4& sphere, const HzbReference& hzb);
+
+	// Same culling and compaction as IdIndirectCuller.hlsl over the same buffers, to check it without a GPU.
+	// The shader appends commands to the window of their chunk in any order, the reference keeps the input order.
+	// The early and late phases need the visibility indexed like the bounds, the late phase also the HZB.
+	// pChunkCounts gets the count of every chunk's window. Returns the count of written commands.
+	size_t CullCommandsReference(
+		const CullingConstants& constants,
+		const IdIndirectCommand* pInputCommands,
+		const uint32_t* pInstances,
+		const ObjectBounds* pObjectBounds,
+		IdIndirectCommand* pOutputCommands,
+		uint32_t* pVisibleInstances,
+		uint32_t* pObjectVisibility = nullptr,
+		const HzbReference* pHzb = nullptr,
+		uint32_t* pChunkCounts = nullptr
+	);
+}
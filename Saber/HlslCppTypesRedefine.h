@@ -17,6 +17,7 @@
 #define float2 DirectX::XMFLOAT2
 #define float3 DirectX::XMFLOAT3
 #define float4 DirectX::XMFLOAT4
+#define float4x4 DirectX::XMFLOAT4X4
 
 #define matrix DirectX::XMMATRIX
 
@@ -0,0 +1,130 @@
+#include "IndirectCommand.h"
+#include "CullingData.h"
+
+#define threadBlockSize 64
+
+ConstantBuffer<CullingConstants> cullingConstants : register(b0);
+
+StructuredBuffer<IdIndirectCommand> inputCommands : register(t0);
+StructuredBuffer<uint> instances : register(t1);
+StructuredBuffer<ObjectBounds> objectBounds : register(t2);
+// all mips, min reduced, only read by the late phase
+Texture2D<float> hzb : register(t3);
+
+RWStructuredBuffer<IdIndirectCommand> outputCommands : register(u0);
+// the counts ExecuteIndirect reads, one per chunk, placed after the output commands
+RWByteAddressBuffer outputCommandsCount : register(u1);
+// visible instances of a command are written to the start of its own range
+RWStructuredBuffer<uint> visibleInstances : register(u2);
+// indexed like objectBounds, written by the late phase and read by the early phase of the next frame
+RWStructuredBuffer<uint> objectVisibility : register(u3);
+
+bool IsSphereVisible(float4 sphere)
+{
+    [unroll]
+    for (uint i = 0; i < 6; ++i)
+    {
+        float4 plane = cullingConstants.frustumPlanes[i];
+        if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// size is the depth's, the HZB is padded to a power of two so the texel of the last pixel is always there
+uint ToTexel(float uv, uint size, uint mip)
+{
+    return min(uint(uv * size), size - 1) >> mip;
+}
+
+// Compares the nearest depth of the sphere's box with the farthest depth under its screen rectangle.
+// The mip is chosen so that the rectangle covers at most 2x2 texels.
+bool IsOccluded(float4 sphere)
+{
+    float2 ndcMin = 1.f;
+    float2 ndcMax = -1.f;
+    float nearestDepth = 0.f;
+    [unroll]
+    for (uint i = 0; i < 8; ++i)
+    {
+        float3 corner = sphere.xyz + float3(i & 1 ? sphere.w : -sphere.w, i & 2 ? sphere.w : -sphere.w, i & 4 ? sphere.w : -sphere.w);
+        float4 clip = mul(cullingConstants.viewProjection, float4(corner, 1.f));
+        // crosses the camera plane, the projected rectangle is meaningless
+        if (clip.w <= 0.f)
+        {
+            return false;
+        }
+        float3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        // reversed depth, the nearest point has the largest value
+        nearestDepth = max(nearestDepth, ndc.z);
+    }
+
+    // texture space has y pointing down
+    float2 uvMin = saturate(float2(ndcMin.x, -ndcMax.y) * 0.5f + 0.5f);
+    float2 uvMax = saturate(float2(ndcMax.x, -ndcMin.y) * 0.5f + 0.5f);
+
+    uint2 hzbSize = cullingConstants.hzbSize;
+    float2 sizePx = (uvMax - uvMin) * hzbSize;
+    uint mip = min(uint(ceil(log2(max(max(sizePx.x, sizePx.y), 1.f)))), cullingConstants.hzbMipsCount - 1);
+    uint x0 = ToTexel(uvMin.x, hzbSize.x, mip);
+    uint x1 = ToTexel(uvMax.x, hzbSize.x, mip);
+    uint y0 = ToTexel(uvMin.y, hzbSize.y, mip);
+    uint y1 = ToTexel(uvMax.y, hzbSize.y, mip);
+
+    float farthestDepth = min(
+        min(hzb.Load(int3(x0, y0, mip)), hzb.Load(int3(x1, y0, mip))),
+        min(hzb.Load(int3(x0, y1, mip)), hzb.Load(int3(x1, y1, mip)))
+    );
+    return nearestDepth < farthestDepth;
+}
+
+// one thread per command, instances of a command are tested in order so the output needs no sorting
+[numthreads(threadBlockSize, 1, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    uint commandId = dispatchThreadId.x;
+    if (commandId >= cullingConstants.commandsCount)
+    {
+        return;
+    }
+
+    IdIndirectCommand command = inputCommands[commandId];
+    uint visibleCount = 0;
+    for (uint i = 0; i < command.drawArguments.InstanceCount; ++i)
+    {
+        uint objectId = instances[command.instanceOffset + i];
+        float4 sphere = objectBounds[objectId].sphere;
+        bool isDrawn = IsSphereVisible(sphere);
+        if (cullingConstants.phase == CULLING_PHASE_EARLY)
+        {
+            isDrawn = isDrawn && objectVisibility[objectId] != 0;
+        }
+        else if (cullingConstants.phase == CULLING_PHASE_LATE)
+        {
+            // what the early phase has drawn is in the HZB and passes, it only isn't drawn twice
+            bool isVisible = isDrawn && !IsOccluded(sphere);
+            isDrawn = isVisible && objectVisibility[objectId] == 0;
+            objectVisibility[objectId] = isVisible ? 1 : 0;
+        }
+        if (isDrawn)
+        {
+            visibleInstances[command.instanceOffset + visibleCount] = objectId;
+            ++visibleCount;
+        }
+    }
+    if (visibleCount == 0)
+    {
+        return;
+    }
+
+    // compacted within the window of the command's chunk
+    uint chunkId = commandId / cullingConstants.commandsPerChunk;
+    uint outputId;
+    outputCommandsCount.InterlockedAdd(4 * chunkId, 1, outputId);
+    command.drawArguments.InstanceCount = visibleCount;
+    outputCommands[chunkId * cullingConstants.commandsPerChunk + outputId] = command;
+}
@@ -0,0 +1,10 @@
+#include "IndirectCommand.h"
+
+#define CommandType IdIndirectCommand
+#include "IndirectCommandUpdater.hlsli"
+
+[numthreads(threadBlockSize, 1, 1)]
+void main(ComputeShaderInput IN)
+{
+    UpdateIndirectCommands(IN);
+}
\ No newline at end of file
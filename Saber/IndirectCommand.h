@@ -2,6 +2,7 @@
 #define INDIRECT_COMMAND
 
 #include "CppHlslTypesRedefine.h"
+#include "HlslCppTypesRedefine.h"
 
 #ifdef __cplusplus
 #include <type_traits>
@@ -67,4 +68,27 @@ DEFINE_INDIRECT_COMMAND(CbMesh4IndirectCommand) {
 #endif
 };
 
+// Geometry comes from a shared pool bound once per subsystem. Every command is an instanced draw:
+// instanceOffset + SV_InstanceID indexes the instances buffer, which holds ids into the object data buffer.
+DEFINE_INDIRECT_COMMAND(IdIndirectCommand) {
+    uint instanceOffset;
+    D3D12_DRAW_INDEXED_ARGUMENTS drawArguments;
+#ifdef __cplusplus
+    static constexpr UINT instanceOffsetRootParameterIndex{ 1 };
+    static constexpr UINT objectDataRootParameterIndex{ 2 };
+    static constexpr UINT instancesRootParameterIndex{ 3 };
+    static inline D3D12_INDIRECT_ARGUMENT_DESC indirectArgumentDescs[2]{
+        {
+            .Type{ D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT },
+            .Constant{
+                .RootParameterIndex{ instanceOffsetRootParameterIndex },
+                .DestOffsetIn32BitValues{ 0 },
+                .Num32BitValuesToSet{ 1 }
+            }
+        },
+        {.Type{ D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED } },
+    };
+#endif
+};
+
 #endif
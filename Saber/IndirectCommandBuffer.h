@@ -2,13 +2,17 @@
 
 #include "Headers.h"
 
+#include <algorithm>
 #include <bit>
+#include <deque>
+#include <limits>
 #include <random>
 
 #include "ConstantBuffer.h"
 #include "ComputeObject.h"
 #include "DescriptorHeapManager.h"
 #include "DescriptorHeapRange.h"
+#include "DirtyRangeList.h"
 #include "DynamicUploadRingBuffer.h"
 #include "GPUResource.h"
 #include "MeshRenderObject.h"
@@ -16,13 +20,44 @@
 
 template <typename IndirectCommand>
 class IndirectCommandBuffer {
+public:
+	// capacity after growth is at least capacity * factor and capacity + minStep
+	struct GrowthPolicy {
+		float factor{ 2.f };
+		uint32_t minStep{ 1024 };
+	};
+
 protected:
+	struct RetiredBuffer {
+		std::shared_ptr<GPUResource> pBuffer{};
+		uint64_t fenceValue{};
+	};
+
 	std::shared_ptr<DescriptorHeapManager> m_pDescHeapManagerCbvSrvUav{};
 	Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_pCommandSignature{};
 	std::shared_ptr<GPUResource> m_pIndirectCommandBuffer{};
+	D3D12_RESOURCE_STATES m_state{ D3D12_RESOURCE_STATE_UNORDERED_ACCESS };
+	// state between updates, GPU culling reads the commands as a shader resource
+	static constexpr D3D12_RESOURCE_STATES m_readState{
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+	};
+
+	// Two uav descriptors used in turns, so growth doesn't overwrite the one the GPU may still read
 	std::shared_ptr<DescHeapRange> m_pDescHeapRangeUav{};
+	size_t m_uavId{};
+	uint64_t m_uavFenceValues[2]{};
+
+	// old buffers after growth, kept alive until the direct queue passes their fence
+	std::vector<std::shared_ptr<GPUResource>> m_pRetiringBuffers{};
+	std::deque<RetiredBuffer> m_retiredBuffers{};
+
+	GrowthPolicy m_growthPolicy{};
+	uint32_t m_reservedCapacity{};
 	
+	// number of live commands, ExecuteIndirect reads it from the uav counter placed after the commands
 	uint32_t m_size{};
+	// value the counter has on GPU, the counter is undefined until the first update
+	uint32_t m_gpuSize{ std::numeric_limits<uint32_t>::max() };
 	uint32_t m_capacity{};
 
 public:
@@ -45,7 +80,7 @@ public:
 
 		m_pDescHeapRangeUav = pDescHeapManagerCbvSrvUav->AllocateRange(
 			(renderObjectName + L"/IndirectCommandBuffer/Uav").c_str(),
-			1,
+			_countof(m_uavFenceValues),
 			D3D12_DESCRIPTOR_RANGE_TYPE_UAV
 		);
 
@@ -56,8 +91,9 @@ public:
 		m_pIndirectCommandBuffer = CreateBuffer(pAllocator, m_capacity);
 		m_pIndirectCommandBuffer->CreateUnorderedAccessView(
 			pDevice,
-			m_pDescHeapRangeUav->GetNextCpuHandle(),
-			&GetUavDesc(m_capacity)
+			m_pDescHeapRangeUav->GetCpuHandle(m_uavId),
+			&GetUavDesc(m_capacity),
+			m_pIndirectCommandBuffer->GetResource()
 		);
 	}
 
@@ -71,16 +107,66 @@ public:
 	) = 0;
 
 	void Execute(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) {
+		if (!m_size) {
+			return;
+		}
 		pCommandList->ExecuteIndirect(
 			m_pCommandSignature.Get(),
-			m_capacity,
+			m_size,
 			m_pIndirectCommandBuffer->GetResource().Get(),
 			0,
+			m_pIndirectCommandBuffer->GetResource().Get(),
+			GetCounterOffset(m_capacity)
+		);
+	}
+
+	// Executes commands [firstCommand, firstCommand + commandsCount), e.g. one chunk of a split recording.
+	// The count is taken as it is instead of from the counter, so it has to be within what was last updated.
+	void Execute(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, uint32_t firstCommand, uint32_t commandsCount) {
+		if (firstCommand >= m_capacity) {
+			return;
+		}
+		commandsCount = std::min(commandsCount, m_capacity - firstCommand);
+		if (!commandsCount) {
+			return;
+		}
+		pCommandList->ExecuteIndirect(
+			m_pCommandSignature.Get(),
+			commandsCount,
+			m_pIndirectCommandBuffer->GetResource().Get(),
+			static_cast<UINT64>(firstCommand) * sizeof(IndirectCommand),
 			nullptr,
 			0
 		);
 	}
 
+	uint32_t GetSize() const {
+		return m_size;
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress() const {
+		return m_pIndirectCommandBuffer->GetResource()->GetGPUVirtualAddress();
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> GetCommandSignature() const {
+		return m_pCommandSignature;
+	}
+
+	void SetGrowthPolicy(const GrowthPolicy& growthPolicy) {
+		m_growthPolicy = growthPolicy;
+	}
+
+	// capacity is grown on the next update, without waiting for the GPU
+	void Reserve(uint32_t capacity) {
+		m_reservedCapacity = std::max(m_reservedCapacity, capacity);
+	}
+
+	// shrinks the live range, the counter is rewritten on the next update
+	void SetSize(uint32_t size) {
+		assert(size <= m_size);
+		m_size = size;
+	}
+
 protected:
 	static Microsoft::WRL::ComPtr<ID3D12CommandSignature> CreateCommandSignature(
 		const Microsoft::WRL::ComPtr<ID3D12Device2>& pDevice,
@@ -99,22 +185,24 @@ protected:
 		return pCommandSignature;
 	}
 
+	static UINT64 GetCounterOffset(uint32_t capacity) {
+		return AlignSize(
+			capacity * sizeof(IndirectCommand),
+			D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT
+		);
+	}
+
 	static std::shared_ptr<GPUResource> CreateBuffer(
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
 		uint32_t capacity,
 		const D3D12_RESOURCE_STATES& initState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS
 	) {
-		uint32_t alignedSize{ AlignSize(
-			capacity * sizeof(IndirectCommand),
-			D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT
-		) };
-		//capacity = alignedSize / sizeof(IndirectCommand);
 		return std::make_shared<GPUResource>(
 			pAllocator,
 			GPUResource::HeapData{.heapType{ D3D12_HEAP_TYPE_DEFAULT } },
 			GPUResource::ResourceData{
 				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(
-					alignedSize,
+					GetCounterOffset(capacity) + sizeof(UINT),
 					D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS
 				) },
 				.resInitState{ initState }
@@ -127,74 +215,115 @@ protected:
 			.ViewDimension{ D3D12_UAV_DIMENSION_BUFFER },
 			.Buffer{
 				.NumElements{ static_cast<UINT>(capacity) },
-				.StructureByteStride{ sizeof(IndirectCommand) }
+				.StructureByteStride{ sizeof(IndirectCommand) },
+				.CounterOffsetInBytes{ GetCounterOffset(static_cast<uint32_t>(capacity)) }
 			}
 		};
 	}
 
+	void Transition(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, D3D12_RESOURCE_STATES state) {
+		if (m_state == state) {
+			return;
+		}
+		ResourceTransition(pCommandList, m_pIndirectCommandBuffer->GetResource(), m_state, state);
+		m_state = state;
+	}
+
+	bool IsSizeDirty() const {
+		return m_gpuSize != m_size;
+	}
+
+	// writes the live count into the uav counter, leaves the buffer in COPY_DEST
+	void RecordSizeUpdate(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) {
+		if (!IsSizeDirty()) {
+			return;
+		}
+		Transition(pCommandList, D3D12_RESOURCE_STATE_COPY_DEST);
+		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER parameter{
+			.Dest{ m_pIndirectCommandBuffer->GetResource()->GetGPUVirtualAddress() + GetCounterOffset(m_capacity) },
+			.Value{ m_size }
+		};
+		pCommandList->WriteBufferImmediate(1, &parameter, nullptr);
+		m_gpuSize = m_size;
+	}
+
+	bool IsExpandRequired(uint32_t numElements) const {
+		return std::max(numElements, m_reservedCapacity) > m_capacity;
+	}
+
+	// Records the copy into the update command list. The old buffer is released by Submit once the GPU is done with it.
 	bool Expand(
 		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
-		std::shared_ptr<CommandQueue> pCommandQueueCopy,
 		std::shared_ptr<CommandQueue> pCommandQueueDirect,
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
 		uint32_t numElements
 	) {
-		if (numElements <= m_capacity) {
+		if (!IsExpandRequired(numElements)) {
 			return false;
 		}
 
-		std::shared_ptr<CommandList> pCommandListDirect{
-			pCommandQueueDirect->GetCommandList(pDevice)
-		};
-		ResourceTransition(
-			pCommandListDirect->m_pCommandList,
-			m_pIndirectCommandBuffer->GetResource(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_SOURCE
-		);
-		pCommandQueueDirect->ExecuteCommandListImmediately(pCommandListDirect);
-
-		uint32_t newCapacity{ std::bit_ceil(numElements) };
+		uint32_t newCapacity{ std::max({
+			numElements,
+			m_reservedCapacity,
+			static_cast<uint32_t>(m_capacity * m_growthPolicy.factor),
+			m_capacity + m_growthPolicy.minStep
+		}) };
 		std::shared_ptr<GPUResource> pIndirectCommandBufferNew{
 			CreateBuffer(pAllocator, newCapacity, D3D12_RESOURCE_STATE_COPY_DEST)
 		};
 
-		std::shared_ptr<CommandList> pCommandListCopy{
-			pCommandQueueCopy->GetCommandList(pDevice)
-		};
-		pCommandListCopy->m_pCommandList->CopyBufferRegion(
-			pIndirectCommandBufferNew->GetResource().Get(),
-			0,
-			m_pIndirectCommandBuffer->GetResource().Get(),
-			0,
-			m_capacity * sizeof(IndirectCommand)
-		);
-		pCommandQueueCopy->ExecuteCommandListImmediately(pCommandListCopy);
-
-		pCommandListDirect = pCommandQueueDirect->GetCommandList(pDevice);
-		ResourceTransition(
-			pCommandListDirect->m_pCommandList,
-			m_pIndirectCommandBuffer->GetResource(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS
-		);
-		pCommandQueueDirect->ExecuteCommandListImmediately(pCommandListDirect);
+		UINT64 copySize{ std::min(m_size, m_capacity) * sizeof(IndirectCommand) };
+		if (copySize) {
+			Transition(pCommandList, D3D12_RESOURCE_STATE_COPY_SOURCE);
+			pCommandList->CopyBufferRegion(
+				pIndirectCommandBufferNew->GetResource().Get(),
+				0,
+				m_pIndirectCommandBuffer->GetResource().Get(),
+				0,
+				copySize
+			);
+		}
 
+		// rarely waits: only if the descriptor was used by an update still in flight
+		m_uavId = (m_uavId + 1) % _countof(m_uavFenceValues);
+		pCommandQueueDirect->WaitForFenceValue(m_uavFenceValues[m_uavId]);
 		pIndirectCommandBufferNew->CreateUnorderedAccessView(
 			pDevice,
-			m_pDescHeapRangeUav->GetCpuHandle(),
-			&GetUavDesc(newCapacity)
+			m_pDescHeapRangeUav->GetCpuHandle(m_uavId),
+			&GetUavDesc(newCapacity),
+			pIndirectCommandBufferNew->GetResource()
 		);
+
+		m_pRetiringBuffers.push_back(m_pIndirectCommandBuffer);
 		m_capacity = newCapacity;
 		m_pIndirectCommandBuffer = pIndirectCommandBufferNew;
+		m_state = D3D12_RESOURCE_STATE_COPY_DEST;
+		// the counter moved with the capacity
+		m_gpuSize = std::numeric_limits<uint32_t>::max();
 
 		return true;
 	}
+
+	// Executes the update list without waiting for it and releases old buffers the GPU has finished with
+	void Submit(std::shared_ptr<CommandQueue> pCommandQueueDirect, std::shared_ptr<CommandList> pCommandList) {
+		uint64_t fenceValue{ pCommandQueueDirect->ExecuteCommandList(pCommandList) };
+		m_uavFenceValues[m_uavId] = fenceValue;
+
+		for (std::shared_ptr<GPUResource>& pBuffer : m_pRetiringBuffers) {
+			m_retiredBuffers.push_back({ std::move(pBuffer), fenceValue });
+		}
+		m_pRetiringBuffers.clear();
+		while (!m_retiredBuffers.empty() && pCommandQueueDirect->IsFenceComplete(m_retiredBuffers.front().fenceValue)) {
+			m_retiredBuffers.pop_front();
+		}
+	}
 };
 
 template <typename IndirectCommand>
 class StaticIndirectCommandBuffer : public IndirectCommandBuffer<IndirectCommand> {
 	std::vector<IndirectCommand> m_indirectCommands{};
+	DirtyRangeList m_dirtyRanges{};
 
 	std::shared_ptr<DynamicUploadHeap> m_pDynamicUploadHeap{};
 
@@ -221,12 +350,14 @@ public:
 	}
 
 	void SetUpdateAll(IndirectCommand* indirectCommands, size_t count) override {
-		if (count > m_capacity) {
+		if (count > m_indirectCommands.size()) {
 			m_indirectCommands.resize(std::bit_ceil(count));
 		}
 		for (size_t i{}; i < count; ++i) {
 			m_indirectCommands[i] = indirectCommands[i];
 		}
+		m_size = std::max<uint32_t>(m_size, static_cast<uint32_t>(count));
+		m_dirtyRanges.Add(0, count);
 	}
 
 	void SetUpdateAt(size_t id, const IndirectCommand& indirectCommand) override {
@@ -234,6 +365,8 @@ public:
 			m_indirectCommands.resize(std::bit_ceil(id + 1));
 		}
 		m_indirectCommands[id] = indirectCommand;
+		m_size = std::max<uint32_t>(m_size, static_cast<uint32_t>(id + 1));
+		m_dirtyRanges.Add(id, id + 1);
 	}
 
 	void PerformUpdate(
@@ -242,59 +375,55 @@ public:
 		std::shared_ptr<CommandQueue> pCommandQueueCopy,
 		std::shared_ptr<CommandQueue> pCommandQueueDirect
 	) override {
-		if (m_indirectCommands.size() > m_capacity) {
-			IndirectCommandBuffer<IndirectCommand>::Expand(
-				pDevice,
-				pAllocator,
-				pCommandQueueCopy,
-				pCommandQueueDirect,
-				m_indirectCommands.size()
-			);
+		if (m_dirtyRanges.IsEmpty() && !IsSizeDirty() && !IsExpandRequired(m_size)) {
+			return;
 		}
 
-		D3D12_SUBRESOURCE_DATA subresData{
-			.pData{ m_indirectCommands.data() },
-			.RowPitch{ static_cast<UINT>(m_indirectCommands.size()) * sizeof(IndirectCommand) },
-			.SlicePitch{ subresData.RowPitch }
-		};
-
+		// one list for growth, transitions and all the spans, submitted without waiting
 		std::shared_ptr<CommandList> pCommandListDirect{
 			pCommandQueueDirect->GetCommandList(pDevice)
 		};
-		ResourceTransition(
+		IndirectCommandBuffer<IndirectCommand>::Expand(
+			pDevice,
+			pAllocator,
+			pCommandQueueDirect,
 			pCommandListDirect->m_pCommandList,
-			m_pIndirectCommandBuffer->GetResource(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_DEST
+			m_size
 		);
-		pCommandQueueDirect->ExecuteCommandListImmediately(pCommandListDirect);
 
-		DynamicAllocation intermediateAllocation{
-			m_pDynamicUploadHeap->Allocate(m_capacity * sizeof(IndirectCommand))
-		};
+		// commands past the live range are dead after removals
+		const std::vector<DirtyRangeList::Range>& dirtyRanges{ m_dirtyRanges.Merge(m_size) };
 
-		std::shared_ptr<CommandList> pCommandListCopy{
-			pCommandQueueCopy->GetCommandList(pDevice)
-		};
-		UpdateSubresources(
-			pCommandListCopy->m_pCommandList.Get(),
-			m_pIndirectCommandBuffer->GetResource().Get(),
-			intermediateAllocation.pBuffer->GetResource().Get(),
-			intermediateAllocation.offset,
-			0,
-			1,
-			&subresData
-		);
-		pCommandQueueCopy->ExecuteCommandListImmediately(pCommandListCopy);
+		size_t uploadSize{ m_dirtyRanges.GetElementsCount() * sizeof(IndirectCommand) };
+		DynamicAllocation uploadAllocation{};
+		if (uploadSize) {
+			uploadAllocation = m_pDynamicUploadHeap->Allocate(uploadSize);
+		}
 
-		pCommandListDirect = pCommandQueueDirect->GetCommandList(pDevice);
-		ResourceTransition(
-			pCommandListDirect->m_pCommandList,
-			m_pIndirectCommandBuffer->GetResource(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
-		);
-		pCommandQueueDirect->ExecuteCommandListImmediately(pCommandListDirect);
+		Transition(pCommandListDirect->m_pCommandList, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		size_t uploadOffset{};
+		for (const DirtyRangeList::Range& range : dirtyRanges) {
+			size_t spanSize{ (range.end - range.begin) * sizeof(IndirectCommand) };
+			memcpy(
+				static_cast<uint8_t*>(uploadAllocation.cpuAddress) + uploadOffset,
+				m_indirectCommands.data() + range.begin,
+				spanSize
+			);
+			pCommandListDirect->m_pCommandList->CopyBufferRegion(
+				m_pIndirectCommandBuffer->GetResource().Get(),
+				range.begin * sizeof(IndirectCommand),
+				uploadAllocation.pBuffer->GetResource().Get(),
+				uploadAllocation.offset + uploadOffset,
+				spanSize
+			);
+			uploadOffset += spanSize;
+		}
+		m_dirtyRanges.Clear();
+
+		RecordSizeUpdate(pCommandListDirect->m_pCommandList);
+		Transition(pCommandListDirect->m_pCommandList, m_readState);
+		Submit(pCommandQueueDirect, pCommandListDirect);
 	}
 };
 
@@ -344,21 +473,26 @@ public:
 	}
 
 	void SetUpdateAll(IndirectCommand* indirectCommands, size_t count) override {
-		if (count > m_capacity) {
-			m_updBufIds.reserve(std::bit_ceil(count));
-			m_updBuf.reserve(std::bit_ceil(count));
-			m_updMaxId = count;
+		// the update buffers are appended to, so the pending updates count too
+		if (m_updBuf.size() + count > m_updBuf.capacity()) {
+			m_updBufIds.reserve(std::bit_ceil(m_updBufIds.size() + count));
+			m_updBuf.reserve(std::bit_ceil(m_updBuf.size() + count));
+		}
+		if (count) {
+			m_updMaxId = std::max<size_t>(m_updMaxId, count - 1);
 		}
 		for (size_t i{}; i < count; ++i) {
 			m_updBufIds.push_back(i);
 			m_updBuf.push_back(indirectCommands[i]);
 		}
+		m_size = std::max<uint32_t>(m_size, static_cast<uint32_t>(count));
 	}
 
 	void SetUpdateAt(size_t id, const IndirectCommand& indirectCommand) override {
 		m_updBufIds.push_back(id);
 		m_updBuf.push_back(indirectCommand);
 		m_updMaxId = std::max<size_t>(m_updMaxId, id);
+		m_size = std::max<uint32_t>(m_size, static_cast<uint32_t>(id + 1));
 	}
 
 	virtual void PerformUpdate(
@@ -369,51 +503,52 @@ public:
 	) override {
 		assert(m_updBufIds.size() == m_updBuf.size());
 		size_t updCnt{ m_updBufIds.size() };
-		if (!updCnt) {
+		if (!updCnt && !IsSizeDirty() && !IsExpandRequired(m_size)) {
 			return;
 		}
 
-		if (m_updMaxId >= m_capacity) {
-			IndirectCommandBuffer<IndirectCommand>::Expand(
-				pDevice,
-				pAllocator,
-				pCommandQueueCopy,
-				pCommandQueueDirect,
-				m_updMaxId + 1
-			);
-		}
-		m_updMaxId = m_capacity - 1;
-
-		size_t updBufIdsSize{ updCnt * sizeof(UINT) };
-		DynamicAllocation updBufIdsAllocation{ m_pDynamicUploadHeap->Allocate(updBufIdsSize) };
-		memcpy(updBufIdsAllocation.cpuAddress, m_updBufIds.data(), updBufIdsSize);
-		m_updBufIds.clear();
-
-		size_t updBufSize{ updCnt * sizeof(IndirectCommand) };
-		DynamicAllocation updBufAllocation{ m_pDynamicUploadHeap->Allocate(updBufSize) };
-		memcpy(updBufAllocation.cpuAddress, m_updBuf.data(), updBufSize);
-		m_updBuf.clear();
-
 		std::shared_ptr<CommandList> pCommandListDirect{
 			pCommandQueueDirect->GetCommandList(pDevice)
 		};
-		static const size_t threadBlockSize{ 128 };
-		UINT u = static_cast<UINT>(std::ceil(updCnt / float(threadBlockSize)));
-		m_pIndirectUpdater->Dispatch(
+		IndirectCommandBuffer<IndirectCommand>::Expand(
+			pDevice,
+			pAllocator,
+			pCommandQueueDirect,
 			pCommandListDirect->m_pCommandList,
-			static_cast<UINT>(std::ceil(updCnt / float(threadBlockSize))), 1, 1,
-			[&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, UINT& rootParamId) {
-				pCommandList->SetComputeRoot32BitConstant(rootParamId++, updCnt, 0);
-				pCommandList->SetComputeRootShaderResourceView(rootParamId++, updBufIdsAllocation.gpuAddress);
-				pCommandList->SetComputeRootShaderResourceView(rootParamId++, updBufAllocation.gpuAddress);
-				
-				pCommandList->SetDescriptorHeaps(1, m_pDescHeapManagerCbvSrvUav->GetDescriptorHeap().GetAddressOf());
-				pCommandList->SetComputeRootDescriptorTable(rootParamId++,
-					m_pDescHeapRangeUav->GetGpuHandle()
-				);
-			}
+			static_cast<uint32_t>(std::max<size_t>(m_updMaxId + 1, m_size))
 		);
+		m_updMaxId = m_capacity - 1;
+		if (updCnt) {
+			size_t updBufIdsSize{ updCnt * sizeof(UINT) };
+			DynamicAllocation updBufIdsAllocation{ m_pDynamicUploadHeap->Allocate(updBufIdsSize) };
+			memcpy(updBufIdsAllocation.cpuAddress, m_updBufIds.data(), updBufIdsSize);
+			m_updBufIds.clear();
+
+			size_t updBufSize{ updCnt * sizeof(IndirectCommand) };
+			DynamicAllocation updBufAllocation{ m_pDynamicUploadHeap->Allocate(updBufSize) };
+			memcpy(updBufAllocation.cpuAddress, m_updBuf.data(), updBufSize);
+			m_updBuf.clear();
+
+			Transition(pCommandListDirect->m_pCommandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			static const size_t threadBlockSize{ 128 };
+			m_pIndirectUpdater->Dispatch(
+				pCommandListDirect->m_pCommandList,
+				static_cast<UINT>(std::ceil(updCnt / float(threadBlockSize))), 1, 1,
+				[&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList, UINT& rootParamId) {
+					pCommandList->SetComputeRoot32BitConstant(rootParamId++, updCnt, 0);
+					pCommandList->SetComputeRootShaderResourceView(rootParamId++, updBufIdsAllocation.gpuAddress);
+					pCommandList->SetComputeRootShaderResourceView(rootParamId++, updBufAllocation.gpuAddress);
+					
+					pCommandList->SetDescriptorHeaps(1, m_pDescHeapManagerCbvSrvUav->GetDescriptorHeap().GetAddressOf());
+					pCommandList->SetComputeRootDescriptorTable(rootParamId++,
+						m_pDescHeapRangeUav->GetGpuHandle(m_uavId)
+					);
+				}
+			);
+		}
 
-		pCommandQueueDirect->ExecuteCommandListImmediately(pCommandListDirect);
+		RecordSizeUpdate(pCommandListDirect->m_pCommandList);
+		Transition(pCommandListDirect->m_pCommandList, m_readState);
+		Submit(pCommandQueueDirect, pCommandListDirect);
 	}
 };
@@ -2,6 +2,7 @@
 
 #include "Atlas.h"
 #include "ComputeObject.h"
+#include "CullingData.h"
 #include "PSOLibrary.h"
 #include "RenderObject.h"
 #include "Resources.h"
@@ -38,6 +39,43 @@ public:
         );
     }
 
+    static std::shared_ptr<ComputeObject> CreateIdUpdater(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
+        std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
+        std::shared_ptr<PSOLibrary> pPSOLibrary
+    ) {
+        return Create(
+            pDevice,
+            pShaderAtlas,
+            pRootSignatureAtlas,
+            pPSOLibrary,
+            L"IdIndirectUpdater.cso"
+        );
+    }
+
+    // culls id commands of an instanced subsystem and compacts the visible ones, see GpuCulling
+    static std::shared_ptr<ComputeObject> CreateIdCuller(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
+        std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
+        std::shared_ptr<PSOLibrary> pPSOLibrary
+    ) {
+        std::shared_ptr<ComputeObject> pComputeObj{ std::make_shared<ComputeObject>() };
+        pComputeObj->InitMaterial(
+            pDevice,
+            RootSignatureData(
+                pRootSignatureAtlas,
+                CreateCullerRootSignatureBlob(pDevice),
+                L"IndirectCullerRootSignature"
+            ),
+            ComputeShaderData(pShaderAtlas, L"IdIndirectCuller.cso"),
+            pPSOLibrary
+        );
+
+        return pComputeObj;
+    }
+
 private:
     static std::shared_ptr<ComputeObject> Create(
         Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
@@ -61,6 +99,31 @@ private:
         return pComputeObj;
     }
 
+    // buffers are bound as root arguments, only the HZB mips need a descriptor table
+    static Microsoft::WRL::ComPtr<ID3DBlob> CreateCullerRootSignatureBlob(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
+    ) {
+        size_t rpId{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[9]{};
+        rootParameters[rpId++].InitAsConstants(sizeof(CullingConstants) / sizeof(UINT), 0);
+        rootParameters[rpId++].InitAsShaderResourceView(0);  // input commands
+        rootParameters[rpId++].InitAsShaderResourceView(1);  // instances
+        rootParameters[rpId++].InitAsShaderResourceView(2);  // object bounds
+        rootParameters[rpId++].InitAsUnorderedAccessView(0);  // output commands
+        rootParameters[rpId++].InitAsUnorderedAccessView(1);  // output commands count
+        rootParameters[rpId++].InitAsUnorderedAccessView(2);  // visible instances
+        rootParameters[rpId++].InitAsUnorderedAccessView(3);  // object visibility
+
+        CD3DX12_DESCRIPTOR_RANGE1 rangeHzb[1]{};
+        rangeHzb[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
+        rootParameters[rpId++].InitAsDescriptorTable(_countof(rangeHzb), rangeHzb);
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters);
+
+        return SerializeRootSignature(pDevice, rootSignatureDescription);
+    }
+
     static Microsoft::WRL::ComPtr<ID3DBlob> CreateRootSignatureBlob(
         Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
     ) {
@@ -80,6 +143,13 @@ private:
         CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
         rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters);
 
+        return SerializeRootSignature(pDevice, rootSignatureDescription);
+    }
+
+    static Microsoft::WRL::ComPtr<ID3DBlob> SerializeRootSignature(
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        const CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC& rootSignatureDescription
+    ) {
         D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{ D3D_ROOT_SIGNATURE_VERSION_1_1 };
         if (FAILED(pDevice->CheckFeatureSupport(
             D3D12_FEATURE_ROOT_SIGNATURE,
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -13,6 +15,8 @@ class JobSystem {
     std::vector<std::thread> m_threads{ ThreadsCount };
     ArrayLockFreeQueue<std::function<void()>> m_jobs{};
     std::atomic<bool> m_isRunning{};
+    // the job system whose worker the thread is, if any
+    static inline thread_local const JobSystem* t_pWorkerOf{};
 
 public:
     ~JobSystem() {
@@ -26,10 +30,13 @@ public:
         }
     }
 
+    // can be called again, and before StartRunning
     void StopRunning() {
         m_isRunning.store(false);
         for (std::thread& thread : m_threads) {
-            thread.join();
+            if (thread.joinable()) {
+                thread.join();
+            }
         }
     }
 
@@ -37,8 +44,44 @@ public:
         return m_jobs.Enqueue(job);
     }
 
+    bool IsWorker() const {
+        return t_pWorkerOf == this;
+    }
+
+    // Calls task(taskId) for ids in [0, tasksCount). The calling thread runs the first task and the ones
+    // that don't fit the queue, then waits for the rest, so it must not be a worker.
+    template <typename Task>
+    void RunAndWait(size_t tasksCount, const Task& task) {
+        // a worker waiting for jobs queued behind it can deadlock the system
+        assert(!IsWorker());
+        if (!tasksCount) {
+            return;
+        }
+
+        // shared with the jobs, the last one still notifies after the wait below can return
+        auto pPendingCount{ std::make_shared<std::atomic<size_t>>(tasksCount - 1) };
+        for (size_t taskId{ 1 }; taskId < tasksCount; ++taskId) {
+            bool isAdded{ AddJob([&task, pPendingCount, taskId]() {
+                task(taskId);
+                if (pPendingCount->fetch_sub(1) == 1) {
+                    pPendingCount->notify_one();
+                }
+            }) };
+            if (!isAdded) {
+                task(taskId);
+                pPendingCount->fetch_sub(1);
+            }
+        }
+        task(0);
+
+        for (size_t pending{ pPendingCount->load() }; pending; pending = pPendingCount->load()) {
+            pPendingCount->wait(pending);
+        }
+    }
+
 private:
     void Worker() {
+        t_pWorkerOf = this;
         size_t passes{};
 
         while (m_isRunning.load()) {
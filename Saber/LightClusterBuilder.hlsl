@@ -0,0 +1,92 @@
+#include "Clusters.hlsli"
+
+#define threadBlockSize 64
+#define maskWordsCount (threadBlockSize / 32)
+
+ConstantBuffer<ClusterConstants> clusterConstants : register(b0);
+
+StructuredBuffer<Light> lights : register(t0);
+
+RWStructuredBuffer<uint> clusterLightCounts : register(u0);
+// every cluster owns CLUSTER_LIGHTS_MAX_COUNT slots starting at clusterId * CLUSTER_LIGHTS_MAX_COUNT
+RWStructuredBuffer<uint> clusterLightIndices : register(u1);
+// a single element, zeroed before the dispatch
+RWStructuredBuffer<ClusterStats> clusterStats : register(u2);
+
+// A group fills the CLUSTERS_Z clusters of a screen tile. Every batch of lights is tested against the tile
+// side planes once, then each cluster only checks the depth of the lights left in the tile mask,
+// so the cost follows the number of lights around the tile instead of clusters times lights.
+groupshared float2 lightDepthRanges[threadBlockSize];
+groupshared uint tileLightMasks[maskWordsCount];
+
+[numthreads(threadBlockSize, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    // a thread per slice, the extra threads only help with the tile tests
+    bool isCluster = groupIndex < CLUSTERS_Z;
+    uint clusterId = min(groupIndex, CLUSTERS_Z - 1) * CLUSTERS_X * CLUSTERS_Y + groupId.x;
+    ClusterBounds bounds = GetClusterBounds(clusterConstants, clusterId);
+
+    if (groupIndex < maskWordsCount)
+    {
+        tileLightMasks[groupIndex] = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // lights reaching the cluster, the dropped ones included
+    uint count = 0;
+    for (uint batchStart = 0; batchStart < clusterConstants.lightsCount; batchStart += threadBlockSize)
+    {
+        uint lightId = batchStart + groupIndex;
+        if (lightId < clusterConstants.lightsCount)
+        {
+            float4 sphere = lights[lightId].position;
+            lightDepthRanges[groupIndex] = GetSphereDepthRange(clusterConstants, sphere);
+            if (IsSphereInTile(clusterConstants, bounds, sphere))
+            {
+                InterlockedOr(tileLightMasks[groupIndex / 32], 1u << (groupIndex % 32));
+            }
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        // bits are taken from the lowest, lights are added in increasing order,
+        // the same lists as ClusteredLighting::AssignLightsReference
+        if (isCluster)
+        {
+            for (uint wordId = 0; wordId < maskWordsCount; ++wordId)
+            {
+                uint mask = tileLightMasks[wordId];
+                while (mask != 0)
+                {
+                    uint batchLightId = wordId * 32 + firstbitlow(mask);
+                    mask &= mask - 1;
+                    if (IsDepthRangeInSlice(bounds, lightDepthRanges[batchLightId]))
+                    {
+                        if (count < CLUSTER_LIGHTS_MAX_COUNT)
+                        {
+                            clusterLightIndices[clusterId * CLUSTER_LIGHTS_MAX_COUNT + count] = batchStart + batchLightId;
+                        }
+                        ++count;
+                    }
+                }
+            }
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        if (groupIndex < maskWordsCount)
+        {
+            tileLightMasks[groupIndex] = 0;
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (isCluster)
+    {
+        clusterLightCounts[clusterId] = min(count, CLUSTER_LIGHTS_MAX_COUNT);
+        InterlockedMax(clusterStats[0].maxClusterLightsCount, count);
+        if (count > CLUSTER_LIGHTS_MAX_COUNT)
+        {
+            InterlockedAdd(clusterStats[0].overflowedClustersCount, 1);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef LIGHTING_DATA
+#define LIGHTING_DATA
+
+#include "HlslCppTypesRedefine.h"
+
+// Layouts shared by LightClusterBuilder.hlsl, DeferredShadingComputeShader.hlsl
+// and the CPU reference in ClusteredLighting
+
+// Froxel grid: screen tiles, split in depth into slices growing exponentially from near to far
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define CLUSTERS_COUNT (CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z)
+// every cluster owns this many slots of the index list, lights past it are dropped and counted in ClusterStats
+#define CLUSTER_LIGHTS_MAX_COUNT 128
+// attenuation times the brightest color channel under which a light doesn't reach, it sets the light range
+#define LIGHT_ATTENUATION_CUTOFF (1.f / 256.f)
+
+// position.w is the range, lights are culled against the sphere it makes
+struct Light {
+    float4 position;
+    float4 diffuseColorAndPower;
+    float4 specularColorAndPower;
+};
+
+// Set as root constants to build the clusters, the shading reads them from LightingConstants.
+// The matrix is stored the way SceneBuffer stores it, shaders multiply it from the left.
+struct ClusterConstants {
+    float4x4 invViewProjection;
+    float4 cameraPosition;
+    float4 cameraForward;
+    float nearZ;
+    float farZ;
+    uint lightsCount;
+    uint padding;
+};
+
+// Written by the build for the CPU to read back
+struct ClusterStats {
+    uint overflowedClustersCount;
+    // dropped lights included
+    uint maxClusterLightsCount;
+};
+
+struct LightingConstants {
+    float4 ambientColorAndPower;
+    ClusterConstants clusters;
+};
+
+#endif
@@ -6,11 +6,12 @@
 
 #include <filesystem>
 #include <initializer_list>
+#include <optional>
 
 #include "Atlas.h"
 #include "CommandQueue.h"
-#include "ConstantBuffer.h"
 #include "GBuffer.h"
+#include "GeometryPool.h"
 #include "IndirectCommand.h"
 #include "MaterialManager.h"
 #include "ModelBuffers.h"
@@ -23,28 +24,26 @@
 template <typename ModelBuffer>
 class MeshRenderObject : public RenderObject {
 protected:
-    std::shared_ptr<Mesh> m_pMesh{};
+    std::shared_ptr<GeometryPool> m_pGeometryPool{};
+    std::wstring m_meshName{};
+    GeometryPool::Allocation m_geometry{};
 
     ModelBuffer m_modelBuffer{};
-    std::shared_ptr<ConstantBuffer> m_pModelCb{};
 
 public:
-    MeshRenderObject(
-        Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
-        ModelBuffer* pModelBuffer = nullptr
-    ) {
+    MeshRenderObject(ModelBuffer* pModelBuffer = nullptr) {
         if (pModelBuffer) {
             m_modelBuffer = *pModelBuffer;
         }
-        m_pModelCb = std::make_shared<ConstantBuffer>(
-            pAllocator,
-            sizeof(ModelBuffer),
-            &m_modelBuffer
-        );
+    }
+    ~MeshRenderObject() {
+        if (m_pGeometryPool) {
+            m_pGeometryPool->Release(m_meshName);
+        }
     }
 
     struct MeshInitData {
-        std::shared_ptr<Atlas<Mesh>> pMeshAtlas;
+        std::shared_ptr<GeometryPool> pGeometryPool;
         Mesh::MeshData meshData;
         std::wstring meshFilename;
     };
@@ -54,123 +53,112 @@ public:
         std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
         const MeshInitData& meshInitData
     ) {
-        m_pMesh = meshInitData.pMeshAtlas->Assign(
-            meshInitData.meshFilename,
+        assert(!m_pGeometryPool);
+        m_geometry = meshInitData.pGeometryPool->Add(
             pDevice,
             pAllocator,
             pCommandQueueCopy,
+            meshInitData.meshFilename,
             meshInitData.meshData
         );
+        m_pGeometryPool = meshInitData.pGeometryPool;
+        m_meshName = meshInitData.meshFilename;
+    }
+
+    // Shares the geometry, material and pipeline state, only the model buffer is different.
+    // Cheaper than creating the object again, nothing goes through the atlases.
+    std::shared_ptr<MeshRenderObject> Clone(const ModelBuffer& modelBuffer) const {
+        assert(m_pGeometryPool);
+        std::shared_ptr<MeshRenderObject> pClone{ std::make_shared<MeshRenderObject>(*this) };
+        m_pGeometryPool->AddReference(m_meshName);
+        pClone->m_modelBuffer = modelBuffer;
+        return pClone;
     }
 
+    // the data reaches GPU when the object is added to a render subsystem
     ModelBuffer& GetModelBuffer() {
         return m_modelBuffer;
     }
     void SetModelBuffer(const ModelBuffer& modelBuffer) {
         m_modelBuffer = modelBuffer;
-        UpdateModelBuffer();
-    }
-    void UpdateModelBuffer() {
-        m_pModelCb->Update(&m_modelBuffer);
     }
 
-    void FillIndirectCommand(CbMeshIndirectCommand& indirectCommand) override {
-        indirectCommand = CbMeshIndirectCommand{
-            .constantBufferView{
-                m_pModelCb->GetResource()->GetGPUVirtualAddress()
-            },
-            .indexBufferView{
-                *m_pMesh->GetIndexBufferView()
-            },
-            .vertexBufferView{
-                *m_pMesh->GetVertexBufferView()
-            },
-            .drawArguments{
-                .IndexCountPerInstance{ static_cast<UINT>(m_pMesh->GetIndicesCount()) },
-                .InstanceCount{ 1 }
-            },
+    void FillIndirectCommand(IdIndirectCommand& indirectCommand) override {
+        indirectCommand = IdIndirectCommand{
+            .drawArguments{ GetDrawArguments() }
         };
     }
 
-    void FillIndirectCommand(CbMesh4IndirectCommand& indirectCommand) override {
-        indirectCommand = CbMesh4IndirectCommand{
-            .constantBufferView{
-                m_pModelCb->GetResource()->GetGPUVirtualAddress()
-            },
-            .indexBufferView{
-                *m_pMesh->GetIndexBufferView()
-            },
-            .vertexBufferView{ *m_pMesh->GetVertexBufferView() },
-            .vertexBufferView1{ *m_pMesh->GetVertexBufferView(1) },
-            .vertexBufferView2{ *m_pMesh->GetVertexBufferView(2) },
-            .vertexBufferView3{ *m_pMesh->GetVertexBufferView(3) },
-            .drawArguments{
-                .IndexCountPerInstance{ static_cast<UINT>(m_pMesh->GetIndicesCount()) },
-                .InstanceCount{ 1 }
-            },
-        };
+    void FillObjectData(::ModelBuffer& objectData) const override {
+        objectData = m_modelBuffer;
+        objectData.SetGeometry(m_geometry.startIndex, m_geometry.baseVertex);
+    }
+
+    void SetWorldMatrices(DirectX::FXMMATRIX worldMatrix, DirectX::CXMMATRIX normalMatrix) override {
+        m_modelBuffer.SetMatrices(worldMatrix, normalMatrix);
+    }
+
+    DirectX::BoundingSphere GetBoundingSphere() const override {
+        DirectX::BoundingSphere boundingSphere{};
+        m_geometry.boundingSphere.Transform(boundingSphere, m_modelBuffer.m_modelMatrix);
+        return boundingSphere;
+    }
+
+    void BindGeometry(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const override {
+        assert(m_pGeometryPool);
+        m_pGeometryPool->Bind(pCommandList);
     }
 
 protected:
-    void RenderJob(
-        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect
-    ) const override {
-        assert(m_pMesh);
-        if (m_pMesh) {
-            pCommandListDirect->IASetVertexBuffers(
-                0,
-                static_cast<UINT>(m_pMesh->GetVertexBuffersCount()),
-                m_pMesh->GetVertexBufferViews()
-            );
-            pCommandListDirect->IASetIndexBuffer(m_pMesh->GetIndexBufferView());
-        }
+    D3D12_DRAW_INDEXED_ARGUMENTS GetDrawArguments() const {
+        return D3D12_DRAW_INDEXED_ARGUMENTS{
+            .IndexCountPerInstance{ m_geometry.indexCount },
+            .InstanceCount{ 1 },
+            .StartIndexLocation{ m_geometry.startIndex },
+            .BaseVertexLocation{ m_geometry.baseVertex }
+        };
     }
 
-    void InnerRootParametersSetter(
-        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
-        UINT& rootParamId
+    void RenderJob(
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect
     ) const override {
-        pCommandListDirect->SetGraphicsRootConstantBufferView(
-            rootParamId++,
-            m_pModelCb->GetResource()->GetGPUVirtualAddress()
-        );
+        BindGeometry(pCommandListDirect);
     }
 
     void DrawCall(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList
     ) const override {
+        D3D12_DRAW_INDEXED_ARGUMENTS drawArguments{ GetDrawArguments() };
         pCommandList->DrawIndexedInstanced(
-            static_cast<UINT>(m_pMesh->GetIndicesCount()),
-            1,
-            0, 0, 0
+            drawArguments.IndexCountPerInstance,
+            drawArguments.InstanceCount,
+            drawArguments.StartIndexLocation,
+            drawArguments.BaseVertexLocation,
+            drawArguments.StartInstanceLocation
         );
     }
 };
 
-class TestRenderObject : protected MeshRenderObject<ModelBuffer> {
-protected:
-    static inline D3D12_INPUT_ELEMENT_DESC m_inputLayoutSoA[4]{
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 2, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 3, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-    };
-};
+class TestRenderObject : protected MeshRenderObject<ModelBuffer> {};
 
 class TestTextureRenderObject : protected TestRenderObject {
 public:
+    // set by the scene in GBuffer::Layout::Visibility, the visibility ids tell the render subsystems apart with it
+    static constexpr UINT subsystemIdRootParameterIndex{ 4 };
+
     static std::shared_ptr<MeshRenderObject<ModelBuffer>> CreateTextureCube(
         Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
         Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
         std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
         std::shared_ptr<CommandQueue> const& pCommandQueueDirect,
-        std::shared_ptr<Atlas<Mesh>> pMeshAtlas,
+        std::shared_ptr<GeometryPool> pGeometryPool,
         std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
         std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
         std::shared_ptr<PSOLibrary> pPSOLibrary,
         std::shared_ptr<GBuffer> pGBuffer,
         std::shared_ptr<MaterialManager> pMaterialManager,
-        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity()
+        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity(),
+        std::optional<size_t> materialId = std::nullopt
     ) {
         DirectX::XMFLOAT3 positions[24]{
             { -1.f, -1.f,  1.f }, {  1.f, -1.f,  1.f }, {  1.f, -1.f, -1.f }, { -1.f, -1.f, -1.f },
@@ -230,30 +218,31 @@ public:
         };
 
         std::shared_ptr<MeshRenderObject<ModelBuffer>> pObj{
-            std::make_shared<MeshRenderObject<ModelBuffer>>(pAllocator)
+            std::make_shared<MeshRenderObject<ModelBuffer>>()
         };
-        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pMeshAtlas, meshData, L"SimpleTextureCube"));
+        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pGeometryPool, meshData, L"SimpleTextureCube"));
+        bool isVisibility{ pGBuffer->GetLayout() == GBuffer::Layout::Visibility };
         pObj->InitMaterial(
             pDevice,
             RootSignatureData{
                 pRootSignatureAtlas,
-                CreateRootSignatureBlob(pDevice),
-                L"GLTFRootSignature"
+                CreateRootSignatureBlob(pDevice, isVisibility),
+                isVisibility ? L"GLTFVisibilityRootSignature" : L"GLTFRootSignature"
             },
             ShaderData{
                 pShaderAtlas,
                 L"SimpleUVVertexShader.cso",
-                L"SimpleUVPixelShader.cso"
+                isVisibility ? L"VisibilityPS.cso" : L"SimpleUVPixelShader.cso"
             },
             PipelineStateData{
                 pPSOLibrary,
-                CreatePipelineStateDesc(m_inputLayoutSoA, _countof(m_inputLayoutSoA), pGBuffer->GetRtFormatArray())
+                CreatePipelineStateDesc(GeometryPool::inputLayout, _countof(GeometryPool::inputLayout), pGBuffer->GetRtFormatArray())
             }
         );
 
         pObj->SetModelBuffer(ModelBuffer{
             modelMatrix,
-            pMaterialManager->AddMaterial(
+            materialId ? *materialId : pMaterialManager->AddMaterial(
                 pDevice,
                 pAllocator,
                 pCommandQueueCopy,
@@ -271,14 +260,15 @@ public:
         Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
         std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
         std::shared_ptr<CommandQueue> const& pCommandQueueDirect,
-        std::shared_ptr<Atlas<Mesh>> pMeshAtlas,
+        std::shared_ptr<GeometryPool> pGeometryPool,
         std::filesystem::path& filepath,
         std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
         std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
         std::shared_ptr<PSOLibrary> pPSOLibrary,
         std::shared_ptr<GBuffer> pGBuffer,
         std::shared_ptr<MaterialManager> pMaterialManager,
-        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity()
+        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity(),
+        std::optional<size_t> materialId = std::nullopt
     ) {
         Mesh::MeshDataGLTF data{
             .filepath{ filepath },
@@ -303,30 +293,31 @@ public:
         };
 
         std::shared_ptr<MeshRenderObject<ModelBuffer>> pObj{
-            std::make_shared<MeshRenderObject<ModelBuffer>>(pAllocator)
+            std::make_shared<MeshRenderObject<ModelBuffer>>()
         };
-        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pMeshAtlas, data, L"MeshGLTF"));
+        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pGeometryPool, data, filepath.wstring()));
+        bool isVisibility{ pGBuffer->GetLayout() == GBuffer::Layout::Visibility };
         pObj->InitMaterial(
             pDevice,
             RootSignatureData{
                 pRootSignatureAtlas,
-                CreateRootSignatureBlob(pDevice),
-                L"GLTFRootSignature"
+                CreateRootSignatureBlob(pDevice, isVisibility),
+                isVisibility ? L"GLTFVisibilityRootSignature" : L"GLTFRootSignature"
             },
             ShaderData{
                 pShaderAtlas,
                 L"SimpleUVVertexShader.cso",
-                L"SimpleUVPixelShader.cso"
+                isVisibility ? L"VisibilityPS.cso" : L"SimpleUVPixelShader.cso"
             },
             PipelineStateData{
                 pPSOLibrary,
-                CreatePipelineStateDesc(m_inputLayoutSoA, _countof(m_inputLayoutSoA), pGBuffer->GetRtFormatArray())
+                CreatePipelineStateDesc(GeometryPool::inputLayout, _countof(GeometryPool::inputLayout), pGBuffer->GetRtFormatArray())
             }
         );
 
         pObj->SetModelBuffer(ModelBuffer{
             modelMatrix,
-            pMaterialManager->AddMaterial(
+            materialId ? *materialId : pMaterialManager->AddMaterial(
                 pDevice,
                 pAllocator,
                 pCommandQueueCopy,
@@ -341,7 +332,8 @@ public:
 
 private:
     static Microsoft::WRL::ComPtr<ID3DBlob> CreateRootSignatureBlob(
-        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        bool isVisibility
     ) {
         // Allow input layout and deny unnecessary access to certain pipeline stages.
         D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags{
@@ -352,12 +344,21 @@ private:
             D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED
         };
 
-        CD3DX12_ROOT_PARAMETER1 rootParameters[2]{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[5]{};
         rootParameters[0].InitAsConstantBufferView(0);  // scene CB
-        rootParameters[1].InitAsConstantBufferView(1);  // model CB
+        rootParameters[IdIndirectCommand::instanceOffsetRootParameterIndex].InitAsConstants(1, 1);  // instance offset
+        rootParameters[IdIndirectCommand::objectDataRootParameterIndex].InitAsShaderResourceView(0, 1);  // objects data
+        rootParameters[IdIndirectCommand::instancesRootParameterIndex].InitAsShaderResourceView(1, 1);  // instances
+        rootParameters[subsystemIdRootParameterIndex].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL);  // subsystem id
 
         CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
-        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, rootSignatureFlags);
+        rootSignatureDescription.Init_1_1(
+            isVisibility ? _countof(rootParameters) : subsystemIdRootParameterIndex,
+            rootParameters,
+            0,
+            nullptr,
+            rootSignatureFlags
+        );
 
         D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{ D3D_ROOT_SIGNATURE_VERSION_1_1 };
         if (FAILED(pDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData)))) {
@@ -401,19 +402,23 @@ private:
 
 class TestAlphaRenderObject : protected TestRenderObject {
 public:
+    // same as TestTextureRenderObject::subsystemIdRootParameterIndex, after the material tables
+    static constexpr UINT subsystemIdRootParameterIndex{ 6 };
+
     static std::shared_ptr<MeshRenderObject<ModelBuffer>> CreateAlphaModelFromGLTF(
         Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
         Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
         std::shared_ptr<CommandQueue> const& pCommandQueueCopy,
         std::shared_ptr<CommandQueue> const& pCommandQueueDirect,
-        std::shared_ptr<Atlas<Mesh>> pMeshAtlas,
+        std::shared_ptr<GeometryPool> pGeometryPool,
         std::filesystem::path& filepath,
         std::shared_ptr<Atlas<ShaderResource>> pShaderAtlas,
         std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas,
         std::shared_ptr<PSOLibrary> pPSOLibrary,
         std::shared_ptr<GBuffer> pGBuffer,
         std::shared_ptr<MaterialManager> pMaterialManager,
-        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity()
+        const DirectX::XMMATRIX& modelMatrix = DirectX::XMMatrixIdentity(),
+        std::optional<size_t> materialId = std::nullopt
     ) {
         Mesh::MeshDataGLTF data{
             .filepath{ filepath },
@@ -438,30 +443,31 @@ public:
         };
 
         std::shared_ptr<MeshRenderObject<ModelBuffer>> pObj{
-            std::make_shared<MeshRenderObject<ModelBuffer>>(pAllocator)
+            std::make_shared<MeshRenderObject<ModelBuffer>>()
         };
-        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pMeshAtlas, data, L"AlphaGrassGLTF"));
+        pObj->InitMesh(pDevice, pAllocator, pCommandQueueCopy, MeshInitData(pGeometryPool, data, filepath.wstring()));
+        bool isVisibility{ pGBuffer->GetLayout() == GBuffer::Layout::Visibility };
         pObj->InitMaterial(
             pDevice,
             RootSignatureData{
                 pRootSignatureAtlas,
-                CreateRootSignatureBlob(pDevice),
-                L"AlphaGrassGLTFRootSignature"
+                CreateRootSignatureBlob(pDevice, isVisibility),
+                isVisibility ? L"AlphaGrassGLTFVisibilityRootSignature" : L"AlphaGrassGLTFRootSignature"
             },
             ShaderData{
                 pShaderAtlas,
                 L"AlphaVS.cso",
-                L"AlphaPS.cso"
+                isVisibility ? L"VisibilityAlphaPS.cso" : L"AlphaPS.cso"
             },
             PipelineStateData{
                 pPSOLibrary,
-                CreateAlphaPipelineStateDesc(m_inputLayoutSoA, _countof(m_inputLayoutSoA), pGBuffer->GetRtFormatArray())
+                CreateAlphaPipelineStateDesc(GeometryPool::inputLayout, _countof(GeometryPool::inputLayout), pGBuffer->GetRtFormatArray())
             }
         );
 
         pObj->SetModelBuffer(ModelBuffer{
             modelMatrix,
-            pMaterialManager->AddMaterial(
+            materialId ? *materialId : pMaterialManager->AddMaterial(
                 pDevice,
                 pAllocator,
                 pCommandQueueCopy,
@@ -476,7 +482,8 @@ public:
 
 protected:
     static Microsoft::WRL::ComPtr<ID3DBlob> CreateRootSignatureBlob(
-        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice
+        Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+        bool isVisibility
     ) {
         // Allow input layout and deny unnecessary access to certain pipeline stages.
         D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags{
@@ -487,17 +494,21 @@ protected:
             D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED
         };
 
-        CD3DX12_ROOT_PARAMETER1 rootParameters[4]{};
+        CD3DX12_ROOT_PARAMETER1 rootParameters[7]{};
         rootParameters[0].InitAsConstantBufferView(0);  // scene CB
-        rootParameters[1].InitAsConstantBufferView(1);  // model CB
+        rootParameters[IdIndirectCommand::instanceOffsetRootParameterIndex].InitAsConstants(1, 1);  // instance offset
+        rootParameters[IdIndirectCommand::objectDataRootParameterIndex].InitAsShaderResourceView(0, 1);  // objects data
+        rootParameters[IdIndirectCommand::instancesRootParameterIndex].InitAsShaderResourceView(1, 1);  // instances
 
         CD3DX12_DESCRIPTOR_RANGE1 rangeCbvsMaterials[1]{};
         rangeCbvsMaterials[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 2);
-        rootParameters[2].InitAsDescriptorTable(_countof(rangeCbvsMaterials), rangeCbvsMaterials, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[4].InitAsDescriptorTable(_countof(rangeCbvsMaterials), rangeCbvsMaterials, D3D12_SHADER_VISIBILITY_PIXEL);
 
         CD3DX12_DESCRIPTOR_RANGE1 rangeSrvsMaterial[1]{};
         rangeSrvsMaterial[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, -1, 0);
-        rootParameters[3].InitAsDescriptorTable(_countof(rangeSrvsMaterial), rangeSrvsMaterial, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[5].InitAsDescriptorTable(_countof(rangeSrvsMaterial), rangeSrvsMaterial, D3D12_SHADER_VISIBILITY_PIXEL);
+
+        rootParameters[subsystemIdRootParameterIndex].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL);  // subsystem id
 
         D3D12_STATIC_SAMPLER_DESC sampler{
             .Filter{ D3D12_FILTER_MIN_MAG_MIP_POINT },
@@ -516,7 +527,13 @@ protected:
         };
 
         CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
-        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 1, &sampler, rootSignatureFlags);
+        rootSignatureDescription.Init_1_1(
+            isVisibility ? _countof(rootParameters) : subsystemIdRootParameterIndex,
+            rootParameters,
+            1,
+            &sampler,
+            rootSignatureFlags
+        );
 
         D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{ D3D_ROOT_SIGNATURE_VERSION_1_1 };
         if (FAILED(pDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData)))) {
@@ -5,6 +5,8 @@
 struct ModelBuffer {
     DirectX::XMMATRIX m_modelMatrix{ DirectX::XMMatrixIdentity() };
     DirectX::XMMATRIX m_normalMatrix{ DirectX::XMMatrixIdentity() };
+    // x is the material, y and z are the first index and the base vertex of the geometry in GeometryPool,
+    // the visibility shading fetches the triangle with them
     DirectX::XMUINT4 m_materialId{};
 
     ModelBuffer() = default;
@@ -18,7 +20,18 @@ struct ModelBuffer {
         m_normalMatrix = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, m_modelMatrix));
     }
 
+    // for matrices computed together, e.g. by TransformHierarchy, no inverse is taken
+    void SetMatrices(const DirectX::XMMATRIX& modelMatrix, const DirectX::XMMATRIX& normalMatrix) {
+        m_modelMatrix = modelMatrix;
+        m_normalMatrix = normalMatrix;
+    }
+
     void SetMaterial(size_t materialId) {
         m_materialId.x = materialId;
     }
+
+    void SetGeometry(uint32_t startIndex, int32_t baseVertex) {
+        m_materialId.y = startIndex;
+        m_materialId.z = static_cast<uint32_t>(baseVertex);
+    }
 };
@@ -0,0 +1,33 @@
+#ifndef OBJECT_DATA_HLSLI
+#define OBJECT_DATA_HLSLI
+
+struct ModelBuffer
+{
+    matrix modelMatrix;
+    matrix normalMatrix;
+    // x is the material, y is the first index and z the base vertex in GeometryPool
+    uint4 materialId;
+};
+
+// set per draw by IdIndirectCommand
+struct InstanceOffsetBuffer
+{
+    uint instanceOffset;
+};
+
+ConstantBuffer<InstanceOffsetBuffer> InstanceOffsetCB : register(b1);
+StructuredBuffer<ModelBuffer> Objects : register(t0, space1);
+// object ids of instances, every draw owns a range starting at instanceOffset
+StructuredBuffer<uint> Instances : register(t1, space1);
+
+uint GetObjectId(uint instanceId)
+{
+    return Instances[InstanceOffsetCB.instanceOffset + instanceId];
+}
+
+ModelBuffer GetObjectData(uint objectId)
+{
+    return Objects[objectId];
+}
+
+#endif
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <bit>
+#include <deque>
+#include <vector>
+
+#include "CommandQueue.h"
+#include "DirtyRangeList.h"
+#include "DynamicUploadRingBuffer.h"
+#include "GPUResource.h"
+
+// Structured buffer of per-object data, shaders index it with the object id of compact indirect commands.
+// The CPU copy is the source of truth: the GPU buffer is created on the first update,
+// growth creates a bigger one and uploads everything again.
+template <typename ObjectData>
+class ObjectDataBuffer {
+	struct RetiredBuffer {
+		std::shared_ptr<GPUResource> pBuffer{};
+		uint64_t fenceValue{};
+	};
+
+	std::vector<ObjectData> m_objectData{};
+	DirtyRangeList m_dirtyRanges{};
+
+	std::shared_ptr<GPUResource> m_pBuffer{};
+	D3D12_RESOURCE_STATES m_state{ D3D12_RESOURCE_STATE_COPY_DEST };
+	uint32_t m_capacity{};
+	std::deque<RetiredBuffer> m_retiredBuffers{};
+
+public:
+	void SetAt(size_t id, const ObjectData& objectData) {
+		if (id >= m_objectData.size()) {
+			m_objectData.resize(id + 1);
+		}
+		m_objectData[id] = objectData;
+		m_dirtyRanges.Add(id, id + 1);
+	}
+
+	const ObjectData& GetAt(size_t id) const {
+		return m_objectData.at(id);
+	}
+
+	size_t GetSize() const {
+		return m_objectData.size();
+	}
+
+	bool IsCreated() const {
+		return static_cast<bool>(m_pBuffer);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress() const {
+		return m_pBuffer->GetResource()->GetGPUVirtualAddress();
+	}
+
+	// Records the upload of changed objects into a direct list and submits it without waiting
+	void PerformUpdate(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<DynamicUploadHeap> pDynamicUploadHeap,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect
+	) {
+		if (m_dirtyRanges.IsEmpty()) {
+			return;
+		}
+
+		std::shared_ptr<GPUResource> pRetiringBuffer{};
+		if (!m_pBuffer || m_objectData.size() > m_capacity) {
+			pRetiringBuffer = m_pBuffer;
+			m_capacity = std::bit_ceil(static_cast<uint32_t>(m_objectData.size()));
+			m_pBuffer = CreateBuffer(pAllocator, m_capacity);
+			m_state = D3D12_RESOURCE_STATE_COPY_DEST;
+			m_dirtyRanges.Clear();
+			m_dirtyRanges.Add(0, m_objectData.size());
+		}
+
+		std::shared_ptr<CommandList> pCommandListDirect{
+			pCommandQueueDirect->GetCommandList(pDevice)
+		};
+
+		const std::vector<DirtyRangeList::Range>& dirtyRanges{ m_dirtyRanges.Merge(m_objectData.size()) };
+		DynamicAllocation uploadAllocation{
+			pDynamicUploadHeap->Allocate(m_dirtyRanges.GetElementsCount() * sizeof(ObjectData))
+		};
+
+		if (m_state != D3D12_RESOURCE_STATE_COPY_DEST) {
+			ResourceTransition(pCommandListDirect->m_pCommandList, m_pBuffer->GetResource(), m_state, D3D12_RESOURCE_STATE_COPY_DEST);
+		}
+
+		size_t uploadOffset{};
+		for (const DirtyRangeList::Range& range : dirtyRanges) {
+			size_t spanSize{ (range.end - range.begin) * sizeof(ObjectData) };
+			memcpy(
+				static_cast<uint8_t*>(uploadAllocation.cpuAddress) + uploadOffset,
+				m_objectData.data() + range.begin,
+				spanSize
+			);
+			pCommandListDirect->m_pCommandList->CopyBufferRegion(
+				m_pBuffer->GetResource().Get(),
+				range.begin * sizeof(ObjectData),
+				uploadAllocation.pBuffer->GetResource().Get(),
+				uploadAllocation.offset + uploadOffset,
+				spanSize
+			);
+			uploadOffset += spanSize;
+		}
+		m_dirtyRanges.Clear();
+
+		m_state = D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE;
+		ResourceTransition(pCommandListDirect->m_pCommandList, m_pBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, m_state);
+
+		uint64_t fenceValue{ pCommandQueueDirect->ExecuteCommandList(pCommandListDirect) };
+		if (pRetiringBuffer) {
+			m_retiredBuffers.push_back({ pRetiringBuffer, fenceValue });
+		}
+		while (!m_retiredBuffers.empty() && pCommandQueueDirect->IsFenceComplete(m_retiredBuffers.front().fenceValue)) {
+			m_retiredBuffers.pop_front();
+		}
+	}
+
+private:
+	static std::shared_ptr<GPUResource> CreateBuffer(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		uint32_t capacity
+	) {
+		return std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ .heapType{ D3D12_HEAP_TYPE_DEFAULT } },
+			GPUResource::ResourceData{
+				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(capacity * sizeof(ObjectData)) },
+				.resInitState{ D3D12_RESOURCE_STATE_COPY_DEST }
+			}
+		);
+	}
+};
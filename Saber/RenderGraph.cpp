@@ -0,0 +1,635 @@
+#include "RenderGraph.h"
+
+// To avoid conflicts and use only min/max defined in <algorithm>
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+
+#include <algorithm>
+#include <cassert>
+
+RenderGraph::ResourceId RenderGraph::ImportResource(
+	const std::wstring& name,
+	D3D12_RESOURCE_STATES initState,
+	D3D12_RESOURCE_STATES finalState
+) {
+	m_isCompiled = false;
+	m_resources.push_back(Resource{
+		.name{ name },
+		.isTransient{ false },
+		.initState{ initState },
+		.finalState{ finalState }
+	});
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::CreateTransientResource(
+	const std::wstring& name,
+	const D3D12_RESOURCE_DESC& resDesc,
+	const D3D12_CLEAR_VALUE* pClearValue
+) {
+	m_isCompiled = false;
+	m_resources.push_back(Resource{
+		.name{ name },
+		.isTransient{ true },
+		.resDesc{ resDesc },
+		.clearValue{ pClearValue ? *pClearValue : D3D12_CLEAR_VALUE{} },
+		.hasClearValue{ pClearValue != nullptr }
+	});
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::AddPass(
+	const std::wstring& name,
+	std::function<void(PassBuilder&)> setup,
+	ExecuteFunc execute,
+	QueueType queue,
+	bool hasSideEffects
+) {
+	m_isCompiled = false;
+
+	std::vector<Access> accesses{};
+	PassBuilder builder{ accesses };
+	setup(builder);
+
+	// one access per resource: states are combined, any write makes it a write
+	std::vector<Access> merged{};
+	for (const Access& access : accesses) {
+		assert(access.id < m_resources.size());
+		auto it{ std::find_if(merged.begin(), merged.end(), [&](const Access& other) { return other.id == access.id; }) };
+		if (it == merged.end()) {
+			merged.push_back(access);
+		}
+		else {
+			it->state |= access.state;
+			it->isWrite |= access.isWrite;
+		}
+	}
+
+	m_passes.push_back(Pass{
+		.name{ name },
+		.queue{ queue },
+		.hasSideEffects{ hasSideEffects },
+		.accesses{ std::move(merged) },
+		.execute{ execute }
+	});
+	return static_cast<PassId>(m_passes.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::AddChunkedPass(
+	const std::wstring& name,
+	std::function<void(PassBuilder&)> setup,
+	ChunksCountFunc getChunksCount,
+	ChunkExecuteFunc executeChunk,
+	QueueType queue,
+	bool hasSideEffects
+) {
+	PassId passId{ AddPass(name, setup, nullptr, queue, hasSideEffects) };
+	m_passes[passId].getChunksCount = std::move(getChunksCount);
+	m_passes[passId].executeChunk = std::move(executeChunk);
+	return passId;
+}
+
+void RenderGraph::Clear() {
+	m_resources.clear();
+	m_passes.clear();
+	m_executionOrder.clear();
+	m_frameEnd = {};
+	m_placements.clear();
+	m_placementIds.clear();
+	m_memoryStats = {};
+	m_isCompiled = false;
+}
+
+bool RenderGraph::Compile(AllocationInfoFunc getAllocationInfo) {
+	m_executionOrder.clear();
+	m_frameEnd = {};
+	m_placements.clear();
+	m_placementIds.assign(m_resources.size(), InvalidId);
+	m_memoryStats = {};
+
+	std::vector<std::vector<PassId>> dependencies{ BuildDependencies() };
+	std::vector<bool> isAlive{ CullPasses(dependencies) };
+	BuildExecutionOrder(dependencies, isAlive);
+	if (m_executionOrder.empty()) {
+		return false;
+	}
+
+	PlaceTransientResources(getAllocationInfo);
+	BuildBarriers();
+	MoveUnsupportedBarriers();
+	BuildQueueSync();
+
+	m_isCompiled = true;
+	return true;
+}
+
+bool RenderGraph::IsCompiled() const {
+	return m_isCompiled;
+}
+
+const std::vector<RenderGraph::Resource>& RenderGraph::GetResources() const {
+	return m_resources;
+}
+
+const RenderGraph::Resource& RenderGraph::GetResource(ResourceId id) const {
+	return m_resources.at(id);
+}
+
+const std::vector<RenderGraph::Pass>& RenderGraph::GetPasses() const {
+	return m_passes;
+}
+
+const RenderGraph::Pass& RenderGraph::GetPass(PassId id) const {
+	return m_passes.at(id);
+}
+
+const std::vector<RenderGraph::CompiledPass>& RenderGraph::GetExecutionOrder() const {
+	return m_executionOrder;
+}
+
+const RenderGraph::FrameEnd& RenderGraph::GetFrameEnd() const {
+	return m_frameEnd;
+}
+
+const std::vector<RenderGraph::TransientPlacement>& RenderGraph::GetTransientPlacements() const {
+	return m_placements;
+}
+
+const RenderGraph::TransientPlacement* RenderGraph::GetTransientPlacement(ResourceId id) const {
+	if (id >= m_placementIds.size() || m_placementIds[id] == InvalidId) {
+		return nullptr;
+	}
+	return &m_placements[m_placementIds[id]];
+}
+
+const RenderGraph::MemoryStats& RenderGraph::GetMemoryStats() const {
+	return m_memoryStats;
+}
+
+D3D12_RESOURCE_STATES RenderGraph::GetInitialState(ResourceId id) const {
+	const Resource& resource{ m_resources.at(id) };
+	if (!resource.isTransient) {
+		return resource.initState;
+	}
+
+	// transient resources stay in the state of their last use between frames,
+	// so they are created in it and the first pass of the next frame transitions them
+	for (auto it{ m_executionOrder.rbegin() }; it != m_executionOrder.rend(); ++it) {
+		for (const Access& access : m_passes[it->id].accesses) {
+			if (access.id == id) {
+				return access.state;
+			}
+		}
+	}
+	return D3D12_RESOURCE_STATE_COMMON;
+}
+
+bool RenderGraph::IsStateSupportedByQueue(D3D12_RESOURCE_STATES state, QueueType queue) {
+	const D3D12_RESOURCE_STATES graphicsOnlyStates{ static_cast<D3D12_RESOURCE_STATES>(
+		D3D12_RESOURCE_STATE_INDEX_BUFFER
+		| D3D12_RESOURCE_STATE_RENDER_TARGET
+		| D3D12_RESOURCE_STATE_DEPTH_WRITE
+		| D3D12_RESOURCE_STATE_DEPTH_READ
+		| D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+		| D3D12_RESOURCE_STATE_STREAM_OUT
+		| D3D12_RESOURCE_STATE_RESOLVE_DEST
+		| D3D12_RESOURCE_STATE_RESOLVE_SOURCE
+	) };
+	return queue == QueueType::Direct || !(state & graphicsOnlyStates);
+}
+
+std::vector<std::vector<RenderGraph::PassId>> RenderGraph::BuildDependencies() const {
+	struct ResourceTracking {
+		PassId lastWriter{ InvalidId };
+		std::vector<PassId> readers{};
+		std::vector<PassId> readGroupDependencies{};
+		D3D12_RESOURCE_STATES readState{};
+	};
+	std::vector<ResourceTracking> tracking{ m_resources.size() };
+	std::vector<std::vector<PassId>> dependencies{ m_passes.size() };
+
+	// declaration order defines the meaning of the frame,
+	// so every dependency points to a pass declared earlier
+	for (PassId passId{}; passId < m_passes.size(); ++passId) {
+		std::vector<PassId>& passDependencies{ dependencies[passId] };
+
+		for (const Access& access : m_passes[passId].accesses) {
+			ResourceTracking& resTracking{ tracking[access.id] };
+
+			if (resTracking.lastWriter != InvalidId) {
+				passDependencies.push_back(resTracking.lastWriter);
+			}
+
+			if (access.isWrite) {
+				// write after read
+				passDependencies.insert(passDependencies.end(), resTracking.readers.begin(), resTracking.readers.end());
+				resTracking.readers.clear();
+				resTracking.readGroupDependencies.clear();
+				resTracking.lastWriter = passId;
+				continue;
+			}
+
+			// reads in different states need a transition in between, so they can't run together
+			if (!resTracking.readers.empty() && resTracking.readState != access.state) {
+				resTracking.readGroupDependencies = std::move(resTracking.readers);
+				resTracking.readers.clear();
+			}
+			// any reader of the group may end up doing the transition
+			passDependencies.insert(
+				passDependencies.end(),
+				resTracking.readGroupDependencies.begin(),
+				resTracking.readGroupDependencies.end()
+			);
+			resTracking.readState = access.state;
+			resTracking.readers.push_back(passId);
+		}
+
+		std::sort(passDependencies.begin(), passDependencies.end());
+		passDependencies.erase(std::unique(passDependencies.begin(), passDependencies.end()), passDependencies.end());
+		passDependencies.erase(std::remove(passDependencies.begin(), passDependencies.end(), passId), passDependencies.end());
+	}
+
+	return dependencies;
+}
+
+std::vector<bool> RenderGraph::CullPasses(const std::vector<std::vector<PassId>>& dependencies) const {
+	std::vector<bool> isAlive(m_passes.size(), false);
+
+	// passes that write something outside of the graph are roots
+	for (PassId passId{}; passId < m_passes.size(); ++passId) {
+		const Pass& pass{ m_passes[passId] };
+		isAlive[passId] = pass.hasSideEffects || std::any_of(
+			pass.accesses.begin(),
+			pass.accesses.end(),
+			[&](const Access& access) { return access.isWrite && !m_resources[access.id].isTransient; }
+		);
+	}
+
+	// dependencies always point backwards, so a single reverse sweep is enough
+	for (PassId passId{ static_cast<PassId>(m_passes.size()) }; passId-- > 0;) {
+		if (!isAlive[passId]) {
+			continue;
+		}
+		for (PassId dependency : dependencies[passId]) {
+			isAlive[dependency] = true;
+		}
+	}
+
+	return isAlive;
+}
+
+void RenderGraph::BuildExecutionOrder(
+	const std::vector<std::vector<PassId>>& dependencies,
+	const std::vector<bool>& isAlive
+) {
+	std::vector<uint32_t> levels(m_passes.size(), 0);
+	for (PassId passId{}; passId < m_passes.size(); ++passId) {
+		if (!isAlive[passId]) {
+			continue;
+		}
+		for (PassId dependency : dependencies[passId]) {
+			levels[passId] = std::max(levels[passId], levels[dependency] + 1);
+		}
+
+		m_executionOrder.push_back(CompiledPass{
+			.id{ passId },
+			.queue{ m_passes[passId].queue },
+			.level{ levels[passId] },
+			.dependencies{ dependencies[passId] }
+		});
+	}
+
+	// stable, so passes on the same level keep their declaration order
+	std::stable_sort(
+		m_executionOrder.begin(),
+		m_executionOrder.end(),
+		[](const CompiledPass& lhs, const CompiledPass& rhs) { return lhs.level < rhs.level; }
+	);
+}
+
+void RenderGraph::PlaceTransientResources(AllocationInfoFunc getAllocationInfo) {
+	// lifetimes in execution order
+	for (uint32_t orderId{}; orderId < m_executionOrder.size(); ++orderId) {
+		for (const Access& access : m_passes[m_executionOrder[orderId].id].accesses) {
+			if (!m_resources[access.id].isTransient) {
+				continue;
+			}
+
+			if (m_placementIds[access.id] == InvalidId) {
+				D3D12_RESOURCE_ALLOCATION_INFO allocationInfo{ getAllocationInfo(m_resources[access.id].resDesc) };
+				m_placementIds[access.id] = static_cast<uint32_t>(m_placements.size());
+				m_placements.push_back(TransientPlacement{
+					.id{ access.id },
+					.size{ allocationInfo.SizeInBytes },
+					.alignment{ std::max<UINT64>(allocationInfo.Alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) },
+					.firstUse{ orderId },
+					.lastUse{ orderId }
+				});
+			}
+			m_placements[m_placementIds[access.id]].lastUse = orderId;
+		}
+	}
+
+	auto isLifetimeOverlapping = [](const TransientPlacement& lhs, const TransientPlacement& rhs) {
+		return lhs.firstUse <= rhs.lastUse && rhs.firstUse <= lhs.lastUse;
+	};
+	auto isMemoryOverlapping = [](const TransientPlacement& lhs, const TransientPlacement& rhs) {
+		return lhs.offset < rhs.offset + rhs.size && rhs.offset < lhs.offset + lhs.size;
+	};
+
+	// greedy first fit, the biggest resources go first
+	std::vector<uint32_t> order(m_placements.size());
+	for (uint32_t i{}; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return m_placements[lhs].size > m_placements[rhs].size;
+	});
+
+	std::vector<uint32_t> placed{};
+	for (uint32_t placementId : order) {
+		TransientPlacement& placement{ m_placements[placementId] };
+
+		std::vector<UINT64> candidates{ 0 };
+		for (uint32_t otherId : placed) {
+			const TransientPlacement& other{ m_placements[otherId] };
+			if (isLifetimeOverlapping(placement, other)) {
+				UINT64 end{ other.offset + other.size };
+				candidates.push_back((end + placement.alignment - 1) / placement.alignment * placement.alignment);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (UINT64 candidate : candidates) {
+			placement.offset = candidate;
+			bool isFree{ std::none_of(placed.begin(), placed.end(), [&](uint32_t otherId) {
+				const TransientPlacement& other{ m_placements[otherId] };
+				return isLifetimeOverlapping(placement, other) && isMemoryOverlapping(placement, other);
+			}) };
+			if (isFree) {
+				break;
+			}
+		}
+		placed.push_back(placementId);
+
+		m_memoryStats.heapSize = std::max(m_memoryStats.heapSize, placement.offset + placement.size);
+		m_memoryStats.heapAlignment = std::max(m_memoryStats.heapAlignment, placement.alignment);
+		m_memoryStats.unaliasedSize += placement.size;
+	}
+
+	// memory shared with anything (also across frames) has to be activated with an aliasing barrier
+	for (TransientPlacement& placement : m_placements) {
+		placement.isAliased = std::any_of(m_placements.begin(), m_placements.end(), [&](const TransientPlacement& other) {
+			return &other != &placement && isMemoryOverlapping(placement, other);
+		});
+	}
+}
+
+void RenderGraph::BuildBarriers() {
+	std::vector<D3D12_RESOURCE_STATES> states(m_resources.size());
+	std::vector<bool> isUavWritten(m_resources.size(), false);
+	for (ResourceId id{}; id < m_resources.size(); ++id) {
+		states[id] = GetInitialState(id);
+	}
+
+	for (uint32_t orderId{}; orderId < m_executionOrder.size(); ++orderId) {
+		CompiledPass& compiledPass{ m_executionOrder[orderId] };
+		std::vector<Barrier>& barriers{ compiledPass.barriers };
+
+		for (const TransientPlacement& placement : m_placements) {
+			if (placement.firstUse == orderId && placement.isAliased) {
+				barriers.push_back(Barrier{
+					.type{ Barrier::Type::Aliasing },
+					.id{ placement.id }
+				});
+			}
+		}
+
+		for (const Access& access : m_passes[compiledPass.id].accesses) {
+			if (states[access.id] != access.state) {
+				barriers.push_back(Barrier{
+					.type{ Barrier::Type::Transition },
+					.id{ access.id },
+					.stateBefore{ states[access.id] },
+					.stateAfter{ access.state }
+				});
+				states[access.id] = access.state;
+			}
+			else if (isUavWritten[access.id] && (access.state & D3D12_RESOURCE_STATE_UNORDERED_ACCESS)) {
+				barriers.push_back(Barrier{
+					.type{ Barrier::Type::Uav },
+					.id{ access.id }
+				});
+			}
+			isUavWritten[access.id] = access.isWrite && (access.state & D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+	}
+
+	for (ResourceId id{}; id < m_resources.size(); ++id) {
+		const Resource& resource{ m_resources[id] };
+		if (!resource.isTransient && states[id] != resource.finalState) {
+			m_frameEnd.barriers.push_back(Barrier{
+				.type{ Barrier::Type::Transition },
+				.id{ id },
+				.stateBefore{ states[id] },
+				.stateAfter{ resource.finalState }
+			});
+		}
+	}
+}
+
+void RenderGraph::MoveUnsupportedBarriers() {
+	uint32_t lastDirectOrderId{ InvalidId };
+
+	for (uint32_t orderId{}; orderId < m_executionOrder.size(); ++orderId) {
+		CompiledPass& compiledPass{ m_executionOrder[orderId] };
+		if (compiledPass.queue == QueueType::Direct) {
+			lastDirectOrderId = orderId;
+			continue;
+		}
+
+		std::vector<Barrier> supported{};
+		std::vector<Barrier> unsupported{};
+		for (const Barrier& barrier : compiledPass.barriers) {
+			bool isSupported{
+				barrier.type != Barrier::Type::Transition
+				|| (IsStateSupportedByQueue(barrier.stateBefore, compiledPass.queue)
+					&& IsStateSupportedByQueue(barrier.stateAfter, compiledPass.queue))
+			};
+			(isSupported ? supported : unsupported).push_back(barrier);
+		}
+		if (unsupported.empty()) {
+			continue;
+		}
+
+		// the resource is in a graphics state, so some direct pass used it before
+		assert(lastDirectOrderId != InvalidId);
+		if (lastDirectOrderId == InvalidId) {
+			continue;
+		}
+
+		// resources have to be active for a transition, so the activation moves too
+		for (auto it{ supported.begin() }; it != supported.end();) {
+			bool isActivationOfMoved{
+				it->type == Barrier::Type::Aliasing
+				&& std::any_of(unsupported.begin(), unsupported.end(), [&](const Barrier& barrier) { return barrier.id == it->id; })
+			};
+			if (isActivationOfMoved) {
+				unsupported.insert(unsupported.begin(), *it);
+				it = supported.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		std::vector<Barrier>& barriersAfter{ m_executionOrder[lastDirectOrderId].barriersAfter };
+		barriersAfter.insert(barriersAfter.end(), unsupported.begin(), unsupported.end());
+		compiledPass.barriers = std::move(supported);
+		compiledPass.waits.push_back(lastDirectOrderId);
+	}
+}
+
+void RenderGraph::BuildQueueSync() {
+	constexpr size_t queueCount{ 2 };
+	auto queueId = [](QueueType queue) { return static_cast<size_t>(queue); };
+
+	std::vector<uint32_t> orderIds(m_passes.size(), InvalidId);
+	for (uint32_t orderId{}; orderId < m_executionOrder.size(); ++orderId) {
+		orderIds[m_executionOrder[orderId].id] = orderId;
+	}
+
+	// the latest pass of one queue another one has already waited for,
+	// everything before it on that queue is covered by the same wait
+	uint32_t waited[queueCount][queueCount]{};
+	for (auto& row : waited) {
+		std::fill(std::begin(row), std::end(row), InvalidId);
+	}
+	auto addWaits = [&](QueueType queue, const std::vector<uint32_t>& candidates) {
+		std::vector<uint32_t> waits{};
+		uint32_t latest[queueCount]{ InvalidId, InvalidId };
+		for (uint32_t candidate : candidates) {
+			size_t otherQueue{ queueId(m_executionOrder[candidate].queue) };
+			if (otherQueue != queueId(queue) && (latest[otherQueue] == InvalidId || candidate > latest[otherQueue])) {
+				latest[otherQueue] = candidate;
+			}
+		}
+		for (size_t otherQueue{}; otherQueue < queueCount; ++otherQueue) {
+			uint32_t& alreadyWaited{ waited[queueId(queue)][otherQueue] };
+			if (latest[otherQueue] == InvalidId || (alreadyWaited != InvalidId && latest[otherQueue] <= alreadyWaited)) {
+				continue;
+			}
+			alreadyWaited = latest[otherQueue];
+			m_executionOrder[latest[otherQueue]].isSignaling = true;
+			waits.push_back(latest[otherQueue]);
+		}
+		return waits;
+	};
+
+	// resources the direct queue touches during the frame
+	std::vector<bool> isUsedByDirect(m_resources.size(), false);
+	for (const CompiledPass& compiledPass : m_executionOrder) {
+		if (compiledPass.queue != QueueType::Direct) {
+			continue;
+		}
+		for (const Access& access : m_passes[compiledPass.id].accesses) {
+			isUsedByDirect[access.id] = true;
+		}
+		for (const Barrier& barrier : compiledPass.barriersAfter) {
+			isUsedByDirect[barrier.id] = true;
+		}
+	}
+	for (const Barrier& barrier : m_frameEnd.barriers) {
+		isUsedByDirect[barrier.id] = true;
+	}
+
+	bool isComputeSynced{};
+	for (CompiledPass& compiledPass : m_executionOrder) {
+		std::vector<uint32_t> candidates{ compiledPass.waits };
+		for (PassId dependency : compiledPass.dependencies) {
+			candidates.push_back(orderIds[dependency]);
+		}
+		compiledPass.waits = addWaits(compiledPass.queue, candidates);
+
+		if (compiledPass.queue != QueueType::Compute || isComputeSynced) {
+			continue;
+		}
+
+		// the direct queue runs frames in order and its frame end joins the compute queue,
+		// compute has to catch up with the previous frame only until it waits for this one
+		isComputeSynced = waited[queueId(QueueType::Compute)][queueId(QueueType::Direct)] != InvalidId;
+		if (!isComputeSynced) {
+			compiledPass.isWaitingPreviousFrame = std::any_of(
+				m_passes[compiledPass.id].accesses.begin(),
+				m_passes[compiledPass.id].accesses.end(),
+				[&](const Access& access) { return isUsedByDirect[access.id]; }
+			);
+			isComputeSynced = compiledPass.isWaitingPreviousFrame;
+		}
+	}
+
+	// frame end waits for everything left on the compute queue
+	std::vector<uint32_t> lastPasses{};
+	for (uint32_t orderId{}; orderId < m_executionOrder.size(); ++orderId) {
+		if (m_executionOrder[orderId].queue == QueueType::Compute) {
+			lastPasses.assign(1, orderId);
+		}
+	}
+	m_frameEnd.waits = addWaits(QueueType::Direct, lastPasses);
+}
+
+std::vector<RenderGraph::SimulatedPass> RenderGraph::SimulateTimeline(
+	const std::vector<double>& passCosts,
+	uint32_t frameCount
+) const {
+	assert(m_isCompiled);
+
+	std::vector<SimulatedPass> timeline{};
+	double queueTime[2]{};
+	double previousFrameEnd{};
+
+	for (uint32_t frame{}; frame < frameCount; ++frame) {
+		size_t frameBegin{ timeline.size() };
+		auto waitFor = [&](double start, const std::vector<uint32_t>& waits) {
+			for (uint32_t orderId : waits) {
+				start = std::max(start, timeline[frameBegin + orderId].end);
+			}
+			return start;
+		};
+
+		for (const CompiledPass& compiledPass : m_executionOrder) {
+			double& time{ queueTime[static_cast<size_t>(compiledPass.queue)] };
+			double start{ waitFor(time, compiledPass.waits) };
+			if (compiledPass.isWaitingPreviousFrame) {
+				start = std::max(start, previousFrameEnd);
+			}
+			double cost{ compiledPass.id < passCosts.size() ? passCosts[compiledPass.id] : 0.0 };
+
+			time = start + cost;
+			timeline.push_back(SimulatedPass{
+				.id{ compiledPass.id },
+				.frame{ frame },
+				.queue{ compiledPass.queue },
+				.start{ start },
+				.end{ time }
+			});
+		}
+
+		double& directTime{ queueTime[static_cast<size_t>(QueueType::Direct)] };
+		directTime = waitFor(directTime, m_frameEnd.waits);
+		previousFrameEnd = directTime;
+		timeline.push_back(SimulatedPass{
+			.frame{ frame },
+			.queue{ QueueType::Direct },
+			.start{ directTime },
+			.end{ directTime }
+		});
+	}
+
+	return timeline;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+// The graph itself is device independent: it only stores declarations and
+// compiles them into an ordered list of passes with their barriers and
+// a memory layout for transient resources. Nothing here touches ID3D12Device,
+// so the compilation can be run and inspected without a GPU.
+// RenderGraphExecutor does the D3D12 part.
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+class RenderGraph {
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+	static constexpr uint32_t InvalidId{ std::numeric_limits<uint32_t>::max() };
+
+	enum class QueueType {
+		Direct,
+		Compute
+	};
+
+	struct Resource {
+		std::wstring name{};
+		bool isTransient{};
+
+		// imported: state the resource is in when the frame starts and has to be returned to
+		D3D12_RESOURCE_STATES initState{ D3D12_RESOURCE_STATE_COMMON };
+		D3D12_RESOURCE_STATES finalState{ D3D12_RESOURCE_STATE_COMMON };
+
+		// transient
+		D3D12_RESOURCE_DESC resDesc{};
+		D3D12_CLEAR_VALUE clearValue{};
+		bool hasClearValue{};
+	};
+
+	struct Access {
+		ResourceId id{ InvalidId };
+		D3D12_RESOURCE_STATES state{};
+		bool isWrite{};
+	};
+
+	class PassBuilder {
+		std::vector<Access>& m_accesses;
+
+	public:
+		PassBuilder(std::vector<Access>& accesses) : m_accesses(accesses) {}
+
+		void Read(ResourceId id, D3D12_RESOURCE_STATES state) {
+			m_accesses.push_back({ id, state, false });
+		}
+		void Write(ResourceId id, D3D12_RESOURCE_STATES state) {
+			m_accesses.push_back({ id, state, true });
+		}
+	};
+
+	using ExecuteFunc = std::function<void(ID3D12GraphicsCommandList2* pCommandList)>;
+	// records the chunkId-th of chunksCount contiguous parts of a pass
+	using ChunkExecuteFunc = std::function<void(ID3D12GraphicsCommandList2* pCommandList, uint32_t chunkId, uint32_t chunksCount)>;
+	// asked every frame before the pass is recorded, 0 counts as 1
+	using ChunksCountFunc = std::function<uint32_t()>;
+
+	struct Pass {
+		std::wstring name{};
+		QueueType queue{};
+		bool hasSideEffects{};
+		std::vector<Access> accesses{};
+		ExecuteFunc execute{};
+		// chunked passes have these instead of execute
+		ChunksCountFunc getChunksCount{};
+		ChunkExecuteFunc executeChunk{};
+	};
+
+	struct Barrier {
+		enum class Type {
+			Transition,
+			Aliasing,
+			Uav
+		};
+		Type type{};
+		ResourceId id{ InvalidId };
+		D3D12_RESOURCE_STATES stateBefore{};
+		D3D12_RESOURCE_STATES stateAfter{};
+	};
+
+	struct CompiledPass {
+		PassId id{ InvalidId };
+		QueueType queue{};
+		// passes with the same level don't depend on each other
+		uint32_t level{};
+		std::vector<PassId> dependencies{};
+		std::vector<Barrier> barriers{};
+		// transitions the compute queue can't do, recorded at the end of the preceding direct pass
+		std::vector<Barrier> barriersAfter{};
+
+		// cross-queue sync on GPU: indices into execution order of passes on the other queue to wait for
+		std::vector<uint32_t> waits{};
+		bool isSignaling{};
+		// compute work that touches resources of the direct queue waits for the end of the previous frame
+		bool isWaitingPreviousFrame{};
+	};
+
+	// End of frame on the direct queue: joins the compute queue and returns imported resources to their final state
+	struct FrameEnd {
+		std::vector<uint32_t> waits{};
+		std::vector<Barrier> barriers{};
+	};
+
+	struct SimulatedPass {
+		// InvalidId for the frame end
+		PassId id{ InvalidId };
+		uint32_t frame{};
+		QueueType queue{};
+		double start{};
+		double end{};
+	};
+
+	struct TransientPlacement {
+		ResourceId id{ InvalidId };
+		UINT64 offset{};
+		UINT64 size{};
+		UINT64 alignment{};
+		// indices into execution order
+		uint32_t firstUse{ InvalidId };
+		uint32_t lastUse{};
+		bool isAliased{};
+	};
+
+	struct MemoryStats {
+		UINT64 heapSize{};
+		UINT64 heapAlignment{};
+		// what the transient resources would take without aliasing
+		UINT64 unaliasedSize{};
+	};
+
+	// returns size and alignment of a transient resource, normally ID3D12Device::GetResourceAllocationInfo
+	using AllocationInfoFunc = std::function<D3D12_RESOURCE_ALLOCATION_INFO(const D3D12_RESOURCE_DESC&)>;
+
+private:
+	std::vector<Resource> m_resources{};
+	std::vector<Pass> m_passes{};
+
+	bool m_isCompiled{};
+	std::vector<CompiledPass> m_executionOrder{};
+	FrameEnd m_frameEnd{};
+	std::vector<TransientPlacement> m_placements{};
+	std::vector<uint32_t> m_placementIds{};
+	MemoryStats m_memoryStats{};
+
+public:
+	ResourceId ImportResource(
+		const std::wstring& name,
+		D3D12_RESOURCE_STATES initState,
+		D3D12_RESOURCE_STATES finalState
+	);
+	ResourceId CreateTransientResource(
+		const std::wstring& name,
+		const D3D12_RESOURCE_DESC& resDesc,
+		const D3D12_CLEAR_VALUE* pClearValue = nullptr
+	);
+
+	PassId AddPass(
+		const std::wstring& name,
+		std::function<void(PassBuilder&)> setup,
+		ExecuteFunc execute,
+		QueueType queue = QueueType::Direct,
+		bool hasSideEffects = false
+	);
+
+	// For passes with much recording work: every chunk is recorded by its own job into its own list.
+	// The lists are submitted in chunk order as one pass, the barriers go before the first chunk
+	// and the cross-queue sync around all of them. The graph compiles it like any other pass.
+	PassId AddChunkedPass(
+		const std::wstring& name,
+		std::function<void(PassBuilder&)> setup,
+		ChunksCountFunc getChunksCount,
+		ChunkExecuteFunc executeChunk,
+		QueueType queue = QueueType::Direct,
+		bool hasSideEffects = false
+	);
+
+	void Clear();
+
+	// Orders passes, culls the ones nobody consumes, places barriers
+	// and packs transient resources with non-overlapping lifetimes into one heap
+	bool Compile(AllocationInfoFunc getAllocationInfo);
+
+	bool IsCompiled() const;
+
+	const std::vector<Resource>& GetResources() const;
+	const Resource& GetResource(ResourceId id) const;
+	const std::vector<Pass>& GetPasses() const;
+	const Pass& GetPass(PassId id) const;
+
+	const std::vector<CompiledPass>& GetExecutionOrder() const;
+	const FrameEnd& GetFrameEnd() const;
+	const std::vector<TransientPlacement>& GetTransientPlacements() const;
+	const TransientPlacement* GetTransientPlacement(ResourceId id) const;
+	const MemoryStats& GetMemoryStats() const;
+
+	// state a resource is in when the first pass using it starts
+	D3D12_RESOURCE_STATES GetInitialState(ResourceId id) const;
+
+	static bool IsStateSupportedByQueue(D3D12_RESOURCE_STATES state, QueueType queue);
+
+	// Replays the compiled schedule for several frames on an idealized GPU:
+	// passes on one queue run in order, a wait delays a pass until the awaited pass ends.
+	// passCosts are indexed by PassId.
+	std::vector<SimulatedPass> SimulateTimeline(const std::vector<double>& passCosts, uint32_t frameCount) const;
+
+private:
+	std::vector<std::vector<PassId>> BuildDependencies() const;
+	std::vector<bool> CullPasses(const std::vector<std::vector<PassId>>& dependencies) const;
+	void BuildExecutionOrder(const std::vector<std::vector<PassId>>& dependencies, const std::vector<bool>& isAlive);
+	void BuildBarriers();
+	void MoveUnsupportedBarriers();
+	void BuildQueueSync();
+	void PlaceTransientResources(AllocationInfoFunc getAllocationInfo);
+};
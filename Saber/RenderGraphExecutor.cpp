@@ -0,0 +1,272 @@
+#include "RenderGraphExecutor.h"
+
+#include "pix3.h"
+
+RenderGraph::AllocationInfoFunc RenderGraphExecutor::GetAllocationInfoFunc(Microsoft::WRL::ComPtr<ID3D12Device2> pDevice) {
+	return [pDevice](const D3D12_RESOURCE_DESC& resDesc) {
+		return pDevice->GetResourceAllocationInfo(0, 1, &resDesc);
+	};
+}
+
+void RenderGraphExecutor::Realize(
+	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+	Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+	const RenderGraph& graph
+) {
+	assert(graph.IsCompiled());
+
+	m_pResources.clear();
+	m_pResources.resize(graph.GetResources().size());
+	m_pAllocations.clear();
+	m_pHeapAllocation.Reset();
+
+	const std::vector<RenderGraph::TransientPlacement>& placements{ graph.GetTransientPlacements() };
+	if (placements.empty()) {
+		return;
+	}
+
+	// heap tier 1 keeps buffers, render targets and other textures in separate heaps
+	bool hasBuffers{}, hasRtDsTextures{}, hasOtherTextures{};
+	for (const RenderGraph::TransientPlacement& placement : placements) {
+		const D3D12_RESOURCE_DESC& resDesc{ graph.GetResource(placement.id).resDesc };
+		if (resDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+			hasBuffers = true;
+		}
+		else if (resDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) {
+			hasRtDsTextures = true;
+		}
+		else {
+			hasOtherTextures = true;
+		}
+	}
+	bool isSingleCategory{ (hasBuffers + hasRtDsTextures + hasOtherTextures) == 1 };
+	bool isAliasingSupported{
+		isSingleCategory || pAllocator->GetD3D12Options().ResourceHeapTier >= D3D12_RESOURCE_HEAP_TIER_2
+	};
+
+	if (!isAliasingSupported) {
+		for (const RenderGraph::TransientPlacement& placement : placements) {
+			const RenderGraph::Resource& resource{ graph.GetResource(placement.id) };
+			D3D12MA::ALLOCATION_DESC allocationDesc{ .HeapType{ D3D12_HEAP_TYPE_DEFAULT } };
+
+			Microsoft::WRL::ComPtr<D3D12MA::Allocation> pAllocation{};
+			ThrowIfFailed(pAllocator->CreateResource(
+				&allocationDesc,
+				&resource.resDesc,
+				graph.GetInitialState(placement.id),
+				resource.hasClearValue ? &resource.clearValue : nullptr,
+				&pAllocation,
+				IID_NULL,
+				nullptr
+			));
+			m_pResources[placement.id] = pAllocation->GetResource();
+			m_pResources[placement.id]->SetName(resource.name.c_str());
+			m_pAllocations.push_back(pAllocation);
+		}
+		return;
+	}
+
+	D3D12_HEAP_FLAGS heapFlags{ D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES };
+	if (isSingleCategory) {
+		heapFlags = hasBuffers ? D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS
+			: hasRtDsTextures ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+			: D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+	}
+
+	const RenderGraph::MemoryStats& memoryStats{ graph.GetMemoryStats() };
+	D3D12MA::ALLOCATION_DESC allocationDesc{
+		.HeapType{ D3D12_HEAP_TYPE_DEFAULT },
+		.ExtraHeapFlags{ heapFlags }
+	};
+	D3D12_RESOURCE_ALLOCATION_INFO allocationInfo{
+		.SizeInBytes{ memoryStats.heapSize },
+		.Alignment{ memoryStats.heapAlignment }
+	};
+	ThrowIfFailed(pAllocator->AllocateMemory(&allocationDesc, &allocationInfo, &m_pHeapAllocation));
+
+	for (const RenderGraph::TransientPlacement& placement : placements) {
+		const RenderGraph::Resource& resource{ graph.GetResource(placement.id) };
+		ThrowIfFailed(pAllocator->CreateAliasingResource(
+			m_pHeapAllocation.Get(),
+			placement.offset,
+			&resource.resDesc,
+			graph.GetInitialState(placement.id),
+			resource.hasClearValue ? &resource.clearValue : nullptr,
+			IID_PPV_ARGS(&m_pResources[placement.id])
+		));
+		m_pResources[placement.id]->SetName(resource.name.c_str());
+	}
+}
+
+void RenderGraphExecutor::SetImportedResource(RenderGraph::ResourceId id, Microsoft::WRL::ComPtr<ID3D12Resource> pResource) {
+	if (id >= m_pResources.size()) {
+		m_pResources.resize(id + 1);
+	}
+	m_pResources[id] = pResource;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> RenderGraphExecutor::GetResource(RenderGraph::ResourceId id) const {
+	return m_pResources.at(id);
+}
+
+void RenderGraphExecutor::Execute(
+	Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+	std::shared_ptr<CommandQueue> pCommandQueueDirect,
+	std::shared_ptr<CommandQueue> pCommandQueueCompute,
+	std::shared_ptr<JobSystem<>> pJobSystem,
+	const RenderGraph& graph,
+	uint8_t basePriority
+) {
+	assert(graph.IsCompiled());
+
+	for (Microsoft::WRL::ComPtr<ID3D12Fence>& pFence : m_pFences) {
+		if (!pFence) {
+			ThrowIfFailed(pDevice->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&pFence)));
+		}
+	}
+
+	const std::vector<RenderGraph::CompiledPass>& executionOrder{ graph.GetExecutionOrder() };
+	assert(basePriority + executionOrder.size() < std::numeric_limits<uint8_t>::max());
+
+	// fence value signaled after the pass with the given execution index
+	uint64_t frameBaseValue{ m_fenceValue };
+	uint64_t frameEndValue{ frameBaseValue + executionOrder.size() + 1 };
+	uint64_t previousFrameEndValue{ m_previousFrameEndValue };
+	m_fenceValue = frameEndValue;
+	m_previousFrameEndValue = frameEndValue;
+
+	auto getQueue = [&](RenderGraph::QueueType queue) {
+		return queue == RenderGraph::QueueType::Direct ? pCommandQueueDirect : pCommandQueueCompute;
+	};
+	auto waitOnGpu = [this, &executionOrder, frameBaseValue](std::shared_ptr<CommandQueue> pQueue, const std::vector<uint32_t>& waits) {
+		for (uint32_t orderId : waits) {
+			ID3D12Fence* pFence{ m_pFences[static_cast<size_t>(executionOrder[orderId].queue)].Get() };
+			ThrowIfFailed(pQueue->GetD3D12CommandQueue()->Wait(pFence, frameBaseValue + orderId + 1));
+		}
+	};
+
+	for (size_t orderId{}; orderId < executionOrder.size(); ++orderId) {
+		const RenderGraph::CompiledPass& compiledPass{ executionOrder[orderId] };
+		const RenderGraph::Pass& pass{ graph.GetPass(compiledPass.id) };
+		std::shared_ptr<CommandQueue> pQueue{ getQueue(compiledPass.queue) };
+		ID3D12Fence* pFence{ m_pFences[static_cast<size_t>(compiledPass.queue)].Get() };
+		ID3D12Fence* pDirectFence{ m_pFences[static_cast<size_t>(RenderGraph::QueueType::Direct)].Get() };
+
+		// the waits go before the first chunk and the signal after the last one
+		uint32_t chunksCount{ pass.getChunksCount ? std::max(pass.getChunksCount(), 1u) : 1 };
+		for (uint32_t chunkId{}; chunkId < chunksCount; ++chunkId) {
+			bool isFirstChunk{ chunkId == 0 };
+			bool isLastChunk{ chunkId + 1 == chunksCount };
+
+			std::shared_ptr<CommandList> pCommandList{ pQueue->GetCommandList(
+				pDevice,
+				true,
+				static_cast<uint8_t>(basePriority + orderId),
+				[=, &compiledPass]() {
+					if (!isFirstChunk) {
+						return;
+					}
+					if (compiledPass.isWaitingPreviousFrame && previousFrameEndValue) {
+						ThrowIfFailed(pQueue->GetD3D12CommandQueue()->Wait(pDirectFence, previousFrameEndValue));
+					}
+					waitOnGpu(pQueue, compiledPass.waits);
+				},
+				[=, &compiledPass]() {
+					if (isLastChunk && compiledPass.isSignaling) {
+						ThrowIfFailed(pQueue->GetD3D12CommandQueue()->Signal(pFence, frameBaseValue + orderId + 1));
+					}
+				},
+				chunkId
+			) };
+
+			// barriers are known after compilation, so every pass and chunk can be recorded independently
+			pJobSystem->AddJob([this, &graph, &compiledPass, &pass, pCommandList, chunkId, chunksCount, isFirstChunk, isLastChunk]() {
+				ID3D12GraphicsCommandList2* pD3D12CommandList{ pCommandList->m_pCommandList.Get() };
+				{
+					PIXScopedEvent(pD3D12CommandList, PIX_COLOR(0, 0, 0), pass.name.c_str());
+					if (isFirstChunk) {
+						RecordBarriers(pD3D12CommandList, graph, compiledPass.barriers);
+					}
+					if (pass.executeChunk) {
+						pass.executeChunk(pD3D12CommandList, chunkId, chunksCount);
+					}
+					else if (pass.execute) {
+						pass.execute(pD3D12CommandList);
+					}
+				}
+				if (isLastChunk) {
+					RecordBarriers(pD3D12CommandList, graph, compiledPass.barriersAfter);
+				}
+				pCommandList->SetReadyForExection();
+			});
+		}
+	}
+
+	// frame end: joins the compute queue, so the direct queue fence covers the whole frame
+	const RenderGraph::FrameEnd& frameEnd{ graph.GetFrameEnd() };
+	ID3D12Fence* pDirectFence{ m_pFences[static_cast<size_t>(RenderGraph::QueueType::Direct)].Get() };
+	std::shared_ptr<CommandList> pCommandListFrameEnd{ pCommandQueueDirect->GetCommandList(
+		pDevice,
+		true,
+		static_cast<uint8_t>(basePriority + executionOrder.size()),
+		[=, &frameEnd]() { waitOnGpu(pCommandQueueDirect, frameEnd.waits); },
+		[=]() { ThrowIfFailed(pCommandQueueDirect->GetD3D12CommandQueue()->Signal(pDirectFence, frameEndValue)); }
+	) };
+	RecordBarriers(pCommandListFrameEnd->m_pCommandList.Get(), graph, frameEnd.barriers);
+	pCommandListFrameEnd->SetReadyForExection();
+}
+
+void RenderGraphExecutor::RecordBarriers(
+	ID3D12GraphicsCommandList2* pCommandList,
+	const RenderGraph& graph,
+	const std::vector<RenderGraph::Barrier>& barriers
+) const {
+	if (barriers.empty()) {
+		return;
+	}
+
+	std::vector<D3D12_RESOURCE_BARRIER> d3d12Barriers{};
+	std::vector<ID3D12Resource*> pDiscardResources{};
+	d3d12Barriers.reserve(barriers.size());
+
+	for (const RenderGraph::Barrier& barrier : barriers) {
+		ID3D12Resource* pResource{ m_pResources[barrier.id].Get() };
+		assert(pResource);
+
+		switch (barrier.type) {
+		case RenderGraph::Barrier::Type::Transition:
+			d3d12Barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(pResource, barrier.stateBefore, barrier.stateAfter));
+			break;
+		case RenderGraph::Barrier::Type::Uav:
+			d3d12Barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(pResource));
+			break;
+		case RenderGraph::Barrier::Type::Aliasing: {
+			d3d12Barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, pResource));
+
+			// activated render targets, depth buffers and uav textures have undefined content
+			// and need a discard or a clear before use
+			const D3D12_RESOURCE_DESC& resDesc{ graph.GetResource(barrier.id).resDesc };
+			D3D12_RESOURCE_STATES state{ graph.GetInitialState(barrier.id) };
+			for (const RenderGraph::Barrier& other : barriers) {
+				if (other.type == RenderGraph::Barrier::Type::Transition && other.id == barrier.id) {
+					state = other.stateAfter;
+				}
+			}
+			bool isDiscardable{
+				(resDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET && state == D3D12_RESOURCE_STATE_RENDER_TARGET)
+				|| (resDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL && state == D3D12_RESOURCE_STATE_DEPTH_WRITE)
+				|| (resDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS && state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+			};
+			if (resDesc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && isDiscardable) {
+				pDiscardResources.push_back(pResource);
+			}
+			break;
+		}
+		}
+	}
+
+	pCommandList->ResourceBarrier(static_cast<UINT>(d3d12Barriers.size()), d3d12Barriers.data());
+	for (ID3D12Resource* pResource : pDiscardResources) {
+		pCommandList->DiscardResource(pResource, nullptr);
+	}
+}
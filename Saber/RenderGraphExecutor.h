@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <vector>
+
+#include "D3D12MemAlloc.h"
+
+#include "CommandQueue.h"
+#include "JobSystem.h"
+#include "RenderGraph.h"
+
+class RenderGraphExecutor {
+	// one heap for all transient resources, they are placed at offsets computed by the graph
+	Microsoft::WRL::ComPtr<D3D12MA::Allocation> m_pHeapAllocation{};
+	// used instead of the heap when the device can't mix resource categories in one heap
+	std::vector<Microsoft::WRL::ComPtr<D3D12MA::Allocation>> m_pAllocations{};
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_pResources{};
+
+	// Cross-queue sync fences, one per queue type. Values are assigned on the CPU while the frame
+	// is recorded, so a queue can wait for work that is submitted later to the other one.
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_pFences[2]{};
+	uint64_t m_fenceValue{};
+	uint64_t m_previousFrameEndValue{};
+
+public:
+	// returns size and alignment the graph needs for placing transient resources
+	static RenderGraph::AllocationInfoFunc GetAllocationInfoFunc(Microsoft::WRL::ComPtr<ID3D12Device2> pDevice);
+
+	// Creates transient resources for a compiled graph. Imported ones have to be set with SetImportedResource.
+	void Realize(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		const RenderGraph& graph
+	);
+
+	void SetImportedResource(RenderGraph::ResourceId id, Microsoft::WRL::ComPtr<ID3D12Resource> pResource);
+	Microsoft::WRL::ComPtr<ID3D12Resource> GetResource(RenderGraph::ResourceId id) const;
+
+	// Every pass is recorded by its own job into its own deferred command list of its queue,
+	// chunked passes by a job and a list per chunk, with the same priority and ordered by chunk.
+	// Priorities follow the execution order, so the lists are submitted in the right order
+	// by CommandQueue::ExecutionTask of both queues, which also waits for the jobs to finish.
+	// Queues are synchronized on GPU only, the frame ends on the direct queue after the compute work.
+	void Execute(
+		Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect,
+		std::shared_ptr<CommandQueue> pCommandQueueCompute,
+		std::shared_ptr<JobSystem<>> pJobSystem,
+		const RenderGraph& graph,
+		uint8_t basePriority = 0
+	);
+
+private:
+	void RecordBarriers(
+		ID3D12GraphicsCommandList2* pCommandList,
+		const RenderGraph& graph,
+		const std::vector<RenderGraph::Barrier>& barriers
+	) const;
+};
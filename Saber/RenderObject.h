@@ -4,14 +4,18 @@
 
 #include "Headers.h"
 
+#include <DirectXCollision.h>
+
 #include <filesystem>
 #include <initializer_list>
+#include <limits>
 
 #include "Atlas.h"
 #include "CommandQueue.h"
 #include "ConstantBuffer.h"
 #include "IndirectCommand.h"
 #include "Mesh.h"
+#include "ModelBuffers.h"
 #include "PSOLibrary.h"
 #include "Resources.h"
 #include "Vertices.h"
@@ -28,6 +32,8 @@ protected:
     RenderObject(RenderObject&&) = default;
 
 public:
+    virtual ~RenderObject() = default;
+
     struct RootSignatureData {
         std::shared_ptr<Atlas<RootSignatureResource>> pRootSignatureAtlas{};
         Microsoft::WRL::ComPtr<ID3DBlob> pRootSignatureBlob{};
@@ -51,6 +57,17 @@ public:
 
     virtual void FillIndirectCommand(CbMeshIndirectCommand& indirectCommand) {}
     virtual void FillIndirectCommand(CbMesh4IndirectCommand& indirectCommand) {}
+    // object id is set by the render subsystem
+    virtual void FillIndirectCommand(IdIndirectCommand& indirectCommand) {}
+    virtual void FillObjectData(ModelBuffer& objectData) const {}
+    // world and normal matrices of the transform node the object is attached to
+    virtual void SetWorldMatrices(DirectX::FXMMATRIX worldMatrix, DirectX::CXMMATRIX normalMatrix) {}
+    // world space bounds, objects without them are never culled
+    virtual DirectX::BoundingSphere GetBoundingSphere() const {
+        return DirectX::BoundingSphere{ {}, std::numeric_limits<float>::infinity() };
+    }
+    // binds shared geometry once for all objects of a subsystem
+    virtual void BindGeometry(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) const {}
 
 	virtual void Render(
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
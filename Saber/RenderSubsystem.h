@@ -2,51 +2,401 @@
 
 #include "Headers.h"
 
+#include <sstream>
+#include <unordered_map>
+
+#include "CullingData.h"
+#include "DrawSorting.h"
+#include "FrustumCulling.h"
+#include "CulledCommandBuffer.h"
 #include "IndirectCommand.h"
 #include "IndirectCommandBuffer.h"
+#include "JobSystem.h"
 #include "RenderObject.h"
 #include "MeshRenderObject.h"
 #include "ModelBuffers.h"
+#include "ObjectDataBuffer.h"
 #include "SeparateChainingMap.h"
+#include "SoftwareOcclusion.h"
+#include "StreamedObjectDataBuffer.h"
 
 template <typename IndirectCommand>
 class RenderSubsystem {
+public:
+	// Stays valid while the object is in the subsystem, even if it is moved to another command slot.
+	// The generation detects handles to removed objects whose slot was reused.
+	struct Handle {
+		uint32_t slotId{ std::numeric_limits<uint32_t>::max() };
+		uint32_t generation{};
+	};
+
+private:
+	struct Slot {
+		uint32_t objectId{};
+		uint32_t generation{};
+		// instancing only
+		uint32_t groupId{};
+		uint32_t instanceId{};
+	};
+
+	// the state fields of the object's draw key, the depth is added when sorting
+	struct DrawState {
+		uint32_t pipelineId{};
+		uint32_t materialId{};
+	};
+
+	// Objects with the same geometry are drawn by one instanced command. The group owns
+	// a range of m_instanceBuffer with slot ids of its instances, which index m_objectDataBuffer.
+	// Slot ids don't change when objects are moved, so only the touched entries are uploaded.
+	struct InstanceGroup {
+		D3D12_DRAW_INDEXED_ARGUMENTS drawArguments{};
+		std::vector<uint32_t> slotIds{};
+		uint32_t base{};
+		uint32_t capacity{};
+		// instances that passed the last culling, they are written to the start of the range
+		uint32_t visibleCount{};
+	};
+
+	static constexpr bool m_isInstanced{ requires { IndirectCommand::instancesRootParameterIndex; } };
+
 	std::wstring m_name{};
+	// the pass field of the draw keys
+	uint32_t m_passId{};
+	// Owns the objects, only touched when they are added, updated and for the pipeline state of the first one.
+	// Per-frame work reads the arrays parallel to it and the object data buffer, which hold everything it needs.
 	std::vector<std::shared_ptr<RenderObject>> m_objects{};
+	// parallel to m_objects
+	std::vector<uint32_t> m_objectSlotIds{};
+	// parallel to m_objects, filled by the object once when it is added,
+	// with instancing only the draw arguments are used to find the group
+	std::vector<IndirectCommand> m_objectCommands{};
+	// parallel to m_objects
+	std::vector<DrawState> m_objectDrawStates{};
+	// small ids of the pipeline states for the draw keys, in the order they were first added
+	std::unordered_map<ID3D12PipelineState*, uint32_t> m_pipelineIds{};
+	std::vector<Slot> m_slots{};
+	std::vector<uint32_t> m_freeSlotIds{};
+	// parallel to m_objects
+	FrustumCulling::BoundingSpheres m_boundingSpheres{};
+	std::vector<uint32_t> m_visibleObjectIds{};
+	// parallel to m_visibleObjectIds
+	std::vector<DrawSorting::DrawKey> m_drawKeys{};
+	std::vector<uint32_t> m_groupVisibleCounts{};
+	bool m_isCulled{};
+	// slot ids end up in per-pixel ids in the visibility mode, which only have room for so many
+	uint32_t m_maxSlotsCount{ std::numeric_limits<uint32_t>::max() };
 	std::mutex m_objectsMutex{};
 
+	// with instancing commands are indexed by group id, otherwise by object id
 	std::shared_ptr<IndirectCommandBuffer<IndirectCommand>> m_pIndirectCommandBuffer{};
+	// Commands on the GPU after the last update. Recording chunks are cut from them, so every chunk
+	// of a frame sees the same count while objects are added meanwhile.
+	uint32_t m_frameCommandsCount{};
+	// above that many commands the recording is split into chunks, up to CULLING_MAX_CHUNKS_COUNT of them
+	static constexpr uint32_t m_recordingChunkSize{ 4096 };
+
+	std::vector<InstanceGroup> m_groups{};
+	std::unordered_map<uint64_t, uint32_t> m_groupIds{};
+	std::vector<uint32_t> m_freeGroupIds{};
+	// ranges of relocated and emptied groups are reclaimed by compaction
+	uint32_t m_instancesEnd{};
+	uint32_t m_instancesGarbage{};
+	ObjectDataBuffer<uint32_t> m_instanceBuffer{};
+	ObjectDataBuffer<ModelBuffer> m_objectDataBuffer{};
+	// objects moved every frame read their data from upload memory instead
+	StreamedObjectDataBuffer<ModelBuffer> m_streamedObjectDataBuffer{};
+	bool m_isObjectDataStreamed{};
+	std::shared_ptr<DynamicUploadHeap> m_pDynamicUploadHeap{};
+
+	// With a culler the commands and instances are culled on the GPU right before drawing,
+	// the CPU only keeps the bounds buffer (indexed by slot id) up to date.
+	// The early and late phases are recorded into different lists, so each has its own output.
+	std::shared_ptr<ComputeObject> m_pIndirectCuller{};
+	ObjectDataBuffer<ObjectBounds> m_objectBoundsBuffer{};
+	GpuCulling::CulledCommandBuffer m_culledCommandBuffers[2]{};
+	GpuCulling::VisibilityBuffer m_visibilityBuffer{};
+	FrustumCulling::Frustum m_frustum{};
+	DirectX::XMFLOAT4X4 m_viewProjection{};
 
 public:
-	RenderSubsystem(const std::wstring& name) : m_name(name) {
+	RenderSubsystem(const std::wstring& name, bool isObjectDataStreamed = false, uint32_t passId = 0)
+		: m_name(name), m_passId(passId), m_isObjectDataStreamed(isObjectDataStreamed) {
 		IndirectCommandBase<IndirectCommand>::Assert();
 	}
 
-	void Add(std::shared_ptr<RenderObject> pObject) {
+	Handle Add(std::shared_ptr<RenderObject> pObject) {
 		std::scoped_lock<std::mutex> lock(m_objectsMutex);
 		if (!m_objects.empty()) {
 			//assert(pObject->GetPipelineState() == m_objects.front()->GetPipelineState());
 		}
+
+		uint32_t slotId{};
+		if (!m_freeSlotIds.empty()) {
+			slotId = m_freeSlotIds.back();
+			m_freeSlotIds.pop_back();
+		}
+		else {
+			if (m_slots.size() >= m_maxSlotsCount) {
+				std::stringstream ss{};
+				ss << "RenderSubsystem: more than " << m_maxSlotsCount << " objects";
+				throw std::runtime_error(ss.str());
+			}
+			slotId = static_cast<uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+		}
+		m_slots[slotId].objectId = static_cast<uint32_t>(m_objects.size());
+
 		m_objects.push_back(pObject);
+		m_objectSlotIds.push_back(slotId);
+		pObject->FillIndirectCommand(m_objectCommands.emplace_back());
+		m_objectDrawStates.push_back(MakeDrawState(*pObject));
+		m_boundingSpheres.PushBack(pObject->GetBoundingSphere());
+		if constexpr (m_isInstanced) {
+			WriteObjectData(m_objects.size() - 1);
+			AddInstance(slotId);
+		}
+		else if (m_pIndirectCommandBuffer) {
+			m_pIndirectCommandBuffer->SetUpdateAt(m_objects.size() - 1, MakeIndirectCommand(m_objects.size() - 1));
+		}
+
+		return Handle{ slotId, m_slots[slotId].generation };
+	}
+
+	// The last object takes the place of the removed one, so only its command has to be patched.
+	// With instancing the same is done inside the instance group.
+	bool Remove(Handle handle) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		if (!IsValidImpl(handle)) {
+			return false;
+		}
+
+		if constexpr (m_isInstanced) {
+			RemoveInstance(handle.slotId);
+		}
+
+		uint32_t objectId{ m_slots[handle.slotId].objectId };
+		uint32_t lastObjectId{ static_cast<uint32_t>(m_objects.size() - 1) };
+		if (objectId != lastObjectId) {
+			m_objects[objectId] = std::move(m_objects[lastObjectId]);
+			m_objectSlotIds[objectId] = m_objectSlotIds[lastObjectId];
+			m_objectCommands[objectId] = m_objectCommands[lastObjectId];
+			m_objectDrawStates[objectId] = m_objectDrawStates[lastObjectId];
+			m_slots[m_objectSlotIds[objectId]].objectId = objectId;
+
+			if (!m_isInstanced && m_pIndirectCommandBuffer) {
+				m_pIndirectCommandBuffer->SetUpdateAt(objectId, MakeIndirectCommand(objectId));
+			}
+		}
+		m_objects.pop_back();
+		m_objectSlotIds.pop_back();
+		m_objectCommands.pop_back();
+		m_objectDrawStates.pop_back();
+		m_boundingSpheres.SwapRemove(objectId);
+
+		++m_slots[handle.slotId].generation;
+		m_freeSlotIds.push_back(handle.slotId);
+
+		if (!m_isInstanced && m_pIndirectCommandBuffer) {
+			m_pIndirectCommandBuffer->SetSize(static_cast<uint32_t>(m_objects.size()));
+		}
+		return true;
+	}
+
+	// Uploads the object data again and refreshes the bounds, e.g. after the model matrix has changed.
+	// Only instanced subsystems keep object data.
+	bool Update(Handle handle) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		if (!IsValidImpl(handle)) {
+			return false;
+		}
+		uint32_t objectId{ m_slots[handle.slotId].objectId };
+		m_boundingSpheres.SetAt(objectId, m_objects[objectId]->GetBoundingSphere());
+		m_objectDrawStates[objectId] = MakeDrawState(*m_objects[objectId]);
+		if constexpr (m_isInstanced) {
+			WriteObjectData(objectId);
+		}
+		return true;
+	}
+
+	// Writes the visible instances of every group to the start of its range and draws only them.
+	// Unchanged instances and commands aren't uploaded again, so a still camera costs no uploads.
+	// Subsystems without instancing keep drawing everything, with a GPU culler the camera is kept for Render.
+	// Objects in the frustum are also tested against the occlusion buffer when there is one.
+	// Visible instances are sorted by draw key, so every group draws them by state and front to back.
+	void Cull(
+		const FrustumCulling::Frustum& frustum,
+		DirectX::FXMMATRIX viewProjection,
+		JobSystem<>& jobSystem,
+		const SoftwareOcclusion::OcclusionBuffer* pOcclusionBuffer = nullptr
+	) {
+		if constexpr (m_isInstanced) {
+			std::scoped_lock<std::mutex> lock(m_objectsMutex);
+			m_frustum = frustum;
+			DirectX::XMStoreFloat4x4(&m_viewProjection, viewProjection);
+			if (m_pIndirectCuller) {
+				return;
+			}
+			m_isCulled = true;
+			FrustumCulling::CullParallel(frustum, m_boundingSpheres, jobSystem, m_visibleObjectIds);
+			if (pOcclusionBuffer) {
+				pOcclusionBuffer->RemoveOccluded(m_boundingSpheres, jobSystem, m_visibleObjectIds);
+			}
+			SortVisibleObjects(jobSystem);
+
+			m_groupVisibleCounts.assign(m_groups.size(), 0);
+			for (uint32_t objectId : m_visibleObjectIds) {
+				uint32_t slotId{ m_objectSlotIds[objectId] };
+				uint32_t groupId{ m_slots[slotId].groupId };
+				size_t instanceId{ m_groups[groupId].base + m_groupVisibleCounts[groupId]++ };
+				if (instanceId >= m_instanceBuffer.GetSize() || m_instanceBuffer.GetAt(instanceId) != slotId) {
+					m_instanceBuffer.SetAt(instanceId, slotId);
+				}
+			}
+			for (uint32_t groupId{}; groupId < m_groups.size(); ++groupId) {
+				if (m_groups[groupId].visibleCount != m_groupVisibleCounts[groupId]) {
+					m_groups[groupId].visibleCount = m_groupVisibleCounts[groupId];
+					WriteGroupCommand(groupId);
+				}
+			}
+		}
+	}
+
+	// Add throws once that many objects are in, slots of removed objects are reused first
+	void SetMaxSlotsCount(uint32_t maxSlotsCount) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		m_maxSlotsCount = maxSlotsCount;
+	}
+
+	// How many chunks Render should be called for this frame, each can be recorded into its own list
+	uint32_t GetRecordingChunksCount() {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		return std::clamp<uint32_t>(
+			(m_frameCommandsCount + m_recordingChunkSize - 1) / m_recordingChunkSize,
+			1,
+			CULLING_MAX_CHUNKS_COUNT
+		);
+	}
+
+	// lets the indirect buffer grow ahead of a large batch of Add calls
+	void Reserve(
+		uint32_t capacity,
+		const typename IndirectCommandBuffer<IndirectCommand>::GrowthPolicy& growthPolicy = {}
+	) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
 		if (m_pIndirectCommandBuffer) {
-			IndirectCommand indirectCommand;
-			pObject->FillIndirectCommand(indirectCommand);
-			m_pIndirectCommandBuffer->SetUpdateAt(m_objects.size() - 1, indirectCommand);
+			m_pIndirectCommandBuffer->SetGrowthPolicy(growthPolicy);
+			m_pIndirectCommandBuffer->Reserve(capacity);
 		}
 	}
 
+	bool IsValid(Handle handle) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		return IsValidImpl(handle);
+	}
+
+	std::shared_ptr<RenderObject> Get(Handle handle) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		return IsValidImpl(handle) ? m_objects[m_slots[handle.slotId].objectId] : nullptr;
+	}
+
+	size_t GetSize() {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		return m_objects.size();
+	}
+
+	// Object data indexed by the object ids the shaders get, 0 before it is created.
+	// Streamed data moves to another copy when it changes, so the address holds for the current frame only.
+	D3D12_GPU_VIRTUAL_ADDRESS GetObjectDataAddress() {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
+		if (m_isObjectDataStreamed) {
+			return m_streamedObjectDataBuffer.IsCreated() ? m_streamedObjectDataBuffer.GetGpuAddress() : 0;
+		}
+		return m_objectDataBuffer.IsCreated() ? m_objectDataBuffer.GetGpuAddress() : 0;
+	}
+
+	// Subsystems without a GPU culler draw everything in the frustum or early phase and nothing in the late one.
+	// With chunks every call draws one contiguous range of the commands and sets the whole draw state,
+	// so the chunks can be recorded into different lists at once. They have to be submitted in chunk order,
+	// the GPU culling is recorded with the first one.
 	void Render(
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
-		const std::function<void()>& commandListPrepare
+		const std::function<void()>& commandListPrepare,
+		GpuCulling::Phase phase = GpuCulling::Phase::Frustum,
+		const GpuCulling::HzbView& hzbView = {},
+		uint32_t chunkId = 0,
+		uint32_t chunksCount = 1
 	) {
 		std::scoped_lock<std::mutex> lock(m_objectsMutex);
-		if (m_objects.empty()) {
+		if (m_objects.empty() || (phase == GpuCulling::Phase::Late && !m_pIndirectCuller)) {
 			return;
 		}
+		GpuCulling::CulledCommandBuffer& culledCommandBuffer{ m_culledCommandBuffers[phase == GpuCulling::Phase::Late ? 1 : 0] };
+		if constexpr (m_isInstanced) {
+			bool isObjectDataCreated{
+				m_isObjectDataStreamed ? m_streamedObjectDataBuffer.IsCreated() : m_objectDataBuffer.IsCreated()
+			};
+			if (!m_instanceBuffer.IsCreated() || !isObjectDataCreated) {
+				return;
+			}
+			if (m_pIndirectCuller
+				&& (!m_objectBoundsBuffer.IsCreated() || !culledCommandBuffer.IsCreated() || !m_visibilityBuffer.IsCreated())
+			) {
+				return;
+			}
+		}
+
+		// the dispatch changes the pipeline state, so it goes before the draw state is set
+		if constexpr (m_isInstanced) {
+			if (m_pIndirectCuller && chunkId == 0) {
+				culledCommandBuffer.RecordCulling(
+					pCommandList,
+					m_pIndirectCuller,
+					GpuCulling::MakeCullingConstants(m_frustum, m_viewProjection, m_frameCommandsCount, phase, hzbView, chunksCount),
+					m_pIndirectCommandBuffer->GetGpuAddress(),
+					m_instanceBuffer.GetGpuAddress(),
+					m_objectBoundsBuffer.GetGpuAddress(),
+					m_visibilityBuffer,
+					hzbView
+				);
+			}
+		}
 
 		m_objects.front()->SetPipelineStateAndRootSignature(pCommandList);
+		m_objects.front()->BindGeometry(pCommandList);
 		commandListPrepare();
-		m_pIndirectCommandBuffer->Execute(pCommandList);
+		if constexpr (m_isInstanced) {
+			pCommandList->SetGraphicsRootShaderResourceView(
+				IndirectCommand::objectDataRootParameterIndex,
+				m_isObjectDataStreamed ? m_streamedObjectDataBuffer.GetGpuAddress() : m_objectDataBuffer.GetGpuAddress()
+			);
+			pCommandList->SetGraphicsRootShaderResourceView(
+				IndirectCommand::instancesRootParameterIndex,
+				m_pIndirectCuller ? culledCommandBuffer.GetVisibleInstancesAddress() : m_instanceBuffer.GetGpuAddress()
+			);
+			if (m_pIndirectCuller) {
+				culledCommandBuffer.Execute(
+					pCommandList,
+					m_pIndirectCommandBuffer->GetCommandSignature(),
+					m_frameCommandsCount,
+					chunkId,
+					chunksCount
+				);
+				return;
+			}
+		}
+		if (chunksCount == 1) {
+			m_pIndirectCommandBuffer->Execute(pCommandList);
+			return;
+		}
+		uint32_t commandsPerChunk{ GpuCulling::GetCommandsPerChunk(m_frameCommandsCount, chunksCount) };
+		uint32_t firstCommand{ chunkId * commandsPerChunk };
+		if (firstCommand < m_frameCommandsCount) {
+			m_pIndirectCommandBuffer->Execute(
+				pCommandList,
+				firstCommand,
+				std::min(commandsPerChunk, m_frameCommandsCount - firstCommand)
+			);
+		}
 	}
 
 	bool InitializeIndirectCommandBuffer(
@@ -54,13 +404,19 @@ public:
 		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
 		std::shared_ptr<DescriptorHeapManager> pDescHeapManagerCbvSrvUav,
 		std::shared_ptr<DynamicUploadHeap> pDynamicUploadHeap,
-		std::shared_ptr<ComputeObject> pIndirectUpdater = nullptr
+		std::shared_ptr<ComputeObject> pIndirectUpdater = nullptr,
+		std::shared_ptr<ComputeObject> pIndirectCuller = nullptr
 	) {
 		std::scoped_lock<std::mutex> lock(m_objectsMutex);
 		if (m_objects.empty()) {
 			return false;
 		}
 
+		m_pDynamicUploadHeap = pDynamicUploadHeap;
+		if constexpr (m_isInstanced) {
+			m_pIndirectCuller = pIndirectCuller;
+		}
+		size_t commandsCount{ m_isInstanced ? m_groups.size() : m_objects.size() };
 		if (pIndirectUpdater) {
 			m_pIndirectCommandBuffer = std::make_shared<
 				DynamicIndirectCommandBuffer<IndirectCommand>
@@ -71,7 +427,7 @@ public:
 				m_objects.front()->GetRootSignature(),
 				pDescHeapManagerCbvSrvUav,
 				m_name + L"IndirectBuffer",
-				m_objects.size(),
+				commandsCount,
 				pDynamicUploadHeap,
 				pIndirectUpdater
 			);
@@ -86,16 +442,22 @@ public:
 				m_objects.front()->GetRootSignature(),
 				pDescHeapManagerCbvSrvUav,
 				m_name + L"IndirectBuffer",
-				m_objects.size(),
+				commandsCount,
 				pDynamicUploadHeap
 			);
 		}
 
-		for (size_t i{}; i < m_objects.size(); ++i) {
-			IndirectCommand indirectCommand;
-			m_objects[i]->FillIndirectCommand(indirectCommand);
-			m_pIndirectCommandBuffer->SetUpdateAt(i, indirectCommand);
+		// object commands are already contiguous, group commands are built from the group array
+		std::vector<IndirectCommand> groupCommands{};
+		IndirectCommand* pIndirectCommands{ m_objectCommands.data() };
+		if constexpr (m_isInstanced) {
+			groupCommands.resize(commandsCount);
+			for (size_t i{}; i < commandsCount; ++i) {
+				groupCommands[i] = MakeIndirectCommand(i);
+			}
+			pIndirectCommands = groupCommands.data();
 		}
+		m_pIndirectCommandBuffer->SetUpdateAll(pIndirectCommands, commandsCount);
 
 		return true;
 	}
@@ -106,15 +468,211 @@ public:
 		std::shared_ptr<CommandQueue> pCommandQueueCopy,
 		std::shared_ptr<CommandQueue> pCommandQueueDirect
 	) {
+		std::scoped_lock<std::mutex> lock(m_objectsMutex);
 		if (!m_pIndirectCommandBuffer) {
 			return false;
 		}
+		if constexpr (m_isInstanced) {
+			if (m_isObjectDataStreamed) {
+				m_streamedObjectDataBuffer.PerformUpdate(pAllocator, pCommandQueueDirect);
+			}
+			else {
+				m_objectDataBuffer.PerformUpdate(pDevice, pAllocator, m_pDynamicUploadHeap, pCommandQueueDirect);
+			}
+			m_instanceBuffer.PerformUpdate(pDevice, pAllocator, m_pDynamicUploadHeap, pCommandQueueDirect);
+			if (m_pIndirectCuller) {
+				m_objectBoundsBuffer.PerformUpdate(pDevice, pAllocator, m_pDynamicUploadHeap, pCommandQueueDirect);
+			}
+		}
 		m_pIndirectCommandBuffer->PerformUpdate(
 			pDevice,
 			pAllocator,
 			pCommandQueueCopy,
 			pCommandQueueDirect
 		);
+		m_frameCommandsCount = m_pIndirectCommandBuffer->GetSize();
+		if (m_pIndirectCuller) {
+			for (GpuCulling::CulledCommandBuffer& culledCommandBuffer : m_culledCommandBuffers) {
+				culledCommandBuffer.Reserve(pAllocator, pCommandQueueDirect, m_pIndirectCommandBuffer->GetSize(), m_instancesEnd);
+			}
+			m_visibilityBuffer.Reserve(pAllocator, pCommandQueueDirect, static_cast<uint32_t>(m_slots.size()));
+		}
 		return true;
 	}
+
+private:
+	bool IsValidImpl(Handle handle) const {
+		return handle.slotId < m_slots.size() && m_slots[handle.slotId].generation == handle.generation;
+	}
+
+	IndirectCommand MakeIndirectCommand(size_t commandId) const {
+		IndirectCommand indirectCommand{};
+		if constexpr (m_isInstanced) {
+			const InstanceGroup& group{ m_groups[commandId] };
+			indirectCommand.instanceOffset = group.base;
+			indirectCommand.drawArguments = group.drawArguments;
+			// removals since the last culling may leave fewer instances than were visible
+			indirectCommand.drawArguments.InstanceCount = m_isCulled
+				? std::min(group.visibleCount, static_cast<uint32_t>(group.slotIds.size()))
+				: static_cast<uint32_t>(group.slotIds.size());
+		}
+		else {
+			indirectCommand = m_objectCommands[commandId];
+		}
+		return indirectCommand;
+	}
+
+	DrawState MakeDrawState(const RenderObject& object) {
+		ModelBuffer objectData{};
+		object.FillObjectData(objectData);
+		auto [it, isInserted]{
+			m_pipelineIds.try_emplace(object.GetPipelineState().Get(), static_cast<uint32_t>(m_pipelineIds.size()))
+		};
+		return DrawState{ .pipelineId{ it->second }, .materialId{ objectData.m_materialId.x } };
+	}
+
+	void WriteObjectData(size_t objectId) {
+		ModelBuffer objectData{};
+		m_objects[objectId]->FillObjectData(objectData);
+		if (m_isObjectDataStreamed) {
+			m_streamedObjectDataBuffer.SetAt(m_objectSlotIds[objectId], objectData);
+		}
+		else {
+			m_objectDataBuffer.SetAt(m_objectSlotIds[objectId], objectData);
+		}
+
+		DirectX::BoundingSphere boundingSphere{ m_objects[objectId]->GetBoundingSphere() };
+		m_objectBoundsBuffer.SetAt(m_objectSlotIds[objectId], ObjectBounds{
+			.sphere{ boundingSphere.Center.x, boundingSphere.Center.y, boundingSphere.Center.z, boundingSphere.Radius }
+		});
+	}
+
+	// The whole subsystem is one pass and pipeline state, the group stands in for the pipeline field
+	// so instances of a group stay together. Materials are indexed in shaders and don't change state.
+	// Keys of large subsystems are built in chunks by the job system workers.
+	void SortVisibleObjects(JobSystem<>& jobSystem) {
+		static constexpr size_t keysChunkSize{ 16 * 1024 };
+
+		size_t visibleCount{ m_visibleObjectIds.size() };
+		m_drawKeys.resize(visibleCount);
+		auto makeKeys{ [this, visibleCount](size_t chunkId) {
+			const float* pCentersX{ m_boundingSpheres.GetCentersX() };
+			const float* pCentersY{ m_boundingSpheres.GetCentersY() };
+			const float* pCentersZ{ m_boundingSpheres.GetCentersZ() };
+			size_t end{ std::min((chunkId + 1) * keysChunkSize, visibleCount) };
+			for (size_t i{ chunkId * keysChunkSize }; i < end; ++i) {
+				uint32_t objectId{ m_visibleObjectIds[i] };
+				// clip space w of the center
+				float viewDepth{
+					pCentersX[objectId] * m_viewProjection._14 + pCentersY[objectId] * m_viewProjection._24
+						+ pCentersZ[objectId] * m_viewProjection._34 + m_viewProjection._44
+				};
+				const DrawState& drawState{ m_objectDrawStates[objectId] };
+				m_drawKeys[i] = DrawSorting::MakeDrawKey(m_passId, drawState.pipelineId, drawState.materialId, viewDepth);
+			}
+		} };
+		size_t chunksCount{ (visibleCount + keysChunkSize - 1) / keysChunkSize };
+		if (chunksCount > 1) {
+			jobSystem.RunAndWait(chunksCount, makeKeys);
+		}
+		else {
+			makeKeys(0);
+		}
+		DrawSorting::RadixSort(m_drawKeys, m_visibleObjectIds, &jobSystem);
+	}
+
+	void WriteGroupCommand(uint32_t groupId) {
+		if (m_pIndirectCommandBuffer) {
+			m_pIndirectCommandBuffer->SetUpdateAt(groupId, MakeIndirectCommand(groupId));
+		}
+	}
+
+	// geometry allocations don't overlap, so the first index and base vertex identify the mesh
+	static uint64_t GetGroupKey(const D3D12_DRAW_INDEXED_ARGUMENTS& drawArguments) {
+		return static_cast<uint64_t>(drawArguments.StartIndexLocation) << 32
+			| static_cast<uint32_t>(drawArguments.BaseVertexLocation);
+	}
+
+	void AddInstance(uint32_t slotId) {
+		const IndirectCommand& indirectCommand{ m_objectCommands[m_slots[slotId].objectId] };
+
+		auto [it, isInserted] { m_groupIds.try_emplace(GetGroupKey(indirectCommand.drawArguments)) };
+		if (isInserted) {
+			if (!m_freeGroupIds.empty()) {
+				it->second = m_freeGroupIds.back();
+				m_freeGroupIds.pop_back();
+			}
+			else {
+				it->second = static_cast<uint32_t>(m_groups.size());
+				m_groups.emplace_back();
+			}
+			m_groups[it->second].drawArguments = indirectCommand.drawArguments;
+		}
+		uint32_t groupId{ it->second };
+		assert(m_groups[groupId].drawArguments.IndexCountPerInstance == indirectCommand.drawArguments.IndexCountPerInstance);
+
+		if (m_groups[groupId].slotIds.size() == m_groups[groupId].capacity) {
+			RelocateGroup(groupId, std::max(m_groups[groupId].capacity * 2, 1u));
+		}
+
+		InstanceGroup& group{ m_groups[groupId] };
+		m_slots[slotId].groupId = groupId;
+		m_slots[slotId].instanceId = static_cast<uint32_t>(group.slotIds.size());
+		group.slotIds.push_back(slotId);
+		m_instanceBuffer.SetAt(group.base + m_slots[slotId].instanceId, slotId);
+
+		WriteGroupCommand(groupId);
+	}
+
+	void RemoveInstance(uint32_t slotId) {
+		const Slot& slot{ m_slots[slotId] };
+		InstanceGroup& group{ m_groups[slot.groupId] };
+
+		uint32_t lastSlotId{ group.slotIds.back() };
+		group.slotIds[slot.instanceId] = lastSlotId;
+		m_slots[lastSlotId].instanceId = slot.instanceId;
+		m_instanceBuffer.SetAt(group.base + slot.instanceId, lastSlotId);
+		group.slotIds.pop_back();
+
+		// an empty group stays as a command with zero instances until its id is reused
+		if (group.slotIds.empty()) {
+			m_groupIds.erase(GetGroupKey(group.drawArguments));
+			m_freeGroupIds.push_back(slot.groupId);
+			m_instancesGarbage += group.capacity;
+			group.capacity = 0;
+			group.visibleCount = 0;
+		}
+
+		WriteGroupCommand(slot.groupId);
+	}
+
+	// moves a full group to the end of the instance buffer
+	void RelocateGroup(uint32_t groupId, uint32_t capacity) {
+		InstanceGroup& group{ m_groups[groupId] };
+		m_instancesGarbage += group.capacity;
+		group.base = m_instancesEnd;
+		group.capacity = capacity;
+		m_instancesEnd += capacity;
+		for (size_t i{}; i < group.slotIds.size(); ++i) {
+			m_instanceBuffer.SetAt(group.base + i, group.slotIds[i]);
+		}
+
+		if (m_instancesGarbage > m_instancesEnd / 2) {
+			CompactInstances();
+		}
+	}
+
+	void CompactInstances() {
+		m_instancesEnd = 0;
+		m_instancesGarbage = 0;
+		for (uint32_t groupId{}; groupId < m_groups.size(); ++groupId) {
+			InstanceGroup& group{ m_groups[groupId] };
+			group.base = m_instancesEnd;
+			m_instancesEnd += group.capacity;
+			for (size_t i{}; i < group.slotIds.size(); ++i) {
+				m_instanceBuffer.SetAt(group.base + i, group.slotIds[i]);
+			}
+			WriteGroupCommand(groupId);
+		}
+	}
 };
@@ -1,14 +1,17 @@
 #include "Renderer.h"
 
 #include <cassert>
-#include <random>
 #include <string>  
 #include <iostream> 
 #include <sstream>
+#include <map>
+#include <optional>
+#include <tuple>
 
 #include "pix3.h"
+#include "SceneFile.h"
 
-Renderer::Renderer(std::shared_ptr<JobSystem<>> pJobSystem, uint8_t backBuffersCnt, bool isUseWarp, uint32_t resWidth, uint32_t resHeight, bool isUseVSync)
+Renderer::Renderer(std::shared_ptr<JobSystem<>> pJobSystem, uint8_t backBuffersCnt, bool isUseWarp, uint32_t resWidth, uint32_t resHeight, bool isUseVSync, bool isUseVisibilityBuffer)
     : m_useWarp(isUseWarp)
     , m_clientWidth(resWidth)
     , m_clientHeight(resHeight)
@@ -16,6 +19,7 @@ Renderer::Renderer(std::shared_ptr<JobSystem<>> pJobSystem, uint8_t backBuffersC
     , m_isTearingSupported(CheckTearingSupport())
     , m_time(m_clock.now())
     , m_viewport(CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(resWidth), static_cast<float>(resHeight)))
+    , m_gBufferLayout(isUseVisibilityBuffer ? GBuffer::Layout::Visibility : GBuffer::Layout::Attributes)
     , m_pMeshAtlas(std::make_shared<Atlas<Mesh>>(L""))
     , m_pShaderAtlas(std::make_shared<Atlas<ShaderResource>>(L""))
     , m_pRootSignatureAtlas(std::make_shared<Atlas<RootSignatureResource>>(L""))
@@ -25,6 +29,7 @@ Renderer::Renderer(std::shared_ptr<JobSystem<>> pJobSystem, uint8_t backBuffersC
 }
 
 Renderer::~Renderer() {
+    m_loaderJobSystem.StopRunning();
     m_pBackBuffersDescHeapRange.reset();
     m_pScenes.clear();
     m_pGBuffers.clear();
@@ -55,7 +60,7 @@ void Renderer::Initialize(HWND hWnd) {
         L"DescHeapManagerRtv",
         m_pDevice,
         D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-        m_numFrames + GBuffer::GetSize() - 1
+        m_numFrames + GBuffer::GetSize(m_gBufferLayout) - 1
     );
     m_pBackBuffersDescHeapRange = m_pRtvDescHeapManager->AllocateRange(L"BackBuffersRange", m_numFrames);
 
@@ -105,15 +110,23 @@ void Renderer::Initialize(HWND hWnd) {
         m_pRtvDescHeapManager,
         m_pResourceDescHeapManager,
         m_clientWidth,
-        m_clientHeight
+        m_clientHeight,
+        true,
+        m_gBufferLayout
     );
 
+    BuildRenderGraph();
+
     m_pMaterialManager = std::make_shared<MaterialManager>(
         L"../../Resources/Textures/",
         m_pDevice,
         m_pAllocator,
         m_pResourceDescHeapManager, 1024
 	);
+    m_pGeometryPool = std::make_shared<GeometryPool>(m_pAllocator, m_pCommandQueueDirect);
+    if (m_gBufferLayout == GBuffer::Layout::Visibility) {
+        m_pGeometryPool->SetMaxTriangleCount(VISIBILITY_MAX_TRIANGLES);
+    }
 
 	const size_t RingBufferDefaultSize{ 1024 };
     m_pRingBuffers.resize(RingBufferId::Count);
@@ -136,227 +149,273 @@ void Renderer::Initialize(HWND hWnd) {
 
     m_isInitialized = true;
 
-    // CreateCbMeshUpdater scenes
-    {
-        m_pScenes.resize(4);
+    // scenes are built when they are needed, the first one once the job system is running
+    m_pScenes.resize(4);
+    m_sceneStates.resize(m_pScenes.size(), SceneState::Unloaded);
+    m_sceneLastFrameIds.resize(m_pScenes.size());
+    PreloadScene(m_nextSceneId.load());
+    m_pPSOLibrary->FlushCacheToFile();
+}
 
-        // 0
-        m_pScenes[0] = std::make_unique<Scene>(
-            L"0",
-            m_pAllocator,
-            m_pRingBuffers[RingBufferId::Cpu],
-            m_pRingBuffers[RingBufferId::Gpu],
-            m_pDepthBuffers[0],
-            m_pGBuffers[0]
-        );
+void Renderer::LoadSceneFile(size_t sceneId, const std::filesystem::path& filepath) {
+    using Clock = std::chrono::high_resolution_clock;
+    struct LoadState {
+        std::unique_ptr<Scene> pScene{};
+        SceneFile::Description description{};
+        // per object, the object it's cloned from
+        std::vector<std::shared_ptr<MeshRenderObject<ModelBuffer>>> pPrototypes{};
+        Clock::time_point startTime{};
+        Clock::time_point parsedTime{};
+        Clock::time_point assetsTime{};
+        // objects the render subsystems rejected
+        std::atomic<size_t> skippedObjectsCount{};
+    };
 
-        // 1
-        {
-            std::unique_ptr<Scene>& pScene{ m_pScenes[1] };
-            pScene = std::make_unique<Scene>(
-                L"1",
+    auto load{ [this, sceneId, filepath]() {
+        std::shared_ptr<LoadState> pState{ std::make_shared<LoadState>() };
+        pState->startTime = Clock::now();
+        try {
+            pState->description = SceneFile::Load(filepath);
+        }
+        catch (const std::exception& e) {
+            OutputDebugStringA((std::string("Scene loading failed: ") + e.what() + "\n").c_str());
+            std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+            m_sceneStates[sceneId] = SceneState::Unloaded;
+            return;
+        }
+        pState->parsedTime = Clock::now();
+        const SceneFile::Description& description{ pState->description };
+
+        // meshes and materials are loaded once, everything else only copies references to them
+        try {
+            std::lock_guard<std::mutex> assetsLock(m_assetsMutex);
+            pState->pScene = std::make_unique<Scene>(
+                std::to_wstring(sceneId),
                 m_pAllocator,
                 m_pRingBuffers[RingBufferId::Cpu],
                 m_pRingBuffers[RingBufferId::Gpu],
                 m_pDepthBuffers[0],
                 m_pGBuffers[0]
             );
-            pScene->SetPostProcessing(CopyPostProcessing::Create(
-                m_pDevice,
-                m_pMeshAtlas,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            pScene->SetDeferredShadingComputeObject(DeferredShading::CreateDefferedShadingComputeObject(
-                m_pDevice,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            pScene->AddStaticObject(TestTextureRenderObject::CreateTextureCube(
-                m_pDevice,
-                m_pAllocator,
-                m_pCommandQueueCopy,
-                m_pCommandQueueDirect,
-                m_pMeshAtlas,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary,
-                m_pGBuffers[0],
-                m_pMaterialManager,
-                DirectX::XMMatrixIdentity()
-            ));
+            // 0 is left empty
+            if (sceneId > 0) {
+                pState->pScene->SetPostProcessing(CopyPostProcessing::Create(
+                    m_pDevice,
+                    m_pMeshAtlas,
+                    m_pShaderAtlas,
+                    m_pRootSignatureAtlas,
+                    m_pPSOLibrary
+                ));
+                pState->pScene->SetDeferredShadingComputeObject(m_gBufferLayout == GBuffer::Layout::Visibility ?
+                    VisibilityShading::CreateVisibilityShadingComputeObject(
+                        m_pDevice,
+                        m_pShaderAtlas,
+                        m_pRootSignatureAtlas,
+                        m_pPSOLibrary
+                    ) :
+                    DeferredShading::CreateDefferedShadingComputeObject(
+                        m_pDevice,
+                        m_pShaderAtlas,
+                        m_pRootSignatureAtlas,
+                        m_pPSOLibrary
+                    )
+                );
+                pState->pScene->SetLightClusterBuilder(LightClusterBuilder::CreateLightClusterBuilderComputeObject(
+                    m_pDevice,
+                    m_pShaderAtlas,
+                    m_pRootSignatureAtlas,
+                    m_pPSOLibrary
+                ));
+            }
 
-            pScene->InitializeRenderSubsystems(
-                m_pDevice,
-                m_pAllocator,
-                m_pResourceDescHeapManager,
-                m_pRingBuffers[RingBufferId::Cpu],
-                IndirectUpdater::CreateCbMesh4Updater(m_pDevice, m_pShaderAtlas, m_pRootSignatureAtlas, m_pPSOLibrary)
-            );
+            std::vector<size_t> materialIds{};
+            materialIds.reserve(description.materials.size());
+            for (const SceneFile::Material& material : description.materials) {
+                materialIds.push_back(m_pMaterialManager->AddMaterial(
+                    m_pDevice,
+                    m_pAllocator,
+                    m_pCommandQueueCopy,
+                    m_pCommandQueueDirect,
+                    material.albedoFilename,
+                    material.normalFilename
+                ));
+            }
+
+            std::map<std::tuple<SceneFile::ObjectKind, uint32_t, uint32_t>, std::shared_ptr<MeshRenderObject<ModelBuffer>>> prototypes{};
+            pState->pPrototypes.reserve(description.objects.size());
+            for (const SceneFile::Object& object : description.objects) {
+                std::shared_ptr<MeshRenderObject<ModelBuffer>>& pPrototype{ prototypes[{ object.kind, object.meshId, object.materialId }] };
+                if (!pPrototype) {
+                    std::optional<size_t> materialId{};
+                    if (object.materialId != SceneFile::nullId) {
+                        materialId = materialIds[object.materialId];
+                    }
+                    const SceneFile::Mesh& mesh{ description.meshes[object.meshId] };
+                    std::filesystem::path meshFilepath{ std::filesystem::path{ L"../../Resources/StaticModels" } / mesh.filename };
+                    if (mesh.filename.empty()) {
+                        pPrototype = TestTextureRenderObject::CreateTextureCube(
+                            m_pDevice,
+                            m_pAllocator,
+                            m_pCommandQueueCopy,
+                            m_pCommandQueueDirect,
+                            m_pGeometryPool,
+                            m_pShaderAtlas,
+                            m_pRootSignatureAtlas,
+                            m_pPSOLibrary,
+                            m_pGBuffers[0],
+                            m_pMaterialManager,
+                            DirectX::XMMatrixIdentity(),
+                            materialId
+                        );
+                    }
+                    else if (object.kind == SceneFile::ObjectKind::StaticAlphaKill || object.kind == SceneFile::ObjectKind::DynamicAlphaKill) {
+                        pPrototype = TestAlphaRenderObject::CreateAlphaModelFromGLTF(
+                            m_pDevice,
+                            m_pAllocator,
+                            m_pCommandQueueCopy,
+                            m_pCommandQueueDirect,
+                            m_pGeometryPool,
+                            meshFilepath,
+                            m_pShaderAtlas,
+                            m_pRootSignatureAtlas,
+                            m_pPSOLibrary,
+                            m_pGBuffers[0],
+                            m_pMaterialManager,
+                            DirectX::XMMatrixIdentity(),
+                            materialId
+                        );
+                    }
+                    else {
+                        pPrototype = TestTextureRenderObject::CreateModelFromGLTF(
+                            m_pDevice,
+                            m_pAllocator,
+                            m_pCommandQueueCopy,
+                            m_pCommandQueueDirect,
+                            m_pGeometryPool,
+                            meshFilepath,
+                            m_pShaderAtlas,
+                            m_pRootSignatureAtlas,
+                            m_pPSOLibrary,
+                            m_pGBuffers[0],
+                            m_pMaterialManager,
+                            DirectX::XMMatrixIdentity(),
+                            materialId
+                        );
+                    }
+                }
+                pState->pPrototypes.push_back(pPrototype);
+            }
         }
+        catch (const std::exception& e) {
+            // e.g. a mesh past the geometry pool's triangle limit in the visibility mode
+            OutputDebugStringA((std::string("Scene loading failed: ") + e.what() + "\n").c_str());
+            std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+            m_sceneStates[sceneId] = SceneState::Unloaded;
+            return;
+        }
+        pState->assetsTime = Clock::now();
+
+        // cloning and adding to the render subsystems is thread-safe, so the objects are added by render workers,
+        // they are short jobs that don't hold a worker the way the asset loads would
+        constexpr size_t chunkSize{ 256 };
+        size_t objectsCount{ description.objects.size() };
+        size_t chunksCount{ (objectsCount + chunkSize - 1) / chunkSize };
+        m_pJobSystem->RunAndWait(chunksCount, [pState, objectsCount](size_t chunkId) {
+            const std::unique_ptr<Scene>& pScene{ pState->pScene };
+            size_t end{ std::min((chunkId + 1) * chunkSize, objectsCount) };
+            for (size_t objectId{ chunkId * chunkSize }; objectId < end; ++objectId) {
+                const SceneFile::Object& object{ pState->description.objects[objectId] };
+                const std::shared_ptr<MeshRenderObject<ModelBuffer>>& pPrototype{ pState->pPrototypes[objectId] };
+                ModelBuffer modelBuffer{ pPrototype->GetModelBuffer() };
+                modelBuffer.UpdateMatrices(SceneFile::GetModelMatrix(object));
+                std::shared_ptr<RenderObject> pObject{ pPrototype->Clone(modelBuffer) };
+                // a subsystem past the visibility object limit throws, the object is left out of the scene
+                try {
+                    switch (object.kind) {
+                    case SceneFile::ObjectKind::Static:
+                        pScene->AddStaticObject(pObject);
+                        break;
+                    case SceneFile::ObjectKind::Dynamic:
+                        pScene->AddDynamicObject(pObject);
+                        break;
+                    case SceneFile::ObjectKind::StaticAlphaKill:
+                        pScene->AddStaticAlphaKillObject(pObject);
+                        break;
+                    case SceneFile::ObjectKind::DynamicAlphaKill:
+                        pScene->AddDynamicAlphaKillObject(pObject);
+                        break;
+                    }
+                }
+                catch (const std::exception&) {
+                    pState->skippedObjectsCount.fetch_add(1);
+                }
+            }
+        });
+        Clock::time_point instantiatedTime{ Clock::now() };
 
-        // 2
+        std::unique_ptr<Scene>& pScene{ pState->pScene };
         {
-            std::unique_ptr<Scene>& pScene{ m_pScenes[2] };
-            pScene = std::make_unique<Scene>(
-                L"2",
-                m_pAllocator,
-                m_pRingBuffers[RingBufferId::Cpu],
-                m_pRingBuffers[RingBufferId::Gpu],
-                m_pDepthBuffers[0],
-                m_pGBuffers[0]
-            );
-            std::filesystem::path filepath{ L"../../Resources/StaticModels/barbarian_rig_axe_2_a.glb" };
-            pScene->SetPostProcessing(CopyPostProcessing::Create(
-                m_pDevice,
-                m_pMeshAtlas,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            pScene->SetDeferredShadingComputeObject(DeferredShading::CreateDefferedShadingComputeObject(
-                m_pDevice,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            pScene->AddDynamicObject(TestTextureRenderObject::CreateModelFromGLTF(
-                m_pDevice,
-                m_pAllocator,
-                m_pCommandQueueCopy,
-                m_pCommandQueueDirect,
-                m_pMeshAtlas,
-                filepath,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary,
-                m_pGBuffers[0],
-                m_pMaterialManager,
-                DirectX::XMMatrixScaling(2.f, 2.f, 2.f) * DirectX::XMMatrixTranslation(0.f, -2.f, 0.f)
-            ));
-            std::filesystem::path filepathGrass{ L"../../Resources/StaticModels/grass.glb" };
-            pScene->AddStaticAlphaKillObject(TestAlphaRenderObject::CreateAlphaModelFromGLTF(
-                m_pDevice,
-                m_pAllocator,
-                m_pCommandQueueCopy,
-                m_pCommandQueueDirect,
-                m_pMeshAtlas,
-                filepathGrass,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary,
-                m_pGBuffers[0],
-                m_pMaterialManager,
-                DirectX::XMMatrixScaling(.025f, .025f, .025f) * DirectX::XMMatrixTranslation(0.f, -2.f, -1.f)
-            ));
-
+            std::lock_guard<std::mutex> assetsLock(m_assetsMutex);
             pScene->InitializeRenderSubsystems(
                 m_pDevice,
                 m_pAllocator,
                 m_pResourceDescHeapManager,
                 m_pRingBuffers[RingBufferId::Cpu],
-                IndirectUpdater::CreateCbMesh4Updater(m_pDevice, m_pShaderAtlas, m_pRootSignatureAtlas, m_pPSOLibrary)
+                IndirectUpdater::CreateIdUpdater(m_pDevice, m_pShaderAtlas, m_pRootSignatureAtlas, m_pPSOLibrary),
+                IndirectUpdater::CreateIdCuller(m_pDevice, m_pShaderAtlas, m_pRootSignatureAtlas, m_pPSOLibrary)
             );
+            m_pPSOLibrary->FlushCacheToFile();
         }
+        // the prototypes aren't drawn, dropping them releases their references to the geometry
+        pState->pPrototypes.clear();
+        Clock::time_point subsystemsTime{ Clock::now() };
 
-        // 3
-        {
-            std::unique_ptr<Scene>& pScene{ m_pScenes[3] };
-            pScene = std::make_unique<Scene>(
-                L"3",
-                m_pAllocator,
-                m_pRingBuffers[RingBufferId::Cpu],
-                m_pRingBuffers[RingBufferId::Gpu],
-                m_pDepthBuffers[0],
-                m_pGBuffers[0]
+        for (const SceneFile::Camera& camera : description.cameras) {
+            if (camera.isDynamic) {
+                pScene->AddCamera(std::make_shared<DynamicCamera>());
+            }
+            else {
+                pScene->AddCamera(std::make_shared<StaticCamera>(camera.position, camera.target, camera.up));
+            }
+        }
+        for (const SceneFile::Light& light : description.lights) {
+            pScene->AddLightSource(
+                light.position,
+                light.diffuseColor,
+                light.specularColor,
+                light.diffusePower,
+                light.specularPower
             );
-            pScene->SetPostProcessing(CopyPostProcessing::Create(
-                m_pDevice,
-                m_pMeshAtlas,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            pScene->SetDeferredShadingComputeObject(DeferredShading::CreateDefferedShadingComputeObject(
-                m_pDevice,
-                m_pShaderAtlas,
-                m_pRootSignatureAtlas,
-                m_pPSOLibrary
-            ));
-            m_pJobSystem->AddJob([&] {
-                std::filesystem::path filepathGrass{ L"../../Resources/StaticModels/grass.glb" };
-                DirectX::XMMATRIX scale{ DirectX::XMMatrixScaling(.025f, .025f, .025f) };
-
-                std::random_device rd;
-                std::mt19937 gen(rd());
-                std::uniform_real_distribution<float> posDist(-10.f, 10.f);
-                for (size_t i{}; i < 100; ++i) {
-                    pScene->AddStaticAlphaKillObject(TestAlphaRenderObject::CreateAlphaModelFromGLTF(
-                        m_pDevice,
-                        m_pAllocator,
-                        m_pCommandQueueCopy,
-                        m_pCommandQueueDirect,
-                        m_pMeshAtlas,
-                        filepathGrass,
-                        m_pShaderAtlas,
-                        m_pRootSignatureAtlas,
-                        m_pPSOLibrary,
-                        m_pGBuffers[0],
-                        m_pMaterialManager,
-                        scale * DirectX::XMMatrixTranslation(posDist(gen), -1.f, posDist(gen))
-                    ));
-                }
-
-                pScene->InitializeRenderSubsystems(
-                    m_pDevice,
-                    m_pAllocator,
-                    m_pResourceDescHeapManager,
-                    m_pRingBuffers[RingBufferId::Cpu],
-                    IndirectUpdater::CreateCbMesh4Updater(m_pDevice, m_pShaderAtlas, m_pRootSignatureAtlas, m_pPSOLibrary)
-                );
-            });
+        }
+        pScene->SetSceneReadiness(true);
+        {
+            std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+            m_pScenes[sceneId] = std::move(pScene);
+            m_sceneStates[sceneId] = SceneState::Ready;
+            m_sceneLastFrameIds[sceneId] = m_frameId.load();
         }
 
-        // cameras for all scenes
-        for (std::unique_ptr<Scene>& pScene : m_pScenes) {
-            m_pJobSystem->AddJob([&]() {
-                // dynamic camera
-                pScene->AddCamera(std::make_shared<DynamicCamera>());
-
-                // standart camera
-                pScene->AddCamera(std::make_shared<StaticCamera>(
-                    DirectX::XMFLOAT3{ 0.f, 0.f, 3.f },
-                    DirectX::XMFLOAT3{ 0.f, 0.f, 0.f },
-                    DirectX::XMFLOAT3{ 0.f, 1.f, 0.f }
-                ));
-
-                // standart light
-                pScene->AddLightSource(
-                    { -1.5f, 0.f, 1.5f, 1.f },
-                    { 1.f, 1.f, 0.f },
-                    { 1.f, 1.f, 0.f }
-                );
-
-                // random lights
-                for (size_t i{}; i < 1; ++i) {
-                    std::random_device rd;
-                    std::mt19937 gen(rd());
-                    std::uniform_real_distribution<float> posDist(-2.5f, 2.5f);
-                    std::uniform_real_distribution<float> colorDist(0.f, 1.f);
-                    pScene->AddLightSource(
-                        { posDist(gen), posDist(gen), posDist(gen), colorDist(gen) },
-                        { colorDist(gen), colorDist(gen), colorDist(gen) },
-                        { colorDist(gen), colorDist(gen), colorDist(gen) }
-                    );
-                }
-
-                pScene->SetSceneReadiness(true);
-            });
+        auto toMs{ [](Clock::duration duration) {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        } };
+        std::wstringstream wss{};
+        wss << L"Scene " << sceneId << L" loaded, " << objectsCount << L" objects: "
+            << L"parse " << toMs(pState->parsedTime - pState->startTime) << L" ms, "
+            << L"assets " << toMs(pState->assetsTime - pState->parsedTime) << L" ms, "
+            << L"instantiation " << toMs(instantiatedTime - pState->assetsTime) << L" ms, "
+            << L"subsystems " << toMs(subsystemsTime - instantiatedTime) << L" ms, "
+            << L"total " << toMs(Clock::now() - pState->startTime) << L" ms\n";
+        if (size_t skippedObjectsCount{ pState->skippedObjectsCount.load() }) {
+            wss << skippedObjectsCount << L" objects skipped, over " << VISIBILITY_MAX_OBJECTS
+                << L" objects in a render subsystem" << std::endl;
         }
+        OutputDebugString(wss.str().c_str());
+    } };
+
+    // the loader thread blocks on file reads and uploads, the render workers stay free for the frame
+    if (!m_loaderJobSystem.AddJob(load)) {
+        load();
     }
-    m_pPSOLibrary->FlushCacheToFile();
 }
 
 bool Renderer::StartRenderThread() {
@@ -364,6 +423,7 @@ bool Renderer::StartRenderThread() {
         return false;
 
     m_pJobSystem->StartRunning();
+    m_loaderJobSystem.StartRunning();
     m_isRenderThreadRunning.store(true);
     m_renderThread = std::thread(&Renderer::RenderLoop, this);
     return true;
@@ -372,6 +432,8 @@ bool Renderer::StartRenderThread() {
 void Renderer::StopRenderThread() {
     m_isRenderThreadRunning.store(false);
     m_renderThread.join();
+    // a load in progress finishes, queued ones are dropped
+    m_loaderJobSystem.StopRunning();
 }
 
 void Renderer::Resize(uint32_t width, uint32_t height) {
@@ -385,9 +447,28 @@ void Renderer::SwitchVSync() {
 }
 
 void Renderer::SetSceneId(size_t sceneId) {
+    if (sceneId >= m_pScenes.size()) {
+        return;
+    }
+    PreloadScene(sceneId);
     m_nextSceneId.store(sceneId);
 }
 
+void Renderer::PreloadScene(size_t sceneId) {
+    {
+        std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+        if (sceneId >= m_sceneStates.size() || m_sceneStates[sceneId] != SceneState::Unloaded) {
+            return;
+        }
+        m_sceneStates[sceneId] = SceneState::Loading;
+    }
+    LoadSceneFile(sceneId, std::filesystem::path{ L"../../Resources/Scenes" } / (std::to_wstring(sceneId) + L".scene"));
+}
+
+void Renderer::SetSceneMemoryBudget(uint64_t bytes) {
+    m_sceneMemoryBudget.store(bytes);
+}
+
 void Renderer::SwitchToNextCamera() {
     m_isSwitchToNextCamera.store(true);
 }
@@ -403,7 +484,11 @@ inline void Renderer::RenderLoop() {
             PerformResize();
             m_isNeedResize.store(false);
         }
-        m_currSceneId = m_nextSceneId.load();
+        SwitchToNextScene();
+        if (m_currSceneId == noSceneId) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
         if (m_isSwitchToNextCamera.load()) {
             m_pScenes[m_currSceneId]->NextCamera();
             m_isSwitchToNextCamera.store(false);
@@ -413,7 +498,59 @@ inline void Renderer::RenderLoop() {
 
         std::scoped_lock<std::mutex> lock(m_renderThreadMutex);
         Render();
+        EvictUnusedScene();
+    }
+}
+
+void Renderer::SwitchToNextScene() {
+    size_t nextSceneId{ m_nextSceneId.load() };
+    if (nextSceneId == m_currSceneId) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+        if (m_sceneStates[nextSceneId] != SceneState::Ready) {
+            return;
+        }
     }
+    m_currSceneId.store(nextSceneId);
+    // cameras keep the aspect ratio they had when the scene was last current
+    m_pScenes[nextSceneId]->UpdateCamerasAspectRatio(static_cast<float>(m_clientWidth) / m_clientHeight);
+}
+
+void Renderer::EvictUnusedScene() {
+    uint64_t frameId{ m_frameId.fetch_add(1) + 1 };
+    m_sceneLastFrameIds[m_currSceneId] = frameId;
+
+    D3D12MA::Budget localBudget{};
+    m_pAllocator->GetBudget(&localBudget, nullptr);
+    if (localBudget.UsageBytes <= std::min(m_sceneMemoryBudget.load(), localBudget.BudgetBytes)) {
+        return;
+    }
+
+    // The least recently used ready scene that isn't requested goes, one per frame so the usage is measured again.
+    // Scenes rendered during the last frames may still be read by the GPU.
+    size_t evictedSceneId{ noSceneId };
+    std::unique_ptr<Scene> pEvictedScene{};
+    {
+        std::lock_guard<std::mutex> scenesLock(m_scenesMutex);
+        for (size_t sceneId{}; sceneId < m_pScenes.size(); ++sceneId) {
+            bool isUsed{ sceneId == m_currSceneId || sceneId == m_nextSceneId.load() };
+            bool isInFlight{ frameId - m_sceneLastFrameIds[sceneId] <= m_numFrames };
+            if (m_sceneStates[sceneId] != SceneState::Ready || isUsed || isInFlight) {
+                continue;
+            }
+            if (evictedSceneId == noSceneId || m_sceneLastFrameIds[sceneId] < m_sceneLastFrameIds[evictedSceneId]) {
+                evictedSceneId = sceneId;
+            }
+        }
+        if (evictedSceneId == noSceneId) {
+            return;
+        }
+        pEvictedScene = std::move(m_pScenes[evictedSceneId]);
+        m_sceneStates[evictedSceneId] = SceneState::Unloaded;
+    }
+    // the scene is destroyed here, outside the lock
 }
 
 void Renderer::PerformResize() {
@@ -456,9 +593,9 @@ void Renderer::PerformResize() {
 
     m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(m_clientWidth), static_cast<float>(m_clientHeight));
 
-    // TODO update during switch
-    for (auto& pScene : m_pScenes) {
-        pScene->UpdateCamerasAspectRatio(static_cast<float>(m_clientWidth) / m_clientHeight);
+    // other scenes are updated when they become current
+    if (m_currSceneId != noSceneId) {
+        m_pScenes[m_currSceneId]->UpdateCamerasAspectRatio(static_cast<float>(m_clientWidth) / m_clientHeight);
     }
     for (auto& pDepthBuffer : m_pDepthBuffers) {
         pDepthBuffer->Resize(m_pDevice, m_pAllocator, m_clientWidth, m_clientHeight);
@@ -466,6 +603,7 @@ void Renderer::PerformResize() {
     for (auto& pGBuffer : m_pGBuffers) {
         pGBuffer->Resize(m_pDevice, m_pAllocator, m_clientWidth, m_clientHeight);
     }
+    BuildRenderGraph();
 }
 
 void Renderer::Update() {
@@ -480,6 +618,8 @@ void Renderer::Update() {
         pScene->Update(deltaTime.count() * 1e-9f, pCommandList);
         m_pCommandQueueDirect->ExecuteCommandListImmediately(pCommandList);
 
+        pScene->UpdateTransforms(*m_pJobSystem);
+        pScene->CullRenderSubsystems(*m_pJobSystem);
     	pScene->UpdateRenderSubsystems(
             m_pDevice,
             m_pAllocator,
@@ -494,6 +634,11 @@ void Renderer::Update() {
 
         std::wstringstream wss{};
         wss << "FPS: " << fps << std::endl;
+        ClusterStats clusterStats{ pScene->GetClusterStats() };
+        if (clusterStats.overflowedClustersCount > 0) {
+            wss << "Lights dropped in " << clusterStats.overflowedClustersCount << " clusters, up to "
+                << clusterStats.maxClusterLightsCount << " lights in a cluster of " << CLUSTER_LIGHTS_MAX_COUNT << std::endl;
+        }
         OutputDebugString(wss.str().c_str());
 
         m_frameCounter = 0;
@@ -501,182 +646,273 @@ void Renderer::Update() {
     }
 }
 
-void Renderer::Render() {
-    auto& scene = m_pScenes.at(m_currSceneId);
-    if (!scene->IsSceneReady())
-        return;
+void Renderer::BuildRenderGraph() {
+    RenderGraphResources& res{ m_renderGraphResources };
+    std::shared_ptr<DepthBuffer>& pDepthBuffer{ m_pDepthBuffers[0] };
+    std::shared_ptr<GBuffer>& pGBuffer{ m_pGBuffers[0] };
+    const size_t gBufferRtCount{ GBuffer::GetSize(m_gBufferLayout) - 1 };
+    const size_t gBufferOutputId{ GBuffer::GetSize(m_gBufferLayout) - 1 };
+
+    m_renderGraph.Clear();
+
+    res.backBuffer = m_renderGraph.ImportResource(
+        L"BackBuffer",
+        D3D12_RESOURCE_STATE_PRESENT,
+        D3D12_RESOURCE_STATE_PRESENT
+    );
+    res.depthBuffer = m_renderGraph.ImportResource(
+        L"DepthBuffer",
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE
+    );
+    bool isHZBUsed{ pDepthBuffer->GetHZBTexture() != nullptr };
+    if (isHZBUsed) {
+        res.hzb = m_renderGraph.ImportResource(
+            L"HZB",
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+        );
+    }
+    res.lightCounts = m_renderGraph.ImportResource(
+        L"LightCounts",
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+    );
+    res.lightIndices = m_renderGraph.ImportResource(
+        L"LightIndices",
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+    );
+    res.gBuffer.resize(GBuffer::GetSize(m_gBufferLayout));
+    for (size_t i{}; i < GBuffer::GetSize(m_gBufferLayout); ++i) {
+        res.gBuffer[i] = m_renderGraph.CreateTransientResource(
+            L"GBuffer/" + std::to_wstring(i),
+            GBuffer::GetResourceDesc(m_gBufferLayout, i, m_clientWidth, m_clientHeight)
+        );
+    }
 
-    size_t listPriority{};
+    auto writeGeometry = [&](RenderGraph::PassBuilder& builder) {
+        builder.Write(res.depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+        for (size_t i{}; i < gBufferRtCount; ++i) {
+            builder.Write(res.gBuffer[i], D3D12_RESOURCE_STATE_RENDER_TARGET);
+        }
+    };
 
-    auto& backBuffer = m_pBackBuffers[m_currBackBufferId];
-    D3D12_CPU_DESCRIPTOR_HANDLE rtv{ m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId) };
+    m_renderGraph.AddPass(
+        L"Before frame part",
+        [&](RenderGraph::PassBuilder& builder) {
+            writeGeometry(builder);
+            builder.Write(res.backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        },
+        [this](ID3D12GraphicsCommandList2* pCommandList) {
+            auto& scene = m_pScenes.at(m_currSceneId);
+            scene->BeforeFrameJob(pCommandList);
+            if (!scene->GetGBuffer()) {
+                float clearColor[]{ 0.6f, 0.4f, 0.4f, 1.0f };
+                ClearRenderTarget(
+                    pCommandList,
+                    m_pBackBuffers[m_currBackBufferId],
+                    m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId),
+                    clearColor
+                );
+            }
+        }
+    );
 
-    std::shared_ptr<CommandList> commandListBeforeFrame{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, listPriority)
+    // large subsystems are split into chunks recorded by parallel jobs
+    auto getChunksCount = [this](Scene::RenderSubsystemId subsystemId) {
+        return [this, subsystemId]() {
+            return m_pScenes.at(m_currSceneId)->GetRecordingChunksCount(subsystemId);
+        };
     };
 
-    // Some small work doesn't need to be moved to jobs, just as example
-    {
-        PIXScopedEvent(
-            commandListBeforeFrame->m_pCommandList.Get(),
-            PIX_COLOR(0, 0, 0),
-            L"Before frame part"
+    // With the HZB static objects are culled in two phases: what was visible last frame is drawn first,
+    // the HZB is built from that depth and the rest is tested against it
+    GpuCulling::Phase cullingPhase{ isHZBUsed ? GpuCulling::Phase::Early : GpuCulling::Phase::Frustum };
+    auto addStaticPasses = [&](
+        const std::wstring& suffix,
+        const std::function<void(RenderGraph::PassBuilder&)>& setupFunc,
+        GpuCulling::Phase phase
+    ) {
+        m_renderGraph.AddChunkedPass(
+            L"Static Objects " + suffix,
+            setupFunc,
+            getChunksCount(Scene::Static),
+            [this, phase](ID3D12GraphicsCommandList2* pCommandList, uint32_t chunkId, uint32_t chunksCount) {
+                m_pScenes.at(m_currSceneId)->RenderStaticObjects(
+                    pCommandList,
+                    m_viewport,
+                    m_scissorRect,
+                    m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId),
+                    m_pResourceDescHeapManager,
+                    phase,
+                    chunkId,
+                    chunksCount
+                );
+            }
         );
-        scene->BeforeFrameJob(commandListBeforeFrame->m_pCommandList);
 
-        ResourceTransition(
-            commandListBeforeFrame->m_pCommandList,
-            backBuffer,
-            D3D12_RESOURCE_STATE_PRESENT,
-            D3D12_RESOURCE_STATE_RENDER_TARGET
+        m_renderGraph.AddChunkedPass(
+            L"Alpha Objects " + suffix,
+            setupFunc,
+            getChunksCount(Scene::StaticAlphaKill),
+            [this, phase](ID3D12GraphicsCommandList2* pCommandList, uint32_t chunkId, uint32_t chunksCount) {
+                m_pScenes.at(m_currSceneId)->RenderStaticAlphaKillObjects(
+                    pCommandList,
+                    m_viewport,
+                    m_scissorRect,
+                    m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId),
+                    m_pResourceDescHeapManager,
+                    m_pMaterialManager,
+                    phase,
+                    chunkId,
+                    chunksCount
+                );
+            }
         );
-        if (!scene->GetGBuffer()) {
-            float clearColor[]{ 0.6f, 0.4f, 0.4f, 1.0f };
-            ClearRenderTarget(
-                commandListBeforeFrame->m_pCommandList,
-                backBuffer,
-                rtv,
-                clearColor
+    };
+
+    addStaticPasses(L"rendering", writeGeometry, cullingPhase);
+
+    m_renderGraph.AddChunkedPass(
+        L"Dynamic Objects rendering",
+        writeGeometry,
+        getChunksCount(Scene::Dynamic),
+        [this](ID3D12GraphicsCommandList2* pCommandList, uint32_t chunkId, uint32_t chunksCount) {
+            m_pScenes.at(m_currSceneId)->RenderDynamicObjects(
+                pCommandList,
+                m_viewport,
+                m_scissorRect,
+                m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId),
+                chunkId,
+                chunksCount
             );
         }
+    );
 
-        commandListBeforeFrame->SetReadyForExection(); // but still it is cl to execute in proper order
-    }
-
-    // two command lists: static (1), dynamic (2)
-    std::shared_ptr<CommandList> commandListForStaticObjects{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, ++listPriority)
-    };
-    m_pJobSystem->AddJob([&]() {
-        PIXScopedEvent(
-            commandListForStaticObjects->m_pCommandList.Get(),
-            PIX_COLOR(0, 0, 0),
-            L"Static Objects rendering"
-        );
-        scene->RenderStaticObjects(
-            commandListForStaticObjects->m_pCommandList,
-            m_viewport,
-            m_scissorRect,
-            rtv
+    // The late phase needs the HZB right away, so it is built on the direct queue.
+    // Depth copy has to stay there anyway, depth-stencil resources can't be copied elsewhere.
+    if (isHZBUsed) {
+        m_renderGraph.AddPass(
+            L"Copying depth to HZB",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.Read(res.depthBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+                builder.Write(res.hzb, D3D12_RESOURCE_STATE_COPY_DEST);
+            },
+            [this](ID3D12GraphicsCommandList2* pCommandList) {
+                m_pDepthBuffers[0]->CopyDepthToHZB(pCommandList);
+            }
         );
-        commandListForStaticObjects->SetReadyForExection();
-    });
 
-    std::shared_ptr<CommandList> commandListForAlphaObjects{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, listPriority)
-    };
-    m_pJobSystem->AddJob([&]() {
-        PIXScopedEvent(
-            commandListForAlphaObjects->m_pCommandList.Get(),
-            PIX_COLOR(0, 0, 0),
-            L"Alpha Objects rendering"
+        m_renderGraph.AddPass(
+            L"Building HZB",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.Read(res.depthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+                builder.Write(res.hzb, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+            },
+            [this](ID3D12GraphicsCommandList2* pCommandList) {
+                m_pDepthBuffers[0]->DownsampleHZB(pCommandList, m_pResourceDescHeapManager->GetDescriptorHeap());
+            }
         );
-        scene->RenderStaticAlphaKillObjects(
-            commandListForAlphaObjects->m_pCommandList,
-            m_viewport,
-            m_scissorRect,
-            rtv,
-            m_pResourceDescHeapManager,
-            m_pMaterialManager
-        );
-        commandListForAlphaObjects->SetReadyForExection();
-        });
 
-    uint64_t fenceValueAfterRender{};
-    std::shared_ptr<CommandList> commandListForDynamicObjects{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, ++listPriority, [] {},
-            [&]() { fenceValueAfterRender = m_pCommandQueueDirect->Signal(); }
-        )
-    };
-    m_pJobSystem->AddJob([&]() {
-        PIXScopedEvent(
-            commandListForDynamicObjects->m_pCommandList.Get(),
-            PIX_COLOR(0, 0, 0),
-            L"Dynamic Objects rendering"
-        );
-        scene->RenderDynamicObjects(
-            commandListForDynamicObjects->m_pCommandList,
-            m_viewport,
-            m_scissorRect,
-            rtv
+        addStaticPasses(
+            L"late rendering",
+            [&](RenderGraph::PassBuilder& builder) {
+                writeGeometry(builder);
+                builder.Read(res.hzb, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            },
+            GpuCulling::Phase::Late
         );
-        commandListForDynamicObjects->SetReadyForExection();
-        });
-
-    
-    uint64_t fenceValueAfterHZB{ static_cast<uint64_t>(-1) };
-    std::shared_ptr<CommandList> commandListForHZB{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, ++listPriority,
-            [&] { m_pCommandQueueDirect->WaitForFenceValue(fenceValueAfterRender); },
-            [&] { fenceValueAfterHZB = m_pCommandQueueDirect->Signal(); }
-        )
-    };
+    }
 
-    uint64_t fenceValueAfterDeferredShading{ static_cast<uint64_t>(-1) };
-    std::shared_ptr<CommandList> commandListForDeferredShading{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, ++listPriority,
-            [&] { m_pCommandQueueDirect->WaitForFenceValue(fenceValueAfterHZB); },
-            [&] { fenceValueAfterDeferredShading = m_pCommandQueueDirect->Signal(); }
-        )
-    };
-    std::shared_ptr<CommandList> commandListAfterFrame{
-        m_pCommandQueueDirect->GetCommandList(m_pDevice, true, ++listPriority,
-            [&] { m_pCommandQueueDirect->WaitForFenceValue(fenceValueAfterDeferredShading); }
-        )
-    };
-    m_pJobSystem->AddJob([&]() {
-        {
-            PIXScopedEvent(
-                commandListForHZB->m_pCommandList.Get(),
-                PIX_COLOR(0, 0, 0),
-                L"Building HZB"
-            );
-            scene->GetDepthBuffer()->CreateHierarchicalDepthBuffer(
-                commandListForHZB->m_pCommandList,
-                m_pResourceDescHeapManager->GetDescriptorHeap()
-            );
-            commandListForHZB->SetReadyForExection();
-        }
+    // Only the lights are read, so the clusters are built on the compute queue while the direct one draws.
+    // All the other readers and writers of the grid are on the compute queue too, the next frame can't overwrite it early.
+    m_renderGraph.AddPass(
+        L"Building light clusters",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.Write(res.lightCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+            builder.Write(res.lightIndices, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        },
+        [this](ID3D12GraphicsCommandList2* pCommandList) {
+            m_pScenes.at(m_currSceneId)->BuildLightClusters(pCommandList);
+        },
+        RenderGraph::QueueType::Compute
+    );
 
-        {
-            PIXScopedEvent(
-                commandListForDeferredShading->m_pCommandList.Get(),
-                PIX_COLOR(0, 0, 0),
-                L"Deferred shading"
-            );
-            scene->RunDeferredShading(
-                commandListForDeferredShading->m_pCommandList,
+    // Shading goes to the compute queue too. It can't overlap the geometry of the next frame:
+    // post processing on the direct queue needs its output first, and there is one G-buffer.
+    m_renderGraph.AddPass(
+        L"Deferred shading",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.Read(res.lightCounts, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            builder.Read(res.lightIndices, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            for (size_t i{}; i < gBufferRtCount; ++i) {
+                builder.Read(res.gBuffer[i], D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            }
+            if (m_gBufferLayout == GBuffer::Layout::Attributes) {
+                builder.Read(res.depthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            }
+            builder.Write(res.gBuffer[gBufferOutputId], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        },
+        [this](ID3D12GraphicsCommandList2* pCommandList) {
+            m_pScenes.at(m_currSceneId)->RunDeferredShading(
+                pCommandList,
                 m_pResourceDescHeapManager,
                 m_pMaterialManager,
+                m_pGeometryPool,
                 m_clientWidth,
                 m_clientHeight
             );
-            commandListForDeferredShading->SetReadyForExection();
-        }
+        },
+        RenderGraph::QueueType::Compute
+    );
 
-        {
-            PIXScopedEvent(
-                commandListAfterFrame->m_pCommandList.Get(),
-                PIX_COLOR(0, 0, 0),
-                L"Post Processing"
-            );
-            scene->RenderPostProcessing(
-                commandListAfterFrame->m_pCommandList,
+    m_renderGraph.AddPass(
+        L"Post Processing",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.Read(res.gBuffer[gBufferOutputId], D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+            builder.Write(res.backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        },
+        [this](ID3D12GraphicsCommandList2* pCommandList) {
+            m_pScenes.at(m_currSceneId)->RenderPostProcessing(
+                pCommandList,
                 m_pResourceDescHeapManager,
                 m_viewport,
                 m_scissorRect,
-                rtv
+                m_pBackBuffersDescHeapRange->GetCpuHandle(m_currBackBufferId)
             );
-            ResourceTransition(
-                commandListAfterFrame->m_pCommandList,
-                backBuffer,
-                D3D12_RESOURCE_STATE_RENDER_TARGET,
-                D3D12_RESOURCE_STATE_PRESENT
-            );
-
-            commandListAfterFrame->SetReadyForExection();
         }
-    });
+    );
+
+    bool isCompiled{ m_renderGraph.Compile(RenderGraphExecutor::GetAllocationInfoFunc(m_pDevice)) };
+    assert(isCompiled);
+
+    m_renderGraphExecutor.Realize(m_pDevice, m_pAllocator, m_renderGraph);
+    m_renderGraphExecutor.SetImportedResource(res.depthBuffer, pDepthBuffer->GetTexture()->GetResource());
+    if (isHZBUsed) {
+        m_renderGraphExecutor.SetImportedResource(res.hzb, pDepthBuffer->GetHZBTexture()->GetResource());
+    }
+    for (size_t i{}; i < GBuffer::GetSize(m_gBufferLayout); ++i) {
+        pGBuffer->SetTexture(
+            m_pDevice,
+            i,
+            std::make_shared<Texture>(m_renderGraphExecutor.GetResource(res.gBuffer[i]))
+        );
+    }
+}
+
+void Renderer::Render() {
+    auto& scene = m_pScenes.at(m_currSceneId);
+    if (!scene->IsSceneReady())
+        return;
+
+    // passes are recorded by jobs, ExecutionTask waits for all of them and submits in graph order,
+    // the queues wait for each other on GPU
+    m_renderGraphExecutor.SetImportedResource(m_renderGraphResources.backBuffer, m_pBackBuffers[m_currBackBufferId]);
+    m_renderGraphExecutor.SetImportedResource(m_renderGraphResources.lightCounts, scene->GetClusterGrid().GetLightCounts());
+    m_renderGraphExecutor.SetImportedResource(m_renderGraphResources.lightIndices, scene->GetClusterGrid().GetLightIndices());
+    m_renderGraphExecutor.Execute(m_pDevice, m_pCommandQueueDirect, m_pCommandQueueCompute, m_pJobSystem, m_renderGraph);
+    m_pCommandQueueCompute->ExecutionTask(0);
 
     uint64_t lastCompletedFenceValue{
         m_frameFenceValues[(m_currBackBufferId + m_numFrames - 1) % m_numFrames]
@@ -708,11 +944,19 @@ void Renderer::Render() {
 }
 
 void Renderer::MoveCamera(float forwardCoef, float rightCoef) {
-    m_pScenes.at(m_currSceneId)->TryMoveCamera(forwardCoef, rightCoef);
+    size_t sceneId{ m_currSceneId.load() };
+    if (sceneId == noSceneId) {
+        return;
+    }
+    m_pScenes[sceneId]->TryMoveCamera(forwardCoef, rightCoef);
 }
 
 void Renderer::RotateCamera(float deltaX, float deltaY) {
-    m_pScenes.at(m_currSceneId)->TryRotateCamera(deltaX / m_clientWidth, deltaY / m_clientHeight);
+    size_t sceneId{ m_currSceneId.load() };
+    if (sceneId == noSceneId) {
+        return;
+    }
+    m_pScenes[sceneId]->TryRotateCamera(deltaX / m_clientWidth, deltaY / m_clientHeight);
 }
 
 bool Renderer::CheckTearingSupport() {
@@ -960,5 +1204,6 @@ std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> Renderer::CreateBackBuffers(
 // before the CPU thread is allowed to continue processing
 void Renderer::Flush() {
     m_pCommandQueueDirect->Flush();
+    m_pCommandQueueCompute->Flush();
     m_pCommandQueueCopy->Flush();
 }
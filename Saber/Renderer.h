@@ -14,6 +14,8 @@
 #include <algorithm>
 #include <chrono>
 #include <vector>
+#include <filesystem>
+#include <limits>
 
 #include <atomic>
 #include <mutex>
@@ -25,9 +27,12 @@
 #include "CommandList.h"
 #include "DepthBuffer.h"
 #include "GBuffer.h"
+#include "GeometryPool.h"
 #include "IndirectUpdater.h"
 #include "PostProcessing.h"
 #include "PSOLibrary.h"
+#include "RenderGraph.h"
+#include "RenderGraphExecutor.h"
 #include "RenderObject.h"
 #include "Resources.h"
 #include "Scene.h"
@@ -92,13 +97,44 @@ class Renderer {
     D3D12_VIEWPORT m_viewport{};
     D3D12_RECT m_scissorRect{ CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX) };
 
+    // Scenes are built by jobs when they are first needed and destroyed when evicted.
+    // The slots are changed under m_scenesMutex, the render thread uses the current scene without it,
+    // as only a ready scene becomes current and only the render thread evicts.
+    enum class SceneState {
+        Unloaded,
+        Loading,
+        Ready
+    };
+    static constexpr size_t noSceneId{ std::numeric_limits<size_t>::max() };
     std::vector<std::unique_ptr<Scene>> m_pScenes{};
-    size_t m_currSceneId{ 2 };
-
-    std::atomic<size_t> m_nextSceneId{ m_currSceneId };
+    std::vector<SceneState> m_sceneStates{};
+    // frame the scene was rendered last or got ready
+    std::vector<uint64_t> m_sceneLastFrameIds{};
+    std::mutex m_scenesMutex{};
+    std::atomic<size_t> m_currSceneId{ noSceneId };
+    std::atomic<uint64_t> m_frameId{};
+    // GPU local memory usage above which unused scenes are released, the system budget if lower
+    std::atomic<uint64_t> m_sceneMemoryBudget{ 1ull << 30 };
+
+    std::atomic<size_t> m_nextSceneId{ 2 };
     std::atomic<bool> m_isSwitchToNextCamera{};
 
     std::vector<std::shared_ptr<GBuffer>> m_pGBuffers{};
+    // the visibility layout stores only triangle ids and shades them from the geometry pool
+    GBuffer::Layout m_gBufferLayout{ GBuffer::Layout::Attributes };
+
+    // Frame passes, rebuilt on resize
+    RenderGraph m_renderGraph{};
+    RenderGraphExecutor m_renderGraphExecutor{};
+    struct RenderGraphResources {
+        RenderGraph::ResourceId backBuffer{ RenderGraph::InvalidId };
+        RenderGraph::ResourceId depthBuffer{ RenderGraph::InvalidId };
+        RenderGraph::ResourceId hzb{ RenderGraph::InvalidId };
+        std::vector<RenderGraph::ResourceId> gBuffer{};
+        // cluster grid of the current scene
+        RenderGraph::ResourceId lightCounts{ RenderGraph::InvalidId };
+        RenderGraph::ResourceId lightIndices{ RenderGraph::InvalidId };
+    } m_renderGraphResources{};
 
     std::shared_ptr<DescriptorHeapManager> m_pDsvDescHeapManager{};
     std::shared_ptr<DescriptorHeapManager> m_pRtvDescHeapManager{};
@@ -118,8 +154,14 @@ class Renderer {
     std::shared_ptr<Atlas<RootSignatureResource>> m_pRootSignatureAtlas{};
     std::shared_ptr<PSOLibrary> m_pPSOLibrary{};
     std::shared_ptr<MaterialManager> m_pMaterialManager{};
+    std::shared_ptr<GeometryPool> m_pGeometryPool{};
+    // the atlases, the PSO library and the material manager aren't thread-safe, scene loading jobs take it to use them
+    std::mutex m_assetsMutex{};
 
     std::shared_ptr<JobSystem<>> m_pJobSystem{};
+    // Scene loads wait on files and uploads, on their own thread they don't hold the render workers.
+    // Only the object instantiation is spread over m_pJobSystem.
+    JobSystem<1> m_loaderJobSystem{};
 
 public:
     Renderer(const Renderer&) = delete;
@@ -130,7 +172,8 @@ public:
         bool isUseWarp = false,
         uint32_t resWidth = 1280,
         uint32_t resHeight = 720,
-        bool isUseVSync = true
+        bool isUseVSync = true,
+        bool isUseVisibilityBuffer = false
     );
     ~Renderer();
 
@@ -141,7 +184,11 @@ public:
 
     void SwitchVSync();
 
+    // Switches on the first frame the scene is ready, until then the current one is rendered.
     void SetSceneId(size_t sceneId);
+    // Starts building the scene in the background, does nothing if it's loaded or loading.
+    void PreloadScene(size_t sceneId);
+    void SetSceneMemoryBudget(uint64_t bytes);
 
     void SwitchToNextCamera();
 
@@ -157,6 +204,16 @@ public:
 private:
     void RenderLoop();
 
+    // render thread only
+    void SwitchToNextScene();
+    void EvictUnusedScene();
+
+    // Queues a job on the loader thread that reads the scene file and fills the scene, which is marked ready at the end.
+    // Each (mesh, material, object type) is created once, the objects are cloned from it in parallel jobs.
+    void LoadSceneFile(size_t sceneId, const std::filesystem::path& filepath);
+
+    void BuildRenderGraph();
+
     bool CheckTearingSupport();
 
     void EnableDebugLayer();
@@ -12,29 +12,20 @@ Scene::Scene(
 ) : m_name(name),
 	m_pDynamicUploadHeapCpu(pDynamicUploadHeapCpu),
 	m_pDynamicUploadHeapGpu(pDynamicUploadHeapGpu),
+	m_clusterGrid(pAllocator),
 	m_pDepthBuffer(pDepthBuffer),
 	m_pGBuffer(pGBuffer)
 {
     m_pRenderSubsystems.resize(RenderSubsystemId::Count);
     m_pRenderSubsystems[RenderSubsystemId::Static] =
-        std::make_shared<RenderSubsystem<CbMesh4IndirectCommand>>(m_name + L"/Static");
+        std::make_shared<RenderSubsystem<IdIndirectCommand>>(m_name + L"/Static", false, RenderSubsystemId::Static);
     m_pRenderSubsystems[RenderSubsystemId::Dynamic] =
-        std::make_shared<RenderSubsystem<CbMesh4IndirectCommand>>(m_name + L"/Dynamic");
+        std::make_shared<RenderSubsystem<IdIndirectCommand>>(m_name + L"/Dynamic", true, RenderSubsystemId::Dynamic);
     m_pRenderSubsystems[RenderSubsystemId::StaticAlphaKill] =
-        std::make_shared<RenderSubsystem<CbMesh4IndirectCommand>>(m_name + L"/Static/AlphaKill");
+        std::make_shared<RenderSubsystem<IdIndirectCommand>>(m_name + L"/Static/AlphaKill", false, RenderSubsystemId::StaticAlphaKill);
     m_pRenderSubsystems[RenderSubsystemId::DynamicAlphaKill] =
-        std::make_shared<RenderSubsystem<CbMesh4IndirectCommand>>(m_name + L"/Dynamic/AlphaKill");
-	
-    m_pSceneCb = std::make_shared<ConstantBuffer>(
-        pAllocator,
-        sizeof(SceneBuffer),
-        nullptr,
-        GPUResource::HeapData{ D3D12_HEAP_TYPE_DEFAULT }
-    );
-    m_pLightCB = std::make_shared<ConstantBuffer>(
-        pAllocator,
-        sizeof(LightBuffer)
-    );
+        std::make_shared<RenderSubsystem<IdIndirectCommand>>(m_name + L"/Dynamic/AlphaKill", true, RenderSubsystemId::DynamicAlphaKill);
+    SetGBuffer(pGBuffer);
 }
 
 /* scene readiness */
@@ -56,6 +47,11 @@ std::shared_ptr<DepthBuffer> Scene::GetDepthBuffer() {
 /* g-buffer */
 void Scene::SetGBuffer(std::shared_ptr<GBuffer> pGBuffer) {
     m_pGBuffer = pGBuffer;
+    if (m_pGBuffer && m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility) {
+        for (auto& pRenderSubsystem : m_pRenderSubsystems) {
+            pRenderSubsystem->SetMaxSlotsCount(VISIBILITY_MAX_OBJECTS);
+        }
+    }
 }
 std::shared_ptr<GBuffer> Scene::GetGBuffer() {
     return m_pGBuffer;
@@ -63,7 +59,42 @@ std::shared_ptr<GBuffer> Scene::GetGBuffer() {
 
 void Scene::Update(float deltaTime, std::shared_ptr<CommandList> pCommandList) {
     TryUpdateCamera(deltaTime);
-    UpdateSceneBuffer(pCommandList->m_pCommandList);
+    PublishFrameSnapshot(pCommandList->m_pCommandList);
+}
+
+void Scene::CullRenderSubsystems(JobSystem<>& jobSystem) {
+    // the same camera the frame is recorded with, the input thread may move it meanwhile
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!pSnapshot || pSnapshot->camerasCount == 0) {
+        return;
+    }
+    const DirectX::XMMATRIX& viewProjection{ pSnapshot->sceneBuffer.viewProjMatrix };
+    FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(viewProjection) };
+
+    std::unique_lock<std::mutex> occludersLock(m_occludersMutex);
+    m_occlusionBuffer.Render(viewProjection, m_occluders, jobSystem);
+    occludersLock.unlock();
+    const SoftwareOcclusion::OcclusionBuffer* pOcclusionBuffer{
+        m_occlusionBuffer.HasOccluders() ? &m_occlusionBuffer : nullptr
+    };
+
+    for (auto& pRenderSubsystem : m_pRenderSubsystems) {
+        pRenderSubsystem->Cull(frustum, viewProjection, jobSystem, pOcclusionBuffer);
+    }
+}
+
+uint32_t Scene::GetRecordingChunksCount(RenderSubsystemId subsystemId) const {
+    return m_pRenderSubsystems[subsystemId]->GetRecordingChunksCount();
+}
+
+void Scene::AddOccluder(SoftwareOcclusion::Occluder occluder) {
+    std::scoped_lock<std::mutex> lock(m_occludersMutex);
+    m_occluders.push_back(std::move(occluder));
+}
+
+void Scene::ClearOccluders() {
+    std::scoped_lock<std::mutex> lock(m_occludersMutex);
+    m_occluders.clear();
 }
 
 void Scene::AddCamera(const std::shared_ptr<Camera>&& pCamera) {
@@ -125,30 +156,23 @@ void Scene::SetAmbientLight(
     const DirectX::XMFLOAT3& color,
     const float& power
 ) {
-    std::scoped_lock<std::mutex> lock(m_lightBufferMutex);
+    std::scoped_lock<std::mutex> lock(m_lightsMutex);
 
-    m_lightBuffer.ambientColorAndPower = {
+    m_ambientColorAndPower = {
         color.x,
         color.y,
         color.z,
         power
     };
-
-    m_isUpdateLightCB.store(true);
 }
-bool Scene::AddLightSource(
+void Scene::AddLightSource(
     const DirectX::XMFLOAT4& position,
     const DirectX::XMFLOAT3& diffuseColor,
     const DirectX::XMFLOAT3& specularColor,
     const float& diffusePower,
     const float& specularPower
 ) {
-    std::scoped_lock<std::mutex> lock(m_lightBufferMutex);
-    if (m_lightBuffer.lightsCount.x == LIGHTS_MAX_COUNT) {
-        return false;
-    }
-
-    m_lightBuffer.lights[m_lightBuffer.lightsCount.x++] = {
+    Light light{
         position,
         {
             diffuseColor.x,
@@ -163,32 +187,150 @@ bool Scene::AddLightSource(
             specularPower
         }
     };
+    // w is the range the clusters are built with
+    light.position.w = ClusteredLighting::GetLightRange(light);
+
+    std::scoped_lock<std::mutex> lock(m_lightsMutex);
+    m_lights.push_back(light);
+}
 
-    m_isUpdateLightCB.store(true);
+ClusterStats Scene::GetClusterStats() const {
+    return m_clusterGrid.GetStats();
+}
+
+Scene::ObjectHandle Scene::AddStaticObject(std::shared_ptr<RenderObject> pObject) const {
+    return AddObject(Static, pObject);
+}
+Scene::ObjectHandle Scene::AddDynamicObject(std::shared_ptr<RenderObject> pObject) const {
+    return AddObject(Dynamic, pObject);
+}
+Scene::ObjectHandle Scene::AddStaticAlphaKillObject(std::shared_ptr<RenderObject> pObject) const {
+    return AddObject(StaticAlphaKill, pObject);
+}
+Scene::ObjectHandle Scene::AddDynamicAlphaKillObject(std::shared_ptr<RenderObject> pObject) const {
+    return AddObject(DynamicAlphaKill, pObject);
+}
+bool Scene::RemoveObject(const ObjectHandle& handle) const {
+    if (!m_pRenderSubsystems.at(handle.subsystemId)->Remove(handle.handle)) {
+        return false;
+    }
+    if (handle.bvhLeafId != DynamicBvh<ObjectHandle>::nullId) {
+        GetBvh(handle.subsystemId)->Remove(handle.bvhLeafId);
+    }
     return true;
 }
+bool Scene::UpdateObject(const ObjectHandle& handle) const {
+    auto& pRenderSubsystem{ m_pRenderSubsystems.at(handle.subsystemId) };
+    if (!pRenderSubsystem->Update(handle.handle)) {
+        return false;
+    }
+    if (handle.bvhLeafId != DynamicBvh<ObjectHandle>::nullId) {
+        DirectX::BoundingSphere sphere{ pRenderSubsystem->Get(handle.handle)->GetBoundingSphere() };
+        GetBvh(handle.subsystemId)->Move(
+            handle.bvhLeafId,
+            DirectX::BoundingBox(sphere.Center, DirectX::XMFLOAT3(sphere.Radius, sphere.Radius, sphere.Radius))
+        );
+    }
+    return true;
+}
+
+void Scene::AttachObject(const ObjectHandle& handle, TransformHierarchy::Handle transform) {
+    std::scoped_lock<std::mutex> lock(m_transformsMutex);
+    std::erase_if(m_transformObjects, [&handle](const auto& transformObject) {
+        const ObjectHandle& attached{ transformObject.second };
+        return attached.subsystemId == handle.subsystemId &&
+            attached.handle.slotId == handle.handle.slotId &&
+            attached.handle.generation == handle.handle.generation;
+    });
+    if (transform != TransformHierarchy::nullHandle) {
+        m_transformObjects.emplace(transform, handle);
+        m_changedTransforms.push_back(transform);
+    }
+}
 
-void Scene::AddStaticObject(std::shared_ptr<RenderObject> pObject) const {
-    m_pRenderSubsystems[Static]->Add(pObject);
+void Scene::UpdateTransforms(JobSystem<>& jobSystem) {
+    std::scoped_lock<std::mutex> lock(m_transformsMutex);
+    m_transformHierarchy.Update(jobSystem, m_changedTransforms);
+
+    for (TransformHierarchy::Handle transform : m_changedTransforms) {
+        if (!m_transformHierarchy.IsValid(transform)) {
+            continue;
+        }
+        DirectX::XMMATRIX worldMatrix{ m_transformHierarchy.GetWorldMatrix(transform) };
+        DirectX::XMMATRIX normalMatrix{ m_transformHierarchy.GetNormalMatrix(transform) };
+        auto [it, end]{ m_transformObjects.equal_range(transform) };
+        while (it != end) {
+            const ObjectHandle& handle{ it->second };
+            std::shared_ptr<RenderObject> pObject{ m_pRenderSubsystems.at(handle.subsystemId)->Get(handle.handle) };
+            if (!pObject) {
+                it = m_transformObjects.erase(it);
+                continue;
+            }
+            pObject->SetWorldMatrices(worldMatrix, normalMatrix);
+            UpdateObject(handle);
+            ++it;
+        }
+    }
+    m_changedTransforms.clear();
 }
-void Scene::AddDynamicObject(std::shared_ptr<RenderObject> pObject) const {
-    m_pRenderSubsystems[Dynamic]->Add(pObject);
+
+std::vector<Scene::ObjectHandle> Scene::QueryObjects(const FrustumCulling::Frustum& frustum, JobSystem<>* pJobSystem) const {
+    std::vector<ObjectHandle> handles{};
+    m_pStaticBvh->Query(frustum, handles, pJobSystem);
+    m_pDynamicBvh->Query(frustum, handles, pJobSystem);
+    return handles;
 }
-void Scene::AddStaticAlphaKillObject(std::shared_ptr<RenderObject> pObject) const {
-    m_pRenderSubsystems[StaticAlphaKill]->Add(pObject);
+
+std::vector<Scene::ObjectHandle> Scene::QueryObjects(const DirectX::BoundingSphere& sphere, JobSystem<>* pJobSystem) const {
+    std::vector<ObjectHandle> handles{};
+    m_pStaticBvh->Query(sphere, handles, pJobSystem);
+    m_pDynamicBvh->Query(sphere, handles, pJobSystem);
+    return handles;
+}
+
+std::vector<Scene::ObjectHandle> Scene::QueryObjects(
+    const DirectX::XMFLOAT3& origin,
+    const DirectX::XMFLOAT3& direction,
+    float maxDistance,
+    JobSystem<>* pJobSystem
+) const {
+    std::vector<ObjectHandle> handles{};
+    m_pStaticBvh->Query(origin, direction, maxDistance, handles, pJobSystem);
+    m_pDynamicBvh->Query(origin, direction, maxDistance, handles, pJobSystem);
+    return handles;
 }
-void Scene::AddDynamicAlphaKillObject(std::shared_ptr<RenderObject> pObject) const {
-    m_pRenderSubsystems[DynamicAlphaKill]->Add(pObject);
+
+Scene::ObjectHandle Scene::AddObject(RenderSubsystemId subsystemId, std::shared_ptr<RenderObject> pObject) const {
+    ObjectHandle handle{ subsystemId, m_pRenderSubsystems[subsystemId]->Add(pObject) };
+    DirectX::BoundingSphere sphere{ pObject->GetBoundingSphere() };
+    if (std::isfinite(sphere.Radius)) {
+        std::shared_ptr<DynamicBvh<ObjectHandle>> pBvh{ GetBvh(subsystemId) };
+        DirectX::BoundingBox box(sphere.Center, DirectX::XMFLOAT3(sphere.Radius, sphere.Radius, sphere.Radius));
+        handle.bvhLeafId = pBvh->Insert(box, handle);
+        // queries return the handle with its own leaf id
+        pBvh->SetUserData(handle.bvhLeafId, handle);
+    }
+    return handle;
+}
+
+std::shared_ptr<DynamicBvh<Scene::ObjectHandle>> Scene::GetBvh(size_t subsystemId) const {
+    return subsystemId == Static || subsystemId == StaticAlphaKill ? m_pStaticBvh : m_pDynamicBvh;
 }
 
 void Scene::RenderStaticObjects(
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
     D3D12_VIEWPORT viewport,
     D3D12_RECT scissorRect,
-    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView
+    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
+    std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
+    GpuCulling::Phase cullingPhase,
+    uint32_t chunkId,
+    uint32_t chunksCount
 ) {
-    if (std::scoped_lock<std::mutex> lock(m_camerasMutex); !m_isSceneReady.load() || m_pCameras.empty())
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!pSnapshot || pSnapshot->camerasCount == 0 || pSnapshot->objectsCounts[Static] == 0) {
         return;
+    }
 
     std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> rtvs;
     if (m_pGBuffer) {
@@ -213,14 +355,20 @@ void Scene::RenderStaticObjects(
 
         pCommandList->SetGraphicsRootConstantBufferView(
             0,
-            m_sceneCBDynamicAllocation.gpuAddress
+            pSnapshot->sceneCbAddress
         );
+        if (m_pGBuffer && m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility) {
+            pCommandList->SetGraphicsRoot32BitConstant(TestTextureRenderObject::subsystemIdRootParameterIndex, Static, 0);
+        }
     };
 
-    std::scoped_lock<std::mutex> sceneCBMutex(m_sceneBufferMutex);
     m_pRenderSubsystems[Static]->Render(
         pCommandList,
-        commandListPrepare
+        commandListPrepare,
+        cullingPhase,
+        GetHzbView(pResDescHeapManager),
+        chunkId,
+        chunksCount
     );
 }
 
@@ -228,10 +376,14 @@ void Scene::RenderDynamicObjects(
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
     D3D12_VIEWPORT viewport,
     D3D12_RECT scissorRect,
-    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView
+    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
+    uint32_t chunkId,
+    uint32_t chunksCount
 ) {
-    if (std::scoped_lock<std::mutex> lock(m_camerasMutex); !m_isSceneReady.load() || m_pCameras.empty())
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!pSnapshot || pSnapshot->camerasCount == 0 || pSnapshot->objectsCounts[Dynamic] == 0) {
         return;
+    }
 
     std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> rtvs;
     if (m_pGBuffer) {
@@ -256,14 +408,20 @@ void Scene::RenderDynamicObjects(
 
         pCommandList->SetGraphicsRootConstantBufferView(
             0,
-            m_sceneCBDynamicAllocation.gpuAddress
+            pSnapshot->sceneCbAddress
         );
+        if (m_pGBuffer && m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility) {
+            pCommandList->SetGraphicsRoot32BitConstant(TestTextureRenderObject::subsystemIdRootParameterIndex, Dynamic, 0);
+        }
         };
 
-    std::scoped_lock<std::mutex> sceneCBMutex(m_sceneBufferMutex);
     m_pRenderSubsystems[Dynamic]->Render(
         pCommandList,
-        commandListPrepare
+        commandListPrepare,
+        GpuCulling::Phase::Frustum,
+        {},
+        chunkId,
+        chunksCount
     );
 }
 
@@ -273,10 +431,15 @@ void Scene::RenderStaticAlphaKillObjects(
     D3D12_RECT scissorRect,
     D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
     std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
-    std::shared_ptr<MaterialManager> pMaterialManager
+    std::shared_ptr<MaterialManager> pMaterialManager,
+    GpuCulling::Phase cullingPhase,
+    uint32_t chunkId,
+    uint32_t chunksCount
 ) {
-    if (std::scoped_lock<std::mutex> lock(m_camerasMutex); !m_isSceneReady.load() || m_pCameras.empty())
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!pSnapshot || pSnapshot->camerasCount == 0 || pSnapshot->objectsCounts[StaticAlphaKill] == 0) {
         return;
+    }
 
     std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> rtvs;
     if (m_pGBuffer) {
@@ -301,17 +464,23 @@ void Scene::RenderStaticAlphaKillObjects(
 
         pCommandList->SetGraphicsRootConstantBufferView(
             0,
-            m_sceneCBDynamicAllocation.gpuAddress
+            pSnapshot->sceneCbAddress
         );
         pCommandList->SetDescriptorHeaps(1, pResDescHeapManager->GetDescriptorHeap().GetAddressOf());
-        pCommandList->SetGraphicsRootDescriptorTable(2, pMaterialManager->GetMaterialCBVsRange()->GetGpuHandle());
-        pCommandList->SetGraphicsRootDescriptorTable(3, pMaterialManager->GetMaterialSRVsRange()->GetGpuHandle());
+        pCommandList->SetGraphicsRootDescriptorTable(4, pMaterialManager->GetMaterialCBVsRange()->GetGpuHandle());
+        pCommandList->SetGraphicsRootDescriptorTable(5, pMaterialManager->GetMaterialSRVsRange()->GetGpuHandle());
+        if (m_pGBuffer && m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility) {
+            pCommandList->SetGraphicsRoot32BitConstant(TestAlphaRenderObject::subsystemIdRootParameterIndex, StaticAlphaKill, 0);
+        }
         };
 
-    std::scoped_lock<std::mutex> sceneCBMutex(m_sceneBufferMutex);
     m_pRenderSubsystems[StaticAlphaKill]->Render(
         pCommandList,
-        commandListPrepare
+        commandListPrepare,
+        cullingPhase,
+        GetHzbView(pResDescHeapManager),
+        chunkId,
+        chunksCount
     );
 }
 
@@ -321,10 +490,14 @@ void Scene::RenderDynamicAlphaKillObjects(
     D3D12_RECT scissorRect,
     D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
     std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
-    std::shared_ptr<MaterialManager> pMaterialManager
+    std::shared_ptr<MaterialManager> pMaterialManager,
+    uint32_t chunkId,
+    uint32_t chunksCount
 ) {
-    if (std::scoped_lock<std::mutex> lock(m_camerasMutex); !m_isSceneReady.load() || m_pCameras.empty())
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!pSnapshot || pSnapshot->camerasCount == 0 || pSnapshot->objectsCounts[DynamicAlphaKill] == 0) {
         return;
+    }
 
     std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> rtvs;
     if (m_pGBuffer) {
@@ -349,37 +522,83 @@ void Scene::RenderDynamicAlphaKillObjects(
 
         pCommandList->SetGraphicsRootConstantBufferView(
             0,
-            m_sceneCBDynamicAllocation.gpuAddress
+            pSnapshot->sceneCbAddress
         );
         pCommandList->SetDescriptorHeaps(1, pResDescHeapManager->GetDescriptorHeap().GetAddressOf());
-        pCommandList->SetGraphicsRootDescriptorTable(2, pMaterialManager->GetMaterialCBVsRange()->GetGpuHandle());
-        pCommandList->SetGraphicsRootDescriptorTable(3, pMaterialManager->GetMaterialSRVsRange()->GetGpuHandle());
+        pCommandList->SetGraphicsRootDescriptorTable(4, pMaterialManager->GetMaterialCBVsRange()->GetGpuHandle());
+        pCommandList->SetGraphicsRootDescriptorTable(5, pMaterialManager->GetMaterialSRVsRange()->GetGpuHandle());
+        if (m_pGBuffer && m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility) {
+            pCommandList->SetGraphicsRoot32BitConstant(TestAlphaRenderObject::subsystemIdRootParameterIndex, DynamicAlphaKill, 0);
+        }
         };
 
-    std::scoped_lock<std::mutex> sceneCBMutex(m_sceneBufferMutex);
     m_pRenderSubsystems[DynamicAlphaKill]->Render(
         pCommandList,
-        commandListPrepare
+        commandListPrepare,
+        GpuCulling::Phase::Frustum,
+        {},
+        chunkId,
+        chunksCount
     );
 }
 
+GpuCulling::HzbView Scene::GetHzbView(std::shared_ptr<DescriptorHeapManager> pResDescHeapManager) const {
+    // without an HZB the depth SRV fills the table, the frustum phase never reads it
+    // the size is the depth's, the HZB is padded after it
+    std::shared_ptr<Texture> pHZB{ m_pDepthBuffer->GetHZBTexture() };
+    D3D12_RESOURCE_DESC depthDesc{ m_pDepthBuffer->GetTexture()->GetResource()->GetDesc() };
+    D3D12_RESOURCE_DESC resDesc{ (pHZB ? pHZB : m_pDepthBuffer->GetTexture())->GetResource()->GetDesc() };
+    return GpuCulling::HzbView{
+        .pDescHeap{ pResDescHeapManager->GetDescriptorHeap().Get() },
+        .srvHandle{ pHZB ? m_pDepthBuffer->GetSrvGpuDescHandleWithMips() : m_pDepthBuffer->GetSrvGpuDescHandle() },
+        .width{ static_cast<uint32_t>(depthDesc.Width) },
+        .height{ depthDesc.Height },
+        .mipsCount{ resDesc.MipLevels }
+    };
+}
+
 void Scene::SetDeferredShadingComputeObject(std::shared_ptr<ComputeObject> pDeferredShadingCO) {
     m_pDeferredShadingComputeObject = pDeferredShadingCO;
 }
 
+void Scene::SetLightClusterBuilder(std::shared_ptr<ComputeObject> pLightClusterBuilder) {
+    m_pLightClusterBuilder = pLightClusterBuilder;
+}
+
+void Scene::BuildLightClusters(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListCompute) {
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!m_pLightClusterBuilder || !pSnapshot || pSnapshot->camerasCount == 0) {
+        return;
+    }
+
+    m_clusterGrid.RecordBuild(
+        pCommandListCompute,
+        m_pLightClusterBuilder,
+        pSnapshot->lightingConstants.clusters,
+        pSnapshot->lightsAddress
+    );
+}
+
+const ClusteredLighting::ClusterGrid& Scene::GetClusterGrid() const {
+    return m_clusterGrid;
+}
+
 void Scene::RunDeferredShading(
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListCompute,
     std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
     std::shared_ptr<MaterialManager> pMaterialManager,
+    std::shared_ptr<GeometryPool> pGeometryPool,
     UINT width,
     UINT height
 ) {
-    if (!m_pDeferredShadingComputeObject) {
+    const FrameSnapshot* pSnapshot{ GetFrameSnapshot() };
+    if (!m_pDeferredShadingComputeObject || !m_pLightClusterBuilder || !pSnapshot || pSnapshot->camerasCount == 0) {
+        return;
+    }
+    bool isVisibility{ m_pGBuffer->GetLayout() == GBuffer::Layout::Visibility };
+    if (isVisibility && !pGeometryPool) {
         return;
     }
-    UpdateLightBuffer();
-
-    std::scoped_lock<std::mutex> lightCBMutex(m_lightBufferMutex);
 
     constexpr int block_size{ 8 };
     m_pDeferredShadingComputeObject->Dispatch(
@@ -390,18 +609,36 @@ void Scene::RunDeferredShading(
         [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListCompute, UINT& rootParamId) {
             pCommandListCompute->SetComputeRootConstantBufferView(
                 rootParamId++,
-                m_sceneCBDynamicAllocation.gpuAddress
+                pSnapshot->sceneCbAddress
             );
             pCommandListCompute->SetComputeRootConstantBufferView(
                 rootParamId++,
-                m_pLightCB->GetResource()->GetGPUVirtualAddress()
+                pSnapshot->lightingCbAddress
             );
+            pCommandListCompute->SetComputeRootShaderResourceView(rootParamId++, pSnapshot->lightsAddress);
+            pCommandListCompute->SetComputeRootShaderResourceView(rootParamId++, m_clusterGrid.GetLightCountsAddress());
+            pCommandListCompute->SetComputeRootShaderResourceView(rootParamId++, m_clusterGrid.GetLightIndicesAddress());
             pCommandListCompute->SetDescriptorHeaps(1, pResDescHeapManager->GetDescriptorHeap().GetAddressOf());
             pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, m_pGBuffer->GetSrvDescHandle());
             pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, m_pGBuffer->GetUavDescHandle());
-            pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, m_pDepthBuffer->GetSrvGpuDescHandle());
+            // the visibility shading interpolates the position instead of reading the depth
+            if (!isVisibility) {
+                pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, m_pDepthBuffer->GetSrvGpuDescHandle());
+            }
             pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, pMaterialManager->GetMaterialCBVsRange()->GetGpuHandle());
             pCommandListCompute->SetComputeRootDescriptorTable(rootParamId++, pMaterialManager->GetMaterialSRVsRange()->GetGpuHandle());
+            if (isVisibility) {
+                pCommandListCompute->SetComputeRootShaderResourceView(rootParamId++, pGeometryPool->GetIndexAddress());
+                for (size_t streamId{}; streamId < GeometryPool::Stream::Count; ++streamId) {
+                    pCommandListCompute->SetComputeRootShaderResourceView(
+                        rootParamId++,
+                        pGeometryPool->GetStreamAddress(static_cast<GeometryPool::Stream>(streamId))
+                    );
+                }
+                for (auto& pRenderSubsystem : m_pRenderSubsystems) {
+                    pCommandListCompute->SetComputeRootShaderResourceView(rootParamId++, pRenderSubsystem->GetObjectDataAddress());
+                }
+            }
         }
     );
 }
@@ -458,50 +695,88 @@ bool Scene::TryUpdateCamera(float deltaTime) {
     return true;
 }
 
-void Scene::UpdateSceneBuffer(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) {
-    std::scoped_lock<std::mutex> sceneBufferMutexLock(m_sceneBufferMutex);
-    std::scoped_lock<std::mutex> camerasMutexLock(m_camerasMutex);
+const Scene::FrameSnapshot* Scene::GetFrameSnapshot() const {
+    return m_pFrameSnapshot.load(std::memory_order_acquire);
+}
 
-    std::shared_ptr<Camera> pCamera{ m_pCameras.at(m_currCameraId) };
+void Scene::PublishFrameSnapshot(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList) {
+    FrameSnapshot& snapshot{ m_frameSnapshots[GetFrameSnapshot() == &m_frameSnapshots[0] ? 1 : 0] };
 
-    m_sceneBuffer.viewProjMatrix = pCamera->GetViewProjectionMatrix();
-    m_sceneBuffer.invViewProjMatrix = DirectX::XMMatrixInverse(nullptr, m_sceneBuffer.viewProjMatrix);
+    {
+        std::scoped_lock<std::mutex> lock(m_camerasMutex);
+        snapshot.camerasCount = m_pCameras.size();
+        if (!m_pCameras.empty()) {
+            std::shared_ptr<Camera> pCamera{ m_pCameras.at(m_currCameraId) };
 
+            snapshot.sceneBuffer.viewProjMatrix = pCamera->GetViewProjectionMatrix();
+            snapshot.sceneBuffer.invViewProjMatrix = DirectX::XMMatrixInverse(nullptr, snapshot.sceneBuffer.viewProjMatrix);
 
-    DirectX::XMFLOAT3 cameraPosition{ pCamera->GetPosition() };
-    m_sceneBuffer.cameraPosition = { cameraPosition.x, cameraPosition.y, cameraPosition.z, 0.f };
-    m_sceneBuffer.nearFar = { pCamera->m_near, pCamera->m_far, 0.f, 0.f };
+            DirectX::XMFLOAT3 cameraPosition{ pCamera->GetPosition() };
+            snapshot.sceneBuffer.cameraPosition = { cameraPosition.x, cameraPosition.y, cameraPosition.z, 0.f };
+            snapshot.sceneBuffer.nearFar = { pCamera->m_near, pCamera->m_far, 0.f, 0.f };
+        }
+    }
+    if (snapshot.camerasCount > 0) {
+        snapshot.sceneCbAddress = UploadConstants(pCommandList, &snapshot.sceneBuffer, sizeof(SceneBuffer));
+    }
 
-    DynamicAllocation cpuAlloc = m_pDynamicUploadHeapCpu->Allocate(sizeof(SceneBuffer));
+    {
+        std::scoped_lock<std::mutex> lock(m_lightsMutex);
+        snapshot.lightingConstants.ambientColorAndPower = m_ambientColorAndPower;
+        snapshot.lights = m_lights;
+    }
+    if (snapshot.camerasCount > 0) {
+        snapshot.lightingConstants.clusters = ClusteredLighting::MakeClusterConstants(
+            snapshot.sceneBuffer.viewProjMatrix,
+            DirectX::XMFLOAT3{ snapshot.sceneBuffer.cameraPosition.x, snapshot.sceneBuffer.cameraPosition.y, snapshot.sceneBuffer.cameraPosition.z },
+            snapshot.sceneBuffer.nearFar.x,
+            snapshot.sceneBuffer.nearFar.y,
+            static_cast<uint32_t>(snapshot.lights.size())
+        );
+        snapshot.lightingCbAddress = UploadConstants(pCommandList, &snapshot.lightingConstants, sizeof(LightingConstants));
 
-    memcpy(cpuAlloc.cpuAddress, &m_sceneBuffer, sizeof(SceneBuffer));
+        // the builder reads nothing without lights, the address only has to be valid
+        size_t lightsSize{ std::max<size_t>(snapshot.lights.size(), 1) * sizeof(Light) };
+        DynamicAllocation lightsAlloc{ m_pDynamicUploadHeapCpu->Allocate(lightsSize) };
+        memcpy(lightsAlloc.cpuAddress, snapshot.lights.data(), snapshot.lights.size() * sizeof(Light));
+        snapshot.lightsAddress = lightsAlloc.gpuAddress;
+    }
+
+    for (size_t subsystemId{}; subsystemId < RenderSubsystemId::Count; ++subsystemId) {
+        snapshot.objectsCounts[subsystemId] = m_pRenderSubsystems[subsystemId]->GetSize();
+    }
+
+    m_pFrameSnapshot.store(&snapshot, std::memory_order_release);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS Scene::UploadConstants(
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+    const void* pData,
+    size_t size
+) {
+    DynamicAllocation cpuAlloc = m_pDynamicUploadHeapCpu->Allocate(size);
+
+    memcpy(cpuAlloc.cpuAddress, pData, size);
 
-    m_sceneCBDynamicAllocation = m_pDynamicUploadHeapGpu->Allocate(sizeof(SceneBuffer));
+    DynamicAllocation gpuAlloc = m_pDynamicUploadHeapGpu->Allocate(size);
     ResourceTransition(
         pCommandList,
-        m_sceneCBDynamicAllocation.pBuffer->GetResource(),
+        gpuAlloc.pBuffer->GetResource(),
         D3D12_RESOURCE_STATE_GENERIC_READ,
         D3D12_RESOURCE_STATE_COPY_DEST
     );
     pCommandList->CopyBufferRegion(
-        m_sceneCBDynamicAllocation.pBuffer->GetResource().Get(),
-        m_sceneCBDynamicAllocation.offset,
+        gpuAlloc.pBuffer->GetResource().Get(),
+        gpuAlloc.offset,
         cpuAlloc.pBuffer->GetResource().Get(),
         cpuAlloc.offset,
-        sizeof(SceneBuffer)
+        size
     );
     ResourceTransition(
         pCommandList,
-        m_sceneCBDynamicAllocation.pBuffer->GetResource(),
+        gpuAlloc.pBuffer->GetResource(),
         D3D12_RESOURCE_STATE_COPY_DEST,
         D3D12_RESOURCE_STATE_GENERIC_READ
     );
-}
-
-void Scene::UpdateLightBuffer() {
-    bool expected{ true };
-    if (m_isUpdateLightCB.compare_exchange_strong(expected, false)) {
-        std::scoped_lock<std::mutex> lock(m_lightBufferMutex);
-        m_pLightCB->Update(&m_lightBuffer);
-    }
+    return gpuAlloc.gpuAddress;
 }
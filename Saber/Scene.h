@@ -3,23 +3,29 @@
 #include "Headers.h"
 
 #include <mutex>
+#include <unordered_map>
 
 #include "Camera.h"
 #include "CommandQueue.h"
+#include "ClusterGrid.h"
 #include "CommandList.h"
-#include "ConstantBuffer.h"
 #include "ComputeObject.h"
 #include "DepthBuffer.h"
+#include "DynamicBvh.h"
 #include "DynamicUploadRingBuffer.h"
+#include "FrustumCulling.h"
 #include "GBuffer.h"
+#include "GpuCulling.h"
+#include "JobSystem.h"
 #include "MeshRenderObject.h"
 #include "PostProcessing.h"
 #include "RenderSubsystem.h"
+#include "SoftwareOcclusion.h"
 #include "Texture.h"
+#include "TransformHierarchy.h"
+#include "VisibilityData.h"
 
 class Scene {
-    static constexpr size_t LIGHTS_MAX_COUNT{ 10 };
-
     std::wstring m_name{};
 
     struct SceneBuffer {
@@ -27,28 +33,17 @@ class Scene {
         DirectX::XMMATRIX invViewProjMatrix{};
         DirectX::XMFLOAT4 cameraPosition{};
         DirectX::XMFLOAT4 nearFar{};
-    } m_sceneBuffer;
-    std::mutex m_sceneBufferMutex{};
+    };
     std::shared_ptr<DynamicUploadHeap> m_pDynamicUploadHeapCpu{};
     std::shared_ptr<DynamicUploadHeap> m_pDynamicUploadHeapGpu{};
-    DynamicAllocation m_sceneCBDynamicAllocation{};
-    std::atomic<bool> m_isUpdSceneCb{ true };
-    std::shared_ptr<ConstantBuffer> m_pSceneCb{};
-
-    struct Light {
-        DirectX::XMFLOAT4 position{};
-        DirectX::XMFLOAT4 diffuseColorAndPower{};
-        DirectX::XMFLOAT4 specularColorAndPower{};
-    };
-    struct LightBuffer {
-        DirectX::XMFLOAT4 ambientColorAndPower{ 0.5f, 0.5f, 0.5f, 1.f };
-        DirectX::XMUINT4 lightsCount{};
-        Light lights[LIGHTS_MAX_COUNT]{};
-    } m_lightBuffer;
-    std::mutex m_lightBufferMutex{};
-    std::shared_ptr<ConstantBuffer> m_pLightCB{};
-    std::atomic<bool> m_isUpdateLightCB{};
 
+    // any number of lights, each pixel is shaded by the ones reaching its cluster
+    DirectX::XMFLOAT4 m_ambientColorAndPower{ 0.5f, 0.5f, 0.5f, 1.f };
+    std::vector<Light> m_lights{};
+    std::mutex m_lightsMutex{};
+    ClusteredLighting::ClusterGrid m_clusterGrid;
+
+public:
     enum RenderSubsystemId {
 	    Static = 0,
         Dynamic = 1,
@@ -56,11 +51,18 @@ class Scene {
         DynamicAlphaKill = 3,
         Count = 4
     };
-    std::vector<std::shared_ptr<RenderSubsystem<CbMesh4IndirectCommand>>> m_pRenderSubsystems{};
+
+private:
+    std::vector<std::shared_ptr<RenderSubsystem<IdIndirectCommand>>> m_pRenderSubsystems{};
     //std::shared_ptr<RenderSubsystem<CbMesh4IndirectCommand>> m_pStaticRenderSubsystem{};
     //std::shared_ptr<RenderSubsystem<CbMesh4IndirectCommand>> m_pDynamicRenderSubsystem{};
     //std::shared_ptr<RenderSubsystem<CbMesh4IndirectCommand>> m_pAlphaRenderSubsystem{};
 
+    // rasterized on the CPU every frame, objects culled on the CPU are tested against them
+    std::vector<SoftwareOcclusion::Occluder> m_occluders{};
+    std::mutex m_occludersMutex{};
+    SoftwareOcclusion::OcclusionBuffer m_occlusionBuffer{ 256, 144 };
+
     std::vector<std::shared_ptr<Camera>> m_pCameras{};
     std::mutex m_camerasMutex{};
     std::atomic<bool> m_isUpdateCamera{};
@@ -68,12 +70,30 @@ class Scene {
 
     std::atomic<bool> m_isSceneReady{};
 
+    // What recording reads, built by Update and published at once. A published snapshot isn't changed,
+    // so the recording jobs read it without locks. Update writes the other one, which was last read
+    // by the previous frame's recording, finished before the next Update.
+    struct FrameSnapshot {
+        size_t camerasCount{};
+        SceneBuffer sceneBuffer{};
+        D3D12_GPU_VIRTUAL_ADDRESS sceneCbAddress{};
+        std::vector<Light> lights{};
+        // read as a root SRV straight from the upload ring buffer
+        D3D12_GPU_VIRTUAL_ADDRESS lightsAddress{};
+        LightingConstants lightingConstants{};
+        D3D12_GPU_VIRTUAL_ADDRESS lightingCbAddress{};
+        size_t objectsCounts[RenderSubsystemId::Count]{};
+    };
+    FrameSnapshot m_frameSnapshots[2]{};
+    std::atomic<const FrameSnapshot*> m_pFrameSnapshot{};
+
     std::shared_ptr<DepthBuffer> m_pDepthBuffer{};
     std::shared_ptr<GBuffer> m_pGBuffer{};
 
     std::shared_ptr<PostProcessing> m_pPostProcessing{};
 
     std::shared_ptr<ComputeObject> m_pDeferredShadingComputeObject{};
+    std::shared_ptr<ComputeObject> m_pLightClusterBuilder{};
 
 public:
     Scene() = delete;
@@ -91,15 +111,18 @@ public:
         Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
         std::shared_ptr<DescriptorHeapManager> pDescHeapManagerCbvSrvUav,
         std::shared_ptr<DynamicUploadHeap> pDynamicUploadHeap,
-        std::shared_ptr<ComputeObject> pIndirectUpdater
+        std::shared_ptr<ComputeObject> pIndirectUpdater,
+        std::shared_ptr<ComputeObject> pIndirectCuller = nullptr
     ) {
+        // static bounds are uploaded once and culled on the GPU, dynamic ones are culled where they change
         for (size_t i{}; i < RenderSubsystemId::Count; ++i) {
             m_pRenderSubsystems[i]->InitializeIndirectCommandBuffer(
                 pDevice,
                 pAllocator,
                 pDescHeapManagerCbvSrvUav,
                 pDynamicUploadHeap,
-                i == Static || i == StaticAlphaKill ? nullptr : pIndirectUpdater
+                i == Static || i == StaticAlphaKill ? nullptr : pIndirectUpdater,
+                i == Static || i == StaticAlphaKill ? pIndirectCuller : nullptr
             );
         }
     }
@@ -120,6 +143,12 @@ public:
         }
     }
 
+    // culls against the current camera, call before UpdateRenderSubsystems
+    void CullRenderSubsystems(JobSystem<>& jobSystem);
+
+    void AddOccluder(SoftwareOcclusion::Occluder occluder);
+    void ClearOccluders();
+
     void SetSceneReadiness(bool value);
     bool IsSceneReady();
 
@@ -148,29 +177,76 @@ public:
         const DirectX::XMFLOAT3& color,
         const float& power = 1.f
     );
-    bool AddLightSource(
+    void AddLightSource(
         const DirectX::XMFLOAT4& position,
         const DirectX::XMFLOAT3& diffuseColor,
         const DirectX::XMFLOAT3& specularColor,
         const float& diffusePower = 1.f,
         const float& specularPower = 1.f
     );
+    // tells if the clusters dropped lights a few frames ago
+    ClusterStats GetClusterStats() const;
+
+    struct ObjectHandle {
+        size_t subsystemId{};
+        RenderSubsystem<IdIndirectCommand>::Handle handle{};
+        // leaf in the static or dynamic BVH, objects without finite bounds aren't in one
+        uint32_t bvhLeafId{ std::numeric_limits<uint32_t>::max() };
+    };
+
+    ObjectHandle AddStaticObject(std::shared_ptr<RenderObject> pObject) const;
+    ObjectHandle AddDynamicObject(std::shared_ptr<RenderObject> pObject) const;
+    ObjectHandle AddStaticAlphaKillObject(std::shared_ptr<RenderObject> pObject) const;
+    ObjectHandle AddDynamicAlphaKillObject(std::shared_ptr<RenderObject> pObject) const;
+    // false if the object was already removed
+    bool RemoveObject(const ObjectHandle& handle) const;
+    // uploads the object data and moves it in the BVH after its transform has changed
+    bool UpdateObject(const ObjectHandle& handle) const;
 
-    void AddStaticObject(std::shared_ptr<RenderObject> pObject) const;
-    void AddDynamicObject(std::shared_ptr<RenderObject> pObject) const;
-    void AddStaticAlphaKillObject(std::shared_ptr<RenderObject> pObject) const;
-    void AddDynamicAlphaKillObject(std::shared_ptr<RenderObject> pObject) const;
+    // Nodes may be changed from any thread that doesn't run UpdateTransforms at the same time.
+    TransformHierarchy& GetTransformHierarchy() {
+        return m_transformHierarchy;
+    }
+    // The object follows the node from the next UpdateTransforms on, several objects can follow one node
+    // like the primitives of a model. Objects of a removed node have to be attached elsewhere or removed too.
+    // nullHandle detaches the object.
+    void AttachObject(const ObjectHandle& handle, TransformHierarchy::Handle transform);
+    // Updates the changed subtrees and passes their matrices to the attached objects, which are updated like in UpdateObject.
+    // Removed objects are detached. The calling thread must not be a job system worker.
+    void UpdateTransforms(JobSystem<>& jobSystem);
+
+    // Objects whose bounds intersect the query, in no particular order. Static objects are kept in a SAH built BVH,
+    // dynamic ones in an incrementally updated one. With a job system subtrees are traversed by its workers.
+    std::vector<ObjectHandle> QueryObjects(const FrustumCulling::Frustum& frustum, JobSystem<>* pJobSystem = nullptr) const;
+    std::vector<ObjectHandle> QueryObjects(const DirectX::BoundingSphere& sphere, JobSystem<>* pJobSystem = nullptr) const;
+    // the direction has to be normalized
+    std::vector<ObjectHandle> QueryObjects(
+        const DirectX::XMFLOAT3& origin,
+        const DirectX::XMFLOAT3& direction,
+        float maxDistance,
+        JobSystem<>* pJobSystem = nullptr
+    ) const;
+    // Large subsystems are recorded in chunks, every chunk can go to its own list, see RenderSubsystem::Render
+    uint32_t GetRecordingChunksCount(RenderSubsystemId subsystemId) const;
+    // Static subsystems are culled on the GPU. With an HZB they are rendered twice a frame:
+    // the early phase before the HZB is built from its depth, the late phase after.
     void RenderStaticObjects(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
         D3D12_VIEWPORT viewport,
         D3D12_RECT scissorRect,
-        D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView
+        D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
+        std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
+        GpuCulling::Phase cullingPhase = GpuCulling::Phase::Frustum,
+        uint32_t chunkId = 0,
+        uint32_t chunksCount = 1
     );
     void RenderDynamicObjects(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
         D3D12_VIEWPORT viewport,
         D3D12_RECT scissorRect,
-        D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView
+        D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
+        uint32_t chunkId = 0,
+        uint32_t chunksCount = 1
     );
     void RenderStaticAlphaKillObjects(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
@@ -178,7 +254,10 @@ public:
         D3D12_RECT scissorRect,
         D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
         std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
-        std::shared_ptr<MaterialManager> pMaterialManager
+        std::shared_ptr<MaterialManager> pMaterialManager,
+        GpuCulling::Phase cullingPhase = GpuCulling::Phase::Frustum,
+        uint32_t chunkId = 0,
+        uint32_t chunksCount = 1
     );
     void RenderDynamicAlphaKillObjects(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListDirect,
@@ -186,14 +265,25 @@ public:
         D3D12_RECT scissorRect,
         D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
         std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
-        std::shared_ptr<MaterialManager> pMaterialManager
+        std::shared_ptr<MaterialManager> pMaterialManager,
+        uint32_t chunkId = 0,
+        uint32_t chunksCount = 1
     );
 
+    // DeferredShading or VisibilityShading, whichever reads the layout of the G-buffer
     void SetDeferredShadingComputeObject(std::shared_ptr<ComputeObject> pDeferredShadingCO);
+    void SetLightClusterBuilder(std::shared_ptr<ComputeObject> pLightClusterBuilder);
+    // Fills the cluster grid with the lights of the frame snapshot. Only reads the lights,
+    // so it runs on the compute queue while the direct one draws the geometry.
+    void BuildLightClusters(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListCompute);
+    const ClusteredLighting::ClusterGrid& GetClusterGrid() const;
+    // reads the clusters BuildLightClusters filled
+    // With GBuffer::Layout::Visibility the shading fetches the triangles from the geometry pool of the objects.
     void RunDeferredShading(
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandListCompute,
         std::shared_ptr<DescriptorHeapManager> pResDescHeapManager,
         std::shared_ptr<MaterialManager> pMaterialManager,
+        std::shared_ptr<GeometryPool> pGeometryPool,
         UINT width,
         UINT height
     );
@@ -208,8 +298,29 @@ public:
     );
 
 private:
+    std::shared_ptr<DynamicBvh<ObjectHandle>> m_pStaticBvh{ std::make_shared<DynamicBvh<ObjectHandle>>(true) };
+    std::shared_ptr<DynamicBvh<ObjectHandle>> m_pDynamicBvh{ std::make_shared<DynamicBvh<ObjectHandle>>(false) };
+
+    TransformHierarchy m_transformHierarchy{};
+    std::unordered_multimap<TransformHierarchy::Handle, ObjectHandle> m_transformObjects{};
+    // newly attached objects take the matrices of their node with the next update even if it hasn't changed
+    std::vector<TransformHierarchy::Handle> m_changedTransforms{};
+    std::mutex m_transformsMutex{};
+
+    ObjectHandle AddObject(RenderSubsystemId subsystemId, std::shared_ptr<RenderObject> pObject) const;
+    std::shared_ptr<DynamicBvh<ObjectHandle>> GetBvh(size_t subsystemId) const;
+
     bool TryUpdateCamera(float deltaTime);
 
-    void UpdateSceneBuffer(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList);
-    void UpdateLightBuffer();
+    GpuCulling::HzbView GetHzbView(std::shared_ptr<DescriptorHeapManager> pResDescHeapManager) const;
+
+    // null until the first Update, recording is skipped without one
+    const FrameSnapshot* GetFrameSnapshot() const;
+    void PublishFrameSnapshot(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList);
+    // copied through the ring buffers, the allocation is valid for the frame
+    D3D12_GPU_VIRTUAL_ADDRESS UploadConstants(
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> pCommandList,
+        const void* pData,
+        size_t size
+    );
 };
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "SceneFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace SceneFile {
+	namespace {
+		class LineParser {
+			std::wistringstream m_stream;
+			const std::filesystem::path& m_filepath;
+			size_t m_lineId{};
+
+		public:
+			LineParser(const std::wstring& line, const std::filesystem::path& filepath, size_t lineId)
+				: m_stream(line), m_filepath(filepath), m_lineId(lineId) {}
+
+			[[noreturn]] void Fail(const std::string& message) const {
+				throw std::runtime_error(m_filepath.string() + ":" + std::to_string(m_lineId) + ": " + message);
+			}
+
+			bool TryRead(std::wstring& token) {
+				return static_cast<bool>(m_stream >> token);
+			}
+
+			std::wstring ReadToken(const char* what) {
+				std::wstring token{};
+				if (!TryRead(token)) {
+					Fail(std::string("expected ") + what);
+				}
+				return token;
+			}
+
+			float ReadFloat(const char* what) {
+				std::wstring token{ ReadToken(what) };
+				try {
+					size_t length{};
+					float value{ std::stof(token, &length) };
+					if (length == token.size()) {
+						return value;
+					}
+				}
+				catch (const std::exception&) {}
+				Fail(std::string("expected a number for ") + what);
+			}
+
+			DirectX::XMFLOAT3 ReadFloat3(const char* what) {
+				return DirectX::XMFLOAT3{ ReadFloat(what), ReadFloat(what), ReadFloat(what) };
+			}
+
+			bool HasMore() {
+				m_stream >> std::ws;
+				return !m_stream.eof();
+			}
+
+			void ExpectEnd() {
+				if (HasMore()) {
+					Fail("unexpected trailing tokens");
+				}
+			}
+		};
+
+		uint32_t FindId(
+			const std::unordered_map<std::wstring, uint32_t>& ids,
+			const std::wstring& name,
+			LineParser& parser,
+			const char* what
+		) {
+			auto it{ ids.find(name) };
+			if (it == ids.end()) {
+				parser.Fail(std::string("unknown ") + what);
+			}
+			return it->second;
+		}
+	}
+
+	Description Load(const std::filesystem::path& filepath) {
+		std::wifstream file{ filepath };
+		if (!file) {
+			throw std::runtime_error("Can't open scene file " + filepath.string());
+		}
+
+		Description description{};
+		std::unordered_map<std::wstring, uint32_t> meshIds{};
+		std::unordered_map<std::wstring, uint32_t> materialIds{};
+
+		std::wstring line{};
+		for (size_t lineId{ 1 }; std::getline(file, line); ++lineId) {
+			if (size_t commentStart{ line.find(L'#') }; commentStart != std::wstring::npos) {
+				line.resize(commentStart);
+			}
+			LineParser parser{ line, filepath, lineId };
+			std::wstring keyword{};
+			if (!parser.TryRead(keyword)) {
+				continue;
+			}
+
+			if (keyword == L"mesh") {
+				Mesh mesh{ .name{ parser.ReadToken("a mesh name") } };
+				std::wstring source{ parser.ReadToken("cube or a glTF file") };
+				if (source != L"cube") {
+					mesh.filename = source;
+				}
+				if (!meshIds.try_emplace(mesh.name, static_cast<uint32_t>(description.meshes.size())).second) {
+					parser.Fail("duplicate mesh name");
+				}
+				description.meshes.push_back(std::move(mesh));
+			}
+			else if (keyword == L"material") {
+				Material material{
+					.name{ parser.ReadToken("a material name") },
+					.albedoFilename{ parser.ReadToken("an albedo texture") },
+					.normalFilename{ parser.ReadToken("a normal texture") }
+				};
+				if (!materialIds.try_emplace(material.name, static_cast<uint32_t>(description.materials.size())).second) {
+					parser.Fail("duplicate material name");
+				}
+				description.materials.push_back(std::move(material));
+			}
+			else if (keyword == L"object") {
+				static const std::unordered_map<std::wstring, ObjectKind> kinds{
+					{ L"static", ObjectKind::Static },
+					{ L"dynamic", ObjectKind::Dynamic },
+					{ L"static_alpha", ObjectKind::StaticAlphaKill },
+					{ L"dynamic_alpha", ObjectKind::DynamicAlphaKill }
+				};
+				auto kindIt{ kinds.find(parser.ReadToken("an object type")) };
+				if (kindIt == kinds.end()) {
+					parser.Fail("unknown object type");
+				}
+
+				Object object{ .kind{ kindIt->second } };
+				object.meshId = FindId(meshIds, parser.ReadToken("a mesh"), parser, "mesh");
+				bool isAlphaKill{ object.kind == ObjectKind::StaticAlphaKill || object.kind == ObjectKind::DynamicAlphaKill };
+				if (isAlphaKill && description.meshes[object.meshId].filename.empty()) {
+					parser.Fail("the cube has no alpha tested variant");
+				}
+				if (std::wstring materialName{ parser.ReadToken("a material or -") }; materialName != L"-") {
+					object.materialId = FindId(materialIds, materialName, parser, "material");
+				}
+				object.position = parser.ReadFloat3("the position");
+				if (parser.HasMore()) {
+					object.rotation = parser.ReadFloat3("the rotation");
+				}
+				if (parser.HasMore()) {
+					object.scale = parser.ReadFloat3("the scale");
+				}
+				description.objects.push_back(object);
+			}
+			else if (keyword == L"camera") {
+				std::wstring type{ parser.ReadToken("the camera type") };
+				Camera camera{ .isDynamic{ type == L"dynamic" } };
+				if (!camera.isDynamic) {
+					if (type != L"static") {
+						parser.Fail("unknown camera type");
+					}
+					camera.position = parser.ReadFloat3("the position");
+					camera.target = parser.ReadFloat3("the target");
+					camera.up = parser.ReadFloat3("the up direction");
+				}
+				description.cameras.push_back(camera);
+			}
+			else if (keyword == L"light") {
+				DirectX::XMFLOAT3 position{ parser.ReadFloat3("the position") };
+				Light light{
+					.position{ position.x, position.y, position.z, 1.f },
+					.diffuseColor{ parser.ReadFloat3("the diffuse color") },
+					.specularColor{ parser.ReadFloat3("the specular color") }
+				};
+				if (parser.HasMore()) {
+					light.diffusePower = parser.ReadFloat("the diffuse power");
+				}
+				if (parser.HasMore()) {
+					light.specularPower = parser.ReadFloat("the specular power");
+				}
+				description.lights.push_back(light);
+			}
+			else {
+				parser.Fail("unknown entry");
+			}
+			parser.ExpectEnd();
+		}
+
+		return description;
+	}
+
+	DirectX::XMMATRIX GetModelMatrix(const Object& object) {
+		using namespace DirectX;
+		return XMMatrixScaling(object.scale.x, object.scale.y, object.scale.z)
+			* XMMatrixRotationRollPitchYaw(
+				XMConvertToRadians(object.rotation.x),
+				XMConvertToRadians(object.rotation.y),
+				XMConvertToRadians(object.rotation.z)
+			)
+			* XMMatrixTranslation(object.position.x, object.position.y, object.position.z);
+	}
+}
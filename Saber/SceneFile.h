@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Text description of a scene, one entry per line, # starts a comment:
+//   mesh <name> cube | <glTF file in Resources/StaticModels>
+//   material <name> <albedo> <normal>                      textures in Resources/Textures
+//   object <static|dynamic|static_alpha|dynamic_alpha> <mesh> <material|-> <x y z> [<pitch yaw roll> [<sx sy sz>]]
+//   camera dynamic | static <x y z> <target x y z> <up x y z>
+//   light <x y z> <diffuse r g b> <specular r g b> [<diffuse power> [<specular power>]]
+// Meshes and materials are referenced by name and have to be declared before the objects using them,
+// "-" keeps the material the object type comes with. Angles are in degrees. The cube can't be alpha tested.
+namespace SceneFile {
+	constexpr uint32_t nullId{ std::numeric_limits<uint32_t>::max() };
+
+	enum class ObjectKind {
+		Static,
+		Dynamic,
+		StaticAlphaKill,
+		DynamicAlphaKill
+	};
+
+	struct Mesh {
+		std::wstring name{};
+		// empty for the built-in cube
+		std::wstring filename{};
+	};
+
+	struct Material {
+		std::wstring name{};
+		std::wstring albedoFilename{};
+		std::wstring normalFilename{};
+	};
+
+	struct Object {
+		ObjectKind kind{};
+		uint32_t meshId{};
+		uint32_t materialId{ nullId };
+		DirectX::XMFLOAT3 position{};
+		DirectX::XMFLOAT3 rotation{};
+		DirectX::XMFLOAT3 scale{ 1.f, 1.f, 1.f };
+	};
+
+	struct Camera {
+		bool isDynamic{};
+		DirectX::XMFLOAT3 position{};
+		DirectX::XMFLOAT3 target{};
+		DirectX::XMFLOAT3 up{ 0.f, 1.f, 0.f };
+	};
+
+	struct Light {
+		DirectX::XMFLOAT4 position{ 0.f, 0.f, 0.f, 1.f };
+		DirectX::XMFLOAT3 diffuseColor{};
+		DirectX::XMFLOAT3 specularColor{};
+		float diffusePower{ 1.f };
+		float specularPower{ 1.f };
+	};
+
+	struct Description {
+		std::vector<Mesh> meshes{};
+		std::vector<Material> materials{};
+		std::vector<Object> objects{};
+		std::vector<Camera> cameras{};
+		std::vector<Light> lights{};
+	};
+
+	// throws runtime_error with the line of the first malformed entry
+	Description Load(const std::filesystem::path& filepath);
+
+	// scale, then rotation, then translation
+	DirectX::XMMATRIX GetModelMatrix(const Object& object);
+}
@@ -1,4 +1,6 @@
+#include "GBufferEncoding.hlsli"
 #include "Math.hlsli"
+#include "ObjectData.hlsli"
 
 struct SceneBuffer
 {
@@ -10,15 +12,6 @@ struct SceneBuffer
 
 ConstantBuffer<SceneBuffer> SceneCB : register(b0);
 
-struct ModelBuffer
-{
-    matrix modelMatrix;
-    matrix normalMatrix;
-    uint4 materialId;
-};
-
-ConstantBuffer<ModelBuffer> ModelCB : register(b1);
-
 SamplerState s1 : register(s0);
 
 struct PSInput
@@ -27,16 +20,19 @@ struct PSInput
     float3 norm : NORMAL;
     float4 tang : TANGENT;
     float2 uv : TEXCOORD;
+    nointerpolation uint objectId : OBJECT_ID;
 };
 
 struct PSOutput
 {
-    float4 uvMaterialId : SV_Target0;
-    float4 tbn : SV_Target1;
+    uint4 uvMaterialId : SV_Target0;
+    uint4 tbn : SV_Target1;
 };
 
 PSOutput main(PSInput input)
 {
+    uint materialId = GetObjectData(input.objectId).materialId.x;
+    
     float3 t = normalize(input.tang.xyz);
     float3 n = normalize(input.norm);
     float3 b = (cross(n, t)) * input.tang.w; // no need to normalize
@@ -50,8 +46,8 @@ PSOutput main(PSInput input)
     float4 tbnQuat = matrix_to_quaternion(tbnMatrix);
     
     PSOutput output;
-    output.uvMaterialId = float4(input.uv, ModelCB.materialId.x, 0.f);
-    output.tbn = tbnQuat;
+    output.uvMaterialId = EncodeUvMaterialId(input.uv, materialId);
+    output.tbn = EncodeQuaternion(tbnQuat);
     
     return output;
 }
@@ -1,5 +1,8 @@
 #include "SinglePassDownsampler.h"
 
+#include <algorithm>
+#include <bit>
+
 SinglePassDownsampler::SinglePassDownsampler(
     Microsoft::WRL::ComPtr<ID3D12Device2> pDevice,
     Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
@@ -68,11 +71,14 @@ void SinglePassDownsampler::Resize(
     // spd constant buffer
     FfxUInt32x2 dispatchThreadGroupCountXY, workGroupOffset, numWorkGroupsAndMips;
     FfxUInt32x4 rectInfo{ 0, 0, width, height };
+    // groups only over the depth, mips down to 1x1 of the HZB which is padded to a power of two
+    FfxInt32 mips{ static_cast<FfxInt32>(std::bit_width(std::bit_ceil(std::max<UINT>(static_cast<UINT>(width), height)))) - 1 };
     ffxSpdSetup(
         dispatchThreadGroupCountXY,
         workGroupOffset,
         numWorkGroupsAndMips,
-        rectInfo
+        rectInfo,
+        mips
     );
     m_dispatchX = dispatchThreadGroupCountXY[0];
     m_dispatchY = dispatchThreadGroupCountXY[1];
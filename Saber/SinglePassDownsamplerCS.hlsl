@@ -23,17 +23,27 @@ SamplerState s_LinearClamp : register(s0);
 groupshared uint spdCounter;
 groupshared float4 spdIntermediate[16][16];
 
+uint2 GetInputSize()
+{
+    uint2 size;
+    InputTexture.GetDimensions(size.x, size.y);
+    return size;
+}
+
 // Either samples or loads from the input texture for a given UV and slice.
+// Loads past an odd side are clamped to the edge, the min of the last texel is then
+// that of the pixels it covers. The mips are padded to a power of two to keep that texel.
 float4 SpdLoadSourceImage(float2 uv, uint slice)
 {
-    return float4(InputTexture.Load(int3(uv, slice)), 0.f, 0.f, 0.f);
+    return float4(InputTexture.Load(int3(min(uint2(uv), GetInputSize() - 1), slice)), 0.f, 0.f, 0.f);
 }
 
 // Loads from separately bound MIP level 6 resource with the [globallycoherent] tag
 // for a given UV and slice. This function is only used by the last active thread group.
+// Clamped to the texels the thread groups wrote, the padding after them is never written.
 float4 SpdLoad(int2 uv, uint slice)
 {
-    return float4(TextureMip6.Load(int3(uv, slice)), 0, 0, 0);
+    return float4(TextureMip6.Load(int3(min(uint2(uv), (GetInputSize() - 1) >> 6), slice)), 0, 0, 0);
 }
 
 // Stores the output to the MIP levels. If mip value is 5, the output needs to be
@@ -71,7 +81,8 @@ void SpdResetAtomicCounter(uint slice)
 // Common reduction functions are min, max or the average.
 float4 SpdReduce4(float4 v0, float4 v1, float4 v2, float4 v3)
 {
-    return max(max(v0, v1), max(v2, v3));
+    // depth is reversed, min keeps the farthest occluder, so the HZB test stays conservative
+    return min(min(v0, v1), min(v2, v3));
 }
 
 // Loads from the group shared buffer.
@@ -0,0 +1,495 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#include <immintrin.h>
+
+namespace SoftwareOcclusion {
+	namespace {
+		constexpr size_t occludersChunkSize{ 64 };
+		constexpr size_t idsChunkSize{ 4 * 1024 };
+		constexpr uint32_t maxBandsCount{ 8 };
+		constexpr uint32_t fullMask{ ~0u };
+		// vertices closer to the camera plane than this skip their triangle
+		constexpr float minW{ 1e-5f };
+		constexpr int tileShiftX{ std::countr_zero(OcclusionBuffer::tileWidth) };
+		constexpr int tileShiftY{ std::countr_zero(OcclusionBuffer::tileHeight) };
+		static_assert(std::has_single_bit(OcclusionBuffer::tileWidth) && std::has_single_bit(OcclusionBuffer::tileHeight));
+
+		// every element of the view projection in its own register, loaded once for all batches of spheres
+		struct ViewProjectionSse {
+			__m128 m[4][4]{};
+		};
+
+		struct ViewProjectionAvx2 {
+			__m256 m[4][4]{};
+		};
+
+		// Tile ranges the boxes around a batch of spheres touch, inclusive, and the nearest depth of each box.
+		// Lanes missing from the mask are never occluded: their box crosses the camera plane or is off screen.
+		struct TileRects {
+			uint32_t minX[8]{};
+			uint32_t maxX[8]{};
+			uint32_t minY[8]{};
+			uint32_t maxY[8]{};
+			float nearestDepth[8]{};
+			uint32_t mask{};
+		};
+
+		ViewProjectionSse LoadViewProjectionSse(const DirectX::XMFLOAT4X4& viewProjection) {
+			ViewProjectionSse lanes{};
+			for (size_t row{}; row < 4; ++row) {
+				for (size_t column{}; column < 4; ++column) {
+					lanes.m[row][column] = _mm_set1_ps(viewProjection.m[row][column]);
+				}
+			}
+			return lanes;
+		}
+
+		ViewProjectionAvx2 LoadViewProjectionAvx2(const DirectX::XMFLOAT4X4& viewProjection) {
+			ViewProjectionAvx2 lanes{};
+			for (size_t row{}; row < 4; ++row) {
+				for (size_t column{}; column < 4; ++column) {
+					lanes.m[row][column] = _mm256_set1_ps(viewProjection.m[row][column]);
+				}
+			}
+			return lanes;
+		}
+
+		TileRects ProjectBoxesSse(const ViewProjectionSse& viewProjection, __m128 x, __m128 y, __m128 z, __m128 radius, uint32_t width, uint32_t height) {
+			const auto& m{ viewProjection.m };
+			// clip = v * M, corners of the box are the projected center plus or minus the projected half axes
+			__m128 center[4]{};
+			__m128 axes[3][4]{};
+			for (size_t i{}; i < 4; ++i) {
+				center[i] = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(x, m[0][i]), _mm_mul_ps(y, m[1][i])),
+					_mm_add_ps(_mm_mul_ps(z, m[2][i]), m[3][i])
+				);
+				for (size_t axis{}; axis < 3; ++axis) {
+					axes[axis][i] = _mm_mul_ps(radius, m[axis][i]);
+				}
+			}
+
+			// corner i adds axis k when bit k of i is set, built from the center one axis at a time
+			__m128 corners[8][4]{};
+			for (size_t i{}; i < 4; ++i) {
+				corners[0][i] = center[i];
+				for (size_t axis{}; axis < 3; ++axis) {
+					size_t bit{ size_t{ 1 } << axis };
+					for (size_t corner{}; corner < bit; ++corner) {
+						corners[corner | bit][i] = _mm_add_ps(corners[corner][i], axes[axis][i]);
+						corners[corner][i] = _mm_sub_ps(corners[corner][i], axes[axis][i]);
+					}
+				}
+			}
+
+			__m128 ndcMinX{ _mm_set1_ps(std::numeric_limits<float>::max()) }, ndcMinY{ ndcMinX };
+			__m128 ndcMaxX{ _mm_set1_ps(std::numeric_limits<float>::lowest()) }, ndcMaxY{ ndcMaxX }, nearestDepth{ ndcMaxX };
+			__m128 isInFront{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+			for (const __m128 (&clip)[4] : corners) {
+				isInFront = _mm_and_ps(isInFront, _mm_cmpgt_ps(clip[3], _mm_set1_ps(minW)));
+				__m128 invW{ _mm_div_ps(_mm_set1_ps(1.f), clip[3]) };
+				__m128 ndcX{ _mm_mul_ps(clip[0], invW) }, ndcY{ _mm_mul_ps(clip[1], invW) };
+				ndcMinX = _mm_min_ps(ndcMinX, ndcX);
+				ndcMinY = _mm_min_ps(ndcMinY, ndcY);
+				ndcMaxX = _mm_max_ps(ndcMaxX, ndcX);
+				ndcMaxY = _mm_max_ps(ndcMaxY, ndcY);
+				nearestDepth = _mm_max_ps(nearestDepth, _mm_mul_ps(clip[2], invW));
+			}
+
+			// pixel y points down
+			__m128 half{ _mm_set1_ps(0.5f) };
+			__m128 widthLanes{ _mm_set1_ps(static_cast<float>(width)) }, heightLanes{ _mm_set1_ps(static_cast<float>(height)) };
+			__m128 minX{ _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndcMinX, half), half), widthLanes) };
+			__m128 maxX{ _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndcMaxX, half), half), widthLanes) };
+			__m128 minY{ _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(ndcMaxY, half)), heightLanes) };
+			__m128 maxY{ _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(ndcMinY, half)), heightLanes) };
+			__m128 zero{ _mm_setzero_ps() };
+			__m128 isOnScreen{ _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(maxX, zero), _mm_cmpge_ps(maxY, zero)),
+				_mm_and_ps(_mm_cmplt_ps(minX, widthLanes), _mm_cmplt_ps(minY, heightLanes))
+			) };
+
+			TileRects rects{};
+			rects.mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(isInFront, isOnScreen)));
+			__m128 lastX{ _mm_set1_ps(width - 1.f) }, lastY{ _mm_set1_ps(height - 1.f) };
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rects.minX), _mm_srli_epi32(_mm_cvttps_epi32(_mm_max_ps(minX, zero)), tileShiftX));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rects.maxX), _mm_srli_epi32(_mm_cvttps_epi32(_mm_min_ps(maxX, lastX)), tileShiftX));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rects.minY), _mm_srli_epi32(_mm_cvttps_epi32(_mm_max_ps(minY, zero)), tileShiftY));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rects.maxY), _mm_srli_epi32(_mm_cvttps_epi32(_mm_min_ps(maxY, lastY)), tileShiftY));
+			_mm_storeu_ps(rects.nearestDepth, nearestDepth);
+			return rects;
+		}
+
+		TileRects ProjectBoxesAvx2(const ViewProjectionAvx2& viewProjection, __m256 x, __m256 y, __m256 z, __m256 radius, uint32_t width, uint32_t height) {
+			const auto& m{ viewProjection.m };
+			__m256 center[4]{};
+			__m256 axes[3][4]{};
+			for (size_t i{}; i < 4; ++i) {
+				// no FMA, the lanes round like the SSE ones and both paths occlude the same spheres
+				center[i] = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(x, m[0][i]), _mm256_mul_ps(y, m[1][i])),
+					_mm256_add_ps(_mm256_mul_ps(z, m[2][i]), m[3][i])
+				);
+				for (size_t axis{}; axis < 3; ++axis) {
+					axes[axis][i] = _mm256_mul_ps(radius, m[axis][i]);
+				}
+			}
+
+			__m256 corners[8][4]{};
+			for (size_t i{}; i < 4; ++i) {
+				corners[0][i] = center[i];
+				for (size_t axis{}; axis < 3; ++axis) {
+					size_t bit{ size_t{ 1 } << axis };
+					for (size_t corner{}; corner < bit; ++corner) {
+						corners[corner | bit][i] = _mm256_add_ps(corners[corner][i], axes[axis][i]);
+						corners[corner][i] = _mm256_sub_ps(corners[corner][i], axes[axis][i]);
+					}
+				}
+			}
+
+			__m256 ndcMinX{ _mm256_set1_ps(std::numeric_limits<float>::max()) }, ndcMinY{ ndcMinX };
+			__m256 ndcMaxX{ _mm256_set1_ps(std::numeric_limits<float>::lowest()) }, ndcMaxY{ ndcMaxX }, nearestDepth{ ndcMaxX };
+			__m256 isInFront{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+			for (const __m256 (&clip)[4] : corners) {
+				isInFront = _mm256_and_ps(isInFront, _mm256_cmp_ps(clip[3], _mm256_set1_ps(minW), _CMP_GT_OQ));
+				__m256 invW{ _mm256_div_ps(_mm256_set1_ps(1.f), clip[3]) };
+				__m256 ndcX{ _mm256_mul_ps(clip[0], invW) }, ndcY{ _mm256_mul_ps(clip[1], invW) };
+				ndcMinX = _mm256_min_ps(ndcMinX, ndcX);
+				ndcMinY = _mm256_min_ps(ndcMinY, ndcY);
+				ndcMaxX = _mm256_max_ps(ndcMaxX, ndcX);
+				ndcMaxY = _mm256_max_ps(ndcMaxY, ndcY);
+				nearestDepth = _mm256_max_ps(nearestDepth, _mm256_mul_ps(clip[2], invW));
+			}
+
+			__m256 half{ _mm256_set1_ps(0.5f) };
+			__m256 widthLanes{ _mm256_set1_ps(static_cast<float>(width)) }, heightLanes{ _mm256_set1_ps(static_cast<float>(height)) };
+			__m256 minX{ _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcMinX, half), half), widthLanes) };
+			__m256 maxX{ _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcMaxX, half), half), widthLanes) };
+			__m256 minY{ _mm256_mul_ps(_mm256_sub_ps(half, _mm256_mul_ps(ndcMaxY, half)), heightLanes) };
+			__m256 maxY{ _mm256_mul_ps(_mm256_sub_ps(half, _mm256_mul_ps(ndcMinY, half)), heightLanes) };
+			__m256 zero{ _mm256_setzero_ps() };
+			__m256 isOnScreen{ _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(maxX, zero, _CMP_GE_OQ), _mm256_cmp_ps(maxY, zero, _CMP_GE_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(minX, widthLanes, _CMP_LT_OQ), _mm256_cmp_ps(minY, heightLanes, _CMP_LT_OQ))
+			) };
+
+			TileRects rects{};
+			rects.mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(isInFront, isOnScreen)));
+			__m256 lastX{ _mm256_set1_ps(width - 1.f) }, lastY{ _mm256_set1_ps(height - 1.f) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rects.minX), _mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_max_ps(minX, zero)), tileShiftX));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rects.maxX), _mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_min_ps(maxX, lastX)), tileShiftX));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rects.minY), _mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_max_ps(minY, zero)), tileShiftY));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rects.maxY), _mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_min_ps(maxY, lastY)), tileShiftY));
+			_mm256_storeu_ps(rects.nearestDepth, nearestDepth);
+			return rects;
+		}
+	}
+
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+		: m_width(width), m_height(height), m_tilesX(width / tileWidth), m_tilesY(height / tileHeight) {
+		assert(width && height && width % tileWidth == 0 && height % tileHeight == 0);
+		m_tiles.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+		m_occluderDepths.resize(m_tiles.size() + 3);
+	}
+
+	void OcclusionBuffer::Render(
+		DirectX::FXMMATRIX viewProjection,
+		const std::vector<Occluder>& occluders,
+		JobSystem<>& jobSystem
+	) {
+		DirectX::XMStoreFloat4x4(&m_viewProjection, viewProjection);
+		std::fill(m_tiles.begin(), m_tiles.end(), Tile{});
+		std::fill(m_occluderDepths.begin(), m_occluderDepths.end(), 0.f);
+		m_hasOccluders = !occluders.empty();
+		if (!m_hasOccluders) {
+			return;
+		}
+
+		m_triangleOffsets.resize(occluders.size() + 1);
+		m_triangleOffsets[0] = 0;
+		for (size_t i{}; i < occluders.size(); ++i) {
+			m_triangleOffsets[i + 1] = m_triangleOffsets[i] + occluders[i].indices.size() / 3;
+		}
+		m_triangles.resize(m_triangleOffsets.back());
+
+		DirectX::XMMATRIX viewProjectionCopy{ viewProjection };
+		jobSystem.RunAndWait((occluders.size() + occludersChunkSize - 1) / occludersChunkSize, [&](size_t chunkId) {
+			size_t end{ std::min((chunkId + 1) * occludersChunkSize, occluders.size()) };
+			for (size_t i{ chunkId * occludersChunkSize }; i < end; ++i) {
+				SetupTriangles(occluders[i], viewProjectionCopy, m_triangles.data() + m_triangleOffsets[i]);
+			}
+		});
+
+		// bands don't share tiles, so they are rasterized without synchronization
+		uint32_t bandsCount{ std::min(m_tilesY, maxBandsCount) };
+		uint32_t bandHeight{ (m_tilesY + bandsCount - 1) / bandsCount };
+		jobSystem.RunAndWait(bandsCount, [&](size_t bandId) {
+			uint32_t tileMinY{ static_cast<uint32_t>(bandId) * bandHeight };
+			if (tileMinY < m_tilesY) {
+				RasterizeBand(tileMinY, std::min(tileMinY + bandHeight, m_tilesY) - 1);
+			}
+		});
+	}
+
+	bool OcclusionBuffer::IsOccluded(float centerX, float centerY, float centerZ, float radius) const {
+		if (!m_hasOccluders) {
+			return false;
+		}
+
+		// the same test as the batches, with the sphere in every lane
+		TileRects rects{ ProjectBoxesSse(
+			LoadViewProjectionSse(m_viewProjection),
+			_mm_set1_ps(centerX), _mm_set1_ps(centerY), _mm_set1_ps(centerZ), _mm_set1_ps(radius),
+			m_width, m_height
+		) };
+		return (rects.mask & 1) && AreTilesOccluded(rects.minX[0], rects.maxX[0], rects.minY[0], rects.maxY[0], rects.nearestDepth[0]);
+	}
+
+	size_t OcclusionBuffer::RemoveOccluded(const FrustumCulling::BoundingSpheres& spheres, uint32_t* pIds, size_t count) const {
+		if (!m_hasOccluders) {
+			return count;
+		}
+
+		// Ids left by the frustum test are scattered, so lanes are gathered and a short last batch repeats its last id.
+		// Ids of a batch are read before any is written back, the write position never passes them.
+		size_t visibleCount{};
+		auto removeBatches{ [&](size_t batchSize, const auto& projectBoxes) {
+			for (size_t i{}; i < count; i += batchSize) {
+				size_t lanesCount{ std::min(count - i, batchSize) };
+				alignas(32) uint32_t ids[8]{};
+				for (size_t lane{}; lane < batchSize; ++lane) {
+					ids[lane] = pIds[i + std::min(lane, lanesCount - 1)];
+				}
+				TileRects rects{ projectBoxes(ids) };
+				// every id is written and only the visible ones advance, most of them are occluded and a branch mispredicts
+				for (size_t lane{}; lane < lanesCount; ++lane) {
+					bool isOccluded{ (rects.mask >> lane & 1)
+						&& AreTilesOccluded(rects.minX[lane], rects.maxX[lane], rects.minY[lane], rects.maxY[lane], rects.nearestDepth[lane]) };
+					pIds[visibleCount] = ids[lane];
+					visibleCount += !isOccluded;
+				}
+			}
+		} };
+
+		const float* pCentersX{ spheres.GetCentersX() };
+		const float* pCentersY{ spheres.GetCentersY() };
+		const float* pCentersZ{ spheres.GetCentersZ() };
+		const float* pRadii{ spheres.GetRadii() };
+		if (FrustumCulling::IsAvx2Supported()) {
+			ViewProjectionAvx2 viewProjection{ LoadViewProjectionAvx2(m_viewProjection) };
+			removeBatches(8, [&](const uint32_t (&ids)[8]) {
+				__m256i indices{ _mm256_load_si256(reinterpret_cast<const __m256i*>(ids)) };
+				return ProjectBoxesAvx2(
+					viewProjection,
+					_mm256_i32gather_ps(pCentersX, indices, 4),
+					_mm256_i32gather_ps(pCentersY, indices, 4),
+					_mm256_i32gather_ps(pCentersZ, indices, 4),
+					_mm256_i32gather_ps(pRadii, indices, 4),
+					m_width, m_height
+				);
+			});
+		} else {
+			ViewProjectionSse viewProjection{ LoadViewProjectionSse(m_viewProjection) };
+			removeBatches(4, [&](const uint32_t (&ids)[8]) {
+				return ProjectBoxesSse(
+					viewProjection,
+					_mm_setr_ps(pCentersX[ids[0]], pCentersX[ids[1]], pCentersX[ids[2]], pCentersX[ids[3]]),
+					_mm_setr_ps(pCentersY[ids[0]], pCentersY[ids[1]], pCentersY[ids[2]], pCentersY[ids[3]]),
+					_mm_setr_ps(pCentersZ[ids[0]], pCentersZ[ids[1]], pCentersZ[ids[2]], pCentersZ[ids[3]]),
+					_mm_setr_ps(pRadii[ids[0]], pRadii[ids[1]], pRadii[ids[2]], pRadii[ids[3]]),
+					m_width, m_height
+				);
+			});
+		}
+		return visibleCount;
+	}
+
+	void OcclusionBuffer::RemoveOccluded(
+		const FrustumCulling::BoundingSpheres& spheres,
+		JobSystem<>& jobSystem,
+		std::vector<uint32_t>& visibleIds
+	) const {
+		if (!m_hasOccluders || visibleIds.empty()) {
+			return;
+		}
+
+		// every chunk compacts its own part of visibleIds, the parts are joined afterwards
+		size_t chunksCount{ (visibleIds.size() + idsChunkSize - 1) / idsChunkSize };
+		std::vector<size_t> counts(chunksCount);
+		jobSystem.RunAndWait(chunksCount, [&](size_t chunkId) {
+			size_t begin{ chunkId * idsChunkSize };
+			counts[chunkId] = RemoveOccluded(spheres, visibleIds.data() + begin, std::min(idsChunkSize, visibleIds.size() - begin));
+		});
+
+		size_t visibleCount{ counts[0] };
+		for (size_t chunkId{ 1 }; chunkId < chunksCount; ++chunkId) {
+			auto chunkBegin{ visibleIds.begin() + chunkId * idsChunkSize };
+			std::copy(chunkBegin, chunkBegin + counts[chunkId], visibleIds.begin() + visibleCount);
+			visibleCount += counts[chunkId];
+		}
+		visibleIds.resize(visibleCount);
+	}
+
+	bool OcclusionBuffer::AreTilesOccluded(uint32_t tileMinX, uint32_t tileMaxX, uint32_t tileMinY, uint32_t tileMaxY, float nearestDepth) const {
+		// 4 tiles of a row per compare, lanes past the range are ignored
+		__m128 nearest{ _mm_set1_ps(nearestDepth) };
+		// most boxes touch at most 4x4 tiles, those rows are compared without branches, repeating the last one
+		if (tileMaxX - tileMinX < 4 && tileMaxY - tileMinY < 4) {
+			uint32_t lanesMask{ (1u << (tileMaxX - tileMinX + 1)) - 1 };
+			__m128 isBehind{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+			for (uint32_t row{}; row < 4; ++row) {
+				size_t tileY{ std::min(tileMinY + row, tileMaxY) };
+				isBehind = _mm_and_ps(isBehind, _mm_cmplt_ps(nearest, _mm_loadu_ps(m_occluderDepths.data() + tileY * m_tilesX + tileMinX)));
+			}
+			return (static_cast<uint32_t>(_mm_movemask_ps(isBehind)) & lanesMask) == lanesMask;
+		}
+		for (uint32_t tileY{ tileMinY }; tileY <= tileMaxY; ++tileY) {
+			const float* pRow{ m_occluderDepths.data() + static_cast<size_t>(tileY) * m_tilesX };
+			for (uint32_t tileX{ tileMinX }; tileX <= tileMaxX; tileX += 4) {
+				uint32_t lanesMask{ (1u << std::min(tileMaxX - tileX + 1, 4u)) - 1 };
+				uint32_t isBehind{ static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(nearest, _mm_loadu_ps(pRow + tileX)))) };
+				if ((isBehind & lanesMask) != lanesMask) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void OcclusionBuffer::SetupTriangles(const Occluder& occluder, DirectX::FXMMATRIX viewProjection, Triangle* pTriangles) const {
+		for (size_t triangleId{}; triangleId < occluder.indices.size() / 3; ++triangleId) {
+			Triangle& triangle{ pTriangles[triangleId] };
+			triangle = Triangle{};
+
+			float x[3]{}, y[3]{}, z[3]{};
+			bool isSkipped{};
+			for (size_t i{}; i < 3; ++i) {
+				DirectX::XMFLOAT4 clip{};
+				DirectX::XMStoreFloat4(&clip, DirectX::XMVector3Transform(
+					DirectX::XMLoadFloat3(&occluder.vertices[occluder.indices[triangleId * 3 + i]]),
+					viewProjection
+				));
+				if (clip.w <= minW) {
+					isSkipped = true;
+					break;
+				}
+				float invW{ 1.f / clip.w };
+				x[i] = (clip.x * invW * 0.5f + 0.5f) * m_width;
+				y[i] = (-clip.y * invW * 0.5f + 0.5f) * m_height;
+				z[i] = clip.z * invW;
+			}
+			if (isSkipped) {
+				continue;
+			}
+
+			float dx1{ x[1] - x[0] }, dy1{ y[1] - y[0] }, dz1{ z[1] - z[0] };
+			float dx2{ x[2] - x[0] }, dy2{ y[2] - y[0] }, dz2{ z[2] - z[0] };
+			float area{ dx1 * dy2 - dx2 * dy1 };
+			if (std::abs(area) < 1e-6f) {
+				continue;
+			}
+
+			float minX{ std::min({ x[0], x[1], x[2] }) }, maxX{ std::max({ x[0], x[1], x[2] }) };
+			float minY{ std::min({ y[0], y[1], y[2] }) }, maxY{ std::max({ y[0], y[1], y[2] }) };
+			if (maxX < 0.f || maxY < 0.f || minX >= m_width || minY >= m_height) {
+				continue;
+			}
+
+			// both windings are drawn, edges are flipped so the inside is positive
+			float sign{ area > 0.f ? 1.f : -1.f };
+			for (size_t i{}; i < 3; ++i) {
+				size_t j{ (i + 1) % 3 };
+				triangle.edgeA[i] = (y[i] - y[j]) * sign;
+				triangle.edgeB[i] = (x[j] - x[i]) * sign;
+				triangle.edgeC[i] = (x[i] * y[j] - x[j] * y[i]) * sign;
+			}
+
+			triangle.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+			triangle.depthB = (dx1 * dz2 - dx2 * dz1) / area;
+			triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+			triangle.minDepth = std::min({ z[0], z[1], z[2] });
+
+			triangle.tileMinX = static_cast<uint32_t>(std::max(minX, 0.f)) / tileWidth;
+			triangle.tileMaxX = static_cast<uint32_t>(std::min(maxX, m_width - 1.f)) / tileWidth;
+			triangle.tileMinY = static_cast<uint32_t>(std::max(minY, 0.f)) / tileHeight;
+			triangle.tileMaxY = static_cast<uint32_t>(std::min(maxY, m_height - 1.f)) / tileHeight;
+		}
+	}
+
+	void OcclusionBuffer::RasterizeBand(uint32_t tileMinY, uint32_t tileMaxY) {
+		for (const Triangle& triangle : m_triangles) {
+			uint32_t triangleMinY{ std::max(triangle.tileMinY, tileMinY) };
+			uint32_t triangleMaxY{ std::min(triangle.tileMaxY, tileMaxY) };
+			if (triangle.tileMinX > triangle.tileMaxX || triangleMinY > triangleMaxY) {
+				continue;
+			}
+			for (uint32_t tileY{ triangleMinY }; tileY <= triangleMaxY; ++tileY) {
+				for (uint32_t tileX{ triangle.tileMinX }; tileX <= triangle.tileMaxX; ++tileX) {
+					RasterizeTile(triangle, tileX, tileY);
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::RasterizeTile(const Triangle& triangle, uint32_t tileX, uint32_t tileY) {
+		size_t tileId{ static_cast<size_t>(tileY) * m_tilesX + tileX };
+		Tile& tile{ m_tiles[tileId] };
+		float& occluderDepth{ m_occluderDepths[tileId] };
+		float x0{ static_cast<float>(tileX * tileWidth) };
+		float y0{ static_cast<float>(tileY * tileHeight) };
+
+		// the farthest depth of the plane is at a tile corner, but not beyond the triangle's own vertices
+		float depth{ triangle.depthC
+			+ triangle.depthA * (triangle.depthA > 0.f ? x0 : x0 + tileWidth)
+			+ triangle.depthB * (triangle.depthB > 0.f ? y0 : y0 + tileHeight) };
+		depth = std::max(depth, triangle.minDepth);
+		if (depth <= occluderDepth) {
+			return;
+		}
+
+		// one row of pixel centers per register, covered pixels have all edges strictly positive
+		__m128 xs{ _mm_add_ps(_mm_set1_ps(x0), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)) };
+		__m128 edges[3]{};
+		__m128 edgeStepsY[3]{};
+		for (size_t i{}; i < 3; ++i) {
+			edges[i] = _mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(triangle.edgeA[i]), xs),
+				_mm_set1_ps(triangle.edgeB[i] * (y0 + 0.5f) + triangle.edgeC[i])
+			);
+			edgeStepsY[i] = _mm_set1_ps(triangle.edgeB[i]);
+		}
+
+		uint32_t mask{};
+		__m128 zero{ _mm_setzero_ps() };
+		for (uint32_t row{}; row < tileHeight; ++row) {
+			__m128 isInside{ _mm_and_ps(
+				_mm_and_ps(_mm_cmpgt_ps(edges[0], zero), _mm_cmpgt_ps(edges[1], zero)),
+				_mm_cmpgt_ps(edges[2], zero)
+			) };
+			mask |= static_cast<uint32_t>(_mm_movemask_ps(isInside)) << (row * tileWidth);
+			for (size_t i{}; i < 3; ++i) {
+				edges[i] = _mm_add_ps(edges[i], edgeStepsY[i]);
+			}
+		}
+		if (!mask) {
+			return;
+		}
+
+		// a triangle covering the whole tile occludes it alone, the working layer is kept
+		if (mask == fullMask) {
+			occluderDepth = depth;
+			return;
+		}
+		tile.layerDepth = tile.mask ? std::min(tile.layerDepth, depth) : depth;
+		tile.mask |= mask;
+		if (tile.mask == fullMask) {
+			occluderDepth = std::max(occluderDepth, tile.layerDepth);
+			tile.mask = 0;
+		}
+	}
+}
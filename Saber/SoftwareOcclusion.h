@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <DirectXCollision.h>
+
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+namespace SoftwareOcclusion {
+	// Low-poly stand-in of a large object, it must not stick out of the object it replaces.
+	// Vertices are in world space, every 3 indices form a triangle.
+	struct Occluder {
+		std::vector<DirectX::XMFLOAT3> vertices{};
+		std::vector<uint32_t> indices{};
+	};
+
+	// Small depth buffer the occluders are rasterized into on the CPU.
+	// Pixels are grouped into 4x8 tiles, so the coverage of a tile fits a 32 bit mask and a row fits an SSE register.
+	// A tile keeps only a conservative depth: the farthest depth of occluders that cover all of it,
+	// partly covered tiles gather triangles in a working layer until it is full. Depth is reversed like on the GPU.
+	class OcclusionBuffer {
+	public:
+		static constexpr uint32_t tileWidth{ 4 };
+		static constexpr uint32_t tileHeight{ 8 };
+
+	private:
+		// the working layer, the occluder depth of the tile is in m_occluderDepths
+		struct Tile {
+			uint32_t mask{};
+			float layerDepth{};
+		};
+
+		// in pixels, edges are positive inside the triangle
+		struct Triangle {
+			float edgeA[3]{};
+			float edgeB[3]{};
+			float edgeC[3]{};
+			// depth = depthA * x + depthB * y + depthC
+			float depthA{};
+			float depthB{};
+			float depthC{};
+			float minDepth{};
+			// inclusive, empty when the triangle is skipped
+			uint32_t tileMinX{ 1 };
+			uint32_t tileMaxX{};
+			uint32_t tileMinY{ 1 };
+			uint32_t tileMaxY{};
+		};
+
+		uint32_t m_width{};
+		uint32_t m_height{};
+		uint32_t m_tilesX{};
+		uint32_t m_tilesY{};
+		std::vector<Tile> m_tiles{};
+		// Apart from the tiles so the test compares 4 tiles of a row at once.
+		// Padded with 3 more, a load at the last tile of the buffer stays inside.
+		std::vector<float> m_occluderDepths{};
+
+		std::vector<Triangle> m_triangles{};
+		std::vector<size_t> m_triangleOffsets{};
+		DirectX::XMFLOAT4X4 m_viewProjection{};
+		bool m_hasOccluders{};
+
+	public:
+		// the size has to be a multiple of the tile size
+		OcclusionBuffer(uint32_t width, uint32_t height);
+
+		// Clears the buffer and rasterizes the occluders, triangles are set up per occluder chunk
+		// and tile rows are split into bands filled by the job system workers.
+		// Triangles crossing the camera plane are skipped, which only lets more objects through.
+		// The calling thread takes part and waits for the rest, so it must not be a job system worker.
+		void Render(
+			DirectX::FXMMATRIX viewProjection,
+			const std::vector<Occluder>& occluders,
+			JobSystem<>& jobSystem
+		);
+
+		// The box around the sphere is projected, it is occluded when its nearest point
+		// is behind the occluders in every tile it touches.
+		bool IsOccluded(float centerX, float centerY, float centerZ, float radius) const;
+
+		// Moves ids of spheres that aren't occluded to the front of [pIds, pIds + count) in order, returns their count.
+		// The boxes of 8 spheres are projected at once with AVX2 when the CPU has it, 4 with SSE otherwise.
+		size_t RemoveOccluded(const FrustumCulling::BoundingSpheres& spheres, uint32_t* pIds, size_t count) const;
+
+		// Removes ids of occluded spheres, the order of the rest is kept.
+		// Chunks of ids are tested by the job system workers like in FrustumCulling::CullParallel.
+		void RemoveOccluded(
+			const FrustumCulling::BoundingSpheres& spheres,
+			JobSystem<>& jobSystem,
+			std::vector<uint32_t>& visibleIds
+		) const;
+
+		bool HasOccluders() const {
+			return m_hasOccluders;
+		}
+
+		uint32_t GetWidth() const {
+			return m_width;
+		}
+
+		uint32_t GetHeight() const {
+			return m_height;
+		}
+
+	private:
+		// inclusive tile ranges
+		bool AreTilesOccluded(uint32_t tileMinX, uint32_t tileMaxX, uint32_t tileMinY, uint32_t tileMaxY, float nearestDepth) const;
+		void SetupTriangles(const Occluder& occluder, DirectX::FXMMATRIX viewProjection, Triangle* pTriangles) const;
+		void RasterizeBand(uint32_t tileMinY, uint32_t tileMaxY);
+		void RasterizeTile(const Triangle& triangle, uint32_t tileX, uint32_t tileY);
+	};
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <bit>
+#include <vector>
+
+#include "CommandQueue.h"
+#include "DirtyRangeList.h"
+#include "GPUResource.h"
+
+// Per-object data of objects that change every frame, read by shaders straight from upload memory.
+// It has the interface of ObjectDataBuffer, but instead of copying into a default buffer it cycles through
+// framesCount persistently mapped copies: the next copy is written only after the fence signaled
+// when it stopped being the current one has completed, so the GPU never reads a copy being written.
+// A copy gets the ranges changed since it was written last, so unchanged objects cost nothing.
+template <typename ObjectData, uint32_t framesCount = 3>
+class StreamedObjectDataBuffer {
+	struct Frame {
+		std::shared_ptr<GPUResource> pBuffer{};
+		std::byte* pMappedData{};
+		uint32_t capacity{};
+		uint64_t fenceValue{};
+		// changed while other copies were written
+		DirtyRangeList dirtyRanges{};
+	};
+
+	std::vector<ObjectData> m_objectData{};
+	Frame m_frames[framesCount]{};
+	uint32_t m_currFrameId{ framesCount - 1 };
+	bool m_isDirty{};
+
+public:
+	StreamedObjectDataBuffer() = default;
+	StreamedObjectDataBuffer(const StreamedObjectDataBuffer&) = delete;
+	~StreamedObjectDataBuffer() {
+		for (Frame& frame : m_frames) {
+			if (frame.pMappedData) {
+				frame.pBuffer->GetResource()->Unmap(0, nullptr);
+			}
+		}
+	}
+
+	void SetAt(size_t id, const ObjectData& objectData) {
+		if (id >= m_objectData.size()) {
+			m_objectData.resize(id + 1);
+		}
+		m_objectData[id] = objectData;
+		for (Frame& frame : m_frames) {
+			frame.dirtyRanges.Add(id, id + 1);
+		}
+		m_isDirty = true;
+	}
+
+	const ObjectData& GetAt(size_t id) const {
+		return m_objectData.at(id);
+	}
+
+	size_t GetSize() const {
+		return m_objectData.size();
+	}
+
+	bool IsCreated() const {
+		return static_cast<bool>(m_frames[m_currFrameId].pBuffer);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress() const {
+		return m_frames[m_currFrameId].pBuffer->GetResource()->GetGPUVirtualAddress();
+	}
+
+	// Writes the changes into the next copy and makes it current, without changes the current copy is kept.
+	// The fence is signaled on the queue the current copy is drawn on, so all draws recorded with it are covered.
+	void PerformUpdate(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		std::shared_ptr<CommandQueue> pCommandQueueDirect
+	) {
+		if (!m_isDirty) {
+			return;
+		}
+
+		Frame& currFrame{ m_frames[m_currFrameId] };
+		if (currFrame.pBuffer) {
+			currFrame.fenceValue = pCommandQueueDirect->Signal();
+		}
+		m_currFrameId = (m_currFrameId + 1) % framesCount;
+		Frame& frame{ m_frames[m_currFrameId] };
+		if (frame.pBuffer && !pCommandQueueDirect->IsFenceComplete(frame.fenceValue)) {
+			pCommandQueueDirect->WaitForFenceValue(frame.fenceValue);
+		}
+
+		if (!frame.pBuffer || m_objectData.size() > frame.capacity) {
+			if (frame.pMappedData) {
+				frame.pBuffer->GetResource()->Unmap(0, nullptr);
+			}
+			frame.capacity = std::bit_ceil(static_cast<uint32_t>(m_objectData.size()));
+			frame.pBuffer = CreateBuffer(pAllocator, frame.capacity);
+			// the CPU never reads upload memory
+			CD3DX12_RANGE readRange{ 0, 0 };
+			void* pMappedData{};
+			ThrowIfFailed(frame.pBuffer->GetResource()->Map(0, &readRange, &pMappedData));
+			frame.pMappedData = static_cast<std::byte*>(pMappedData);
+			frame.dirtyRanges.Clear();
+			frame.dirtyRanges.Add(0, m_objectData.size());
+		}
+
+		for (const DirtyRangeList::Range& range : frame.dirtyRanges.Merge(m_objectData.size())) {
+			memcpy(
+				frame.pMappedData + range.begin * sizeof(ObjectData),
+				m_objectData.data() + range.begin,
+				(range.end - range.begin) * sizeof(ObjectData)
+			);
+		}
+		frame.dirtyRanges.Clear();
+
+		m_isDirty = false;
+	}
+
+private:
+	static std::shared_ptr<GPUResource> CreateBuffer(
+		Microsoft::WRL::ComPtr<D3D12MA::Allocator> pAllocator,
+		uint32_t capacity
+	) {
+		return std::make_shared<GPUResource>(
+			pAllocator,
+			GPUResource::HeapData{ .heapType{ D3D12_HEAP_TYPE_UPLOAD } },
+			GPUResource::ResourceData{
+				.resDesc{ CD3DX12_RESOURCE_DESC::Buffer(capacity * sizeof(ObjectData)) },
+				.resInitState{ D3D12_RESOURCE_STATE_GENERIC_READ }
+			}
+		);
+	}
+};
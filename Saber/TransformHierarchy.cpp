@@ -0,0 +1,253 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+
+TransformHierarchy::Handle TransformHierarchy::Add(const Transform& local, Handle parent) {
+	uint32_t parentId{ parent == nullHandle ? nullIndex : GetIndex(parent) };
+	uint32_t depth{ parentId == nullIndex ? 0 : m_depths[parentId] + 1 };
+	uint32_t index{ static_cast<uint32_t>(m_parentIds.size()) };
+
+	// the parent is already in, so appending keeps the order unless a shallower level gets a new node
+	if (!m_isOrderDirty) {
+		if (!m_depths.empty() && depth < m_depths.back()) {
+			m_isOrderDirty = true;
+		}
+		else if (depth + 1 == m_levelOffsets.size()) {
+			m_levelOffsets.push_back(index + 1);
+		}
+		else {
+			m_levelOffsets.back() = index + 1;
+		}
+	}
+
+	m_positions.push_back(local.position);
+	m_rotations.push_back(local.rotation);
+	m_scales.push_back(local.scale);
+	m_parentIds.push_back(parentId);
+	m_depths.push_back(depth);
+	m_isLocalDirty.push_back(1);
+	m_isWorldChanged.push_back(0);
+	m_worldMatrices.push_back(DirectX::XMMatrixIdentity());
+	m_normalMatrices.push_back(DirectX::XMMatrixIdentity());
+	m_isDirty = true;
+
+	Handle handle{};
+	if (!m_freeHandles.empty()) {
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else {
+		handle = static_cast<Handle>(m_handleIndices.size());
+		m_handleIndices.push_back(nullIndex);
+	}
+	m_handleIndices[handle] = index;
+	m_indexHandles.push_back(handle);
+	return handle;
+}
+
+void TransformHierarchy::Remove(Handle handle) {
+	uint32_t index{ GetIndex(handle) };
+	for (size_t i{}; i < m_parentIds.size(); ++i) {
+		if (m_parentIds[i] == index) {
+			m_parentIds[i] = m_parentIds[index];
+			MarkDirty(static_cast<uint32_t>(i));
+		}
+	}
+
+	// the arrays are compacted with the next sort
+	m_indexHandles[index] = nullHandle;
+	m_handleIndices[handle] = nullIndex;
+	m_freeHandles.push_back(handle);
+	m_isOrderDirty = true;
+}
+
+void TransformHierarchy::SetParent(Handle handle, Handle parent) {
+	uint32_t index{ GetIndex(handle) };
+	uint32_t parentId{ parent == nullHandle ? nullIndex : GetIndex(parent) };
+	for (uint32_t ancestorId{ parentId }; ancestorId != nullIndex; ancestorId = m_parentIds[ancestorId]) {
+		assert(ancestorId != index && "A node can't be attached to its own subtree");
+	}
+
+	m_parentIds[index] = parentId;
+	MarkDirty(index);
+	m_isOrderDirty = true;
+}
+
+void TransformHierarchy::SetLocal(Handle handle, const Transform& local) {
+	uint32_t index{ GetIndex(handle) };
+	m_positions[index] = local.position;
+	m_rotations[index] = local.rotation;
+	m_scales[index] = local.scale;
+	MarkDirty(index);
+}
+
+void TransformHierarchy::SetPosition(Handle handle, const DirectX::XMFLOAT3& position) {
+	uint32_t index{ GetIndex(handle) };
+	m_positions[index] = position;
+	MarkDirty(index);
+}
+
+void TransformHierarchy::SetRotation(Handle handle, const DirectX::XMFLOAT4& rotation) {
+	uint32_t index{ GetIndex(handle) };
+	m_rotations[index] = rotation;
+	MarkDirty(index);
+}
+
+void TransformHierarchy::SetScale(Handle handle, const DirectX::XMFLOAT3& scale) {
+	uint32_t index{ GetIndex(handle) };
+	m_scales[index] = scale;
+	MarkDirty(index);
+}
+
+TransformHierarchy::Transform TransformHierarchy::GetLocal(Handle handle) const {
+	uint32_t index{ GetIndex(handle) };
+	return Transform{
+		.position{ m_positions[index] },
+		.rotation{ m_rotations[index] },
+		.scale{ m_scales[index] }
+	};
+}
+
+DirectX::XMMATRIX TransformHierarchy::GetWorldMatrix(Handle handle) const {
+	return m_worldMatrices[GetIndex(handle)];
+}
+
+DirectX::XMMATRIX TransformHierarchy::GetNormalMatrix(Handle handle) const {
+	return m_normalMatrices[GetIndex(handle)];
+}
+
+void TransformHierarchy::Update(JobSystem<>& jobSystem, std::vector<Handle>& changedHandles) {
+	if (!m_isDirty && !m_isOrderDirty) {
+		return;
+	}
+	if (m_isOrderDirty) {
+		SortByDepth();
+	}
+
+	// a level only reads world matrices of the previous one
+	for (size_t level{}; level + 1 < m_levelOffsets.size(); ++level) {
+		size_t begin{ m_levelOffsets[level] };
+		size_t end{ m_levelOffsets[level + 1] };
+		size_t chunksCount{ (end - begin + chunkSize - 1) / chunkSize };
+		if (chunksCount == 1) {
+			UpdateRange(begin, end);
+			continue;
+		}
+		jobSystem.RunAndWait(chunksCount, [this, begin, end](size_t chunkId) {
+			size_t chunkBegin{ begin + chunkId * chunkSize };
+			UpdateRange(chunkBegin, std::min(chunkBegin + chunkSize, end));
+		});
+	}
+
+	for (size_t i{}; i < m_isWorldChanged.size(); ++i) {
+		if (m_isWorldChanged[i]) {
+			changedHandles.push_back(m_indexHandles[i]);
+		}
+	}
+	std::fill(m_isLocalDirty.begin(), m_isLocalDirty.end(), uint8_t{});
+	m_isDirty = false;
+}
+
+void TransformHierarchy::SortByDepth() {
+	size_t count{ m_parentIds.size() };
+
+	// reparenting leaves stale depths below the moved node, they are found again walking up to a known one
+	std::vector<uint32_t> depths(count, nullIndex);
+	std::vector<uint32_t> path{};
+	for (uint32_t i{}; i < count; ++i) {
+		if (m_indexHandles[i] == nullHandle) {
+			continue;
+		}
+		uint32_t ancestorId{ i };
+		while (ancestorId != nullIndex && depths[ancestorId] == nullIndex) {
+			path.push_back(ancestorId);
+			ancestorId = m_parentIds[ancestorId];
+		}
+		uint32_t depth{ ancestorId == nullIndex ? 0 : depths[ancestorId] + 1 };
+		for (auto it{ path.rbegin() }; it != path.rend(); ++it) {
+			depths[*it] = depth++;
+		}
+		path.clear();
+	}
+
+	std::vector<uint32_t> order{};
+	order.reserve(count);
+	for (uint32_t i{}; i < count; ++i) {
+		if (m_indexHandles[i] != nullHandle) {
+			order.push_back(i);
+		}
+	}
+	// stable, so unchanged levels keep their order and the caches stay warm
+	std::stable_sort(order.begin(), order.end(), [&depths](uint32_t lhs, uint32_t rhs) {
+		return depths[lhs] < depths[rhs];
+	});
+
+	std::vector<uint32_t> newIndices(count, nullIndex);
+	for (uint32_t i{}; i < order.size(); ++i) {
+		newIndices[order[i]] = i;
+	}
+
+	auto permute{ [&order](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted{};
+		sorted.reserve(order.size());
+		for (uint32_t id : order) {
+			sorted.push_back(values[id]);
+		}
+		values = std::move(sorted);
+	} };
+	permute(m_positions);
+	permute(m_rotations);
+	permute(m_scales);
+	permute(m_parentIds);
+	permute(m_isLocalDirty);
+	permute(m_isWorldChanged);
+	permute(m_worldMatrices);
+	permute(m_normalMatrices);
+	permute(m_indexHandles);
+	permute(depths);
+	m_depths = std::move(depths);
+
+	m_levelOffsets.assign(1, 0);
+	for (uint32_t i{}; i < order.size(); ++i) {
+		if (m_parentIds[i] != nullIndex) {
+			m_parentIds[i] = newIndices[m_parentIds[i]];
+		}
+		m_handleIndices[m_indexHandles[i]] = i;
+		if (m_depths[i] + 1 == m_levelOffsets.size()) {
+			m_levelOffsets.push_back(i + 1);
+		}
+		else {
+			m_levelOffsets.back() = i + 1;
+		}
+	}
+	m_isOrderDirty = false;
+}
+
+void TransformHierarchy::UpdateRange(size_t begin, size_t end) {
+	using namespace DirectX;
+
+	for (size_t i{ begin }; i < end; ++i) {
+		uint32_t parentId{ m_parentIds[i] };
+		bool isChanged{ m_isLocalDirty[i] || (parentId != nullIndex && m_isWorldChanged[parentId]) };
+		m_isWorldChanged[i] = isChanged;
+		if (!isChanged) {
+			continue;
+		}
+
+		assert(m_scales[i].x != 0.f && m_scales[i].y != 0.f && m_scales[i].z != 0.f);
+		XMVECTOR scale{ XMLoadFloat3(&m_scales[i]) };
+		XMMATRIX rotation{ XMMatrixRotationQuaternion(XMQuaternionNormalize(XMLoadFloat4(&m_rotations[i]))) };
+
+		XMMATRIX world{ XMMatrixMultiply(XMMatrixScalingFromVector(scale), rotation) };
+		world.r[3] = XMVectorSetW(XMLoadFloat3(&m_positions[i]), 1.f);
+		// transpose(inverse(S * R)) = inverse(S) * R, the translation is dropped since normals have w = 0
+		XMMATRIX normal{ XMMatrixMultiply(XMMatrixScalingFromVector(XMVectorReciprocal(scale)), rotation) };
+
+		if (parentId != nullIndex) {
+			world = XMMatrixMultiply(world, m_worldMatrices[parentId]);
+			normal = XMMatrixMultiply(normal, m_normalMatrices[parentId]);
+		}
+		m_worldMatrices[i] = world;
+		m_normalMatrices[i] = normal;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Headers.h"
+
+#include <limits>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Parent/child transforms stored as parallel arrays sorted by depth, so every parent comes before its children
+// and a whole depth level can be updated at once. Handles stay valid while nodes are added, removed and reparented.
+// Only nodes whose local transform changed and their subtrees are recomputed.
+// Normal matrices are composed from inverse scales and rotations, nothing is inverted in general.
+class TransformHierarchy {
+public:
+	using Handle = uint32_t;
+	static constexpr Handle nullHandle{ std::numeric_limits<Handle>::max() };
+
+	// scale = 0 on any axis isn't supported, the normal matrix needs its inverse
+	struct Transform {
+		DirectX::XMFLOAT3 position{};
+		DirectX::XMFLOAT4 rotation{ 0.f, 0.f, 0.f, 1.f };
+		DirectX::XMFLOAT3 scale{ 1.f, 1.f, 1.f };
+	};
+
+private:
+	static constexpr uint32_t nullIndex{ std::numeric_limits<uint32_t>::max() };
+	// nodes of a level are split into chunks of this size between the job system workers
+	static constexpr size_t chunkSize{ 256 };
+
+	// by index, sorted by depth
+	std::vector<DirectX::XMFLOAT3> m_positions{};
+	std::vector<DirectX::XMFLOAT4> m_rotations{};
+	std::vector<DirectX::XMFLOAT3> m_scales{};
+	std::vector<uint32_t> m_parentIds{};
+	std::vector<uint32_t> m_depths{};
+	// bytes, not bools, so workers can write neighbouring flags
+	std::vector<uint8_t> m_isLocalDirty{};
+	std::vector<uint8_t> m_isWorldChanged{};
+	std::vector<DirectX::XMMATRIX> m_worldMatrices{};
+	std::vector<DirectX::XMMATRIX> m_normalMatrices{};
+	// nullHandle for removed nodes until the arrays are compacted
+	std::vector<Handle> m_indexHandles{};
+
+	std::vector<uint32_t> m_handleIndices{};
+	std::vector<Handle> m_freeHandles{};
+
+	// first index of every depth level and the end of the last one
+	std::vector<size_t> m_levelOffsets{ 0 };
+	bool m_isOrderDirty{};
+	bool m_isDirty{};
+
+public:
+	Handle Add(const Transform& local, Handle parent = nullHandle);
+	// children are attached to the parent of the removed node and keep their local transforms
+	void Remove(Handle handle);
+	// the node keeps its local transform, so it moves along with the new parent
+	void SetParent(Handle handle, Handle parent);
+
+	void SetLocal(Handle handle, const Transform& local);
+	void SetPosition(Handle handle, const DirectX::XMFLOAT3& position);
+	void SetRotation(Handle handle, const DirectX::XMFLOAT4& rotation);
+	void SetScale(Handle handle, const DirectX::XMFLOAT3& scale);
+	Transform GetLocal(Handle handle) const;
+
+	// valid after the update that followed the last change
+	DirectX::XMMATRIX GetWorldMatrix(Handle handle) const;
+	DirectX::XMMATRIX GetNormalMatrix(Handle handle) const;
+
+	bool IsValid(Handle handle) const {
+		return handle < m_handleIndices.size() && m_handleIndices[handle] != nullIndex;
+	}
+
+	size_t GetSize() const {
+		return m_handleIndices.size() - m_freeHandles.size();
+	}
+
+	// Levels are updated one after another, the nodes of a level by the job system workers.
+	// Appends handles of nodes whose world matrix changed. The calling thread takes part
+	// and waits for the rest, so it must not be a job system worker.
+	void Update(JobSystem<>& jobSystem, std::vector<Handle>& changedHandles);
+
+private:
+	uint32_t GetIndex(Handle handle) const {
+		assert(IsValid(handle));
+		return m_handleIndices[handle];
+	}
+
+	void MarkDirty(uint32_t index) {
+		m_isLocalDirty[index] = 1;
+		m_isDirty = true;
+	}
+
+	void SortByDepth();
+	void UpdateRange(size_t begin, size_t end);
+};
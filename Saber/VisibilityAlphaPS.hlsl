@@ -0,0 +1,37 @@
+#include "MaterialCB.h"
+#include "ObjectData.hlsli"
+#include "VisibilityBuffer.hlsli"
+
+// set once per subsystem, objects of different subsystems share slot ids
+struct SubsystemBuffer
+{
+    uint subsystemId;
+};
+
+ConstantBuffer<SubsystemBuffer> SubsystemCB : register(b3);
+
+ConstantBuffer<MaterialCB> Materials : register(b2);
+Texture2D<float4> MaterialsTextures[] : register(t0);
+
+SamplerState s1 : register(s0);
+
+struct PSInput
+{
+    float3 worldPos : POSITION;
+    float3 norm : NORMAL;
+    float4 tang : TANGENT;
+    float2 uv : TEXCOORD;
+    nointerpolation uint objectId : OBJECT_ID;
+};
+
+uint main(PSInput input, uint primitiveId : SV_PrimitiveID) : SV_Target0
+{
+    uint materialId = GetObjectData(input.objectId).materialId.x;
+    
+    if (MaterialsTextures[Materials.materials[materialId].x].Sample(s1, input.uv).w == 0.f)
+    {
+        discard;
+    }
+    
+    return PackVisibilityId(SubsystemCB.subsystemId, input.objectId, primitiveId);
+}
@@ -0,0 +1,90 @@
+#include "VisibilityBuffer.h"
+
+namespace VisibilityBuffer {
+	namespace {
+		constexpr uint32_t triangleMask{ (1u << VISIBILITY_TRIANGLE_BITS) - 1 };
+		constexpr uint32_t objectMask{ (1u << VISIBILITY_OBJECT_BITS) - 1 };
+
+		DirectX::XMFLOAT3 DivideBySum(const DirectX::XMFLOAT3& v) {
+			float invSum{ 1.f / (v.x + v.y + v.z) };
+			return DirectX::XMFLOAT3{ v.x * invSum, v.y * invSum, v.z * invSum };
+		}
+	}
+
+	uint32_t PackId(const Id& id) {
+		uint32_t objectKey{ id.subsystemId << VISIBILITY_OBJECT_BITS | (id.objectId & objectMask) };
+		return (objectKey << VISIBILITY_TRIANGLE_BITS | (id.triangleId & triangleMask)) + 1;
+	}
+
+	Id UnpackId(uint32_t packedId) {
+		uint32_t id{ packedId - 1 };
+		return Id{
+			.subsystemId{ id >> (VISIBILITY_TRIANGLE_BITS + VISIBILITY_OBJECT_BITS) },
+			.objectId{ id >> VISIBILITY_TRIANGLE_BITS & objectMask },
+			.triangleId{ id & triangleMask }
+		};
+	}
+
+	Barycentrics ComputeBarycentrics(
+		const DirectX::XMFLOAT4& clip0,
+		const DirectX::XMFLOAT4& clip1,
+		const DirectX::XMFLOAT4& clip2,
+		const DirectX::XMFLOAT2& pixelNdc,
+		const DirectX::XMFLOAT2& pixelStep
+	) {
+		DirectX::XMFLOAT3 invW{ 1.f / clip0.w, 1.f / clip1.w, 1.f / clip2.w };
+		DirectX::XMFLOAT2 ndc0{ clip0.x * invW.x, clip0.y * invW.x };
+		DirectX::XMFLOAT2 ndc1{ clip1.x * invW.y, clip1.y * invW.y };
+		DirectX::XMFLOAT2 ndc2{ clip2.x * invW.z, clip2.y * invW.z };
+
+		// screen space barycentrics are linear in NDC, divided by w they stay linear
+		float invDet{ 1.f / ((ndc2.x - ndc1.x) * (ndc0.y - ndc1.y) - (ndc2.y - ndc1.y) * (ndc0.x - ndc1.x)) };
+		DirectX::XMFLOAT3 gradientX{
+			(ndc1.y - ndc2.y) * invDet * invW.x,
+			(ndc2.y - ndc0.y) * invDet * invW.y,
+			(ndc0.y - ndc1.y) * invDet * invW.z
+		};
+		DirectX::XMFLOAT3 gradientY{
+			(ndc2.x - ndc1.x) * invDet * invW.x,
+			(ndc0.x - ndc2.x) * invDet * invW.y,
+			(ndc1.x - ndc0.x) * invDet * invW.z
+		};
+
+		DirectX::XMFLOAT2 delta{ pixelNdc.x - ndc0.x, pixelNdc.y - ndc0.y };
+		DirectX::XMFLOAT3 overW{
+			invW.x + delta.x * gradientX.x + delta.y * gradientY.x,
+			delta.x * gradientX.y + delta.y * gradientY.y,
+			delta.x * gradientX.z + delta.y * gradientY.z
+		};
+		DirectX::XMFLOAT3 overWX{
+			overW.x + pixelStep.x * gradientX.x,
+			overW.y + pixelStep.x * gradientX.y,
+			overW.z + pixelStep.x * gradientX.z
+		};
+		DirectX::XMFLOAT3 overWY{
+			overW.x + pixelStep.y * gradientY.x,
+			overW.y + pixelStep.y * gradientY.y,
+			overW.z + pixelStep.y * gradientY.z
+		};
+
+		Barycentrics barycentrics{ .lambda{ DivideBySum(overW) } };
+		DirectX::XMFLOAT3 lambdaX{ DivideBySum(overWX) };
+		DirectX::XMFLOAT3 lambdaY{ DivideBySum(overWY) };
+		const DirectX::XMFLOAT3& lambda{ barycentrics.lambda };
+		barycentrics.ddx = DirectX::XMFLOAT3{ lambdaX.x - lambda.x, lambdaX.y - lambda.y, lambdaX.z - lambda.z };
+		barycentrics.ddy = DirectX::XMFLOAT3{ lambdaY.x - lambda.x, lambdaY.y - lambda.y, lambdaY.z - lambda.z };
+		return barycentrics;
+	}
+
+	DirectX::XMFLOAT2 Interpolate(
+		const DirectX::XMFLOAT3& weights,
+		const DirectX::XMFLOAT2& a0,
+		const DirectX::XMFLOAT2& a1,
+		const DirectX::XMFLOAT2& a2
+	) {
+		return DirectX::XMFLOAT2{
+			weights.x * a0.x + weights.y * a1.x + weights.z * a2.x,
+			weights.x * a0.y + weights.y * a1.y + weights.z * a2.y
+		};
+	}
+}
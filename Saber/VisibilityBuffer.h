@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+#include "VisibilityData.h"
+
+// Same id packing and barycentrics as VisibilityBuffer.hlsli, to check the reconstruction without a GPU.
+// Only needs DirectXMath, so it builds on any platform.
+namespace VisibilityBuffer {
+	struct Id {
+		uint32_t subsystemId{};
+		uint32_t objectId{};
+		uint32_t triangleId{};
+	};
+
+	// ids past their bits wrap around, RenderSubsystem and GeometryPool reject them in the visibility mode
+	uint32_t PackId(const Id& id);
+	// not for VISIBILITY_EMPTY_ID
+	Id UnpackId(uint32_t packedId);
+
+	struct Barycentrics {
+		DirectX::XMFLOAT3 lambda{};
+		// change to the next pixel right and down
+		DirectX::XMFLOAT3 ddx{};
+		DirectX::XMFLOAT3 ddy{};
+	};
+
+	// pixelStep is the NDC size of a pixel, y is negative as rows go down
+	Barycentrics ComputeBarycentrics(
+		const DirectX::XMFLOAT4& clip0,
+		const DirectX::XMFLOAT4& clip1,
+		const DirectX::XMFLOAT4& clip2,
+		const DirectX::XMFLOAT2& pixelNdc,
+		const DirectX::XMFLOAT2& pixelStep
+	);
+
+	DirectX::XMFLOAT2 Interpolate(
+		const DirectX::XMFLOAT3& weights,
+		const DirectX::XMFLOAT2& a0,
+		const DirectX::XMFLOAT2& a1,
+		const DirectX::XMFLOAT2& a2
+	);
+}
@@ -0,0 +1,75 @@
+#include "VisibilityData.h"
+
+// Mirrors VisibilityBuffer.cpp, keep them in sync
+
+uint PackVisibilityId(uint subsystemId, uint objectId, uint triangleId)
+{
+    uint objectKey = subsystemId << VISIBILITY_OBJECT_BITS | (objectId & ((1u << VISIBILITY_OBJECT_BITS) - 1));
+    return (objectKey << VISIBILITY_TRIANGLE_BITS | (triangleId & ((1u << VISIBILITY_TRIANGLE_BITS) - 1))) + 1;
+}
+
+struct VisibilityId
+{
+    uint subsystemId;
+    uint objectId;
+    uint triangleId;
+};
+
+VisibilityId UnpackVisibilityId(uint packedId)
+{
+    uint id = packedId - 1;
+    VisibilityId visibilityId;
+    visibilityId.triangleId = id & ((1u << VISIBILITY_TRIANGLE_BITS) - 1);
+    visibilityId.objectId = id >> VISIBILITY_TRIANGLE_BITS & ((1u << VISIBILITY_OBJECT_BITS) - 1);
+    visibilityId.subsystemId = id >> (VISIBILITY_TRIANGLE_BITS + VISIBILITY_OBJECT_BITS);
+    return visibilityId;
+}
+
+// Perspective correct barycentrics of a pixel and their change to the next pixel right and down,
+// so attributes get exact derivatives for SampleGrad.
+struct Barycentrics
+{
+    float3 lambda;
+    float3 ddx;
+    float3 ddy;
+};
+
+// pixelStep is the NDC size of a pixel, y is negative as rows go down
+Barycentrics ComputeBarycentrics(float4 clip0, float4 clip1, float4 clip2, float2 pixelNdc, float2 pixelStep)
+{
+    float3 invW = 1.f / float3(clip0.w, clip1.w, clip2.w);
+    float2 ndc0 = clip0.xy * invW.x;
+    float2 ndc1 = clip1.xy * invW.y;
+    float2 ndc2 = clip2.xy * invW.z;
+
+    // screen space barycentrics are linear in NDC, divided by w they stay linear
+    float invDet = 1.f / ((ndc2.x - ndc1.x) * (ndc0.y - ndc1.y) - (ndc2.y - ndc1.y) * (ndc0.x - ndc1.x));
+    float3 gradientX = float3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    float3 gradientY = float3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+
+    float2 delta = pixelNdc - ndc0;
+    float3 overW = float3(invW.x, 0.f, 0.f) + delta.x * gradientX + delta.y * gradientY;
+    float3 overWX = overW + pixelStep.x * gradientX;
+    float3 overWY = overW + pixelStep.y * gradientY;
+
+    Barycentrics barycentrics;
+    barycentrics.lambda = overW / (overW.x + overW.y + overW.z);
+    barycentrics.ddx = overWX / (overWX.x + overWX.y + overWX.z) - barycentrics.lambda;
+    barycentrics.ddy = overWY / (overWY.x + overWY.y + overWY.z) - barycentrics.lambda;
+    return barycentrics;
+}
+
+float2 Interpolate(float3 weights, float2 a0, float2 a1, float2 a2)
+{
+    return weights.x * a0 + weights.y * a1 + weights.z * a2;
+}
+
+float3 Interpolate(float3 weights, float3 a0, float3 a1, float3 a2)
+{
+    return weights.x * a0 + weights.y * a1 + weights.z * a2;
+}
+
+float4 Interpolate(float3 weights, float4 a0, float4 a1, float4 a2)
+{
+    return weights.x * a0 + weights.y * a1 + weights.z * a2;
+}
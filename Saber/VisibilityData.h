@@ -0,0 +1,20 @@
+#ifndef VISIBILITY_DATA
+#define VISIBILITY_DATA
+
+// Id layout shared by the visibility pixel shaders, VisibilityShadingComputeShader.hlsl
+// and the CPU reference in VisibilityBuffer
+
+// subsystem | object in the subsystem | triangle of the draw, stored plus one
+#define VISIBILITY_TRIANGLE_BITS 17
+#define VISIBILITY_OBJECT_BITS 13
+#define VISIBILITY_SUBSYSTEM_BITS 2
+// what the G-buffer clear leaves where nothing was drawn
+#define VISIBILITY_EMPTY_ID 0
+
+// Limits checked when objects and meshes are added, the bits above would silently wrap.
+// The last triangle id is left out: with the other fields at their maximum the stored id
+// would overflow to VISIBILITY_EMPTY_ID.
+#define VISIBILITY_MAX_OBJECTS (1 << VISIBILITY_OBJECT_BITS)
+#define VISIBILITY_MAX_TRIANGLES ((1 << VISIBILITY_TRIANGLE_BITS) - 1)
+
+#endif
@@ -0,0 +1,24 @@
+#include "ObjectData.hlsli"
+#include "VisibilityBuffer.hlsli"
+
+// set once per subsystem, objects of different subsystems share slot ids
+struct SubsystemBuffer
+{
+    uint subsystemId;
+};
+
+ConstantBuffer<SubsystemBuffer> SubsystemCB : register(b3);
+
+struct PSInput
+{
+    float3 worldPos : POSITION;
+    float3 norm : NORMAL;
+    float4 tang : TANGENT;
+    float2 uv : TEXCOORD;
+    nointerpolation uint objectId : OBJECT_ID;
+};
+
+uint main(PSInput input, uint primitiveId : SV_PrimitiveID) : SV_Target0
+{
+    return PackVisibilityId(SubsystemCB.subsystemId, input.objectId, primitiveId);
+}
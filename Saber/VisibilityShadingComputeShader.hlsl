@@ -0,0 +1,158 @@
+#include "DeferredLighting.hlsli"
+#include "MaterialCB.h"
+#include "VisibilityBuffer.hlsli"
+
+// same layout as ModelBuffer in ObjectData.hlsli
+struct ObjectData
+{
+    matrix modelMatrix;
+    matrix normalMatrix;
+    uint4 materialId;
+};
+
+Texture2D<uint> visibility : register(t0);
+
+RWTexture2D<float4> output : register(u0);
+
+ConstantBuffer<MaterialCB> Materials : register(b2);
+Texture2D<float4> MaterialsTextures[] : register(t3);
+
+// GeometryPool buffers, indices are 32 bit
+StructuredBuffer<uint> indices : register(t0, space2);
+StructuredBuffer<float3> positions : register(t1, space2);
+StructuredBuffer<float3> normals : register(t2, space2);
+StructuredBuffer<float4> tangents : register(t3, space2);
+StructuredBuffer<float2> uvs : register(t4, space2);
+
+// object data of the render subsystems, in Scene::RenderSubsystemId order
+StructuredBuffer<ObjectData> staticObjects : register(t0, space3);
+StructuredBuffer<ObjectData> dynamicObjects : register(t1, space3);
+StructuredBuffer<ObjectData> staticAlphaKillObjects : register(t2, space3);
+StructuredBuffer<ObjectData> dynamicAlphaKillObjects : register(t3, space3);
+
+SamplerState s1 : register(s0);
+
+ObjectData GetObjectData(uint subsystemId, uint objectId)
+{
+    if (subsystemId == 0)
+    {
+        return staticObjects[objectId];
+    }
+    if (subsystemId == 1)
+    {
+        return dynamicObjects[objectId];
+    }
+    if (subsystemId == 2)
+    {
+        return staticAlphaKillObjects[objectId];
+    }
+    return dynamicAlphaKillObjects[objectId];
+}
+
+// y and z of materialId locate the geometry of the object, see ModelBuffer
+uint GetVertexId(ObjectData objectData, uint triangleId, uint corner)
+{
+    return uint(int(indices[objectData.materialId.y + 3 * triangleId + corner]) + asint(objectData.materialId.z));
+}
+
+#define FFX_GPU
+#define FFX_HLSL
+#include "ffx_core.h"
+
+struct ComputeShaderInput
+{
+    uint3 GroupID : SV_GroupID; // 3D index of the thread group in the dispatch.
+    uint3 GroupThreadID : SV_GroupThreadID; // 3D index of local thread ID in a thread group.
+    uint3 DispatchThreadID : SV_DispatchThreadID; // 3D index of global thread ID in the dispatch.
+    uint GroupIndex : SV_GroupIndex; // Flattened local index of the thread within a thread group.
+};
+#define BLOCK_SIZE 8
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint2 GTid = ffxRemapForWaveReduction(IN.GroupIndex);
+
+    uint3 pixel = uint3(IN.GroupID.xy * BLOCK_SIZE + GTid.xy, 0);
+
+    uint w = 0;
+    uint h = 0;
+    visibility.GetDimensions(w, h);
+
+    if (pixel.x >= w || pixel.y >= h)
+    {
+        return;
+    }
+
+    uint packedId = visibility.Load(pixel);
+    if (packedId == VISIBILITY_EMPTY_ID)
+    {
+        output[pixel.xy] = float4(.4f, .6f, .9f, 1.f);
+        return;
+    }
+
+    // the triangle the rasterizer found, transformed again the way SimpleUVVertexShader.hlsl does it
+    VisibilityId id = UnpackVisibilityId(packedId);
+    ObjectData objectData = GetObjectData(id.subsystemId, id.objectId);
+    uint3 vertexIds = uint3(
+        GetVertexId(objectData, id.triangleId, 0),
+        GetVertexId(objectData, id.triangleId, 1),
+        GetVertexId(objectData, id.triangleId, 2)
+    );
+
+    float3 worldPos0 = mul(objectData.modelMatrix, float4(positions[vertexIds.x], 1.f)).xyz;
+    float3 worldPos1 = mul(objectData.modelMatrix, float4(positions[vertexIds.y], 1.f)).xyz;
+    float3 worldPos2 = mul(objectData.modelMatrix, float4(positions[vertexIds.z], 1.f)).xyz;
+
+    float2 uvGlobal = (float2(pixel.xy) + .5f) / float2(w, h);
+    Barycentrics barycentrics = ComputeBarycentrics(
+        mul(SceneCB.vpMatrix, float4(worldPos0, 1.f)),
+        mul(SceneCB.vpMatrix, float4(worldPos1, 1.f)),
+        mul(SceneCB.vpMatrix, float4(worldPos2, 1.f)),
+        float2(2.f, -2.f) * uvGlobal - float2(1.f, -1.f),
+        float2(2.f, -2.f) / float2(w, h)
+    );
+
+    // exact derivatives, no neighbours needed
+    float2 uv0 = uvs[vertexIds.x];
+    float2 uv1 = uvs[vertexIds.y];
+    float2 uv2 = uvs[vertexIds.z];
+    float2 uv = Interpolate(barycentrics.lambda, uv0, uv1, uv2);
+    float2 uvDdx = Interpolate(barycentrics.ddx, uv0, uv1, uv2);
+    float2 uvDdy = Interpolate(barycentrics.ddy, uv0, uv1, uv2);
+
+    uint4 material = Materials.materials[objectData.materialId.x];
+
+    // normal
+    float3 n = normalize(Interpolate(
+        barycentrics.lambda,
+        mul(objectData.normalMatrix, float4(normals[vertexIds.x], 0.f)).xyz,
+        mul(objectData.normalMatrix, float4(normals[vertexIds.y], 0.f)).xyz,
+        mul(objectData.normalMatrix, float4(normals[vertexIds.z], 0.f)).xyz
+    ));
+    float4 tang0 = tangents[vertexIds.x];
+    float4 tang1 = tangents[vertexIds.y];
+    float4 tang2 = tangents[vertexIds.z];
+    float4 tang = Interpolate(
+        barycentrics.lambda,
+        float4(mul(objectData.normalMatrix, float4(tang0.xyz, 0.f)).xyz, tang0.w),
+        float4(mul(objectData.normalMatrix, float4(tang1.xyz, 0.f)).xyz, tang1.w),
+        float4(mul(objectData.normalMatrix, float4(tang2.xyz, 0.f)).xyz, tang2.w)
+    );
+    float3 t = normalize(tang.xyz);
+    float3 b = (cross(n, t)) * tang.w; // no need to normalize
+
+    float3 nmValue = MaterialsTextures[NonUniformResourceIndex(material.y)].SampleGrad(s1, uv, uvDdx, uvDdy).xyz;
+    float3 localNorm = normalize(2.f * nmValue - 1.f); // normalize to avoid unnormalized texture
+    float3 norm = localNorm.x * t + localNorm.y * b + localNorm.z * n;
+
+    // world position, interpolated instead of read back from the depth
+    float3 worldPos = Interpolate(barycentrics.lambda, worldPos0, worldPos1, worldPos2);
+
+    float3 lightColor = GetLightColor(uvGlobal, worldPos, norm);
+
+    float3 albedo = MaterialsTextures[NonUniformResourceIndex(material.x)].SampleGrad(s1, uv, uvDdx, uvDdy).xyz;
+
+    float3 finalColor = albedo * lightColor;
+
+    output[pixel.xy] = float4(finalColor, 1.f);
+}
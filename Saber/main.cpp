@@ -10,6 +10,8 @@
 
 // Use WARP adapter
 bool g_useWarp{};
+// Store triangle ids instead of surface attributes in the G-buffer
+bool g_useVisibilityBuffer{};
 
 // Window client area size
 uint32_t g_clientWidth{ 1280 };
@@ -40,6 +42,10 @@ void ParseCommandLineArguments() {
 
         // Is using warp renderer
         g_useWarp = ::wcscmp(argv[i], L"-warp") == 0 || ::wcscmp(argv[i], L"--warp") == 0;
+
+        // Is using visibility buffer
+        if (::wcscmp(argv[i], L"-visibility") == 0 || ::wcscmp(argv[i], L"--visibility") == 0)
+            g_useVisibilityBuffer = true;
     }
 
     // Free memory allocated by CommandLineToArgvW
@@ -61,7 +67,13 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
         case '1':
         case '2':
         case '3':
-            g_pRenderer->SetSceneId(wParam - '0');
+            // with shift the scene is only built in the background
+            if ((::GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0) {
+                g_pRenderer->PreloadScene(wParam - '0');
+            }
+            else {
+                g_pRenderer->SetSceneId(wParam - '0');
+            }
             break;
         case 'C':
             g_pRenderer->SwitchToNextCamera();
@@ -245,7 +257,7 @@ int CALLBACK wWinMain(
 
     g_pJobSystem = std::make_shared<JobSystem<>>();
 
-    g_pRenderer = std::make_unique<Renderer>(g_pJobSystem, 3, g_useWarp, g_clientWidth, g_clientHeight, true);
+    g_pRenderer = std::make_unique<Renderer>(g_pJobSystem, 3, g_useWarp, g_clientWidth, g_clientHeight, true, g_useVisibilityBuffer);
     g_pRenderer->Initialize(g_pOutputContext->getHWND());
 
     g_isInitialized = true;
@@ -0,0 +1,53 @@
+#pragma once
+
+// Benchmarks are plain executables outside of CTest. Every measured function
+// runs once to warm up, then several times; the best and the mean time are printed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace Benchmark {
+	struct Result {
+		double bestMs{};
+		double meanMs{};
+	};
+
+	template <typename Func>
+	Result Measure(size_t runsCount, Func func) {
+		using Clock = std::chrono::steady_clock;
+
+		func();
+		Result result{ .bestMs{ 1e30 } };
+		for (size_t i{}; i < runsCount; ++i) {
+			Clock::time_point start{ Clock::now() };
+			func();
+			double ms{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+			result.bestMs = std::min(result.bestMs, ms);
+			result.meanMs += ms / static_cast<double>(runsCount);
+		}
+		return result;
+	}
+
+	// itemsCount items are processed per run, the throughput is computed from the best run
+	inline void Print(const char* pName, const Result& result, double itemsCount, const char* pItemsName) {
+		std::printf(
+			"%-36s best %9.3f ms  mean %9.3f ms  %9.2f M %s/s\n",
+			pName,
+			result.bestMs,
+			result.meanMs,
+			itemsCount / result.bestMs / 1e3,
+			pItemsName
+		);
+	}
+
+	// the first argument overrides the default item count, e.g. for a quick run
+	inline size_t GetCount(int argc, char** argv, size_t defaultCount) {
+		if (argc > 1) {
+			size_t count{ std::strtoull(argv[1], nullptr, 10) };
+			return count ? count : defaultCount;
+		}
+		return defaultCount;
+	}
+}
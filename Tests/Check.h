@@ -0,0 +1,29 @@
+#pragma once
+
+// The tests are plain executables: every failed CHECK is printed,
+// and the exit code of Check::Finish tells CTest if any failed.
+
+#include <cstdio>
+
+namespace Check {
+	inline int failuresCount{};
+
+	inline bool Report(bool isPassed, const char* pExpression, const char* pFile, int line) {
+		if (!isPassed) {
+			++failuresCount;
+			std::printf("%s(%d): CHECK(%s) failed\n", pFile, line, pExpression);
+		}
+		return isPassed;
+	}
+
+	inline int Finish(const char* pName) {
+		if (failuresCount == 0) {
+			std::printf("%s: passed\n", pName);
+			return 0;
+		}
+		std::printf("%s: %d checks failed\n", pName, failuresCount);
+		return 1;
+	}
+}
+
+#define CHECK(expression) Check::Report(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
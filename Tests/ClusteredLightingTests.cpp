@@ -0,0 +1,284 @@
+#include "Check.h"
+#include "CullingScene.h"
+
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+	constexpr float nearZ{ 0.1f };
+	constexpr float farZ{ 200.f };
+
+	struct Camera {
+		DirectX::XMFLOAT3 position{};
+		DirectX::XMFLOAT3 forward{};
+		DirectX::XMFLOAT4X4 viewProjection{};
+		DirectX::XMFLOAT4X4 invViewProjection{};
+		ClusterConstants constants{};
+	};
+
+	// reversed depth like Saber's camera
+	Camera MakeCamera(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& target, uint32_t lightsCount) {
+		DirectX::XMMATRIX view{ DirectX::XMMatrixLookAtLH(
+			DirectX::XMVectorSet(position.x, position.y, position.z, 1.f),
+			DirectX::XMVectorSet(target.x, target.y, target.z, 1.f),
+			DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f)
+		) };
+		DirectX::XMMATRIX projection{ DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(60.f), 16.f / 9.f, farZ, nearZ) };
+		DirectX::XMMATRIX viewProjection{ DirectX::XMMatrixMultiply(view, projection) };
+
+		Camera camera{ .position{ position } };
+		DirectX::XMStoreFloat3(&camera.forward, DirectX::XMVector3Normalize(DirectX::XMVectorSet(
+			target.x - position.x, target.y - position.y, target.z - position.z, 0.f
+		)));
+		DirectX::XMStoreFloat4x4(&camera.viewProjection, viewProjection);
+		DirectX::XMStoreFloat4x4(&camera.invViewProjection, DirectX::XMMatrixInverse(nullptr, viewProjection));
+		camera.constants = ClusteredLighting::MakeClusterConstants(viewProjection, position, nearZ, farZ, lightsCount);
+		return camera;
+	}
+
+	DirectX::XMFLOAT4 Transform(const DirectX::XMFLOAT4X4& m, double x, double y, double z) {
+		DirectX::XMFLOAT4 result{};
+		DirectX::XMStoreFloat4(&result, DirectX::XMVector3Transform(
+			DirectX::XMVectorSet(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z), 1.f),
+			DirectX::XMLoadFloat4x4(&m)
+		));
+		return result;
+	}
+
+	double GetViewDepth(const Camera& camera, double x, double y, double z) {
+		return (x - camera.position.x) * camera.forward.x + (y - camera.position.y) * camera.forward.y
+			+ (z - camera.position.z) * camera.forward.z;
+	}
+
+	double GetSliceDepth(uint32_t sliceId) {
+		return nearZ * std::pow(static_cast<double>(farZ) / nearZ, static_cast<double>(sliceId) / CLUSTERS_Z);
+	}
+
+	// The side planes of the tile and the depth range of the slice in double precision.
+	// Like the shader each of them is tested on its own, so spheres near a corner of the cluster
+	// can pass all of them without touching it, a cheap test that is never too tight.
+	bool IsSphereNearCluster(const Camera& camera, uint32_t clusterId, const DirectX::XMFLOAT4& sphere, double tolerance) {
+		uint32_t x{ clusterId % CLUSTERS_X }, y{ clusterId / CLUSTERS_X % CLUSTERS_Y }, z{ clusterId / (CLUSTERS_X * CLUSTERS_Y) };
+		double offset[3]{ sphere.x - camera.position.x, sphere.y - camera.position.y, sphere.z - camera.position.z };
+		double depth{ offset[0] * camera.forward.x + offset[1] * camera.forward.y + offset[2] * camera.forward.z };
+		if (sphere.w <= 0.f || depth + sphere.w < GetSliceDepth(z) - tolerance || depth - sphere.w > GetSliceDepth(z + 1) + tolerance) {
+			return false;
+		}
+
+		// corner directions from the camera through the near plane, counterclockwise on the screen
+		double corners[4][3]{};
+		double center[3]{};
+		for (uint32_t corner{}; corner < 4; ++corner) {
+			uint32_t cornerX{ x + (corner == 1 || corner == 2) }, cornerY{ y + (corner >= 2) };
+			DirectX::XMFLOAT4 nearPoint{ Transform(
+				camera.invViewProjection, -1. + 2. * cornerX / CLUSTERS_X, 1. - 2. * cornerY / CLUSTERS_Y, 1.
+			) };
+			corners[corner][0] = nearPoint.x / nearPoint.w - camera.position.x;
+			corners[corner][1] = nearPoint.y / nearPoint.w - camera.position.y;
+			corners[corner][2] = nearPoint.z / nearPoint.w - camera.position.z;
+			for (size_t i{}; i < 3; ++i) {
+				center[i] += corners[corner][i];
+			}
+		}
+		for (uint32_t corner{}; corner < 4; ++corner) {
+			const double* a{ corners[corner] };
+			const double* b{ corners[(corner + 1) % 4] };
+			double normal[3]{ a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+			double length{ std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) };
+			double sign{ normal[0] * center[0] + normal[1] * center[1] + normal[2] * center[2] < 0. ? -1. : 1. };
+			double distance{ sign * (normal[0] * offset[0] + normal[1] * offset[1] + normal[2] * offset[2]) / length };
+			if (distance < -sphere.w - tolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct Assignment {
+		std::vector<uint32_t> counts{ std::vector<uint32_t>(CLUSTERS_COUNT) };
+		std::vector<uint32_t> indices{ std::vector<uint32_t>(CLUSTERS_COUNT * CLUSTER_LIGHTS_MAX_COUNT) };
+		ClusterStats stats{};
+
+		bool Contains(uint32_t clusterId, uint32_t lightId) const {
+			auto begin{ indices.begin() + clusterId * CLUSTER_LIGHTS_MAX_COUNT };
+			return std::binary_search(begin, begin + counts[clusterId], lightId);
+		}
+	};
+
+	Assignment AssignLights(const Camera& camera, const std::vector<Light>& lights) {
+		Assignment assignment{};
+		ClusteredLighting::AssignLightsReference(
+			camera.constants, lights.data(), assignment.counts.data(), assignment.indices.data(), &assignment.stats
+		);
+		return assignment;
+	}
+
+	Light MakeLight(const DirectX::XMFLOAT3& position, float power) {
+		Light light{
+			.position{ position.x, position.y, position.z, 0.f },
+			.diffuseColorAndPower{ 1.f, 0.5f, 0.25f, power },
+			.specularColorAndPower{ 0.5f, 0.5f, 0.5f, power }
+		};
+		light.position.w = ClusteredLighting::GetLightRange(light);
+		return light;
+	}
+
+	// Every point a light reaches finds the light in the cluster the shading looks up for it,
+	// and lights are only assigned to clusters whose side planes and depth range their sphere touches
+	void CheckAssignment(const Camera& camera, const std::vector<Light>& lights, const Assignment& assignment, uint32_t seed) {
+		size_t assignedCount{};
+		size_t farAssignmentsCount{};
+		for (uint32_t clusterId{}; clusterId < CLUSTERS_COUNT; ++clusterId) {
+			uint32_t count{ assignment.counts[clusterId] };
+			CHECK(count <= CLUSTER_LIGHTS_MAX_COUNT);
+			auto begin{ assignment.indices.begin() + clusterId * CLUSTER_LIGHTS_MAX_COUNT };
+			CHECK(std::adjacent_find(begin, begin + count, std::greater_equal<uint32_t>{}) == begin + count);
+			for (uint32_t i{}; i < count; ++i) {
+				const Light& light{ lights[begin[i]] };
+				farAssignmentsCount += !IsSphereNearCluster(camera, clusterId, light.position, 1e-3);
+			}
+			assignedCount += count;
+		}
+		CHECK(farAssignmentsCount == 0);
+		CHECK(assignedCount > 0);
+
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<double> unit{ -1., 1. };
+		size_t testedPointsCount{};
+		size_t missesCount{};
+		for (uint32_t lightId{}; lightId < lights.size(); ++lightId) {
+			const DirectX::XMFLOAT4& sphere{ lights[lightId].position };
+			for (size_t i{}; i < 64 && sphere.w > 0.f; ++i) {
+				double offset[3]{ unit(random), unit(random), unit(random) };
+				if (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] > 1.) {
+					continue;
+				}
+				double x{ sphere.x + offset[0] * sphere.w }, y{ sphere.y + offset[1] * sphere.w }, z{ sphere.z + offset[2] * sphere.w };
+				DirectX::XMFLOAT4 clip{ Transform(camera.viewProjection, x, y, z) };
+				double viewDepth{ GetViewDepth(camera, x, y, z) };
+				double u{ clip.x / clip.w * 0.5 + 0.5 }, v{ -clip.y / clip.w * 0.5 + 0.5 };
+				if (clip.w <= 0.f || u < 0. || u >= 1. || v < 0. || v >= 1. || viewDepth < nearZ || viewDepth >= farZ) {
+					continue;
+				}
+				uint32_t clusterId{ ClusteredLighting::GetClusterId(
+					camera.constants, static_cast<float>(u), static_cast<float>(v), static_cast<float>(viewDepth)
+				) };
+				++testedPointsCount;
+				if (assignment.counts[clusterId] < CLUSTER_LIGHTS_MAX_COUNT) {
+					missesCount += !assignment.Contains(clusterId, lightId);
+				}
+			}
+		}
+		CHECK(missesCount == 0);
+		CHECK(testedPointsCount > 1000);
+	}
+
+	void TestLightRange() {
+		// the range is where the brightest channel times the attenuation drops to the cutoff
+		Light light{ MakeLight({}, 4.f) };
+		CHECK(std::abs(light.position.w - std::sqrt(4.f / LIGHT_ATTENUATION_CUTOFF)) < 1e-3f);
+		CHECK(std::abs(4.f / (light.position.w * light.position.w) - LIGHT_ATTENUATION_CUTOFF) < 1e-6f);
+		// the specular color counts too
+		light.specularColorAndPower = DirectX::XMFLOAT4{ 2.f, 0.f, 0.f, 4.f };
+		CHECK(std::abs(ClusteredLighting::GetLightRange(light) - std::sqrt(8.f / LIGHT_ATTENUATION_CUTOFF)) < 1e-3f);
+		// lights the shading skips
+		CHECK(MakeLight({}, 0.f).position.w == 0.f);
+		CHECK(MakeLight({}, -1.f).position.w == 0.f);
+	}
+
+	void TestClusterId() {
+		Camera camera{ MakeCamera({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 0) };
+		CHECK(std::abs(camera.constants.cameraForward.z - 1.f) < 1e-5f);
+
+		CHECK(ClusteredLighting::GetClusterId(camera.constants, 0.f, 0.f, nearZ) == 0);
+		CHECK(ClusteredLighting::GetClusterId(camera.constants, 0.999f, 0.999f, farZ) == CLUSTERS_COUNT - 1);
+		// clamped outside of the screen and the depth range
+		CHECK(ClusteredLighting::GetClusterId(camera.constants, -0.5f, 2.f, 1e6f) == (CLUSTERS_Z * CLUSTERS_Y - 1) * CLUSTERS_X);
+		CHECK(ClusteredLighting::GetClusterId(camera.constants, 0.5f, 0.5f, 0.f) == (CLUSTERS_Y / 2) * CLUSTERS_X + CLUSTERS_X / 2);
+
+		// slices grow exponentially
+		for (uint32_t sliceId{}; sliceId < CLUSTERS_Z; ++sliceId) {
+			float depth{ static_cast<float>(std::sqrt(GetSliceDepth(sliceId) * GetSliceDepth(sliceId + 1))) };
+			CHECK(ClusteredLighting::GetClusterId(camera.constants, 0.f, 0.f, depth) == sliceId * CLUSTERS_X * CLUSTERS_Y);
+		}
+	}
+
+	void TestAssignLights() {
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> xy{ -1.f, 1.f };
+		std::uniform_real_distribution<float> depth{ -10.f, 220.f };
+		std::uniform_real_distribution<float> power{ 0.001f, 0.5f };
+
+		std::vector<Light> lights{};
+		for (size_t i{}; i < 500; ++i) {
+			float z{ depth(random) };
+			float spread{ std::abs(z) + 10.f };
+			lights.push_back(MakeLight({ xy(random) * spread, xy(random) * spread * 0.6f, z }, power(random)));
+		}
+		// around and behind the camera, and off
+		lights.push_back(MakeLight({ 0.f, 0.f, 0.f }, 0.1f));
+		lights.push_back(MakeLight({ 0.f, 0.f, -8.f }, 0.1f));
+		lights.push_back(MakeLight({ 0.f, 0.f, 20.f }, 0.f));
+
+		Camera camera{ MakeCamera({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, static_cast<uint32_t>(lights.size())) };
+		Assignment assignment{ AssignLights(camera, lights) };
+		CheckAssignment(camera, lights, assignment, 2);
+		CHECK(assignment.stats.overflowedClustersCount == 0);
+		CHECK(assignment.stats.maxClusterLightsCount == *std::max_element(assignment.counts.begin(), assignment.counts.end()));
+
+		// the light around the camera reaches the nearest slice of every tile, the light that is off nothing
+		for (uint32_t tileId{}; tileId < CLUSTERS_X * CLUSTERS_Y; ++tileId) {
+			CHECK(assignment.Contains(tileId, 500));
+		}
+		uint32_t offLightsCount{};
+		for (uint32_t clusterId{}; clusterId < CLUSTERS_COUNT; ++clusterId) {
+			offLightsCount += assignment.Contains(clusterId, 502);
+		}
+		CHECK(offLightsCount == 0);
+
+		// a camera away from the origin looking sideways and down
+		Camera movedCamera{ MakeCamera({ 30.f, 20.f, -40.f }, { 0.f, 0.f, 60.f }, static_cast<uint32_t>(lights.size())) };
+		CheckAssignment(movedCamera, lights, AssignLights(movedCamera, lights), 3);
+
+		// no lights
+		Camera emptyCamera{ MakeCamera({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 0) };
+		Assignment empty{ AssignLights(emptyCamera, lights) };
+		CHECK(std::all_of(empty.counts.begin(), empty.counts.end(), [](uint32_t count) { return count == 0; }));
+		CHECK(empty.stats.maxClusterLightsCount == 0);
+	}
+
+	void TestOverflow() {
+		// more lights in one place than a cluster can list
+		constexpr uint32_t lightsCount{ CLUSTER_LIGHTS_MAX_COUNT + 22 };
+		std::vector<Light> lights{};
+		for (uint32_t i{}; i < lightsCount; ++i) {
+			lights.push_back(MakeLight({ 0.f, 0.f, 50.f + 0.01f * i }, 0.01f));
+		}
+		Camera camera{ MakeCamera({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, lightsCount) };
+		Assignment assignment{ AssignLights(camera, lights) };
+
+		CHECK(assignment.stats.maxClusterLightsCount == lightsCount);
+		uint32_t overflowedCount{};
+		for (uint32_t clusterId{}; clusterId < CLUSTERS_COUNT; ++clusterId) {
+			if (assignment.counts[clusterId] == CLUSTER_LIGHTS_MAX_COUNT) {
+				++overflowedCount;
+				// the first lights are kept
+				auto begin{ assignment.indices.begin() + clusterId * CLUSTER_LIGHTS_MAX_COUNT };
+				CHECK(begin[0] == 0 && begin[CLUSTER_LIGHTS_MAX_COUNT - 1] == CLUSTER_LIGHTS_MAX_COUNT - 1);
+			}
+		}
+		CHECK(overflowedCount > 0);
+		CHECK(assignment.stats.overflowedClustersCount == overflowedCount);
+	}
+}
+
+int main() {
+	TestLightRange();
+	TestClusterId();
+	TestAssignLights();
+	TestOverflow();
+	return Check::Finish("ClusteredLightingTests");
+}
@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+
+#include "IndirectCommand.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+	// Stand-in for a render object filling its command through a virtual call, like every
+	// RenderSubsystem did before the commands were kept in an array parallel to the objects
+	class FillObject {
+	public:
+		virtual ~FillObject() = default;
+		virtual void FillIndirectCommand(CbMesh4IndirectCommand& indirectCommand) const = 0;
+		virtual void FillIndirectCommand(IdIndirectCommand& indirectCommand) const = 0;
+	};
+
+	class MeshFillObject : public FillObject {
+		D3D12_GPU_VIRTUAL_ADDRESS m_constantBufferAddress{};
+		D3D12_GPU_VIRTUAL_ADDRESS m_vertexBufferAddress{};
+		D3D12_GPU_VIRTUAL_ADDRESS m_indexBufferAddress{};
+		D3D12_DRAW_INDEXED_ARGUMENTS m_drawArguments{};
+
+	public:
+		explicit MeshFillObject(uint32_t meshId)
+			: m_constantBufferAddress(0x10000ull + meshId * 256ull),
+			m_vertexBufferAddress(0x1000000ull + meshId * 4096ull),
+			m_indexBufferAddress(0x8000000ull + meshId * 1024ull),
+			m_drawArguments{ .IndexCountPerInstance{ 36 }, .InstanceCount{ 1 } } {}
+
+		void FillIndirectCommand(CbMesh4IndirectCommand& indirectCommand) const override {
+			D3D12_VERTEX_BUFFER_VIEW vertexBufferView{ m_vertexBufferAddress, 1024, 12 };
+			indirectCommand = CbMesh4IndirectCommand{
+				.constantBufferView{ m_constantBufferAddress },
+				.indexBufferView{ m_indexBufferAddress, 1024, DXGI_FORMAT_R32_UINT },
+				.vertexBufferView{ vertexBufferView },
+				.vertexBufferView1{ vertexBufferView.BufferLocation + 1024, 1024, 12 },
+				.vertexBufferView2{ vertexBufferView.BufferLocation + 2048, 1024, 8 },
+				.vertexBufferView3{ vertexBufferView.BufferLocation + 3072, 1024, 12 },
+				.drawArguments{ m_drawArguments }
+			};
+		}
+
+		void FillIndirectCommand(IdIndirectCommand& indirectCommand) const override {
+			indirectCommand = IdIndirectCommand{ .drawArguments{ m_drawArguments } };
+		}
+	};
+}
+
+// Filling the indirect commands of 1M objects: through a virtual call per shared object with the
+// large per-object command and the compact id command, and from the contiguous command array
+int main(int argc, char** argv) {
+	size_t objectsCount{ Benchmark::GetCount(argc, argv, 1'000'000) };
+	constexpr size_t runsCount{ 10 };
+
+	// objects are added in any order, their allocations are not in the order of the array
+	std::vector<std::shared_ptr<FillObject>> objects(objectsCount);
+	std::vector<size_t> order(objectsCount);
+	std::iota(order.begin(), order.end(), size_t{});
+	std::shuffle(order.begin(), order.end(), std::mt19937{ 1 });
+	for (size_t objectId : order) {
+		objects[objectId] = std::make_shared<MeshFillObject>(static_cast<uint32_t>(objectId % 1000));
+	}
+
+	std::vector<CbMesh4IndirectCommand> meshCommands(objectsCount);
+	std::vector<IdIndirectCommand> objectCommands(objectsCount);
+	for (size_t i{}; i < objectsCount; ++i) {
+		objects[i]->FillIndirectCommand(objectCommands[i]);
+	}
+	// the upload destination
+	std::vector<IdIndirectCommand> commands(objectsCount);
+
+	std::printf(
+		"%zu objects, %zu bytes per mesh command, %zu bytes per id command\n",
+		objectsCount,
+		sizeof(CbMesh4IndirectCommand),
+		sizeof(IdIndirectCommand)
+	);
+
+	Benchmark::Result meshFill{ Benchmark::Measure(runsCount, [&] {
+		for (size_t i{}; i < objectsCount; ++i) {
+			objects[i]->FillIndirectCommand(meshCommands[i]);
+		}
+	}) };
+	Benchmark::Print("Virtual fill, mesh commands", meshFill, static_cast<double>(objectsCount), "commands");
+
+	Benchmark::Result idFill{ Benchmark::Measure(runsCount, [&] {
+		for (size_t i{}; i < objectsCount; ++i) {
+			objects[i]->FillIndirectCommand(commands[i]);
+		}
+	}) };
+	Benchmark::Print("Virtual fill, id commands", idFill, static_cast<double>(objectsCount), "commands");
+
+	Benchmark::Result arrayFill{ Benchmark::Measure(runsCount, [&] {
+		std::memcpy(commands.data(), objectCommands.data(), objectsCount * sizeof(IdIndirectCommand));
+	}) };
+	Benchmark::Print("Command array, id commands", arrayFill, static_cast<double>(objectsCount), "commands");
+
+	std::printf(
+		"%.1f MB of mesh commands, %.1f MB of id commands, array %.1fx faster than virtual mesh fill\n",
+		objectsCount * sizeof(CbMesh4IndirectCommand) / 1e6,
+		objectsCount * sizeof(IdIndirectCommand) / 1e6,
+		meshFill.bestMs / arrayFill.bestMs
+	);
+	return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Stand-in for the bounding volumes of DirectXCollision, see DirectXMath.h next to it
+
+#include "DirectXMath.h"
+
+namespace DirectX {
+	struct BoundingSphere {
+		XMFLOAT3 Center{ 0.f, 0.f, 0.f };
+		float Radius{ 1.f };
+
+		BoundingSphere() = default;
+		constexpr BoundingSphere(const XMFLOAT3& center, float radius) : Center(center), Radius(radius) {}
+	};
+
+	struct BoundingBox {
+		XMFLOAT3 Center{ 0.f, 0.f, 0.f };
+		XMFLOAT3 Extents{ 1.f, 1.f, 1.f };
+
+		BoundingBox() = default;
+		constexpr BoundingBox(const XMFLOAT3& center, const XMFLOAT3& extents) : Center(center), Extents(extents) {}
+	};
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+// Scalar stand-in for the part of DirectXMath the tested code and the tests use.
+// Layouts and conventions match DirectXMath: row vectors, row-major matrices, left-handed.
+
+#include <cmath>
+#include <cstdint>
+
+namespace DirectX {
+	constexpr float XM_PI{ 3.141592654f };
+	constexpr float XM_2PI{ 6.283185307f };
+	constexpr float XM_PIDIV2{ 1.570796327f };
+	constexpr float XM_PIDIV4{ 0.785398163f };
+
+	constexpr float XMConvertToRadians(float degrees) {
+		return degrees * (XM_PI / 180.f);
+	}
+
+	struct XMFLOAT2 {
+		float x{};
+		float y{};
+
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3 {
+		float x{};
+		float y{};
+		float z{};
+
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4 {
+		float x{};
+		float y{};
+		float z{};
+		float w{};
+
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMFLOAT4X4 {
+		float m[4][4]{};
+
+		XMFLOAT4X4() = default;
+		constexpr XMFLOAT4X4(
+			float m00, float m01, float m02, float m03,
+			float m10, float m11, float m12, float m13,
+			float m20, float m21, float m22, float m23,
+			float m30, float m31, float m32, float m33
+		) : m{ { m00, m01, m02, m03 }, { m10, m11, m12, m13 }, { m20, m21, m22, m23 }, { m30, m31, m32, m33 } } {}
+
+		float operator()(size_t row, size_t column) const {
+			return m[row][column];
+		}
+		float& operator()(size_t row, size_t column) {
+			return m[row][column];
+		}
+	};
+
+	struct XMINT2 {
+		int32_t x{};
+		int32_t y{};
+
+		XMINT2() = default;
+		constexpr XMINT2(int32_t x, int32_t y) : x(x), y(y) {}
+	};
+
+	struct XMINT3 {
+		int32_t x{};
+		int32_t y{};
+		int32_t z{};
+
+		XMINT3() = default;
+		constexpr XMINT3(int32_t x, int32_t y, int32_t z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMINT4 {
+		int32_t x{};
+		int32_t y{};
+		int32_t z{};
+		int32_t w{};
+
+		XMINT4() = default;
+		constexpr XMINT4(int32_t x, int32_t y, int32_t z, int32_t w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMUINT2 {
+		uint32_t x{};
+		uint32_t y{};
+
+		XMUINT2() = default;
+		constexpr XMUINT2(uint32_t x, uint32_t y) : x(x), y(y) {}
+	};
+
+	struct XMUINT3 {
+		uint32_t x{};
+		uint32_t y{};
+		uint32_t z{};
+
+		XMUINT3() = default;
+		constexpr XMUINT3(uint32_t x, uint32_t y, uint32_t z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMUINT4 {
+		uint32_t x{};
+		uint32_t y{};
+		uint32_t z{};
+		uint32_t w{};
+
+		XMUINT4() = default;
+		constexpr XMUINT4(uint32_t x, uint32_t y, uint32_t z, uint32_t w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMVECTOR {
+		float f[4]{};
+	};
+	using FXMVECTOR = const XMVECTOR;
+
+	struct XMMATRIX {
+		XMVECTOR r[4]{};
+	};
+	using FXMMATRIX = const XMMATRIX&;
+	using CXMMATRIX = const XMMATRIX&;
+
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w) {
+		return XMVECTOR{ { x, y, z, w } };
+	}
+
+	inline XMVECTOR XMVectorZero() {
+		return XMVECTOR{};
+	}
+
+	inline float XMVectorGetX(FXMVECTOR v) {
+		return v.f[0];
+	}
+	inline float XMVectorGetY(FXMVECTOR v) {
+		return v.f[1];
+	}
+	inline float XMVectorGetZ(FXMVECTOR v) {
+		return v.f[2];
+	}
+	inline float XMVectorGetW(FXMVECTOR v) {
+		return v.f[3];
+	}
+
+	inline XMVECTOR XMVectorAdd(FXMVECTOR lhs, FXMVECTOR rhs) {
+		return XMVectorSet(lhs.f[0] + rhs.f[0], lhs.f[1] + rhs.f[1], lhs.f[2] + rhs.f[2], lhs.f[3] + rhs.f[3]);
+	}
+
+	inline XMVECTOR XMVectorSubtract(FXMVECTOR lhs, FXMVECTOR rhs) {
+		return XMVectorSet(lhs.f[0] - rhs.f[0], lhs.f[1] - rhs.f[1], lhs.f[2] - rhs.f[2], lhs.f[3] - rhs.f[3]);
+	}
+
+	inline XMVECTOR XMVectorScale(FXMVECTOR v, float scale) {
+		return XMVectorSet(v.f[0] * scale, v.f[1] * scale, v.f[2] * scale, v.f[3] * scale);
+	}
+
+	inline XMVECTOR XMVector3Dot(FXMVECTOR lhs, FXMVECTOR rhs) {
+		float dot{ lhs.f[0] * rhs.f[0] + lhs.f[1] * rhs.f[1] + lhs.f[2] * rhs.f[2] };
+		return XMVectorSet(dot, dot, dot, dot);
+	}
+
+	inline XMVECTOR XMVector3Cross(FXMVECTOR lhs, FXMVECTOR rhs) {
+		return XMVectorSet(
+			lhs.f[1] * rhs.f[2] - lhs.f[2] * rhs.f[1],
+			lhs.f[2] * rhs.f[0] - lhs.f[0] * rhs.f[2],
+			lhs.f[0] * rhs.f[1] - lhs.f[1] * rhs.f[0],
+			0.f
+		);
+	}
+
+	inline XMVECTOR XMVector3Normalize(FXMVECTOR v) {
+		float length{ std::sqrt(XMVectorGetX(XMVector3Dot(v, v))) };
+		return length > 0.f ? XMVectorScale(v, 1.f / length) : v;
+	}
+
+	// divides by the length of the normal
+	inline XMVECTOR XMPlaneNormalize(FXMVECTOR plane) {
+		float length{ std::sqrt(plane.f[0] * plane.f[0] + plane.f[1] * plane.f[1] + plane.f[2] * plane.f[2]) };
+		return length > 0.f ? XMVectorScale(plane, 1.f / length) : plane;
+	}
+
+	inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m) {
+		XMVECTOR result{};
+		for (size_t i{}; i < 4; ++i) {
+			result = XMVectorAdd(result, XMVectorScale(m.r[i], v.f[i]));
+		}
+		return result;
+	}
+
+	// w is taken as 1
+	inline XMVECTOR XMVector3Transform(FXMVECTOR v, FXMMATRIX m) {
+		return XMVector4Transform(XMVectorSet(v.f[0], v.f[1], v.f[2], 1.f), m);
+	}
+
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* pSource) {
+		return XMVectorSet(pSource->x, pSource->y, pSource->z, 0.f);
+	}
+
+	inline XMVECTOR XMLoadFloat4(const XMFLOAT4* pSource) {
+		return XMVectorSet(pSource->x, pSource->y, pSource->z, pSource->w);
+	}
+
+	inline void XMStoreFloat3(XMFLOAT3* pDestination, FXMVECTOR v) {
+		*pDestination = XMFLOAT3{ v.f[0], v.f[1], v.f[2] };
+	}
+
+	inline void XMStoreFloat4(XMFLOAT4* pDestination, FXMVECTOR v) {
+		*pDestination = XMFLOAT4{ v.f[0], v.f[1], v.f[2], v.f[3] };
+	}
+
+	inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* pSource) {
+		XMMATRIX m{};
+		for (size_t i{}; i < 4; ++i) {
+			m.r[i] = XMVectorSet(pSource->m[i][0], pSource->m[i][1], pSource->m[i][2], pSource->m[i][3]);
+		}
+		return m;
+	}
+
+	inline void XMStoreFloat4x4(XMFLOAT4X4* pDestination, FXMMATRIX m) {
+		for (size_t i{}; i < 4; ++i) {
+			for (size_t j{}; j < 4; ++j) {
+				pDestination->m[i][j] = m.r[i].f[j];
+			}
+		}
+	}
+
+	inline XMMATRIX XMMatrixSet(
+		float m00, float m01, float m02, float m03,
+		float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23,
+		float m30, float m31, float m32, float m33
+	) {
+		return XMMATRIX{ {
+			XMVectorSet(m00, m01, m02, m03),
+			XMVectorSet(m10, m11, m12, m13),
+			XMVectorSet(m20, m21, m22, m23),
+			XMVectorSet(m30, m31, m32, m33)
+		} };
+	}
+
+	inline XMMATRIX XMMatrixIdentity() {
+		return XMMatrixSet(1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f);
+	}
+
+	inline XMMATRIX XMMatrixTranslation(float x, float y, float z) {
+		return XMMatrixSet(1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, x, y, z, 1.f);
+	}
+
+	inline XMMATRIX XMMatrixMultiply(FXMMATRIX lhs, CXMMATRIX rhs) {
+		XMMATRIX result{};
+		for (size_t i{}; i < 4; ++i) {
+			result.r[i] = XMVector4Transform(lhs.r[i], rhs);
+		}
+		return result;
+	}
+
+	inline XMMATRIX operator*(FXMMATRIX lhs, CXMMATRIX rhs) {
+		return XMMatrixMultiply(lhs, rhs);
+	}
+
+	inline XMMATRIX XMMatrixTranspose(FXMMATRIX m) {
+		XMMATRIX result{};
+		for (size_t i{}; i < 4; ++i) {
+			for (size_t j{}; j < 4; ++j) {
+				result.r[i].f[j] = m.r[j].f[i];
+			}
+		}
+		return result;
+	}
+
+	// Gauss-Jordan elimination with partial pivoting, pDeterminant is left untouched
+	inline XMMATRIX XMMatrixInverse(XMVECTOR* pDeterminant, FXMMATRIX m) {
+		(void)pDeterminant;
+		double a[4][8]{};
+		for (size_t i{}; i < 4; ++i) {
+			for (size_t j{}; j < 4; ++j) {
+				a[i][j] = m.r[i].f[j];
+			}
+			a[i][4 + i] = 1.0;
+		}
+		for (size_t column{}; column < 4; ++column) {
+			size_t pivot{ column };
+			for (size_t i{ column + 1 }; i < 4; ++i) {
+				if (std::abs(a[i][column]) > std::abs(a[pivot][column])) {
+					pivot = i;
+				}
+			}
+			for (size_t j{}; j < 8; ++j) {
+				double temp{ a[column][j] };
+				a[column][j] = a[pivot][j];
+				a[pivot][j] = temp;
+			}
+			double scale{ 1.0 / a[column][column] };
+			for (size_t j{}; j < 8; ++j) {
+				a[column][j] *= scale;
+			}
+			for (size_t i{}; i < 4; ++i) {
+				if (i == column) {
+					continue;
+				}
+				double factor{ a[i][column] };
+				for (size_t j{}; j < 8; ++j) {
+					a[i][j] -= factor * a[column][j];
+				}
+			}
+		}
+		XMMATRIX result{};
+		for (size_t i{}; i < 4; ++i) {
+			for (size_t j{}; j < 4; ++j) {
+				result.r[i].f[j] = static_cast<float>(a[i][4 + j]);
+			}
+		}
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixLookToLH(FXMVECTOR eyePosition, FXMVECTOR eyeDirection, FXMVECTOR upDirection) {
+		XMVECTOR zAxis{ XMVector3Normalize(eyeDirection) };
+		XMVECTOR xAxis{ XMVector3Normalize(XMVector3Cross(upDirection, zAxis)) };
+		XMVECTOR yAxis{ XMVector3Cross(zAxis, xAxis) };
+		auto dot = [&](FXMVECTOR axis) {
+			return -XMVectorGetX(XMVector3Dot(axis, eyePosition));
+		};
+		return XMMatrixSet(
+			xAxis.f[0], yAxis.f[0], zAxis.f[0], 0.f,
+			xAxis.f[1], yAxis.f[1], zAxis.f[1], 0.f,
+			xAxis.f[2], yAxis.f[2], zAxis.f[2], 0.f,
+			dot(xAxis), dot(yAxis), dot(zAxis), 1.f
+		);
+	}
+
+	inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR eyePosition, FXMVECTOR focusPosition, FXMVECTOR upDirection) {
+		return XMMatrixLookToLH(eyePosition, XMVectorSubtract(focusPosition, eyePosition), upDirection);
+	}
+
+	inline XMMATRIX XMMatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ) {
+		float height{ 1.f / std::tan(0.5f * fovAngleY) };
+		float width{ height / aspectRatio };
+		float range{ farZ / (farZ - nearZ) };
+		return XMMatrixSet(
+			width, 0.f, 0.f, 0.f,
+			0.f, height, 0.f, 0.f,
+			0.f, 0.f, range, 1.f,
+			0.f, 0.f, -range * nearZ, 0.f
+		);
+	}
+}
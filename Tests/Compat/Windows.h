@@ -0,0 +1,25 @@
+#pragma once
+
+// Stand-in for the Windows types the tested code uses, see d3d12.h next to it
+
+#include <cstdint>
+
+using BYTE = uint8_t;
+using UINT8 = uint8_t;
+using UINT16 = uint16_t;
+using INT = int32_t;
+using UINT = uint32_t;
+using UINT64 = uint64_t;
+using FLOAT = float;
+using BOOL = int;
+using LONG = int32_t;
+using HRESULT = LONG;
+
+#define FAILED(hr) (static_cast<HRESULT>(hr) < 0)
+#define SUCCEEDED(hr) (static_cast<HRESULT>(hr) >= 0)
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+inline void OutputDebugStringA(const char*) {}
+inline void OutputDebugStringW(const wchar_t*) {}
+#define OutputDebugString OutputDebugStringW
@@ -0,0 +1,19 @@
+#pragma once
+
+// Stand-in for _com_error, used by ThrowIfFailed
+
+#include "Windows.h"
+
+class _com_error {
+	HRESULT m_hr{};
+
+public:
+	explicit _com_error(HRESULT hr) : m_hr(hr) {}
+
+	HRESULT Error() const {
+		return m_hr;
+	}
+	const wchar_t* ErrorMessage() const {
+		return L"HRESULT failed";
+	}
+};
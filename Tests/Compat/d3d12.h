@@ -0,0 +1,164 @@
+#pragma once
+
+// Stand-in for the part of the D3D12 headers the tested code uses, so the tests build without
+// the Windows SDK. Only declarations: values and layouts match d3d12.h, nothing can be called.
+
+#include "Windows.h"
+
+enum D3D12_RESOURCE_STATES {
+	D3D12_RESOURCE_STATE_COMMON = 0,
+	D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	D3D12_RESOURCE_STATE_INDEX_BUFFER = 0x2,
+	D3D12_RESOURCE_STATE_RENDER_TARGET = 0x4,
+	D3D12_RESOURCE_STATE_UNORDERED_ACCESS = 0x8,
+	D3D12_RESOURCE_STATE_DEPTH_WRITE = 0x10,
+	D3D12_RESOURCE_STATE_DEPTH_READ = 0x20,
+	D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	D3D12_RESOURCE_STATE_STREAM_OUT = 0x100,
+	D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT = 0x200,
+	D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+	D3D12_RESOURCE_STATE_COPY_SOURCE = 0x800,
+	D3D12_RESOURCE_STATE_RESOLVE_DEST = 0x1000,
+	D3D12_RESOURCE_STATE_RESOLVE_SOURCE = 0x2000,
+	D3D12_RESOURCE_STATE_GENERIC_READ = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800,
+	D3D12_RESOURCE_STATE_PRESENT = 0
+};
+
+inline D3D12_RESOURCE_STATES operator|(D3D12_RESOURCE_STATES lhs, D3D12_RESOURCE_STATES rhs) {
+	return static_cast<D3D12_RESOURCE_STATES>(static_cast<int>(lhs) | static_cast<int>(rhs));
+}
+
+inline D3D12_RESOURCE_STATES& operator|=(D3D12_RESOURCE_STATES& lhs, D3D12_RESOURCE_STATES rhs) {
+	return lhs = lhs | rhs;
+}
+
+enum DXGI_FORMAT {
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_D32_FLOAT = 40,
+	DXGI_FORMAT_R32_UINT = 42
+};
+
+struct DXGI_SAMPLE_DESC {
+	UINT Count;
+	UINT Quality;
+};
+
+enum D3D12_RESOURCE_DIMENSION {
+	D3D12_RESOURCE_DIMENSION_UNKNOWN = 0,
+	D3D12_RESOURCE_DIMENSION_BUFFER = 1,
+	D3D12_RESOURCE_DIMENSION_TEXTURE1D = 2,
+	D3D12_RESOURCE_DIMENSION_TEXTURE2D = 3,
+	D3D12_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+
+enum D3D12_TEXTURE_LAYOUT {
+	D3D12_TEXTURE_LAYOUT_UNKNOWN = 0,
+	D3D12_TEXTURE_LAYOUT_ROW_MAJOR = 1
+};
+
+enum D3D12_RESOURCE_FLAGS {
+	D3D12_RESOURCE_FLAG_NONE = 0,
+	D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET = 0x1,
+	D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL = 0x2,
+	D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS = 0x4
+};
+
+struct D3D12_RESOURCE_DESC {
+	D3D12_RESOURCE_DIMENSION Dimension;
+	UINT64 Alignment;
+	UINT64 Width;
+	UINT Height;
+	UINT16 DepthOrArraySize;
+	UINT16 MipLevels;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D12_TEXTURE_LAYOUT Layout;
+	D3D12_RESOURCE_FLAGS Flags;
+};
+
+struct D3D12_DEPTH_STENCIL_VALUE {
+	FLOAT Depth;
+	UINT8 Stencil;
+};
+
+struct D3D12_CLEAR_VALUE {
+	DXGI_FORMAT Format;
+	union {
+		FLOAT Color[4];
+		D3D12_DEPTH_STENCIL_VALUE DepthStencil;
+	};
+};
+
+struct D3D12_RESOURCE_ALLOCATION_INFO {
+	UINT64 SizeInBytes;
+	UINT64 Alignment;
+};
+
+#define D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT 65536
+
+struct ID3D12Device;
+struct ID3D12GraphicsCommandList2;
+
+using D3D12_GPU_VIRTUAL_ADDRESS = UINT64;
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE {
+	UINT64 ptr;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW {
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	DXGI_FORMAT Format;
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW {
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	UINT StrideInBytes;
+};
+
+struct D3D12_DRAW_INDEXED_ARGUMENTS {
+	UINT IndexCountPerInstance;
+	UINT InstanceCount;
+	UINT StartIndexLocation;
+	INT BaseVertexLocation;
+	UINT StartInstanceLocation;
+};
+
+enum D3D12_INDIRECT_ARGUMENT_TYPE {
+	D3D12_INDIRECT_ARGUMENT_TYPE_DRAW = 0,
+	D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED = 1,
+	D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH = 2,
+	D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW = 3,
+	D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW = 4,
+	D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT = 5,
+	D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW = 6
+};
+
+struct D3D12_INDIRECT_ARGUMENT_DESC {
+	D3D12_INDIRECT_ARGUMENT_TYPE Type;
+	union {
+		struct {
+			UINT Slot;
+		} VertexBuffer;
+		struct {
+			UINT RootParameterIndex;
+			UINT DestOffsetIn32BitValues;
+			UINT Num32BitValuesToSet;
+		} Constant;
+		struct {
+			UINT RootParameterIndex;
+		} ConstantBufferView;
+	};
+};
+
+struct D3D12_COMMAND_SIGNATURE_DESC {
+	UINT ByteStride;
+	UINT NumArgumentDescs;
+	const D3D12_INDIRECT_ARGUMENT_DESC* pArgumentDescs;
+	UINT NodeMask;
+};
+
+struct ID3D12DescriptorHeap;
@@ -0,0 +1,3 @@
+#pragma once
+
+// Nothing the tested code uses, see d3d12.h next to it
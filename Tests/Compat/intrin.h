@@ -0,0 +1,13 @@
+#pragma once
+
+// Stand-in for the CPU feature queries of the MSVC intrinsics header.
+// GCC and Clang already have __cpuidex in cpuid.h and _xgetbv in immintrin.h (with -mxsave).
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+// cpuid.h defines __cpuid as a macro with four outputs
+#undef __cpuid
+inline void __cpuid(int cpuInfo[4], int function) {
+	__cpuidex(cpuInfo, function, 0);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Stand-in for Microsoft::WRL::ComPtr, only holds the pointer: nothing in the tests owns COM objects
+
+namespace Microsoft::WRL {
+	template <typename T>
+	class ComPtr {
+		T* m_pointer{};
+
+	public:
+		ComPtr() = default;
+		ComPtr(T* pointer) : m_pointer(pointer) {}
+
+		T* Get() const {
+			return m_pointer;
+		}
+		T* operator->() const {
+			return m_pointer;
+		}
+		explicit operator bool() const {
+			return m_pointer != nullptr;
+		}
+	};
+}
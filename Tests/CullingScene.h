@@ -0,0 +1,162 @@
+#pragma once
+
+// Random scenes and scalar references shared by the culling tests and benchmarks
+
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace CullingScene {
+	constexpr float sceneExtent{ 500.f };
+
+	// camera at the origin looking along +z, like the scenes Saber loads.
+	// With reversed depth near and far are swapped like Saber's camera does, depth is 1 at the near plane.
+	inline DirectX::XMMATRIX MakeViewProjection(float fovDegrees = 60.f, float farZ = 1000.f, bool isReversedDepth = false) {
+		constexpr float nearZ{ 0.1f };
+		DirectX::XMMATRIX view{ DirectX::XMMatrixLookAtLH(
+			DirectX::XMVectorSet(0.f, 0.f, 0.f, 1.f),
+			DirectX::XMVectorSet(0.f, 0.f, 1.f, 1.f),
+			DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f)
+		) };
+		DirectX::XMMATRIX projection{ DirectX::XMMatrixPerspectiveFovLH(
+			DirectX::XMConvertToRadians(fovDegrees),
+			16.f / 9.f,
+			isReversedDepth ? farZ : nearZ,
+			isReversedDepth ? nearZ : farZ
+		) };
+		return DirectX::XMMatrixMultiply(view, projection);
+	}
+
+	// spheres spread over a cube around the camera
+	inline std::vector<DirectX::BoundingSphere> MakeSpheres(size_t count, uint32_t seed, float minRadius = 0.5f, float maxRadius = 4.f) {
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> position{ -sceneExtent, sceneExtent };
+		std::uniform_real_distribution<float> radius{ minRadius, maxRadius };
+
+		std::vector<DirectX::BoundingSphere> spheres(count);
+		for (DirectX::BoundingSphere& sphere : spheres) {
+			sphere.Center = DirectX::XMFLOAT3{ position(random), position(random), position(random) };
+			sphere.Radius = radius(random);
+		}
+		return spheres;
+	}
+
+	// boxes spread over the same cube, extents are picked per axis
+	inline std::vector<DirectX::BoundingBox> MakeBoxes(size_t count, uint32_t seed, float minExtent = 0.5f, float maxExtent = 4.f) {
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> position{ -sceneExtent, sceneExtent };
+		std::uniform_real_distribution<float> extent{ minExtent, maxExtent };
+
+		std::vector<DirectX::BoundingBox> boxes(count);
+		for (DirectX::BoundingBox& box : boxes) {
+			box.Center = DirectX::XMFLOAT3{ position(random), position(random), position(random) };
+			box.Extents = DirectX::XMFLOAT3{ extent(random), extent(random), extent(random) };
+		}
+		return boxes;
+	}
+
+	enum class Visibility {
+		Outside,
+		Inside,
+		// within tolerance of a plane, float rounding may decide either way
+		Borderline
+	};
+
+	// the plane test of FrustumCulling::Cull in double precision
+	inline Visibility Classify(const FrustumCulling::Frustum& frustum, const DirectX::BoundingSphere& sphere, double tolerance = 1e-3) {
+		Visibility visibility{ Visibility::Inside };
+		for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+			double distance{
+				static_cast<double>(plane.x) * sphere.Center.x
+				+ static_cast<double>(plane.y) * sphere.Center.y
+				+ static_cast<double>(plane.z) * sphere.Center.z
+				+ plane.w
+				+ sphere.Radius
+			};
+			if (distance < -tolerance) {
+				return Visibility::Outside;
+			}
+			if (distance <= tolerance) {
+				visibility = Visibility::Borderline;
+			}
+		}
+		return visibility;
+	}
+
+	// The box corner farthest along each plane normal decides, like the DynamicBvh frustum query
+	inline Visibility Classify(const FrustumCulling::Frustum& frustum, const DirectX::BoundingBox& box, double tolerance = 1e-3) {
+		Visibility visibility{ Visibility::Inside };
+		for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+			double distance{ plane.w };
+			const float* pPlane{ &plane.x };
+			for (size_t i{}; i < 3; ++i) {
+				double extent{ (&box.Extents.x)[i] };
+				distance += pPlane[i] * ((&box.Center.x)[i] + (pPlane[i] >= 0.f ? extent : -extent));
+			}
+			if (distance < -tolerance) {
+				return Visibility::Outside;
+			}
+			if (distance <= tolerance) {
+				visibility = Visibility::Borderline;
+			}
+		}
+		return visibility;
+	}
+
+	// positive inside
+	inline Visibility ClassifyDistance(double distance, double tolerance) {
+		return distance < -tolerance ? Visibility::Outside : distance <= tolerance ? Visibility::Borderline : Visibility::Inside;
+	}
+
+	inline Visibility Classify(const DirectX::BoundingSphere& sphere, const DirectX::BoundingBox& box, double tolerance = 1e-3) {
+		double squaredDistance{};
+		for (size_t i{}; i < 3; ++i) {
+			double offset{ std::abs(static_cast<double>((&sphere.Center.x)[i]) - (&box.Center.x)[i]) - (&box.Extents.x)[i] };
+			squaredDistance += offset > 0. ? offset * offset : 0.;
+		}
+		return ClassifyDistance(sphere.Radius - std::sqrt(squaredDistance), tolerance);
+	}
+
+	// the segment from origin along the normalized direction, no direction component may be 0
+	inline Visibility Classify(
+		const DirectX::XMFLOAT3& origin,
+		const DirectX::XMFLOAT3& direction,
+		float maxDistance,
+		const DirectX::BoundingBox& box,
+		double tolerance = 1e-3
+	) {
+		double tMin{}, tMax{ maxDistance };
+		for (size_t i{}; i < 3; ++i) {
+			double center{ (&box.Center.x)[i] }, extent{ (&box.Extents.x)[i] };
+			double t0{ (center - extent - (&origin.x)[i]) / (&direction.x)[i] };
+			double t1{ (center + extent - (&origin.x)[i]) / (&direction.x)[i] };
+			tMin = std::max(tMin, std::min(t0, t1));
+			tMax = std::min(tMax, std::max(t0, t1));
+		}
+		return ClassifyDistance(tMax - tMin, tolerance);
+	}
+
+	// one sphere at a time, what the SIMD paths are measured against
+	inline size_t CullScalar(const FrustumCulling::Frustum& frustum, const FrustumCulling::BoundingSpheres& spheres, uint32_t* pVisibleIds) {
+		size_t count{};
+		for (size_t i{}; i < spheres.GetSize(); ++i) {
+			bool isInside{ true };
+			for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+				float distance{
+					spheres.GetCentersX()[i] * plane.x
+					+ spheres.GetCentersY()[i] * plane.y
+					+ spheres.GetCentersZ()[i] * plane.z
+					+ plane.w
+				};
+				isInside &= distance >= -spheres.GetRadii()[i];
+			}
+			if (isInside) {
+				pVisibleIds[count++] = static_cast<uint32_t>(i);
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,108 @@
+#include "Check.h"
+
+#include "DrawSorting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace {
+	// std::stable_sort of the same keys and values, what RadixSort has to match exactly
+	void CheckSort(const std::vector<DrawSorting::DrawKey>& keys, JobSystem<>* pJobSystem) {
+		std::vector<uint32_t> values(keys.size());
+		std::iota(values.begin(), values.end(), 0u);
+
+		std::vector<uint32_t> expectedValues{ values };
+		std::stable_sort(expectedValues.begin(), expectedValues.end(), [&keys](uint32_t lhs, uint32_t rhs) {
+			return keys[lhs] < keys[rhs];
+		});
+		std::vector<DrawSorting::DrawKey> expectedKeys(keys.size());
+		for (size_t i{}; i < keys.size(); ++i) {
+			expectedKeys[i] = keys[expectedValues[i]];
+		}
+
+		std::vector<DrawSorting::DrawKey> sortedKeys{ keys };
+		DrawSorting::RadixSort(sortedKeys, values, pJobSystem);
+		CHECK(sortedKeys == expectedKeys);
+		CHECK(values == expectedValues);
+	}
+
+	std::vector<DrawSorting::DrawKey> MakeKeys(size_t count, uint32_t seed, uint32_t pipelinesCount, uint32_t materialsCount) {
+		std::mt19937 random{ seed };
+		std::uniform_int_distribution<uint32_t> pipelineId{ 0, pipelinesCount - 1 };
+		std::uniform_int_distribution<uint32_t> materialId{ 0, materialsCount - 1 };
+		std::uniform_real_distribution<float> viewDepth{ -10.f, 1000.f };
+
+		std::vector<DrawSorting::DrawKey> keys(count);
+		for (DrawSorting::DrawKey& key : keys) {
+			key = DrawSorting::MakeDrawKey(1, pipelineId(random), materialId(random), viewDepth(random));
+		}
+		return keys;
+	}
+
+	void TestMakeDrawKey() {
+		using namespace DrawSorting;
+
+		CHECK(MakeDrawKey(0, 0, 0, 0.f) == 0);
+		CHECK(MakeDrawKey(1, 0, 0, 0.f) == DrawKey{ 1 } << 60);
+		CHECK(MakeDrawKey(0, 1, 0, 0.f) == DrawKey{ 1 } << 44);
+		CHECK(MakeDrawKey(0, 0, 1, 0.f) == DrawKey{ 1 } << 24);
+		// ids are truncated to their fields and don't spill into the next one
+		CHECK(MakeDrawKey(0x13, 0, 0, 0.f) == DrawKey{ 3 } << 60);
+		CHECK(MakeDrawKey(0, 0x1ffff, 0, 0.f) == DrawKey{ 0xffff } << 44);
+		CHECK(MakeDrawKey(0, 0, 0x1fffff, 0.f) == DrawKey{ 0xfffff } << 24);
+		// behind the camera
+		CHECK(MakeDrawKey(0, 0, 0, -5.f) == 0);
+
+		// fields take precedence from the pass down to the depth
+		CHECK(MakeDrawKey(0, 0xffff, 0xfffff, 1e30f) < MakeDrawKey(1, 0, 0, 0.f));
+		CHECK(MakeDrawKey(0, 0, 0xfffff, 1e30f) < MakeDrawKey(0, 1, 0, 0.f));
+		CHECK(MakeDrawKey(0, 0, 0, 1e30f) < MakeDrawKey(0, 0, 1, 0.f));
+
+		// front to back, depths closer than the truncated mantissa can tell apart share a key
+		DrawKey previousKey{};
+		for (float depth{ 0.01f }; depth < 10000.f; depth *= 1.01f) {
+			DrawKey key{ MakeDrawKey(2, 3, 4, depth) };
+			CHECK(key > previousKey);
+			previousKey = key;
+		}
+		CHECK(MakeDrawKey(0, 0, 0, 100.f) == MakeDrawKey(0, 0, 0, std::nextafter(100.f, 200.f)));
+	}
+
+	void TestRadixSort(JobSystem<>& jobSystem) {
+		for (JobSystem<>* pJobSystem : { static_cast<JobSystem<>*>(nullptr), &jobSystem }) {
+			CheckSort({}, pJobSystem);
+			CheckSort({ 5 }, pJobSystem);
+			CheckSort({ 5, 3 }, pJobSystem);
+			CheckSort(MakeKeys(1000, 1, 4, 16), pJobSystem);
+			// several chunks with a partial one, few distinct states so there are many equal keys
+			CheckSort(MakeKeys(300'001, 2, 3, 5), pJobSystem);
+
+			// every byte of the keys varies
+			std::mt19937_64 random{ 3 };
+			std::vector<DrawSorting::DrawKey> keys(200'000);
+			for (DrawSorting::DrawKey& key : keys) {
+				key = random();
+			}
+			CheckSort(keys, pJobSystem);
+
+			// only the low byte varies, the other passes are skipped
+			for (DrawSorting::DrawKey& key : keys) {
+				key = 0xabcdef0000000000ull | (key & 0xff);
+			}
+			CheckSort(keys, pJobSystem);
+
+			// all keys equal, the values keep their order
+			CheckSort(std::vector<DrawSorting::DrawKey>(100'000, 42), pJobSystem);
+		}
+	}
+}
+
+int main() {
+	JobSystem<> jobSystem{};
+	jobSystem.StartRunning();
+	TestMakeDrawKey();
+	TestRadixSort(jobSystem);
+	return Check::Finish("DrawSortingTests");
+}
@@ -0,0 +1,119 @@
+#include "Benchmark.h"
+#include "CullingScene.h"
+
+#include "DynamicBvh.h"
+
+namespace {
+	// every box against the frustum, what the tree queries are measured against
+	size_t QueryBruteForce(const FrustumCulling::Frustum& frustum, const std::vector<DirectX::BoundingBox>& boxes, std::vector<uint32_t>& results) {
+		results.clear();
+		for (uint32_t id{}; id < boxes.size(); ++id) {
+			const DirectX::BoundingBox& box{ boxes[id] };
+			bool isInside{ true };
+			for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+				float x{ box.Center.x + (plane.x >= 0.f ? box.Extents.x : -box.Extents.x) };
+				float y{ box.Center.y + (plane.y >= 0.f ? box.Extents.y : -box.Extents.y) };
+				float z{ box.Center.z + (plane.z >= 0.f ? box.Extents.z : -box.Extents.z) };
+				isInside &= plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.f;
+			}
+			if (isInside) {
+				results.push_back(id);
+			}
+		}
+		return results.size();
+	}
+}
+
+// Queries of static and dynamic trees of 100k boxes: a frustum on one thread and over the job system,
+// small spheres like picking and light influence, and rays
+int main(int argc, char** argv) {
+	size_t boxesCount{ Benchmark::GetCount(argc, argv, 100'000) };
+	constexpr size_t runsCount{ 10 };
+	constexpr size_t queriesCount{ 1000 };
+
+	std::vector<DirectX::BoundingBox> boxes{ CullingScene::MakeBoxes(boxesCount, 1) };
+	FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection(60.f, 300.f)) };
+
+	std::mt19937 random{ 2 };
+	std::uniform_real_distribution<float> position{ -CullingScene::sceneExtent, CullingScene::sceneExtent };
+	std::normal_distribution<float> direction{};
+	std::vector<DirectX::BoundingSphere> spheres(queriesCount);
+	std::vector<DirectX::XMFLOAT3> rayOrigins(queriesCount);
+	std::vector<DirectX::XMFLOAT3> rayDirections(queriesCount);
+	for (size_t i{}; i < queriesCount; ++i) {
+		spheres[i] = DirectX::BoundingSphere{ { position(random), position(random), position(random) }, 20.f };
+		rayOrigins[i] = DirectX::XMFLOAT3{ position(random), position(random), position(random) };
+		DirectX::XMStoreFloat3(&rayDirections[i], DirectX::XMVector3Normalize(
+			DirectX::XMVectorSet(direction(random), direction(random), direction(random), 0.f)
+		));
+	}
+
+	JobSystem<> jobSystem{};
+	jobSystem.StartRunning();
+	std::vector<uint32_t> results{};
+	size_t resultsCount{};
+
+	std::printf("%zu boxes, %zu spheres and rays\n", boxesCount, queriesCount);
+
+	Benchmark::Result bruteForce{ Benchmark::Measure(runsCount, [&] {
+		resultsCount = QueryBruteForce(frustum, boxes, results);
+	}) };
+	Benchmark::Print("Frustum, brute force", bruteForce, static_cast<double>(boxesCount), "boxes");
+	std::printf("%zu boxes in the frustum\n", resultsCount);
+
+	for (bool isStatic : { true, false }) {
+		const char* pTreeName{ isStatic ? "static" : "dynamic" };
+		char name[64]{};
+		DynamicBvh<uint32_t> bvh{ isStatic };
+
+		// inserting all boxes, a static tree is rebuilt with SAH at the end
+		Benchmark::Result build{ Benchmark::Measure(3, [&] {
+			DynamicBvh<uint32_t> tree{ isStatic };
+			for (uint32_t id{}; id < boxes.size(); ++id) {
+				tree.Insert(boxes[id], id);
+			}
+			tree.Rebuild();
+		}) };
+		std::snprintf(name, sizeof(name), "Build %s", pTreeName);
+		Benchmark::Print(name, build, static_cast<double>(boxesCount), "boxes");
+		for (uint32_t id{}; id < boxes.size(); ++id) {
+			bvh.Insert(boxes[id], id);
+		}
+		bvh.Rebuild();
+
+		Benchmark::Result frustumQuery{ Benchmark::Measure(runsCount, [&] {
+			results.clear();
+			bvh.Query(frustum, results);
+		}) };
+		std::snprintf(name, sizeof(name), "Frustum, %s, 1 thread", pTreeName);
+		Benchmark::Print(name, frustumQuery, static_cast<double>(boxesCount), "boxes");
+
+		Benchmark::Result parallelFrustumQuery{ Benchmark::Measure(runsCount, [&] {
+			results.clear();
+			bvh.Query(frustum, results, &jobSystem);
+		}) };
+		std::snprintf(name, sizeof(name), "Frustum, %s, job system", pTreeName);
+		Benchmark::Print(name, parallelFrustumQuery, static_cast<double>(boxesCount), "boxes");
+
+		Benchmark::Result sphereQueries{ Benchmark::Measure(runsCount, [&] {
+			results.clear();
+			for (const DirectX::BoundingSphere& sphere : spheres) {
+				bvh.Query(sphere, results);
+			}
+		}) };
+		std::snprintf(name, sizeof(name), "Spheres, %s", pTreeName);
+		Benchmark::Print(name, sphereQueries, static_cast<double>(queriesCount), "queries");
+
+		Benchmark::Result rayQueries{ Benchmark::Measure(runsCount, [&] {
+			results.clear();
+			for (size_t i{}; i < queriesCount; ++i) {
+				bvh.Query(rayOrigins[i], rayDirections[i], 200.f, results);
+			}
+		}) };
+		std::snprintf(name, sizeof(name), "Rays, %s", pTreeName);
+		Benchmark::Print(name, rayQueries, static_cast<double>(queriesCount), "queries");
+
+		std::printf("%s frustum query %.1fx faster than brute force\n", pTreeName, bruteForce.bestMs / frustumQuery.bestMs);
+	}
+	return 0;
+}
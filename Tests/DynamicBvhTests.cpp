@@ -0,0 +1,217 @@
+#include "Check.h"
+#include "CullingScene.h"
+
+#include "DynamicBvh.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+	// Brute force model of a tree: the box of every live leaf, indexed by object id.
+	// Dynamic leaves keep their fattened box until the object moves out of it, like the tree does.
+	struct Model {
+		static constexpr float fatMargin{ 0.1f };
+
+		bool isStatic{};
+		std::vector<DirectX::BoundingBox> leafBoxes{};
+		std::vector<uint32_t> leafIds{};
+		std::vector<bool> isAlive{};
+		size_t keptLeavesCount{};
+
+		DirectX::BoundingBox GetLeafBox(const DirectX::BoundingBox& box) const {
+			if (isStatic) {
+				return box;
+			}
+			DirectX::BoundingBox fatBox{ box };
+			fatBox.Extents.x *= 1.f + fatMargin;
+			fatBox.Extents.y *= 1.f + fatMargin;
+			fatBox.Extents.z *= 1.f + fatMargin;
+			return fatBox;
+		}
+
+		bool Contains(const DirectX::BoundingBox& outer, const DirectX::BoundingBox& inner) const {
+			for (size_t i{}; i < 3; ++i) {
+				float outerCenter{ (&outer.Center.x)[i] }, outerExtent{ (&outer.Extents.x)[i] };
+				float innerCenter{ (&inner.Center.x)[i] }, innerExtent{ (&inner.Extents.x)[i] };
+				if (outerCenter - outerExtent > innerCenter - innerExtent || outerCenter + outerExtent < innerCenter + innerExtent) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void Insert(DynamicBvh<uint32_t>& bvh, const DirectX::BoundingBox& box) {
+			uint32_t objectId{ static_cast<uint32_t>(leafBoxes.size()) };
+			leafBoxes.push_back(GetLeafBox(box));
+			leafIds.push_back(bvh.Insert(box, objectId));
+			isAlive.push_back(true);
+		}
+
+		void Move(DynamicBvh<uint32_t>& bvh, uint32_t objectId, const DirectX::BoundingBox& box) {
+			bool isMoved{ isStatic || !Contains(leafBoxes[objectId], box) };
+			CHECK(bvh.Move(leafIds[objectId], box) == isMoved);
+			if (isMoved) {
+				leafBoxes[objectId] = GetLeafBox(box);
+			}
+			else {
+				++keptLeavesCount;
+			}
+		}
+
+		void Remove(DynamicBvh<uint32_t>& bvh, uint32_t objectId) {
+			bvh.Remove(leafIds[objectId]);
+			isAlive[objectId] = false;
+		}
+
+		size_t GetAliveCount() const {
+			return static_cast<size_t>(std::count(isAlive.begin(), isAlive.end(), true));
+		}
+	};
+
+	// Every leaf clearly overlapping is returned once, none clearly apart, the same with the job system
+	template <typename QueryFunc, typename ClassifyFunc>
+	void CheckQuery(const Model& model, JobSystem<>& jobSystem, const QueryFunc& query, const ClassifyFunc& classify) {
+		std::vector<uint32_t> results{};
+		query(results, nullptr);
+		std::sort(results.begin(), results.end());
+		CHECK(std::adjacent_find(results.begin(), results.end()) == results.end());
+
+		size_t mismatchesCount{};
+		for (uint32_t objectId{}; objectId < model.leafBoxes.size(); ++objectId) {
+			bool isReturned{ std::binary_search(results.begin(), results.end(), objectId) };
+			if (!model.isAlive[objectId]) {
+				mismatchesCount += isReturned;
+				continue;
+			}
+			CullingScene::Visibility visibility{ classify(model.leafBoxes[objectId]) };
+			mismatchesCount += visibility == CullingScene::Visibility::Inside && !isReturned;
+			mismatchesCount += visibility == CullingScene::Visibility::Outside && isReturned;
+		}
+		CHECK(mismatchesCount == 0);
+
+		std::vector<uint32_t> parallelResults{};
+		query(parallelResults, &jobSystem);
+		std::sort(parallelResults.begin(), parallelResults.end());
+		CHECK(parallelResults == results);
+	}
+
+	// a frustum, spheres and rays of different sizes and lengths
+	void CheckQueries(DynamicBvh<uint32_t>& bvh, const Model& model, JobSystem<>& jobSystem, uint32_t seed) {
+		CHECK(bvh.GetSize() == model.GetAliveCount());
+
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection(60.f, 400.f)) };
+		CheckQuery(
+			model, jobSystem,
+			[&](std::vector<uint32_t>& results, JobSystem<>* pJobSystem) { bvh.Query(frustum, results, pJobSystem); },
+			[&](const DirectX::BoundingBox& box) { return CullingScene::Classify(frustum, box); }
+		);
+
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> position{ -CullingScene::sceneExtent, CullingScene::sceneExtent };
+		std::uniform_real_distribution<float> radius{ 5.f, 80.f };
+		std::uniform_real_distribution<float> length{ 100.f, 2000.f };
+		std::normal_distribution<float> direction{};
+		for (size_t i{}; i < 10; ++i) {
+			DirectX::BoundingSphere sphere{ { position(random), position(random), position(random) }, radius(random) };
+			CheckQuery(
+				model, jobSystem,
+				[&](std::vector<uint32_t>& results, JobSystem<>* pJobSystem) { bvh.Query(sphere, results, pJobSystem); },
+				[&](const DirectX::BoundingBox& box) { return CullingScene::Classify(sphere, box); }
+			);
+
+			DirectX::XMFLOAT3 origin{ position(random), position(random), position(random) };
+			DirectX::XMFLOAT3 rayDirection{};
+			DirectX::XMStoreFloat3(&rayDirection, DirectX::XMVector3Normalize(
+				DirectX::XMVectorSet(direction(random), direction(random), direction(random), 0.f)
+			));
+			float maxDistance{ length(random) };
+			CheckQuery(
+				model, jobSystem,
+				[&](std::vector<uint32_t>& results, JobSystem<>* pJobSystem) {
+					bvh.Query(origin, rayDirection, maxDistance, results, pJobSystem);
+				},
+				[&](const DirectX::BoundingBox& box) { return CullingScene::Classify(origin, rayDirection, maxDistance, box); }
+			);
+		}
+	}
+
+	void TestTree(bool isStatic, JobSystem<>& jobSystem) {
+		DynamicBvh<uint32_t> bvh{ isStatic };
+		Model model{ .isStatic{ isStatic } };
+
+		std::vector<uint32_t> results{};
+		bvh.Query(DirectX::BoundingSphere{ { 0.f, 0.f, 0.f }, 1000.f }, results);
+		CHECK(results.empty());
+
+		for (const DirectX::BoundingBox& box : CullingScene::MakeBoxes(3000, 1, 0.5f, 8.f)) {
+			model.Insert(bvh, box);
+		}
+		CheckQueries(bvh, model, jobSystem, 2);
+
+		// small moves stay in dynamic leaves, large ones go anywhere
+		std::mt19937 random{ 3 };
+		std::uniform_real_distribution<float> offset{ -0.02f, 0.02f };
+		std::vector<DirectX::BoundingBox> newBoxes{ CullingScene::MakeBoxes(500, 4, 0.5f, 8.f) };
+		for (uint32_t objectId{}; objectId < 1000; ++objectId) {
+			DirectX::BoundingBox box{ model.leafBoxes[objectId] };
+			if (!isStatic) {
+				box.Extents.x /= 1.f + Model::fatMargin;
+				box.Extents.y /= 1.f + Model::fatMargin;
+				box.Extents.z /= 1.f + Model::fatMargin;
+			}
+			box.Center.x += offset(random) * box.Extents.x;
+			model.Move(bvh, objectId, box);
+		}
+		CHECK(isStatic ? model.keptLeavesCount == 0 : model.keptLeavesCount > 900);
+		for (uint32_t i{}; i < newBoxes.size(); ++i) {
+			model.Move(bvh, 1000 + 2 * i, newBoxes[i]);
+		}
+		CheckQueries(bvh, model, jobSystem, 5);
+
+		// removed leaves are reused by new ones
+		for (uint32_t objectId{ 1 }; objectId < 3000; objectId += 3) {
+			model.Remove(bvh, objectId);
+		}
+		for (const DirectX::BoundingBox& box : CullingScene::MakeBoxes(500, 6, 0.5f, 30.f)) {
+			model.Insert(bvh, box);
+		}
+		CHECK(*std::max_element(model.leafIds.begin(), model.leafIds.end()) < 2 * 3000);
+		CheckQueries(bvh, model, jobSystem, 7);
+
+		bvh.Rebuild();
+		CheckQueries(bvh, model, jobSystem, 8);
+
+		for (uint32_t objectId{}; objectId < model.leafBoxes.size(); ++objectId) {
+			if (model.isAlive[objectId]) {
+				model.Remove(bvh, objectId);
+			}
+		}
+		CHECK(bvh.GetSize() == 0);
+		bvh.Query(DirectX::BoundingSphere{ { 0.f, 0.f, 0.f }, 1000.f }, results);
+		CHECK(results.empty());
+	}
+
+	void TestUserData() {
+		DynamicBvh<uint32_t> bvh{ false };
+		uint32_t leafId{ bvh.Insert(DirectX::BoundingBox{ { 0.f, 0.f, 10.f }, { 1.f, 1.f, 1.f } }, 1) };
+		bvh.SetUserData(leafId, 42);
+
+		// a ray along an axis, its other inverse direction components are infinite
+		std::vector<uint32_t> results{};
+		bvh.Query(DirectX::XMFLOAT3{ 0.f, 0.f, 0.f }, DirectX::XMFLOAT3{ 0.f, 0.f, 1.f }, 100.f, results);
+		CHECK(results == std::vector<uint32_t>{ 42 });
+		// too short
+		results.clear();
+		bvh.Query(DirectX::XMFLOAT3{ 0.f, 0.f, 0.f }, DirectX::XMFLOAT3{ 0.f, 0.f, 1.f }, 8.f, results);
+		CHECK(results.empty());
+	}
+}
+
+int main() {
+	JobSystem<> jobSystem{};
+	jobSystem.StartRunning();
+	TestTree(true, jobSystem);
+	TestTree(false, jobSystem);
+	TestUserData();
+	return Check::Finish("DynamicBvhTests");
+}
@@ -0,0 +1,41 @@
+#include "Benchmark.h"
+#include "CullingScene.h"
+
+#include "FrustumCulling.h"
+
+// Frustum culling of 1M bounding spheres: one sphere at a time, SIMD on one thread,
+// and SIMD split into chunks over the job system like Scene::CullRenderSubsystems does it
+int main(int argc, char** argv) {
+	size_t spheresCount{ Benchmark::GetCount(argc, argv, 1'000'000) };
+	constexpr size_t runsCount{ 20 };
+
+	FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+	FrustumCulling::BoundingSpheres spheres{};
+	for (const DirectX::BoundingSphere& sphere : CullingScene::MakeSpheres(spheresCount, 1)) {
+		spheres.PushBack(sphere);
+	}
+	std::vector<uint32_t> visibleIds(spheres.GetSize());
+	size_t visibleCount{};
+
+	std::printf("%zu spheres\n", spheresCount);
+
+	Benchmark::Result scalar{ Benchmark::Measure(runsCount, [&] {
+		visibleCount = CullingScene::CullScalar(frustum, spheres, visibleIds.data());
+	}) };
+	Benchmark::Print("Scalar", scalar, static_cast<double>(spheresCount), "spheres");
+
+	Benchmark::Result simd{ Benchmark::Measure(runsCount, [&] {
+		visibleCount = FrustumCulling::Cull(frustum, spheres, 0, spheres.GetSize(), visibleIds.data());
+	}) };
+	Benchmark::Print("SIMD, 1 thread", simd, static_cast<double>(spheresCount), "spheres");
+
+	JobSystem<> jobSystem{};
+	jobSystem.StartRunning();
+	Benchmark::Result parallel{ Benchmark::Measure(runsCount, [&] {
+		FrustumCulling::CullParallel(frustum, spheres, jobSystem, visibleIds);
+	}) };
+	Benchmark::Print("SIMD, job system", parallel, static_cast<double>(spheresCount), "spheres");
+
+	std::printf("%zu visible, SIMD %.2fx faster than scalar\n", visibleCount, scalar.bestMs / simd.bestMs);
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include "Check.h"
+#include "CullingScene.h"
+
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	FrustumCulling::BoundingSpheres ToSoa(const std::vector<DirectX::BoundingSphere>& spheres) {
+		FrustumCulling::BoundingSpheres soa{};
+		for (const DirectX::BoundingSphere& sphere : spheres) {
+			soa.PushBack(sphere);
+		}
+		return soa;
+	}
+
+	bool IsInside(const FrustumCulling::Frustum& frustum, const DirectX::XMFLOAT3& point) {
+		return CullingScene::Classify(frustum, DirectX::BoundingSphere{ point, 0.f }) == CullingScene::Visibility::Inside;
+	}
+
+	void TestFrustumPlanes() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+
+		for (const DirectX::XMFLOAT4& plane : frustum.planes) {
+			float length{ std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z) };
+			CHECK(std::abs(length - 1.f) < 1e-5f);
+		}
+
+		CHECK(IsInside(frustum, { 0.f, 0.f, 10.f }));
+		CHECK(IsInside(frustum, { 0.f, 0.f, 999.f }));
+		// behind the camera, before the near plane, after the far plane
+		CHECK(!IsInside(frustum, { 0.f, 0.f, -10.f }));
+		CHECK(!IsInside(frustum, { 0.f, 0.f, 0.05f }));
+		CHECK(!IsInside(frustum, { 0.f, 0.f, 1001.f }));
+		// 60 degrees vertically, 16:9, so about 45.8 degrees to the side at most
+		CHECK(IsInside(frustum, { 10.f, 0.f, 10.f }));
+		CHECK(!IsInside(frustum, { -11.f, 0.f, 10.f }));
+		CHECK(IsInside(frustum, { 0.f, 5.f, 10.f }));
+		CHECK(!IsInside(frustum, { 0.f, -6.f, 10.f }));
+	}
+
+	void TestCullMatchesReference() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		// not a multiple of the lane count, and big spheres that cross planes
+		std::vector<DirectX::BoundingSphere> spheres{ CullingScene::MakeSpheres(10007, 1, 0.1f, 50.f) };
+		spheres.push_back(DirectX::BoundingSphere{ { 0.f, 0.f, -5.f }, 100.f });
+		FrustumCulling::BoundingSpheres soa{ ToSoa(spheres) };
+
+		std::vector<uint32_t> visibleIds(soa.GetSize());
+		visibleIds.resize(FrustumCulling::Cull(frustum, soa, 0, soa.GetSize(), visibleIds.data()));
+		CHECK(std::is_sorted(visibleIds.begin(), visibleIds.end()));
+		CHECK(std::adjacent_find(visibleIds.begin(), visibleIds.end()) == visibleIds.end());
+
+		size_t insideCount{};
+		size_t mismatchesCount{};
+		for (uint32_t id{}; id < spheres.size(); ++id) {
+			CullingScene::Visibility visibility{ CullingScene::Classify(frustum, spheres[id]) };
+			bool isVisible{ std::binary_search(visibleIds.begin(), visibleIds.end(), id) };
+			if (visibility == CullingScene::Visibility::Inside) {
+				++insideCount;
+				mismatchesCount += !isVisible;
+			}
+			else if (visibility == CullingScene::Visibility::Outside) {
+				mismatchesCount += isVisible;
+			}
+		}
+		CHECK(mismatchesCount == 0);
+		// the scene isn't trivially all in or all out
+		CHECK(insideCount > 100 && insideCount < spheres.size() / 2);
+		// the sphere around the camera
+		CHECK(!visibleIds.empty() && visibleIds.back() == spheres.size() - 1);
+
+		// the scalar reference the benchmark compares with agrees on everything but rounding
+		std::vector<uint32_t> scalarIds(soa.GetSize());
+		scalarIds.resize(CullingScene::CullScalar(frustum, soa, scalarIds.data()));
+		std::vector<uint32_t> difference{};
+		std::set_symmetric_difference(
+			visibleIds.begin(), visibleIds.end(),
+			scalarIds.begin(), scalarIds.end(),
+			std::back_inserter(difference)
+		);
+		for (uint32_t id : difference) {
+			CHECK(CullingScene::Classify(frustum, spheres[id]) == CullingScene::Visibility::Borderline);
+		}
+	}
+
+	void TestCullRange() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		// visible spheres only
+		std::vector<DirectX::BoundingSphere> spheres(1003, DirectX::BoundingSphere{ { 0.f, 0.f, 100.f }, 1.f });
+		FrustumCulling::BoundingSpheres soa{ ToSoa(spheres) };
+		std::vector<uint32_t> visibleIds(soa.GetSize());
+
+		size_t count{ FrustumCulling::Cull(frustum, soa, 64, 1000, visibleIds.data()) };
+		CHECK(count == 1000 - 64);
+		CHECK(visibleIds[0] == 64 && visibleIds[count - 1] == 999);
+
+		// end is clamped to the size, the padding is never visible
+		count = FrustumCulling::Cull(frustum, soa, 992, 2000, visibleIds.data());
+		CHECK(count == 1003 - 992);
+		CHECK(FrustumCulling::Cull(frustum, soa, 1008, 2000, visibleIds.data()) == 0);
+
+		// the last sphere takes the place of the removed one
+		soa.SetAt(1002, DirectX::BoundingSphere{ { 0.f, 0.f, -100.f }, 1.f });
+		soa.SwapRemove(5);
+		CHECK(soa.GetSize() == 1002);
+		CHECK(soa.GetCentersZ()[5] == -100.f);
+		count = FrustumCulling::Cull(frustum, soa, 0, soa.GetSize(), visibleIds.data());
+		CHECK(count == 1001);
+		CHECK(visibleIds[5] == 6);
+
+		soa.Clear();
+		CHECK(soa.GetSize() == 0);
+		CHECK(FrustumCulling::Cull(frustum, soa, 0, 1000, visibleIds.data()) == 0);
+	}
+
+	void TestCullParallel() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		// several chunks and a partial one
+		FrustumCulling::BoundingSpheres soa{ ToSoa(CullingScene::MakeSpheres(100003, 2)) };
+
+		std::vector<uint32_t> expectedIds(soa.GetSize());
+		expectedIds.resize(FrustumCulling::Cull(frustum, soa, 0, soa.GetSize(), expectedIds.data()));
+
+		JobSystem<> jobSystem{};
+		jobSystem.StartRunning();
+		std::vector<uint32_t> visibleIds{};
+		for (size_t i{}; i < 4; ++i) {
+			FrustumCulling::CullParallel(frustum, soa, jobSystem, visibleIds);
+			CHECK(visibleIds == expectedIds);
+		}
+
+		// a single chunk is culled on the calling thread
+		FrustumCulling::BoundingSpheres small{ ToSoa(CullingScene::MakeSpheres(100, 3)) };
+		std::vector<uint32_t> smallExpectedIds(small.GetSize());
+		smallExpectedIds.resize(FrustumCulling::Cull(frustum, small, 0, small.GetSize(), smallExpectedIds.data()));
+		FrustumCulling::CullParallel(frustum, small, jobSystem, visibleIds);
+		CHECK(visibleIds == smallExpectedIds);
+	}
+}
+
+int main() {
+	TestFrustumPlanes();
+	TestCullMatchesReference();
+	TestCullRange();
+	TestCullParallel();
+	return Check::Finish("FrustumCullingTests");
+}
@@ -0,0 +1,144 @@
+#include "Check.h"
+
+#include "GBufferEncoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+	constexpr double pi{ 3.14159265358979323846 };
+
+	// angle of the rotation from one quaternion to the other, q and -q are the same rotation
+	double GetAngleDegrees(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b) {
+		double dot{ std::abs(
+			static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y + static_cast<double>(a.z) * b.z + static_cast<double>(a.w) * b.w
+		) };
+		return 2. * std::acos(std::min(dot, 1.)) * 180. / pi;
+	}
+
+	// distance on the unit circle, the uv wraps
+	double GetWrappedError(double decoded, double expected) {
+		double error{ decoded - (expected - std::floor(expected)) };
+		return std::abs(error - std::round(error));
+	}
+
+	// the z axis of the tangent frame the quaternion rotates, the normal the shading rebuilds
+	DirectX::XMFLOAT3 GetNormal(const DirectX::XMFLOAT4& q) {
+		return DirectX::XMFLOAT3{
+			2.f * (q.x * q.z + q.w * q.y),
+			2.f * (q.y * q.z - q.w * q.x),
+			1.f - 2.f * (q.x * q.x + q.y * q.y)
+		};
+	}
+
+	bool IsInRange(const DirectX::XMUINT4& encoded) {
+		return encoded.x <= GBUFFER_QUATERNION_MAX && encoded.y <= GBUFFER_QUATERNION_MAX
+			&& encoded.z <= GBUFFER_QUATERNION_MAX && encoded.w <= 3;
+	}
+
+	void CheckQuaternion(const DirectX::XMFLOAT4& quaternion, double maxAngleDegrees) {
+		DirectX::XMUINT4 encoded{ GBufferEncoding::EncodeQuaternion(quaternion) };
+		CHECK(IsInRange(encoded));
+		DirectX::XMFLOAT4 decoded{ GBufferEncoding::DecodeQuaternion(encoded) };
+		CHECK(GetAngleDegrees(quaternion, decoded) <= maxAngleDegrees);
+	}
+
+	void TestUv() {
+		using namespace GBufferEncoding;
+
+		CHECK(DecodeUv(EncodeUvMaterialId({ 0.f, 0.f }, 0)).x == 0.f);
+		// within half a step under 1 rounds up to the last step, not around to 0
+		DirectX::XMFLOAT2 almostOne{ DecodeUv(EncodeUvMaterialId({ 0.999999f, 0.5f }, 0)) };
+		CHECK(almostOne.x == 1.f && std::abs(almostOne.y - 0.5f) <= 0.5f / GBUFFER_UV_MAX);
+		// tiled and negative uvs keep the fraction
+		DirectX::XMFLOAT2 wrapped{ DecodeUv(EncodeUvMaterialId({ 3.25f, -0.25f }, 0)) };
+		CHECK(std::abs(wrapped.x - 0.25f) <= 0.5f / GBUFFER_UV_MAX);
+		CHECK(std::abs(wrapped.y - 0.75f) <= 0.5f / GBUFFER_UV_MAX);
+
+		// the error is half a step, plus what the float fraction loses at large uvs
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> uv{ -4.f, 4.f };
+		double maxError{};
+		for (size_t i{}; i < 1'000'000; ++i) {
+			DirectX::XMFLOAT2 value{ uv(random), uv(random) };
+			DirectX::XMUINT4 encoded{ EncodeUvMaterialId(value, 0) };
+			CHECK(encoded.x <= GBUFFER_UV_MAX && encoded.y <= GBUFFER_UV_MAX && encoded.w == 0);
+			DirectX::XMFLOAT2 decoded{ DecodeUv(encoded) };
+			maxError = std::max({ maxError, GetWrappedError(decoded.x, value.x), GetWrappedError(decoded.y, value.y) });
+		}
+		CHECK(maxError <= 0.5 / GBUFFER_UV_MAX + 1e-6);
+		CHECK(maxError >= 0.4 / GBUFFER_UV_MAX);
+	}
+
+	void TestMaterialId() {
+		using namespace GBufferEncoding;
+
+		for (uint32_t materialId : { 0u, 1u, 4242u, uint32_t{ GBUFFER_MATERIAL_ID_MAX } }) {
+			CHECK(DecodeMaterialId(EncodeUvMaterialId({ 0.3f, 0.7f }, materialId)) == materialId);
+		}
+		// ids that don't fit are clamped, not wrapped onto another material
+		CHECK(DecodeMaterialId(EncodeUvMaterialId({}, GBUFFER_MATERIAL_ID_MAX + 1)) == GBUFFER_MATERIAL_ID_MAX);
+		CHECK(DecodeMaterialId(EncodeUvMaterialId({}, UINT32_MAX)) == GBUFFER_MATERIAL_ID_MAX);
+		// the material id doesn't change the uv
+		CHECK(EncodeUvMaterialId({ 0.3f, 0.7f }, 7).x == EncodeUvMaterialId({ 0.3f, 0.7f }, 9).x);
+	}
+
+	void TestQuaternion() {
+		// each of the smallest three is off by at most half a step, the dropped one follows from the length
+		constexpr double maxAngleDegrees{ 0.25 };
+		const float halfSqrt2{ std::sqrt(0.5f) };
+
+		// identity, every axis as the largest component and both signs
+		for (uint32_t axis{}; axis < 4; ++axis) {
+			for (float sign : { 1.f, -1.f }) {
+				float q[4]{};
+				q[axis] = sign;
+				DirectX::XMFLOAT4 quaternion{ q[0], q[1], q[2], q[3] };
+				DirectX::XMUINT4 encoded{ GBufferEncoding::EncodeQuaternion(quaternion) };
+				CHECK(encoded.w == axis);
+				CHECK(GetAngleDegrees(quaternion, GBufferEncoding::DecodeQuaternion(encoded)) <= maxAngleDegrees);
+			}
+		}
+		// the smallest three at the ends of their range
+		CheckQuaternion({ halfSqrt2, halfSqrt2, 0.f, 0.f }, maxAngleDegrees);
+		CheckQuaternion({ -halfSqrt2, 0.f, 0.f, halfSqrt2 }, maxAngleDegrees);
+		CheckQuaternion({ 0.5f, -0.5f, 0.5f, -0.5f }, maxAngleDegrees);
+
+		std::mt19937 random{ 2 };
+		std::normal_distribution<float> component{};
+		double maxAngle{};
+		double maxNormalAngle{};
+		for (size_t i{}; i < 1'000'000; ++i) {
+			float q[4]{ component(random), component(random), component(random), component(random) };
+			float length{ std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) };
+			DirectX::XMFLOAT4 quaternion{ q[0] / length, q[1] / length, q[2] / length, q[3] / length };
+			DirectX::XMUINT4 encoded{ GBufferEncoding::EncodeQuaternion(quaternion) };
+			CHECK(IsInRange(encoded));
+			DirectX::XMFLOAT4 decoded{ GBufferEncoding::DecodeQuaternion(encoded) };
+			maxAngle = std::max(maxAngle, GetAngleDegrees(quaternion, decoded));
+
+			// the normal the shading rebuilds is never off by more than the rotation
+			DirectX::XMFLOAT3 normal{ GetNormal(quaternion) };
+			DirectX::XMFLOAT3 decodedNormal{ GetNormal(decoded) };
+			double cosine{
+				(static_cast<double>(normal.x) * decodedNormal.x + static_cast<double>(normal.y) * decodedNormal.y
+					+ static_cast<double>(normal.z) * decodedNormal.z)
+				/ std::sqrt(static_cast<double>(decodedNormal.x) * decodedNormal.x
+					+ static_cast<double>(decodedNormal.y) * decodedNormal.y + static_cast<double>(decodedNormal.z) * decodedNormal.z)
+			};
+			maxNormalAngle = std::max(maxNormalAngle, std::acos(std::clamp(cosine, -1., 1.)) * 180. / pi);
+		}
+		CHECK(maxAngle <= maxAngleDegrees);
+		CHECK(maxNormalAngle <= maxAngle + 0.01);
+		// the bound is close to what 10 bits allow, not loose enough to hide a broken encoding
+		CHECK(maxAngle >= 0.05);
+	}
+}
+
+int main() {
+	TestUv();
+	TestMaterialId();
+	TestQuaternion();
+	return Check::Finish("GBufferEncodingTests");
+}
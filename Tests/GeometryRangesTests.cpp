@@ -0,0 +1,106 @@
+#include "Check.h"
+
+#include "GeometryRanges.h"
+
+#include <stdexcept>
+
+namespace {
+	template <typename Func>
+	bool Throws(Func func) {
+		try {
+			func();
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	}
+
+	void TestAllocate() {
+		GeometryRanges ranges{ 1000, 3000 };
+		CHECK(ranges.GetVertexCapacity() == 1000 && ranges.GetIndexCapacity() == 3000);
+		CHECK(ranges.GetVertexCount() == 0 && ranges.GetIndexCount() == 0);
+
+		GeometryRanges::Range first{ ranges.Allocate(100, 300) };
+		GeometryRanges::Range second{ ranges.Allocate(900, 600) };
+		CHECK(first.vertexCount == 100 && first.indexCount == 300);
+		CHECK(ranges.GetVertexCount() == 1000 && ranges.GetIndexCount() == 900);
+
+		// ranges don't overlap
+		CHECK(first.firstVertex + first.vertexCount <= second.firstVertex || second.firstVertex + second.vertexCount <= first.firstVertex);
+		CHECK(first.firstIndex + first.indexCount <= second.firstIndex || second.firstIndex + second.indexCount <= first.firstIndex);
+		CHECK(second.firstVertex + second.vertexCount <= 1000);
+		CHECK(second.firstIndex + second.indexCount <= 3000);
+
+		// the vertex block is full
+		CHECK(Throws([&] { ranges.Allocate(1, 1); }));
+		CHECK(ranges.GetVertexCount() == 1000 && ranges.GetIndexCount() == 900);
+	}
+
+	void TestFailedIndexAllocation() {
+		GeometryRanges ranges{ 100, 300 };
+		GeometryRanges::Range range{ ranges.Allocate(10, 300) };
+
+		// the vertices were allocated first and have to be given back
+		CHECK(Throws([&] { ranges.Allocate(90, 1); }));
+		CHECK(ranges.GetVertexCount() == 10 && ranges.GetIndexCount() == 300);
+
+		// so all vertices are free again after the first range
+		ranges.Free(range, 0);
+		ranges.FreeCompleted([](uint64_t) { return true; });
+		CHECK(!Throws([&] { ranges.Allocate(100, 1); }));
+	}
+
+	void TestDeferredFree() {
+		GeometryRanges ranges{ 300, 300 };
+		GeometryRanges::Range a{ ranges.Allocate(100, 100) };
+		GeometryRanges::Range b{ ranges.Allocate(100, 100) };
+		GeometryRanges::Range c{ ranges.Allocate(100, 100) };
+		CHECK(ranges.GetVertexCount() == 300);
+
+		uint64_t completedFenceValue{};
+		auto isFenceComplete = [&](uint64_t fenceValue) {
+			return fenceValue <= completedFenceValue;
+		};
+
+		ranges.Free(b, 1);
+		ranges.Free(a, 2);
+
+		// the GPU may still read the ranges
+		ranges.FreeCompleted(isFenceComplete);
+		CHECK(ranges.GetVertexCount() == 300 && ranges.GetIndexCount() == 300);
+		CHECK(Throws([&] { ranges.Allocate(50, 50); }));
+
+		// only the frees with completed fences are done, in order
+		completedFenceValue = 1;
+		ranges.FreeCompleted(isFenceComplete);
+		CHECK(ranges.GetVertexCount() == 200 && ranges.GetIndexCount() == 200);
+
+		// the hole left by b is the only free space
+		GeometryRanges::Range reused{ ranges.Allocate(50, 60) };
+		CHECK(reused.firstVertex >= b.firstVertex && reused.firstVertex + reused.vertexCount <= b.firstVertex + b.vertexCount);
+		CHECK(reused.firstIndex >= b.firstIndex && reused.firstIndex + reused.indexCount <= b.firstIndex + b.indexCount);
+		CHECK(ranges.GetVertexCount() == 250 && ranges.GetIndexCount() == 260);
+
+		completedFenceValue = 2;
+		ranges.FreeCompleted(isFenceComplete);
+		CHECK(ranges.GetVertexCount() == 150 && ranges.GetIndexCount() == 160);
+
+		ranges.Free(c, 3);
+		ranges.Free(reused, 3);
+		completedFenceValue = 3;
+		ranges.FreeCompleted(isFenceComplete);
+		CHECK(ranges.GetVertexCount() == 0 && ranges.GetIndexCount() == 0);
+
+		// everything merged back into one range
+		GeometryRanges::Range whole{ ranges.Allocate(300, 300) };
+		CHECK(whole.firstVertex == 0 && whole.firstIndex == 0);
+	}
+}
+
+int main() {
+	TestAllocate();
+	TestFailedIndexAllocation();
+	TestDeferredFree();
+	return Check::Finish("GeometryRangesTests");
+}
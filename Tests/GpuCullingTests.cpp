@@ -0,0 +1,371 @@
+#include "Check.h"
+#include "CullingScene.h"
+
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace {
+	// Commands over a shuffled set of objects, every object is an instance of exactly one command
+	struct CommandScene {
+		std::vector<ObjectBounds> objectBounds{};
+		std::vector<IdIndirectCommand> commands{};
+		std::vector<uint32_t> instances{};
+	};
+
+	CommandScene MakeCommandScene(size_t commandsCount, uint32_t seed) {
+		std::mt19937 random{ seed };
+		std::uniform_int_distribution<uint32_t> instancesCount{ 0, 8 };
+
+		CommandScene scene{};
+		for (size_t i{}; i < commandsCount; ++i) {
+			IdIndirectCommand command{};
+			command.instanceOffset = static_cast<uint32_t>(scene.instances.size());
+			command.drawArguments.IndexCountPerInstance = static_cast<UINT>(3 * (i + 1));
+			command.drawArguments.InstanceCount = instancesCount(random);
+			scene.commands.push_back(command);
+			scene.instances.resize(scene.instances.size() + command.drawArguments.InstanceCount);
+		}
+		std::iota(scene.instances.begin(), scene.instances.end(), 0u);
+		std::shuffle(scene.instances.begin(), scene.instances.end(), random);
+
+		for (const DirectX::BoundingSphere& sphere : CullingScene::MakeSpheres(scene.instances.size(), seed, 0.5f, 20.f)) {
+			scene.objectBounds.push_back(ObjectBounds{ { sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius } });
+		}
+		return scene;
+	}
+
+	CullingScene::Visibility Classify(const FrustumCulling::Frustum& frustum, const ObjectBounds& bounds) {
+		return CullingScene::Classify(
+			frustum,
+			DirectX::BoundingSphere{ { bounds.sphere.x, bounds.sphere.y, bounds.sphere.z }, bounds.sphere.w }
+		);
+	}
+
+	DirectX::XMFLOAT4X4 StoreViewProjection(bool isReversedDepth = false) {
+		DirectX::XMFLOAT4X4 viewProjection{};
+		DirectX::XMStoreFloat4x4(&viewProjection, CullingScene::MakeViewProjection(60.f, 1000.f, isReversedDepth));
+		return viewProjection;
+	}
+
+	DirectX::XMFLOAT3 Project(const DirectX::XMFLOAT4X4& viewProjection, float x, float y, float z) {
+		DirectX::XMFLOAT4 clip{};
+		DirectX::XMStoreFloat4(
+			&clip,
+			DirectX::XMVector3Transform(DirectX::XMVectorSet(x, y, z, 1.f), DirectX::XMLoadFloat4x4(&viewProjection))
+		);
+		return DirectX::XMFLOAT3{ clip.x / clip.w, clip.y / clip.w, clip.z / clip.w };
+	}
+
+	struct CullResult {
+		std::vector<IdIndirectCommand> commands{};
+		std::vector<uint32_t> visibleInstances{};
+		uint32_t chunkCounts[CULLING_MAX_CHUNKS_COUNT]{};
+		size_t count{};
+	};
+
+	CullResult Cull(
+		const CullingConstants& constants,
+		const CommandScene& scene,
+		uint32_t* pObjectVisibility = nullptr,
+		const GpuCulling::HzbReference* pHzb = nullptr
+	) {
+		CullResult result{};
+		// every chunk's window is full size, the last one included
+		result.commands.resize(static_cast<size_t>(constants.commandsPerChunk) * CULLING_MAX_CHUNKS_COUNT);
+		result.visibleInstances.resize(scene.instances.size());
+		result.count = GpuCulling::CullCommandsReference(
+			constants,
+			scene.commands.data(),
+			scene.instances.data(),
+			scene.objectBounds.data(),
+			result.commands.data(),
+			result.visibleInstances.data(),
+			pObjectVisibility,
+			pHzb,
+			result.chunkCounts
+		);
+		return result;
+	}
+
+	// The visible instances of every written command, in input order
+	std::vector<std::vector<uint32_t>> GetDrawnInstances(const CullingConstants& constants, const CullResult& result) {
+		std::vector<std::vector<uint32_t>> drawnInstances(constants.commandsCount);
+		for (uint32_t chunkId{}; chunkId < CULLING_MAX_CHUNKS_COUNT; ++chunkId) {
+			for (uint32_t i{}; i < result.chunkCounts[chunkId]; ++i) {
+				const IdIndirectCommand& command{ result.commands[chunkId * constants.commandsPerChunk + i] };
+				uint32_t commandId{ command.drawArguments.IndexCountPerInstance / 3 - 1 };
+				drawnInstances[commandId].assign(
+					result.visibleInstances.begin() + command.instanceOffset,
+					result.visibleInstances.begin() + command.instanceOffset + command.drawArguments.InstanceCount
+				);
+			}
+		}
+		return drawnInstances;
+	}
+
+	void TestCommandsPerChunk() {
+		CHECK(GpuCulling::GetCommandsPerChunk(10, 3) == 4);
+		CHECK(GpuCulling::GetCommandsPerChunk(9, 3) == 3);
+		CHECK(GpuCulling::GetCommandsPerChunk(1, 8) == 1);
+		CHECK(GpuCulling::GetCommandsPerChunk(0, 4) == 1);
+		CHECK(GpuCulling::GetCommandsPerChunk(1000, 1) == 1000);
+
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		CullingConstants constants{ GpuCulling::MakeCullingConstants(frustum, StoreViewProjection(), 10, GpuCulling::Phase::Late, {}, 3) };
+		CHECK(constants.commandsCount == 10);
+		CHECK(constants.commandsPerChunk == 4);
+		CHECK(constants.phase == CULLING_PHASE_LATE);
+		CHECK(std::equal(std::begin(frustum.planes), std::end(frustum.planes), std::begin(constants.frustumPlanes), [](const auto& a, const auto& b) {
+			return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+		}));
+	}
+
+	void TestFrustumPhase() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		CommandScene scene{ MakeCommandScene(1001, 1) };
+		constexpr uint32_t chunksCount{ 3 };
+		CullingConstants constants{ GpuCulling::MakeCullingConstants(
+			frustum, StoreViewProjection(), static_cast<uint32_t>(scene.commands.size()), GpuCulling::Phase::Frustum, {}, chunksCount
+		) };
+		CullResult result{ Cull(constants, scene) };
+
+		// chunks write their own window in input order and nothing else
+		size_t chunkCountsSum{};
+		for (uint32_t chunkId{}; chunkId < CULLING_MAX_CHUNKS_COUNT; ++chunkId) {
+			chunkCountsSum += result.chunkCounts[chunkId];
+			CHECK(result.chunkCounts[chunkId] <= constants.commandsPerChunk);
+			if (chunkId >= chunksCount) {
+				CHECK(result.chunkCounts[chunkId] == 0);
+			}
+			uint32_t previousCommandId{};
+			for (uint32_t i{}; i < result.chunkCounts[chunkId]; ++i) {
+				const IdIndirectCommand& command{ result.commands[chunkId * constants.commandsPerChunk + i] };
+				uint32_t commandId{ command.drawArguments.IndexCountPerInstance / 3 - 1 };
+				CHECK(commandId / constants.commandsPerChunk == chunkId);
+				CHECK(i == 0 || commandId > previousCommandId);
+				CHECK(command.instanceOffset == scene.commands[commandId].instanceOffset);
+				previousCommandId = commandId;
+			}
+		}
+		CHECK(chunkCountsSum == result.count);
+
+		// against the sphere test in double precision, visible instances keep their order
+		std::vector<std::vector<uint32_t>> drawnInstances{ GetDrawnInstances(constants, result) };
+		size_t drawnCount{};
+		size_t mismatchesCount{};
+		for (size_t commandId{}; commandId < scene.commands.size(); ++commandId) {
+			const IdIndirectCommand& command{ scene.commands[commandId] };
+			const std::vector<uint32_t>& drawn{ drawnInstances[commandId] };
+			auto nextDrawn{ drawn.begin() };
+			for (uint32_t i{}; i < command.drawArguments.InstanceCount; ++i) {
+				uint32_t objectId{ scene.instances[command.instanceOffset + i] };
+				bool isDrawn{ nextDrawn != drawn.end() && *nextDrawn == objectId };
+				nextDrawn += isDrawn;
+				CullingScene::Visibility visibility{ Classify(frustum, scene.objectBounds[objectId]) };
+				mismatchesCount += visibility == CullingScene::Visibility::Inside && !isDrawn;
+				mismatchesCount += visibility == CullingScene::Visibility::Outside && isDrawn;
+			}
+			// only the visible instances, in order
+			CHECK(nextDrawn == drawn.end());
+			drawnCount += drawn.size();
+		}
+		CHECK(mismatchesCount == 0);
+		CHECK(drawnCount > 100 && drawnCount < scene.instances.size() / 2);
+	}
+
+	void TestEarlyAndLatePhases() {
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(CullingScene::MakeViewProjection()) };
+		DirectX::XMFLOAT4X4 viewProjection{ StoreViewProjection() };
+		CommandScene scene{ MakeCommandScene(500, 2) };
+		uint32_t commandsCount{ static_cast<uint32_t>(scene.commands.size()) };
+
+		// nothing is occluded by the far plane of a reversed depth buffer
+		std::vector<float> depth(64 * 36, 0.f);
+		GpuCulling::HzbReference hzb{ depth.data(), 64, 36 };
+		GpuCulling::HzbView hzbView{ .width{ 64 }, .height{ 36 }, .mipsCount{ hzb.GetMipsCount() } };
+
+		CullingConstants frustumConstants{ GpuCulling::MakeCullingConstants(frustum, viewProjection, commandsCount) };
+		CullResult frustumResult{ Cull(frustumConstants, scene) };
+		std::vector<std::vector<uint32_t>> frustumDrawn{ GetDrawnInstances(frustumConstants, frustumResult) };
+
+		// last frame saw a random half of the objects
+		std::mt19937 random{ 3 };
+		std::vector<uint32_t> visibility(scene.objectBounds.size());
+		for (uint32_t& isVisible : visibility) {
+			isVisible = random() & 1;
+		}
+		std::vector<uint32_t> previousVisibility{ visibility };
+
+		CullingConstants earlyConstants{ GpuCulling::MakeCullingConstants(frustum, viewProjection, commandsCount, GpuCulling::Phase::Early, hzbView, 2) };
+		CullResult early{ Cull(earlyConstants, scene, visibility.data()) };
+		// the early phase only reads the visibility
+		CHECK(visibility == previousVisibility);
+
+		CullingConstants lateConstants{ GpuCulling::MakeCullingConstants(frustum, viewProjection, commandsCount, GpuCulling::Phase::Late, hzbView, 2) };
+		CullResult late{ Cull(lateConstants, scene, visibility.data(), &hzb) };
+
+		std::vector<std::vector<uint32_t>> earlyDrawn{ GetDrawnInstances(earlyConstants, early) };
+		std::vector<std::vector<uint32_t>> lateDrawn{ GetDrawnInstances(lateConstants, late) };
+		std::vector<uint32_t> frustumVisibility(scene.objectBounds.size());
+		for (uint32_t commandId{}; commandId < commandsCount; ++commandId) {
+			for (uint32_t objectId : frustumDrawn[commandId]) {
+				frustumVisibility[objectId] = 1;
+			}
+			for (uint32_t objectId : earlyDrawn[commandId]) {
+				CHECK(previousVisibility[objectId]);
+			}
+			for (uint32_t objectId : lateDrawn[commandId]) {
+				CHECK(!previousVisibility[objectId]);
+			}
+			// without occlusion both phases together draw what the frustum phase draws
+			std::vector<uint32_t> merged{ earlyDrawn[commandId] };
+			merged.insert(merged.end(), lateDrawn[commandId].begin(), lateDrawn[commandId].end());
+			std::vector<uint32_t> expected{ frustumDrawn[commandId] };
+			std::sort(expected.begin(), expected.end());
+			std::sort(merged.begin(), merged.end());
+			CHECK(merged == expected);
+		}
+		CHECK(early.count > 0 && late.count > 0);
+
+		// the late phase leaves the visibility of this frame for the next one
+		CHECK(visibility == frustumVisibility);
+		CullResult nextEarly{ Cull(earlyConstants, scene, visibility.data()) };
+		CHECK(nextEarly.count == frustumResult.count);
+		CullResult nextLate{ Cull(lateConstants, scene, visibility.data(), &hzb) };
+		CHECK(nextLate.count == 0);
+	}
+
+	void CheckHzbMips(uint32_t width, uint32_t height, uint32_t mipsCount) {
+		std::mt19937 random{ width * height };
+		std::uniform_real_distribution<float> distribution{ 0.f, 1.f };
+		std::vector<float> depth(width * height);
+		for (float& value : depth) {
+			value = distribution(random);
+		}
+
+		GpuCulling::HzbReference hzb{ depth.data(), width, height };
+		CHECK(hzb.GetMipsCount() == mipsCount);
+		// Every texel holds the farthest depth of the mip 0 texels under it. Texel t of mip m covers [t << m, (t + 1) << m),
+		// on an odd side the last texel covers the pixels left over, sides stop at 1 texel.
+		for (uint32_t mipId{}; mipId < hzb.GetMipsCount(); ++mipId) {
+			uint32_t mipWidth{ ((width - 1) >> mipId) + 1 }, mipHeight{ ((height - 1) >> mipId) + 1 };
+			for (uint32_t y{}; y < mipHeight; ++y) {
+				for (uint32_t x{}; x < mipWidth; ++x) {
+					float farthest{ 1.f };
+					for (uint32_t srcY{ y << mipId }; srcY < std::min((y + 1) << mipId, height); ++srcY) {
+						for (uint32_t srcX{ x << mipId }; srcX < std::min((x + 1) << mipId, width); ++srcX) {
+							farthest = std::min(farthest, depth[srcY * width + srcX]);
+						}
+					}
+					CHECK(hzb.Load(x, y, mipId) == farthest);
+				}
+			}
+		}
+		CHECK(hzb.Load(0, 0, hzb.GetMipsCount() - 1) == *std::min_element(depth.begin(), depth.end()));
+	}
+
+	void TestHzbMips() {
+		CheckHzbMips(64, 16, 7);
+		// the mips of odd sides go down to 1x1 of the next power of two
+		CheckHzbMips(37, 11, 7);
+		CheckHzbMips(129, 3, 9);
+
+		// a single row, the last texel is never dropped
+		float row[5]{ 0.5f, 0.25f, 0.75f, 0.125f, 0.0625f };
+		GpuCulling::HzbReference rowHzb{ row, 5, 1 };
+		CHECK(rowHzb.GetMipsCount() == 4);
+		CHECK(rowHzb.Load(0, 0, 1) == 0.25f && rowHzb.Load(1, 0, 1) == 0.125f && rowHzb.Load(2, 0, 1) == 0.0625f);
+		CHECK(rowHzb.Load(0, 0, 2) == 0.125f && rowHzb.Load(1, 0, 2) == 0.0625f);
+		CHECK(rowHzb.Load(0, 0, 3) == 0.0625f);
+	}
+
+	void TestOcclusion(uint32_t width, uint32_t height, uint32_t mipsCount) {
+		DirectX::XMFLOAT4X4 viewProjection{ StoreViewProjection(true) };
+		FrustumCulling::Frustum frustum{ FrustumCulling::Frustum::FromViewProjection(DirectX::XMLoadFloat4x4(&viewProjection)) };
+		GpuCulling::HzbView hzbView{ .width{ width }, .height{ height }, .mipsCount{ mipsCount } };
+		CullingConstants constants{ GpuCulling::MakeCullingConstants(frustum, viewProjection, 0, GpuCulling::Phase::Late, hzbView) };
+
+		// walls at 20, 50 and 100 in three quadrants, the top right one is empty
+		float wallDistances[4]{ 20.f, 0.f, 50.f, 100.f };
+		std::vector<float> depth(width * height);
+		for (uint32_t y{}; y < height; ++y) {
+			for (uint32_t x{}; x < width; ++x) {
+				float distance{ wallDistances[(y < height / 2 ? 0 : 2) + (x < width / 2 ? 0 : 1)] };
+				// the last column and row are empty, on odd sides they are what a 2x2 reduction drops
+				if (x == width - 1 || y == height - 1) {
+					distance = 0.f;
+				}
+				depth[y * width + x] = distance > 0.f ? Project(viewProjection, 0.f, 0.f, distance).z : 0.f;
+			}
+		}
+		GpuCulling::HzbReference hzb{ depth.data(), width, height };
+		CHECK(hzb.GetMipsCount() == hzbView.mipsCount);
+
+		// top left quadrant
+		CHECK(GpuCulling::IsOccludedReference(constants, { -10.f, 5.f, 40.f, 1.f }, hzb));
+		CHECK(!GpuCulling::IsOccludedReference(constants, { -5.f, 2.5f, 10.f, 1.f }, hzb));
+		// nothing behind the empty quadrant is occluded
+		CHECK(!GpuCulling::IsOccludedReference(constants, { 40.f, 20.f, 500.f, 1.f }, hzb));
+		// across the border of the empty quadrant
+		CHECK(!GpuCulling::IsOccludedReference(constants, { 0.f, 10.f, 200.f, 5.f }, hzb));
+		// around the camera
+		CHECK(!GpuCulling::IsOccludedReference(constants, { 0.f, 0.f, 0.5f, 1.f }, hzb));
+
+		// Random spheres: occluded ones have every texel of their screen rectangle in front of them.
+		// The rectangle is that of the box around the sphere, like the shader uses.
+		std::mt19937 random{ 5 };
+		std::uniform_real_distribution<float> xy{ -1.f, 1.f };
+		std::uniform_real_distribution<float> z{ 5.f, 300.f };
+		std::uniform_real_distribution<float> radius{ 0.2f, 8.f };
+		size_t occludedCount{};
+		size_t visibleCount{};
+		for (size_t i{}; i < 10000; ++i) {
+			float sphereZ{ z(random) };
+			DirectX::XMFLOAT4 sphere{ xy(random) * sphereZ, xy(random) * sphereZ * 0.5625f, sphereZ, radius(random) };
+			if (!GpuCulling::IsOccludedReference(constants, sphere, hzb)) {
+				++visibleCount;
+				continue;
+			}
+			++occludedCount;
+
+			float minX{ 1.f }, minY{ 1.f }, maxX{ -1.f }, maxY{ -1.f }, nearestDepth{};
+			for (uint32_t corner{}; corner < 8; ++corner) {
+				DirectX::XMFLOAT3 ndc{ Project(
+					viewProjection,
+					sphere.x + (corner & 1 ? sphere.w : -sphere.w),
+					sphere.y + (corner & 2 ? sphere.w : -sphere.w),
+					sphere.z + (corner & 4 ? sphere.w : -sphere.w)
+				) };
+				minX = std::min(minX, ndc.x);
+				minY = std::min(minY, ndc.y);
+				maxX = std::max(maxX, ndc.x);
+				maxY = std::max(maxY, ndc.y);
+				nearestDepth = std::max(nearestDepth, ndc.z);
+			}
+			auto toPixel{ [](float ndc, uint32_t size) {
+				return std::min(static_cast<uint32_t>(std::clamp(ndc * 0.5f + 0.5f, 0.f, 1.f) * size), size - 1);
+			} };
+			bool isBehindDepth{ true };
+			for (uint32_t y{ toPixel(-maxY, height) }; y <= toPixel(-minY, height); ++y) {
+				for (uint32_t x{ toPixel(minX, width) }; x <= toPixel(maxX, width); ++x) {
+					isBehindDepth &= nearestDepth < depth[y * width + x];
+				}
+			}
+			CHECK(isBehindDepth);
+		}
+		CHECK(occludedCount > 1000 && visibleCount > 1000);
+	}
+}
+
+int main() {
+	TestCommandsPerChunk();
+	TestFrustumPhase();
+	TestEarlyAndLatePhases();
+	TestHzbMips();
+	TestOcclusion(256, 128, 9);
+	TestOcclusion(255, 127, 9);
+	return Check::Finish("GpuCullingTests");
+}
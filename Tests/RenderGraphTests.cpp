@@ -0,0 +1,537 @@
+#include "Check.h"
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+namespace {
+	using Barrier = RenderGraph::Barrier;
+	using QueueType = RenderGraph::QueueType;
+
+	constexpr UINT64 megabyte{ 1 << 20 };
+
+	// transient buffers are as big as their width, like buffers are on a device
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(const D3D12_RESOURCE_DESC& resDesc) {
+		return D3D12_RESOURCE_ALLOCATION_INFO{
+			.SizeInBytes{ resDesc.Width },
+			.Alignment{ D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT }
+		};
+	}
+
+	D3D12_RESOURCE_DESC BufferDesc(UINT64 size) {
+		return D3D12_RESOURCE_DESC{
+			.Dimension{ D3D12_RESOURCE_DIMENSION_BUFFER },
+			.Width{ size },
+			.Height{ 1 },
+			.DepthOrArraySize{ 1 },
+			.MipLevels{ 1 },
+			.SampleDesc{ 1, 0 },
+			.Layout{ D3D12_TEXTURE_LAYOUT_ROW_MAJOR }
+		};
+	}
+
+	uint32_t GetOrderId(const RenderGraph& graph, RenderGraph::PassId passId) {
+		const std::vector<RenderGraph::CompiledPass>& order{ graph.GetExecutionOrder() };
+		auto it{ std::find_if(order.begin(), order.end(), [&](const RenderGraph::CompiledPass& pass) { return pass.id == passId; }) };
+		return it == order.end() ? RenderGraph::InvalidId : static_cast<uint32_t>(it - order.begin());
+	}
+
+	const RenderGraph::CompiledPass& GetCompiledPass(const RenderGraph& graph, RenderGraph::PassId passId) {
+		return graph.GetExecutionOrder().at(GetOrderId(graph, passId));
+	}
+
+	bool HasTransition(
+		const std::vector<Barrier>& barriers,
+		RenderGraph::ResourceId id,
+		D3D12_RESOURCE_STATES stateBefore,
+		D3D12_RESOURCE_STATES stateAfter
+	) {
+		return std::any_of(barriers.begin(), barriers.end(), [&](const Barrier& barrier) {
+			return barrier.type == Barrier::Type::Transition
+				&& barrier.id == id
+				&& barrier.stateBefore == stateBefore
+				&& barrier.stateAfter == stateAfter;
+		});
+	}
+
+	bool HasBarrier(const std::vector<Barrier>& barriers, Barrier::Type type, RenderGraph::ResourceId id) {
+		return std::any_of(barriers.begin(), barriers.end(), [&](const Barrier& barrier) {
+			return barrier.type == type && barrier.id == id;
+		});
+	}
+
+	bool HasAnyBarrier(const std::vector<Barrier>& barriers, RenderGraph::ResourceId id) {
+		return std::any_of(barriers.begin(), barriers.end(), [&](const Barrier& barrier) { return barrier.id == id; });
+	}
+
+	bool Contains(const std::vector<uint32_t>& values, uint32_t value) {
+		return std::find(values.begin(), values.end(), value) != values.end();
+	}
+
+	void TestOrderingAndCulling() {
+		RenderGraph graph{};
+		auto output{ graph.ImportResource(L"Output", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT) };
+		auto a{ graph.CreateTransientResource(L"A", BufferDesc(megabyte)) };
+		auto b{ graph.CreateTransientResource(L"B", BufferDesc(megabyte)) };
+		auto unused{ graph.CreateTransientResource(L"Unused", BufferDesc(megabyte)) };
+		auto marker{ graph.CreateTransientResource(L"Marker", BufferDesc(megabyte)) };
+
+		auto writeA{ graph.AddPass(L"Write A", [&](auto& builder) {
+			builder.Write(a, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+		auto writeUnused{ graph.AddPass(L"Write unused", [&](auto& builder) {
+			builder.Write(unused, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto writeB{ graph.AddPass(L"Write B", [&](auto& builder) {
+			builder.Write(b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto combine{ graph.AddPass(L"Combine", [&](auto& builder) {
+			builder.Read(a, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Read(b, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Write(output, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+		auto sideEffects{ graph.AddPass(L"Side effects", [&](auto& builder) {
+			builder.Write(marker, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Direct, true) };
+
+		CHECK(!graph.IsCompiled());
+		CHECK(graph.Compile(GetAllocationInfo));
+		CHECK(graph.IsCompiled());
+
+		// nothing reads the unused resource, the side effects keep the last pass
+		const std::vector<RenderGraph::CompiledPass>& order{ graph.GetExecutionOrder() };
+		CHECK(GetOrderId(graph, writeUnused) == RenderGraph::InvalidId);
+		CHECK(graph.GetTransientPlacement(unused) == nullptr);
+
+		// independent passes share level 0 in declaration order, the consumer comes after them
+		if (CHECK(order.size() == 4)) {
+			CHECK(order[0].id == writeA && order[0].level == 0);
+			CHECK(order[1].id == writeB && order[1].level == 0);
+			CHECK(order[2].id == sideEffects && order[2].level == 0);
+			CHECK(order[3].id == combine && order[3].level == 1);
+		}
+		const RenderGraph::CompiledPass& combinePass{ GetCompiledPass(graph, combine) };
+		CHECK((combinePass.dependencies == std::vector<RenderGraph::PassId>{ writeA, writeB }));
+
+		// a new declaration invalidates the compilation
+		graph.AddPass(L"Late", [&](auto& builder) {
+			builder.Read(a, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		}, {});
+		CHECK(!graph.IsCompiled());
+
+		graph.Clear();
+		CHECK(graph.GetPasses().empty() && graph.GetResources().empty());
+		CHECK(!graph.Compile(GetAllocationInfo));
+	}
+
+	void TestDependencies() {
+		RenderGraph graph{};
+		auto output{ graph.ImportResource(L"Output", D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON) };
+		auto buffer{ graph.CreateTransientResource(L"Buffer", BufferDesc(megabyte)) };
+
+		auto write{ graph.AddPass(L"Write", [&](auto& builder) {
+			builder.Write(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto readSrv0{ graph.AddPass(L"Read SRV 0", [&](auto& builder) {
+			builder.Read(buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto readSrv1{ graph.AddPass(L"Read SRV 1", [&](auto& builder) {
+			builder.Read(buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}, {}, QueueType::Direct, true) };
+		// another read state needs a transition after the readers of the first one
+		auto readCopy{ graph.AddPass(L"Read copy", [&](auto& builder) {
+			builder.Read(buffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		}, {}, QueueType::Direct, true) };
+		// write after read waits for all readers
+		auto rewrite{ graph.AddPass(L"Rewrite", [&](auto& builder) {
+			builder.Write(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Direct, true) };
+		// read and write of one resource merge into a single write access
+		auto readWrite{ graph.AddPass(L"Read write", [&](auto& builder) {
+			builder.Read(output, D3D12_RESOURCE_STATE_COPY_SOURCE);
+			builder.Write(output, D3D12_RESOURCE_STATE_COPY_DEST);
+		}, {}) };
+
+		const RenderGraph::Pass& readWritePass{ graph.GetPass(readWrite) };
+		if (CHECK(readWritePass.accesses.size() == 1)) {
+			CHECK(readWritePass.accesses[0].isWrite);
+			CHECK(readWritePass.accesses[0].state == (D3D12_RESOURCE_STATE_COPY_SOURCE | D3D12_RESOURCE_STATE_COPY_DEST));
+		}
+
+		CHECK(graph.Compile(GetAllocationInfo));
+		CHECK(GetCompiledPass(graph, readSrv0).level == 1);
+		CHECK(GetCompiledPass(graph, readSrv1).level == 1);
+		CHECK((GetCompiledPass(graph, readSrv1).dependencies == std::vector<RenderGraph::PassId>{ write }));
+		CHECK(GetCompiledPass(graph, readCopy).level == 2);
+		CHECK((GetCompiledPass(graph, readCopy).dependencies == std::vector<RenderGraph::PassId>{ write, readSrv0, readSrv1 }));
+		CHECK(GetCompiledPass(graph, rewrite).level == 3);
+		CHECK(Contains(GetCompiledPass(graph, rewrite).dependencies, readCopy));
+		CHECK(GetCompiledPass(graph, readWrite).level == 2);
+
+		// every pass comes after what it depends on
+		for (const RenderGraph::CompiledPass& compiledPass : graph.GetExecutionOrder()) {
+			for (RenderGraph::PassId dependency : compiledPass.dependencies) {
+				CHECK(GetOrderId(graph, dependency) < GetOrderId(graph, compiledPass.id));
+			}
+		}
+	}
+
+	void TestBarriers() {
+		RenderGraph graph{};
+		auto depth{ graph.ImportResource(L"Depth", D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE) };
+		auto target{ graph.ImportResource(L"Target", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT) };
+		auto buffer{ graph.CreateTransientResource(L"Buffer", BufferDesc(megabyte)) };
+
+		auto drawDepth{ graph.AddPass(L"Depth", [&](auto& builder) {
+			builder.Write(depth, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		}, {}) };
+		auto fill{ graph.AddPass(L"Fill", [&](auto& builder) {
+			builder.Write(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto accumulate{ graph.AddPass(L"Accumulate", [&](auto& builder) {
+			builder.Write(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		auto resolve{ graph.AddPass(L"Resolve", [&](auto& builder) {
+			builder.Read(depth, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Read(buffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Write(target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+
+		CHECK(graph.Compile(GetAllocationInfo));
+
+		// imported resources start in their init state
+		CHECK(GetCompiledPass(graph, drawDepth).barriers.empty());
+
+		// a transient resource stays in the state of its last use between frames
+		CHECK(graph.GetInitialState(buffer) == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		CHECK(HasTransition(
+			GetCompiledPass(graph, fill).barriers,
+			buffer,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+		));
+
+		// UAV writes in a row are separated by a UAV barrier instead of a transition
+		const std::vector<Barrier>& accumulateBarriers{ GetCompiledPass(graph, accumulate).barriers };
+		CHECK(accumulateBarriers.size() == 1);
+		CHECK(HasBarrier(accumulateBarriers, Barrier::Type::Uav, buffer));
+
+		const std::vector<Barrier>& resolveBarriers{ GetCompiledPass(graph, resolve).barriers };
+		CHECK(resolveBarriers.size() == 3);
+		CHECK(HasTransition(resolveBarriers, depth, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		CHECK(HasTransition(resolveBarriers, buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		CHECK(HasTransition(resolveBarriers, target, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+		// imported resources go back to their final state, transient ones don't
+		const RenderGraph::FrameEnd& frameEnd{ graph.GetFrameEnd() };
+		CHECK(frameEnd.barriers.size() == 2);
+		CHECK(HasTransition(frameEnd.barriers, depth, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+		CHECK(HasTransition(frameEnd.barriers, target, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+		CHECK(frameEnd.waits.empty());
+	}
+
+	void TestComputeQueue() {
+		RenderGraph graph{};
+		auto depth{ graph.ImportResource(L"Depth", D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE) };
+		auto target{ graph.ImportResource(L"Target", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT) };
+		auto shaded{ graph.CreateTransientResource(L"Shaded", BufferDesc(megabyte)) };
+
+		auto drawDepth{ graph.AddPass(L"Depth", [&](auto& builder) {
+			builder.Write(depth, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		}, {}) };
+		auto shade{ graph.AddPass(L"Shade", [&](auto& builder) {
+			builder.Read(depth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(shaded, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Compute) };
+		auto post{ graph.AddPass(L"Post", [&](auto& builder) {
+			builder.Read(shaded, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Write(target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+
+		CHECK(!RenderGraph::IsStateSupportedByQueue(D3D12_RESOURCE_STATE_DEPTH_WRITE, QueueType::Compute));
+		CHECK(!RenderGraph::IsStateSupportedByQueue(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, QueueType::Compute));
+		CHECK(RenderGraph::IsStateSupportedByQueue(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, QueueType::Compute));
+		CHECK(RenderGraph::IsStateSupportedByQueue(D3D12_RESOURCE_STATE_DEPTH_WRITE, QueueType::Direct));
+
+		CHECK(graph.Compile(GetAllocationInfo));
+		uint32_t depthOrderId{ GetOrderId(graph, drawDepth) };
+		uint32_t shadeOrderId{ GetOrderId(graph, shade) };
+		const RenderGraph::CompiledPass& depthPass{ GetCompiledPass(graph, drawDepth) };
+		const RenderGraph::CompiledPass& shadePass{ GetCompiledPass(graph, shade) };
+		const RenderGraph::CompiledPass& postPass{ GetCompiledPass(graph, post) };
+
+		// the compute queue can't leave DEPTH_WRITE or PIXEL_SHADER_RESOURCE,
+		// so the direct queue transitions after the depth pass and compute waits for it
+		CHECK(!HasAnyBarrier(shadePass.barriers, depth));
+		CHECK(!HasAnyBarrier(shadePass.barriers, shaded));
+		CHECK(HasTransition(
+			depthPass.barriersAfter,
+			depth,
+			D3D12_RESOURCE_STATE_DEPTH_WRITE,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		));
+		CHECK(HasTransition(
+			depthPass.barriersAfter,
+			shaded,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+		));
+		CHECK((shadePass.waits == std::vector<uint32_t>{ depthOrderId }));
+		CHECK(depthPass.isSignaling);
+
+		// compute already waits for this frame's direct work, so it doesn't wait for the previous frame
+		CHECK(!shadePass.isWaitingPreviousFrame);
+
+		// the direct queue reads the compute output after a wait
+		CHECK((postPass.waits == std::vector<uint32_t>{ shadeOrderId }));
+		CHECK(shadePass.isSignaling);
+		CHECK(HasTransition(
+			postPass.barriers,
+			shaded,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+		));
+
+		// the post pass has already joined the compute queue
+		CHECK(graph.GetFrameEnd().waits.empty());
+	}
+
+	void TestPreviousFrameWait() {
+		RenderGraph graph{};
+		auto target{ graph.ImportResource(L"Target", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT) };
+		auto arguments{ graph.ImportResource(L"Arguments", D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS) };
+		auto history{ graph.ImportResource(L"History", D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS) };
+
+		// only the compute queue touches the history, so it can run ahead into the next frame
+		auto integrate{ graph.AddPass(L"Integrate", [&](auto& builder) {
+			builder.Write(history, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Compute) };
+		// the arguments are read by the direct queue, so the update waits until the previous frame is over
+		auto update{ graph.AddPass(L"Update", [&](auto& builder) {
+			builder.Write(arguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Compute) };
+		auto draw{ graph.AddPass(L"Draw", [&](auto& builder) {
+			builder.Read(arguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+			builder.Write(target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+
+		CHECK(graph.Compile(GetAllocationInfo));
+		const RenderGraph::CompiledPass& integratePass{ GetCompiledPass(graph, integrate) };
+		const RenderGraph::CompiledPass& updatePass{ GetCompiledPass(graph, update) };
+		const RenderGraph::CompiledPass& drawPass{ GetCompiledPass(graph, draw) };
+
+		CHECK(integratePass.waits.empty() && !integratePass.isWaitingPreviousFrame);
+		CHECK(updatePass.waits.empty() && updatePass.isWaitingPreviousFrame);
+		CHECK((drawPass.waits == std::vector<uint32_t>{ GetOrderId(graph, update) }));
+		CHECK(updatePass.isSignaling && !integratePass.isSignaling);
+
+		// the draw has joined the compute queue after its last pass, the frame end returns the arguments
+		CHECK(graph.GetFrameEnd().waits.empty());
+		CHECK(HasTransition(
+			graph.GetFrameEnd().barriers,
+			arguments,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+		));
+	}
+
+	void TestTransientAliasing() {
+		RenderGraph graph{};
+		auto output{ graph.ImportResource(L"Output", D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON) };
+		auto first{ graph.CreateTransientResource(L"First", BufferDesc(megabyte)) };
+		auto middle{ graph.CreateTransientResource(L"Middle", BufferDesc(megabyte / 2 + 1)) };
+		auto last{ graph.CreateTransientResource(L"Last", BufferDesc(megabyte)) };
+
+		// a chain, so the lifetimes are first [0, 1], middle [1, 2] and last [2, 3]
+		graph.AddPass(L"0", [&](auto& builder) {
+			builder.Write(first, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {});
+		graph.AddPass(L"1", [&](auto& builder) {
+			builder.Read(first, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(middle, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {});
+		auto pass2{ graph.AddPass(L"2", [&](auto& builder) {
+			builder.Read(middle, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(last, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}) };
+		graph.AddPass(L"3", [&](auto& builder) {
+			builder.Read(last, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {});
+
+		CHECK(graph.Compile(GetAllocationInfo));
+
+		const RenderGraph::TransientPlacement* pFirst{ graph.GetTransientPlacement(first) };
+		const RenderGraph::TransientPlacement* pMiddle{ graph.GetTransientPlacement(middle) };
+		const RenderGraph::TransientPlacement* pLast{ graph.GetTransientPlacement(last) };
+		CHECK(graph.GetTransientPlacement(output) == nullptr);
+		if (!CHECK(pFirst && pMiddle && pLast)) {
+			return;
+		}
+
+		CHECK(pFirst->firstUse == 0 && pFirst->lastUse == 1);
+		CHECK(pMiddle->firstUse == 1 && pMiddle->lastUse == 2);
+		CHECK(pLast->firstUse == 2 && pLast->lastUse == 3);
+
+		// first and last never live together and share memory, middle overlaps both in time
+		CHECK(pFirst->offset == 0 && pLast->offset == 0);
+		CHECK(pMiddle->offset == megabyte);
+		CHECK(pMiddle->offset % pMiddle->alignment == 0);
+		CHECK(pFirst->isAliased && pLast->isAliased);
+		CHECK(!pMiddle->isAliased);
+
+		const RenderGraph::MemoryStats& stats{ graph.GetMemoryStats() };
+		CHECK(stats.heapSize == megabyte + megabyte / 2 + 1);
+		CHECK(stats.unaliasedSize == 2 * megabyte + megabyte / 2 + 1);
+		CHECK(stats.heapAlignment == D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+		// aliased memory is activated by the first pass using it
+		const std::vector<RenderGraph::CompiledPass>& order{ graph.GetExecutionOrder() };
+		CHECK(HasBarrier(order[0].barriers, Barrier::Type::Aliasing, first));
+		CHECK(HasBarrier(GetCompiledPass(graph, pass2).barriers, Barrier::Type::Aliasing, last));
+		CHECK(!HasBarrier(order[1].barriers, Barrier::Type::Aliasing, middle));
+
+		// no two resources alive at once overlap in memory
+		const std::vector<RenderGraph::TransientPlacement>& placements{ graph.GetTransientPlacements() };
+		for (size_t i{}; i < placements.size(); ++i) {
+			for (size_t j{ i + 1 }; j < placements.size(); ++j) {
+				const RenderGraph::TransientPlacement& lhs{ placements[i] };
+				const RenderGraph::TransientPlacement& rhs{ placements[j] };
+				bool isLifetimeOverlapping{ lhs.firstUse <= rhs.lastUse && rhs.firstUse <= lhs.lastUse };
+				bool isMemoryOverlapping{ lhs.offset < rhs.offset + rhs.size && rhs.offset < lhs.offset + lhs.size };
+				CHECK(!(isLifetimeOverlapping && isMemoryOverlapping));
+			}
+		}
+	}
+
+	// the frame of Renderer::BuildRenderGraph without the HZB
+	void TestAsyncComputeTimeline() {
+		RenderGraph graph{};
+		auto backBuffer{ graph.ImportResource(L"BackBuffer", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT) };
+		auto depth{ graph.ImportResource(L"DepthBuffer", D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE) };
+		auto lightCounts{ graph.ImportResource(
+			L"LightCounts",
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		) };
+		auto lightIndices{ graph.ImportResource(
+			L"LightIndices",
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		) };
+		RenderGraph::ResourceId gBuffer[3]{};
+		for (RenderGraph::ResourceId& id : gBuffer) {
+			id = graph.CreateTransientResource(L"GBuffer", BufferDesc(megabyte));
+		}
+
+		auto writeGeometry = [&](RenderGraph::PassBuilder& builder) {
+			builder.Write(depth, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+			builder.Write(gBuffer[0], D3D12_RESOURCE_STATE_RENDER_TARGET);
+			builder.Write(gBuffer[1], D3D12_RESOURCE_STATE_RENDER_TARGET);
+		};
+		auto before{ graph.AddPass(L"Before frame part", [&](auto& builder) {
+			writeGeometry(builder);
+			builder.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+		auto staticGeometry{ graph.AddPass(L"Static", writeGeometry, {}) };
+		auto dynamicGeometry{ graph.AddPass(L"Dynamic", writeGeometry, {}) };
+		auto clusters{ graph.AddPass(L"Building light clusters", [&](auto& builder) {
+			builder.Write(lightCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			builder.Write(lightIndices, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Compute) };
+		auto shading{ graph.AddPass(L"Deferred shading", [&](auto& builder) {
+			builder.Read(lightCounts, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Read(lightIndices, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Read(gBuffer[0], D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Read(gBuffer[1], D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			builder.Write(gBuffer[2], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}, {}, QueueType::Compute) };
+		auto post{ graph.AddPass(L"Post Processing", [&](auto& builder) {
+			builder.Read(gBuffer[2], D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			builder.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}, {}) };
+
+		CHECK(graph.Compile(GetAllocationInfo));
+
+		// the clusters only touch resources of the compute queue, nothing holds them back
+		const RenderGraph::CompiledPass& clustersPass{ GetCompiledPass(graph, clusters) };
+		CHECK(clustersPass.level == 0);
+		CHECK(clustersPass.waits.empty());
+		CHECK(!clustersPass.isWaitingPreviousFrame);
+		CHECK(clustersPass.barriers.size() == 2);
+		CHECK(HasTransition(
+			clustersPass.barriers,
+			lightCounts,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+		));
+		CHECK((GetCompiledPass(graph, shading).waits == std::vector<uint32_t>{ GetOrderId(graph, dynamicGeometry) }));
+		CHECK((GetCompiledPass(graph, post).waits == std::vector<uint32_t>{ GetOrderId(graph, shading) }));
+
+		std::vector<double> passCosts(graph.GetPasses().size());
+		passCosts[before] = 0.1;
+		passCosts[staticGeometry] = 2.0;
+		passCosts[dynamicGeometry] = 1.0;
+		passCosts[clusters] = 0.5;
+		passCosts[shading] = 1.5;
+		passCosts[post] = 0.5;
+		constexpr uint32_t frameCount{ 3 };
+		std::vector<RenderGraph::SimulatedPass> timeline{ graph.SimulateTimeline(passCosts, frameCount) };
+
+		const size_t passesPerFrame{ graph.GetExecutionOrder().size() + 1 };
+		if (!CHECK(timeline.size() == passesPerFrame * frameCount)) {
+			return;
+		}
+		auto find = [&](uint32_t frame, RenderGraph::PassId id) {
+			auto it{ std::find_if(timeline.begin(), timeline.end(), [&](const RenderGraph::SimulatedPass& pass) {
+				return pass.frame == frame && pass.id == id;
+			}) };
+			return it == timeline.end() ? RenderGraph::SimulatedPass{} : *it;
+		};
+		auto isOverlapping = [](const RenderGraph::SimulatedPass& lhs, const RenderGraph::SimulatedPass& rhs) {
+			return lhs.start < rhs.end && rhs.start < lhs.end;
+		};
+
+		// the clusters run on the compute queue while the direct queue draws the first frame
+		RenderGraph::SimulatedPass clusters0{ find(0, clusters) };
+		CHECK(clusters0.queue == QueueType::Compute);
+		CHECK(clusters0.start == 0.0 && clusters0.end == 0.5);
+		CHECK(isOverlapping(clusters0, find(0, staticGeometry)));
+
+		// and the frame is as long as the passes after them, the clusters are hidden
+		RenderGraph::SimulatedPass frameEnd0{ find(0, RenderGraph::InvalidId) };
+		CHECK(frameEnd0.end == 0.1 + 2.0 + 1.0 + 1.5 + 0.5);
+
+		// the next clusters start as soon as the shading is done, before the previous frame ends
+		RenderGraph::SimulatedPass clusters1{ find(1, clusters) };
+		CHECK(clusters1.start == find(0, shading).end);
+		CHECK(isOverlapping(clusters1, find(0, post)));
+
+		for (const RenderGraph::SimulatedPass& pass : timeline) {
+			// passes of one queue never overlap
+			for (const RenderGraph::SimulatedPass& other : timeline) {
+				if (&other != &pass && other.queue == pass.queue && other.id != RenderGraph::InvalidId && pass.id != RenderGraph::InvalidId) {
+					CHECK(!isOverlapping(pass, other));
+				}
+			}
+			// and start after the passes they wait for
+			if (pass.id != RenderGraph::InvalidId) {
+				for (uint32_t orderId : GetCompiledPass(graph, pass.id).waits) {
+					CHECK(pass.start >= find(pass.frame, graph.GetExecutionOrder()[orderId].id).end);
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	TestOrderingAndCulling();
+	TestDependencies();
+	TestBarriers();
+	TestComputeQueue();
+	TestPreviousFrameWait();
+	TestTransientAliasing();
+	TestAsyncComputeTimeline();
+	return Check::Finish("RenderGraphTests");
+}
@@ -0,0 +1,102 @@
+#include "Benchmark.h"
+#include "CullingScene.h"
+
+#include "SoftwareOcclusion.h"
+
+#include <numeric>
+
+namespace {
+	// 12 triangles of an axis aligned box
+	SoftwareOcclusion::Occluder MakeBox(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents) {
+		SoftwareOcclusion::Occluder box{};
+		for (uint32_t i{}; i < 8; ++i) {
+			box.vertices.push_back(DirectX::XMFLOAT3{
+				center.x + (i & 1 ? extents.x : -extents.x),
+				center.y + (i & 2 ? extents.y : -extents.y),
+				center.z + (i & 4 ? extents.z : -extents.z)
+			});
+		}
+		box.indices = {
+			0, 1, 3, 0, 3, 2,	4, 5, 7, 4, 7, 6,
+			0, 1, 5, 0, 5, 4,	2, 3, 7, 2, 7, 6,
+			0, 2, 6, 0, 6, 4,	1, 3, 7, 1, 7, 5
+		};
+		return box;
+	}
+
+	// positions in the view cone of CullingScene::MakeViewProjection at distances from minZ to maxZ
+	DirectX::XMFLOAT3 MakeViewPosition(std::mt19937& random, float minZ, float maxZ) {
+		std::uniform_real_distribution<float> xy{ -1.f, 1.f };
+		std::uniform_real_distribution<float> distance{ minZ, maxZ };
+		float z{ distance(random) };
+		return DirectX::XMFLOAT3{ xy(random) * z, xy(random) * z * 0.5f, z };
+	}
+}
+
+// Occlusion culling on the CPU with the occlusion buffer size of Scene: rendering the occluders,
+// and testing spheres one at a time, in batches, and over the job system like RenderSubsystem::Cull does it
+int main(int argc, char** argv) {
+	size_t occludeesCount{ Benchmark::GetCount(argc, argv, 100'000) };
+	constexpr size_t occludersCount{ 1000 };
+	constexpr size_t runsCount{ 20 };
+
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> extent{ 1.f, 6.f };
+	std::uniform_real_distribution<float> radius{ 0.5f, 3.f };
+
+	std::vector<SoftwareOcclusion::Occluder> occluders{};
+	for (size_t i{}; i < occludersCount; ++i) {
+		occluders.push_back(MakeBox(MakeViewPosition(random, 30.f, 300.f), { extent(random), extent(random), extent(random) }));
+	}
+	FrustumCulling::BoundingSpheres spheres{};
+	for (size_t i{}; i < occludeesCount; ++i) {
+		spheres.PushBack(DirectX::BoundingSphere{ MakeViewPosition(random, 10.f, 500.f), radius(random) });
+	}
+	std::vector<uint32_t> allIds(spheres.GetSize());
+	std::iota(allIds.begin(), allIds.end(), 0u);
+
+	JobSystem<> jobSystem{};
+	jobSystem.StartRunning();
+	DirectX::XMMATRIX viewProjection{ CullingScene::MakeViewProjection(60.f, 1000.f, true) };
+	SoftwareOcclusion::OcclusionBuffer occlusionBuffer{ 256, 144 };
+
+	std::printf("%zu occluders, %zu occludees\n", occludersCount, occludeesCount);
+
+	Benchmark::Result render{ Benchmark::Measure(runsCount, [&] {
+		occlusionBuffer.Render(viewProjection, occluders, jobSystem);
+	}) };
+	Benchmark::Print("Render occluders, job system", render, static_cast<double>(occludersCount * 12), "triangles");
+
+	size_t occludedCount{};
+	Benchmark::Result test{ Benchmark::Measure(runsCount, [&] {
+		occludedCount = 0;
+		for (size_t i{}; i < spheres.GetSize(); ++i) {
+			occludedCount += occlusionBuffer.IsOccluded(
+				spheres.GetCentersX()[i], spheres.GetCentersY()[i], spheres.GetCentersZ()[i], spheres.GetRadii()[i]
+			);
+		}
+	}) };
+	Benchmark::Print("IsOccluded, 1 thread", test, static_cast<double>(occludeesCount), "spheres");
+
+	// the ids are copied back every run, RemoveOccluded compacts them in place
+	std::vector<uint32_t> visibleIds{};
+	size_t keptCount{};
+	Benchmark::Result removeBatches{ Benchmark::Measure(runsCount, [&] {
+		visibleIds = allIds;
+		keptCount = occlusionBuffer.RemoveOccluded(spheres, visibleIds.data(), visibleIds.size());
+	}) };
+	Benchmark::Print("RemoveOccluded, 1 thread", removeBatches, static_cast<double>(occludeesCount), "spheres");
+	if (keptCount + occludedCount != occludeesCount) {
+		std::printf("the batches keep %zu spheres, IsOccluded %zu\n", keptCount, occludeesCount - occludedCount);
+		return 1;
+	}
+
+	Benchmark::Result remove{ Benchmark::Measure(runsCount, [&] {
+		visibleIds = allIds;
+		occlusionBuffer.RemoveOccluded(spheres, jobSystem, visibleIds);
+	}) };
+	Benchmark::Print("RemoveOccluded, job system", remove, static_cast<double>(occludeesCount), "spheres");
+
+	std::printf("%zu occluded (%.1f%%), %zu kept\n", occludedCount, 100.0 * occludedCount / occludeesCount, visibleIds.size());
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "Check.h"
+
+#include "VisibilityBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_set>
+
+namespace {
+	constexpr double width{ 1280. };
+	constexpr double height{ 720. };
+
+	struct Vector {
+		double x{};
+		double y{};
+		double z{};
+	};
+
+	Vector Subtract(const Vector& a, const Vector& b) {
+		return Vector{ a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	Vector Cross(const Vector& a, const Vector& b) {
+		return Vector{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	double Dot(const Vector& a, const Vector& b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// Barycentrics of the point of the triangle the camera sees through the NDC position,
+	// found by intersecting the view ray in double precision
+	bool GetExactBarycentrics(const Vector (&points)[3], const DirectX::XMFLOAT4X4& projection, double ndcX, double ndcY, double (&result)[3]) {
+		Vector direction{ ndcX / projection.m[0][0], ndcY / projection.m[1][1], 1. };
+		Vector normal{ Cross(Subtract(points[1], points[0]), Subtract(points[2], points[0])) };
+		double denominator{ Dot(normal, direction) };
+		if (std::abs(denominator) < 1e-12) {
+			return false;
+		}
+		double distance{ Dot(normal, points[0]) / denominator };
+		Vector point{ direction.x * distance, direction.y * distance, direction.z * distance };
+		double area{ Dot(normal, normal) };
+		result[0] = Dot(Cross(Subtract(points[1], point), Subtract(points[2], point)), normal) / area;
+		result[1] = Dot(Cross(Subtract(points[2], point), Subtract(points[0], point)), normal) / area;
+		result[2] = 1. - result[0] - result[1];
+		return true;
+	}
+
+	void TestPackId() {
+		using namespace VisibilityBuffer;
+
+		auto isSameId{ [](const Id& a, const Id& b) {
+			return a.subsystemId == b.subsystemId && a.objectId == b.objectId && a.triangleId == b.triangleId;
+		} };
+		const Id maxId{ (1u << VISIBILITY_SUBSYSTEM_BITS) - 1, VISIBILITY_MAX_OBJECTS - 1, VISIBILITY_MAX_TRIANGLES - 1 };
+		for (const Id& id : { Id{}, Id{ 1, 2, 3 }, Id{ 3, 0, VISIBILITY_MAX_TRIANGLES - 1 }, Id{ 0, VISIBILITY_MAX_OBJECTS - 1, 0 }, maxId }) {
+			uint32_t packedId{ PackId(id) };
+			CHECK(packedId != VISIBILITY_EMPTY_ID);
+			CHECK(isSameId(UnpackId(packedId), id));
+		}
+		// the fields use all 32 bits and the largest id allowed stays clear of the empty id
+		static_assert(VISIBILITY_TRIANGLE_BITS + VISIBILITY_OBJECT_BITS + VISIBILITY_SUBSYSTEM_BITS == 32);
+		CHECK(PackId(maxId) == UINT32_MAX);
+		CHECK(PackId(Id{ maxId.subsystemId, maxId.objectId, maxId.triangleId + 1 }) == VISIBILITY_EMPTY_ID);
+		// past their bits the fields wrap instead of spilling into the next one
+		CHECK(isSameId(UnpackId(PackId(Id{ 1, VISIBILITY_MAX_OBJECTS + 5, 7 })), Id{ 1, 5, 7 }));
+		CHECK(isSameId(UnpackId(PackId(Id{ 2, 9, VISIBILITY_MAX_TRIANGLES + 1 })), Id{ 2, 9, 0 }));
+
+		// different ids never share a packed id
+		std::mt19937 random{ 1 };
+		std::uniform_int_distribution<uint32_t> subsystemId{ 0, maxId.subsystemId };
+		std::uniform_int_distribution<uint32_t> objectId{ 0, maxId.objectId };
+		std::uniform_int_distribution<uint32_t> triangleId{ 0, maxId.triangleId };
+		std::unordered_set<uint64_t> ids{};
+		std::unordered_set<uint32_t> packedIds{};
+		for (size_t i{}; i < 100'000; ++i) {
+			Id id{ subsystemId(random), objectId(random), triangleId(random) };
+			uint32_t packedId{ PackId(id) };
+			CHECK(isSameId(UnpackId(packedId), id));
+			bool isNewId{ ids.insert(uint64_t{ id.subsystemId } << 48 | uint64_t{ id.objectId } << 24 | id.triangleId).second };
+			CHECK(packedIds.insert(packedId).second == isNewId);
+		}
+	}
+
+	void TestBarycentrics() {
+		DirectX::XMFLOAT4X4 projection{};
+		DirectX::XMStoreFloat4x4(&projection, DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(60.f), static_cast<float>(width / height), 1000.f, 0.1f));
+
+		std::mt19937 random{ 2 };
+		std::uniform_real_distribution<double> unit{ -1., 1. };
+		size_t testedCount{};
+		double maxLambdaError{};
+		double maxDerivativeError{};
+		double maxUvError{};
+		while (testedCount < 100'000) {
+			// triangles in front of the camera at any angle
+			Vector points[3]{};
+			DirectX::XMFLOAT4 clip[3]{};
+			double screen[3][2]{};
+			for (size_t i{}; i < 3; ++i) {
+				points[i] = Vector{ unit(random) * 3., unit(random) * 3., 2. + std::abs(unit(random)) * 8. };
+				DirectX::XMStoreFloat4(&clip[i], DirectX::XMVector3Transform(
+					DirectX::XMVectorSet(static_cast<float>(points[i].x), static_cast<float>(points[i].y), static_cast<float>(points[i].z), 1.f),
+					DirectX::XMLoadFloat4x4(&projection)
+				));
+				screen[i][0] = points[i].x * projection.m[0][0] / points[i].z;
+				screen[i][1] = points[i].y * projection.m[1][1] / points[i].z;
+			}
+			// at least a few pixels so there is a pixel center inside near the centroid
+			double area{ std::abs((screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1])
+				- (screen[1][1] - screen[0][1]) * (screen[2][0] - screen[0][0])) / 2. * width * height / 4. };
+			if (area < 16.) {
+				continue;
+			}
+
+			// the pixel center the centroid falls in
+			double centroidX{ (screen[0][0] + screen[1][0] + screen[2][0]) / 3. };
+			double centroidY{ (screen[0][1] + screen[1][1] + screen[2][1]) / 3. };
+			double ndcX{ (std::floor((centroidX + 1.) / 2. * width) + 0.5) / width * 2. - 1. };
+			double ndcY{ 1. - (std::floor((1. - centroidY) / 2. * height) + 0.5) / height * 2. };
+			double expected[3]{}, expectedX[3]{}, expectedY[3]{};
+			if (!GetExactBarycentrics(points, projection, ndcX, ndcY, expected)
+				|| !GetExactBarycentrics(points, projection, ndcX + 2. / width, ndcY, expectedX)
+				|| !GetExactBarycentrics(points, projection, ndcX, ndcY - 2. / height, expectedY)
+				|| std::min({ expected[0], expected[1], expected[2] }) < 0.) {
+				continue;
+			}
+
+			VisibilityBuffer::Barycentrics barycentrics{ VisibilityBuffer::ComputeBarycentrics(
+				clip[0], clip[1], clip[2],
+				{ static_cast<float>(ndcX), static_cast<float>(ndcY) },
+				{ static_cast<float>(2. / width), static_cast<float>(-2. / height) }
+			) };
+			const float* pLambda{ &barycentrics.lambda.x };
+			const float* pDdx{ &barycentrics.ddx.x };
+			const float* pDdy{ &barycentrics.ddy.x };
+			for (size_t i{}; i < 3; ++i) {
+				maxLambdaError = std::max(maxLambdaError, std::abs(pLambda[i] - expected[i]));
+				// a step of more than the whole triangle is a triangle seen edge on, float only keeps it relatively close
+				double expectedDdx{ expectedX[i] - expected[i] }, expectedDdy{ expectedY[i] - expected[i] };
+				if (std::abs(expectedDdx) < 1.) {
+					maxDerivativeError = std::max(maxDerivativeError, std::abs(pDdx[i] - expectedDdx));
+				}
+				if (std::abs(expectedDdy) < 1.) {
+					maxDerivativeError = std::max(maxDerivativeError, std::abs(pDdy[i] - expectedDdy));
+				}
+			}
+
+			// uvs interpolate with the perspective correct weights
+			DirectX::XMFLOAT2 uv{ VisibilityBuffer::Interpolate(barycentrics.lambda, { 0.f, 0.f }, { 4.f, 0.f }, { 0.f, 2.f }) };
+			maxUvError = std::max({ maxUvError, std::abs(uv.x - 4. * expected[1]), std::abs(uv.y - 2. * expected[2]) });
+			++testedCount;
+		}
+		CHECK(maxLambdaError < 1e-3);
+		CHECK(maxDerivativeError < 1e-3);
+		CHECK(maxUvError < 4e-3);
+
+		// at a vertex the weights pick that vertex
+		const DirectX::XMFLOAT4 clip0{ -0.5f, -0.5f, 0.f, 2.f }, clip1{ 1.5f, -0.5f, 0.f, 3.f }, clip2{ 0.f, 2.f, 0.f, 4.f };
+		VisibilityBuffer::Barycentrics atVertex{ VisibilityBuffer::ComputeBarycentrics(clip0, clip1, clip2, { 0.5f, -1.f / 6.f }, { 0.01f, -0.01f }) };
+		CHECK(std::abs(atVertex.lambda.y - 1.f) < 1e-5f && std::abs(atVertex.lambda.x) < 1e-5f && std::abs(atVertex.lambda.z) < 1e-5f);
+		// the weights always sum to 1 and the derivatives to 0
+		CHECK(std::abs(atVertex.ddx.x + atVertex.ddx.y + atVertex.ddx.z) < 1e-5f);
+		CHECK(std::abs(atVertex.ddy.x + atVertex.ddy.y + atVertex.ddy.z) < 1e-5f);
+	}
+}
+
+int main() {
+	TestPackId();
+	TestBarycentrics();
+	return Check::Finish("VisibilityBufferTests");
+}